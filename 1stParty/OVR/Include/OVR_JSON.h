@@ -56,8 +56,8 @@ Notes       :
 #include <memory>
 #include <vector>
 #include <string>
-#include <list>
 #include <fstream>
+#include <algorithm>
 
 #include "OVR_Types.h"
 #include "OVR_Math.h"
@@ -73,6 +73,12 @@ Notes       :
 #include <limits.h>
 #include <ctype.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 namespace OVR {
 
 // JSONItemType describes the type of JSON item, specifying the type of
@@ -236,43 +242,359 @@ inline char* PrintString(const char* str) {
     return out;
 }
 
+//-----------------------------------------------------------------------------
+// Returns the index of the first of the 16 bytes at p that is above ' ', or 16.
+inline int JSON_FindNonSpace16(const char* p) {
+#if defined(__SSE2__)
+    const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i isSpace = _mm_cmpeq_epi8(_mm_max_epu8(bytes, space), space);
+    const unsigned mask = ~_mm_movemask_epi8(isSpace) & 0xFFFF;
+    return (mask != 0) ? __builtin_ctz(mask) : 16;
+#elif defined(__aarch64__)
+    const uint8x16_t bytes = vld1q_u8(reinterpret_cast<const uint8_t*>(p));
+    const uint8x16_t notSpace = vcgtq_u8(bytes, vdupq_n_u8(' '));
+    // 4 bits per byte, as there is no movemask
+    const uint64_t mask =
+        vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(notSpace), 4)), 0);
+    return (mask != 0) ? (__builtin_ctzll(mask) >> 2) : 16;
+#else
+    for (int i = 0; i < 16; i++) {
+        if ((unsigned char)p[i] > ' ') {
+            return i;
+        }
+    }
+    return 16;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// Returns the index of the first of the 16 bytes at p that is a quote or a backslash, or 16.
+inline int JSON_FindQuoteOrEscape16(const char* p) {
+#if defined(__SSE2__)
+    const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    const __m128i special = _mm_or_si128(
+        _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\"')), _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\\')));
+    const unsigned mask = _mm_movemask_epi8(special);
+    return (mask != 0) ? __builtin_ctz(mask) : 16;
+#elif defined(__aarch64__)
+    const uint8x16_t bytes = vld1q_u8(reinterpret_cast<const uint8_t*>(p));
+    const uint8x16_t special =
+        vorrq_u8(vceqq_u8(bytes, vdupq_n_u8('\"')), vceqq_u8(bytes, vdupq_n_u8('\\')));
+    const uint64_t mask =
+        vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(special), 4)), 0);
+    return (mask != 0) ? (__builtin_ctzll(mask) >> 2) : 16;
+#else
+    for (int i = 0; i < 16; i++) {
+        if (p[i] == '\"' || p[i] == '\\') {
+            return i;
+        }
+    }
+    return 16;
+#endif
+}
+
 //-----------------------------------------------------------------------------
 // Utility to jump whitespace and cr/lf
-static const char* skip(const char* in) {
-    while (in && *in && (unsigned char)*in <= ' ')
+// end is the terminating null character, 16 bytes are scanned at a time up to there.
+static const char* skip(const char* in, const char* end) {
+    // values are mostly separated by nothing or a single space
+    if (!in || (unsigned char)*in > ' ') {
+        return in;
+    }
+    while (end - in >= 16) {
+        const int count = JSON_FindNonSpace16(in);
+        in += count;
+        if (count < 16) {
+            return in;
+        }
+    }
+    while (*in && (unsigned char)*in <= ' ')
         in++;
     return in;
 }
 
+//-----------------------------------------------------------------------------
+// Returns the first quote, backslash or the null character at or after str.
+inline const char* JSON_FindQuoteOrEscape(const char* str, const char* end) {
+    while (end - str >= 16) {
+        const int count = JSON_FindQuoteOrEscape16(str);
+        str += count;
+        if (count < 16) {
+            return str;
+        }
+    }
+    while (*str && *str != '\"' && *str != '\\')
+        str++;
+    return str;
+}
+
+//-----------------------------------------------------------------------------
+// Powers of ten that are exactly representable as doubles.
+static constexpr double JSON_ExactPowersOf10[23] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                                    1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                                    1e18, 1e19, 1e20, 1e21, 1e22};
+
+//-----------------------------------------------------------------------------
+// Hash of an object member name, used to find members without comparing every name.
+inline uint32_t JSON_HashName(const char* name) {
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (; *name != '\0'; name++) {
+        hash = (hash ^ (uint8_t)*name) * 16777619u;
+    }
+    return hash;
+}
+
+//-----------------------------------------------------------------------------
+// Parses the number at num and returns the first character after it.
+inline const char* JSON_ParseNumber(const char* num, double& value) {
+    const char* num_start = num;
+    bool negative = false;
+    uint64_t mantissa = 0;
+    int digits = 0; // significant digits in mantissa
+    int scale = 0, subscale = 0, signsubscale = 1;
+
+    if (*num == '-') {
+        negative = true, num++; // Has sign?
+    }
+    if (*num == '0') {
+        num++; // is zero
+    }
+
+    if (*num >= '1' && *num <= '9') {
+        do {
+            mantissa = mantissa * 10 + (*num++ - '0');
+            digits++;
+        } while (*num >= '0' && *num <= '9'); // Number?
+    }
+
+    if (*num == '.' && num[1] >= '0' && num[1] <= '9') {
+        num++;
+        do {
+            mantissa = mantissa * 10 + (*num++ - '0');
+            digits += (mantissa != 0); // leading zeros of the fraction aren't significant
+            scale--;
+        } while (*num >= '0' && *num <= '9'); // Fractional part?
+    }
+
+    if (*num == 'e' || *num == 'E') // Exponent?
+    {
+        num++;
+        if (*num == '+') {
+            num++;
+        } else if (*num == '-') {
+            signsubscale = -1;
+            num++; // With sign?
+        }
+
+        while (*num >= '0' && *num <= '9') {
+            if (subscale < 100000) {
+                subscale = (subscale * 10) + (*num - '0'); // Number?
+            }
+            num++;
+        }
+    }
+
+    // Number = +/- number.fraction * 10^+/- exponent
+    const int exponent = scale + subscale * signsubscale;
+    double n;
+    if (digits == 0) {
+        n = 0; // whatever the exponent
+    } else if (digits <= 19 && mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22) {
+        // the mantissa and the power of ten are exact, so one rounding gives the closest double
+        n = (double)mantissa;
+        n = (exponent < 0) ? n / JSON_ExactPowersOf10[-exponent]
+                           : n * JSON_ExactPowersOf10[exponent];
+    } else {
+        n = 0;
+        for (const char* d = num_start + negative; d < num && *d != 'e' && *d != 'E'; d++) {
+            if (*d != '.') {
+                n = (n * 10.0) + (*d - '0');
+            }
+        }
+        n = n * pow(10.0, exponent);
+    }
+
+    value = negative ? -n : n;
+    return num;
+}
+
+//-----------------------------------------------------------------------------
+// Un-escapes the string that starts with the quote at str into out, and returns the first
+// character after the closing quote.
+inline const char* JSON_ParseString(const char* str, const char* end, std::string& out) {
+    const char* ptr = str + 1;
+    const char* p;
+    char* ptr2;
+    char utf8[4];
+    int len = 0;
+    unsigned uc, uc2;
+
+    // Copy runs without escapes straight from the text.
+    out.clear();
+    for (;;) {
+        const char* run = JSON_FindQuoteOrEscape(ptr, end);
+        out.append(ptr, run - ptr);
+        ptr = run;
+        if (*ptr != '\\') {
+            break; // closing quote or end of text
+        }
+
+        ptr++;
+        switch (*ptr) {
+            case 'b':
+                out += '\b';
+                break;
+            case 'f':
+                out += '\f';
+                break;
+            case 'n':
+                out += '\n';
+                break;
+            case 'r':
+                out += '\r';
+                break;
+            case 't':
+                out += '\t';
+                break;
+
+            // Transcode utf16 to utf8.
+            case 'u':
+
+                // Get the unicode char.
+                p = ParseHex(&uc, 4, ptr + 1);
+                if (ptr != p)
+                    ptr = p - 1;
+
+                if ((uc >= 0xDC00 && uc <= 0xDFFF) || uc == 0)
+                    break; // Check for invalid.
+
+                // UTF16 surrogate pairs.
+                if (uc >= 0xD800 && uc <= 0xDBFF) {
+                    if (ptr[1] != '\\' || ptr[2] != 'u')
+                        break; // Missing second-half of surrogate.
+
+                    p = ParseHex(&uc2, 4, ptr + 3);
+                    if (ptr != p)
+                        ptr = p - 1;
+
+                    if (uc2 < 0xDC00 || uc2 > 0xDFFF)
+                        break; // Invalid second-half of surrogate.
+
+                    uc = 0x10000 + (((uc & 0x3FF) << 10) | (uc2 & 0x3FF));
+                }
+
+                len = 4;
+
+                if (uc < 0x80)
+                    len = 1;
+                else if (uc < 0x800)
+                    len = 2;
+                else if (uc < 0x10000)
+                    len = 3;
+
+                ptr2 = utf8 + len;
+
+                switch (len) {
+                    case 4:
+                        *--ptr2 = static_cast<char>((uc | 0x80) & 0xBF);
+                        uc >>= 6;
+                        [[fallthrough]];
+                    case 3:
+                        *--ptr2 = static_cast<char>((uc | 0x80) & 0xBF);
+                        uc >>= 6;
+                        [[fallthrough]];
+                    case 2:
+                        *--ptr2 = static_cast<char>((uc | 0x80) & 0xBF);
+                        uc >>= 6;
+                        [[fallthrough]];
+                    case 1:
+                        *--ptr2 = (char)(uc | firstByteMark[len]);
+                        // no break
+                }
+                out.append(utf8, len);
+                break;
+
+            default:
+                if (*ptr) {
+                    out += *ptr;
+                }
+                break;
+        }
+        if (*ptr) {
+            ptr++;
+        }
+    }
+
+    if (*ptr == '\"')
+        ptr++;
+
+    return ptr;
+}
+
+class JSON;
+
+//-----------------------------------------------------------------------------
+// ***** JSONArena
+
+// Storage for JSON nodes. Nodes are allocated in blocks and are all freed together with the
+// arena. Pointers to nodes share ownership of the whole arena. Parsed trees use one arena, nodes
+// made with the JSON::Create functions get an arena of their own.
+
+class JSONArena : public std::enable_shared_from_this<JSONArena> {
+   public:
+    JSONArena(int firstBlockSize = 64)
+        : FirstBlockSize(firstBlockSize), BlockSize(0), Used(0) {}
+
+    JSON* Allocate();
+
+   private:
+    JSONArena(const JSONArena&) = delete;
+    JSONArena& operator=(const JSONArena&) = delete;
+
+    friend class JSON;
+
+    std::vector<std::unique_ptr<JSON[]>> Blocks;
+    int FirstBlockSize;
+    int BlockSize;
+    int Used; // nodes used in the last block
+    // Children of the nodes being parsed, so each node allocates its child array only once.
+    std::vector<JSON*> ParseStack;
+};
+
 //-----------------------------------------------------------------------------
 // ***** JSON
 
 // JSON object represents a JSON node that can be either a root of the JSON tree
 // or a child item. Every node has a type that describes what it is.
 // New JSON trees are typically loaded with JSON::Load or created with JSON::Parse.
+// Nodes live in a JSONArena, and parents keep the arenas of children that were
+// added to them alive. Nodes should only be made with the Parse and Create functions.
 
 class JSON {
    public:
-    std::list<std::shared_ptr<JSON>> Children;
+    std::vector<JSON*> Children; // Owned by the arena, or by Extra->OwnedChildren.
     JSONItemType Type; // Type of this JSON node.
-    std::string Name; // Name part of the {Name, Value} pair in a parent object.
+    std::string Name; // Name part of the {Name, Value} pair in a parent object, set with AddItem.
     std::string Value;
     double dValue;
 
    public:
-    JSON(JSONItemType itemType = JSON_Object) : Type(itemType), dValue(0.0) {}
+    JSON(JSONItemType itemType = JSON_Object)
+        : Type(itemType), dValue(0.0), NameHash(JSON_HashName("")), Arena(nullptr) {}
     ~JSON() {}
 
     // *** Creation of NEW JSON objects
 
     static std::shared_ptr<JSON> CreateObject() {
-        return std::make_shared<JSON>(JSON_Object);
+        return createHelper(JSON_Object, 0.0);
     }
     static std::shared_ptr<JSON> CreateNull() {
-        return std::make_shared<JSON>(JSON_Null);
+        return createHelper(JSON_Null, 0.0);
     }
     static std::shared_ptr<JSON> CreateArray() {
-        return std::make_shared<JSON>(JSON_Array);
+        return createHelper(JSON_Array, 0.0);
     }
     static std::shared_ptr<JSON> CreateBool(bool b) {
         return createHelper(JSON_Bool, b ? 1.0 : 0.0);
@@ -288,19 +610,16 @@ class JSON {
     // Returns a null pointer and fills in *perror in case of parse error.
     static std::shared_ptr<JSON> Parse(const char* buff, const char** perror = nullptr) {
         const char* end = nullptr;
-        std::shared_ptr<JSON> json = std::make_shared<JSON>();
-
-        if (json == nullptr) {
-            AssignError(perror, "Error: Failed to allocate memory");
-            return nullptr;
-        }
+        const char* textEnd = (buff != nullptr) ? buff + strlen(buff) : nullptr;
+        std::shared_ptr<JSONArena> arena = std::make_shared<JSONArena>();
+        JSON* json = arena->Allocate();
 
-        end = json->parseValue(skip(buff), perror);
+        end = json->parseValue(skip(buff, textEnd), textEnd, perror);
         if (!end) {
             return nullptr;
         } // parse failure. ep is set.
 
-        return json;
+        return std::shared_ptr<JSON>(arena, json);
     }
 
     // Loads and parses a JSON object from a file.
@@ -385,7 +704,8 @@ class JSON {
         if (!item)
             return;
         item->Name = string;
-        Children.push_back(item);
+        item->NameHash = JSON_HashName(string);
+        addChild(item);
     }
     void AddBoolItem(const char* name, bool b) {
         AddItem(name, CreateBool(b));
@@ -405,61 +725,56 @@ class JSON {
     }
     // Returns first/last child item, or null if child list is empty.
     std::shared_ptr<JSON> GetFirstItem() {
-        return (!Children.empty()) ? Children.front() : nullptr;
+        return (!Children.empty()) ? shareNode(Children.front()) : nullptr;
     }
     const std::shared_ptr<JSON> GetFirstItem() const {
-        return (!Children.empty()) ? Children.front() : nullptr;
+        return (!Children.empty()) ? shareNode(Children.front()) : nullptr;
     }
     std::shared_ptr<JSON> GetLastItem() {
-        return (!Children.empty()) ? Children.back() : nullptr;
+        return (!Children.empty()) ? shareNode(Children.back()) : nullptr;
     }
     const std::shared_ptr<JSON> GetLastItem() const {
-        return (!Children.empty()) ? Children.back() : nullptr;
+        return (!Children.empty()) ? shareNode(Children.back()) : nullptr;
     }
 
-    // Counts the number of items in the object; these methods are inefficient.
     unsigned GetItemCount() const {
         return static_cast<unsigned>(Children.size());
     }
     std::shared_ptr<JSON> GetItemByIndex(unsigned index) {
-        for (const std::shared_ptr<JSON>& child : Children) {
-            if (index-- == 0) {
-                return child;
-            }
-        }
-        return nullptr;
+        return (index < Children.size()) ? shareNode(Children[index]) : nullptr;
     }
     const std::shared_ptr<JSON> GetItemByIndex(unsigned index) const {
-        for (const std::shared_ptr<JSON>& child : Children) {
-            if (index-- == 0) {
-                return child;
-            }
-        }
-        return nullptr;
+        return (index < Children.size()) ? shareNode(Children[index]) : nullptr;
     }
     std::shared_ptr<JSON> GetItemByName(const char* name) {
-        for (const std::shared_ptr<JSON>& child : Children) {
-            if (OVR_strcmp(child->Name.c_str(), name) == 0) {
-                return child;
-            }
-        }
-        return nullptr;
+        const int index = findItem(name, JSON_HashName(name));
+        return (index >= 0) ? shareNode(Children[index]) : nullptr;
     }
     const std::shared_ptr<JSON> GetItemByName(const char* name) const {
-        for (const std::shared_ptr<JSON>& child : Children) {
-            if (OVR_strcmp(child->Name.c_str(), name) == 0) {
-                return child;
-            }
-        }
-        return nullptr;
+        const int index = findItem(name, JSON_HashName(name));
+        return (index >= 0) ? shareNode(Children[index]) : nullptr;
     }
     void ReplaceNodeWith(const char* name, const std::shared_ptr<JSON> newNode) {
-        for (auto it = Children.begin(); it != Children.end(); ++it) {
-            if (OVR_strcmp((*it)->Name.c_str(), name) == 0) {
-                *it = newNode;
-                return;
+        const int index = findItem(name, JSON_HashName(name));
+        if (index < 0 || !newNode) {
+            return;
+        }
+        std::vector<std::shared_ptr<JSON>>& owned = getExtra().OwnedChildren;
+        for (auto it = owned.begin(); it != owned.end(); ++it) {
+            if (it->get() == Children[index]) {
+                owned.erase(it);
+                break;
             }
         }
+        Children[index] = newNode.get();
+        owned.push_back(newNode);
+        Extra->NameIndex.clear();
+        updateNameIndex();
+    }
+
+    // Returns a pointer that keeps this node alive, along with the rest of its arena.
+    std::shared_ptr<JSON> GetShared() {
+        return shareNode(this);
     }
 
     /*
@@ -517,7 +832,7 @@ class JSON {
             return;
         }
 
-        Children.push_back(item);
+        addChild(item);
     }
     void AddArrayBool(bool b) {
         AddArrayElement(CreateBool(b));
@@ -529,7 +844,6 @@ class JSON {
         AddArrayElement(CreateString(s));
     }
 
-    // Accessed array elements; currently inefficient.
     int GetArraySize() const {
         if (Type == JSON_Array) {
             return GetItemCount();
@@ -537,17 +851,15 @@ class JSON {
             return 0;
     }
     double GetArrayNumber(int index) const {
-        if (Type == JSON_Array) {
-            const std::shared_ptr<JSON> number = GetItemByIndex(index);
-            return number ? number->dValue : 0.0;
+        if (Type == JSON_Array && index >= 0 && index < static_cast<int>(Children.size())) {
+            return Children[index]->dValue;
         } else {
             return 0;
         }
     }
     const char* GetArrayString(int index) const {
-        if (Type == JSON_Array) {
-            const std::shared_ptr<JSON> number = GetItemByIndex(index);
-            return number ? number->Value.c_str() : nullptr;
+        if (Type == JSON_Array && index >= 0 && index < static_cast<int>(Children.size())) {
+            return Children[index]->Value.c_str();
         } else {
             return nullptr;
         }
@@ -591,19 +903,99 @@ class JSON {
     }
 
    protected:
+    // Objects with at least this many members get a sorted index of member name hashes.
+    static const int NAME_INDEX_MIN_ITEMS = 16;
+
+    // Rarely needed, so nodes stay small.
+    struct ExtraData {
+        std::vector<uint64_t> NameIndex; // NameHash << 32 | child index, sorted
+        std::vector<std::shared_ptr<JSON>> OwnedChildren; // children added from other arenas
+    };
+
+    uint32_t NameHash; // JSON_HashName( Name )
+    std::unique_ptr<ExtraData> Extra;
+    JSONArena* Arena;
+
+    ExtraData& getExtra() {
+        if (!Extra) {
+            Extra.reset(new ExtraData());
+        }
+        return *Extra;
+    }
+
+    static std::shared_ptr<JSON> shareNode(const JSON* node) {
+        JSON* n = const_cast<JSON*>(node);
+        if (n->Arena == nullptr) {
+            // not made by Parse or Create, only valid while its parent is
+            return std::shared_ptr<JSON>(std::shared_ptr<JSON>(), n);
+        }
+        return std::shared_ptr<JSON>(n->Arena->shared_from_this(), n);
+    }
+
+    void addChild(const std::shared_ptr<JSON>& item) {
+        Children.push_back(item.get());
+        getExtra().OwnedChildren.push_back(item);
+        updateNameIndex();
+    }
+
+    // Keeps the name index up to date after children were added.
+    void updateNameIndex() {
+        const int count = static_cast<int>(Children.size());
+        if (count < NAME_INDEX_MIN_ITEMS) {
+            if (Extra) {
+                Extra->NameIndex.clear();
+            }
+            return;
+        }
+        std::vector<uint64_t>& index = getExtra().NameIndex;
+        if (static_cast<int>(index.size()) + 1 == count) {
+            const uint64_t key = ((uint64_t)Children[count - 1]->NameHash << 32) | (count - 1);
+            index.insert(std::upper_bound(index.begin(), index.end(), key), key);
+            return;
+        }
+        index.resize(count);
+        for (int i = 0; i < count; i++) {
+            index[i] = ((uint64_t)Children[i]->NameHash << 32) | i;
+        }
+        std::sort(index.begin(), index.end());
+    }
+
+    // Returns the index of the first child with the given name, or -1.
+    int findItem(const char* name, const uint32_t hash) const {
+        if (Extra && !Extra->NameIndex.empty()) {
+            const std::vector<uint64_t>& index = Extra->NameIndex;
+            for (auto it = std::lower_bound(index.begin(), index.end(), (uint64_t)hash << 32);
+                 it != index.end() && (uint32_t)(*it >> 32) == hash;
+                 ++it) {
+                const int i = (int)(*it & 0xFFFFFFFF);
+                if (OVR_strcmp(Children[i]->Name.c_str(), name) == 0) {
+                    return i;
+                }
+            }
+            return -1;
+        }
+        for (int i = 0; i < static_cast<int>(Children.size()); i++) {
+            if (Children[i]->NameHash == hash && OVR_strcmp(Children[i]->Name.c_str(), name) == 0) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
     static std::shared_ptr<JSON>
     createHelper(JSONItemType itemType, double dval, const char* strVal = nullptr) {
-        std::shared_ptr<JSON> item = std::make_shared<JSON>(itemType);
-        if (item) {
-            item->dValue = dval;
-            if (strVal)
-                item->Value = strVal;
-        }
-        return item;
+        std::shared_ptr<JSONArena> arena = std::make_shared<JSONArena>(1);
+        JSON* item = arena->Allocate();
+        item->Type = itemType;
+        item->dValue = dval;
+        if (strVal)
+            item->Value = strVal;
+        return std::shared_ptr<JSON>(arena, item);
     }
 
     // JSON Parsing helper functions.
-    const char* parseValue(const char* buff, const char** perror) {
+    // end points at the null character that terminates the text.
+    const char* parseValue(const char* buff, const char* end, const char** perror) {
         if (perror)
             *perror = 0;
 
@@ -627,297 +1019,137 @@ class JSON {
             return buff + 4;
         }
         if (*buff == '\"') {
-            return parseString(buff, perror);
+            return parseString(buff, end, perror);
         }
         if (*buff == '-' || (*buff >= '0' && *buff <= '9')) {
             return parseNumber(buff);
         }
         if (*buff == '[') {
-            return parseArray(buff, perror);
+            return parseArray(buff, end, perror);
         }
         if (*buff == '{') {
-            return parseObject(buff, perror);
+            return parseObject(buff, end, perror);
         }
 
         return AssignError(perror, (std::string("Syntax Error: Invalid syntax: ") + buff).c_str());
     }
     const char* parseNumber(const char* num) {
-        const char* num_start = num;
-        double n = 0, sign = 1, scale = 0;
-        int subscale = 0, signsubscale = 1;
-
-        // Could use sscanf for this?
-        if (*num == '-') {
-            sign = -1, num++; // Has sign?
-        }
-        if (*num == '0') {
-            num++; // is zero
-        }
-
-        if (*num >= '1' && *num <= '9') {
-            do {
-                n = (n * 10.0) + (*num++ - '0');
-            } while (*num >= '0' && *num <= '9'); // Number?
-        }
-
-        if (*num == '.' && num[1] >= '0' && num[1] <= '9') {
-            num++;
-            do {
-                n = (n * 10.0) + (*num++ - '0');
-                scale--;
-            } while (*num >= '0' && *num <= '9'); // Fractional part?
-        }
-
-        if (*num == 'e' || *num == 'E') // Exponent?
-        {
-            num++;
-            if (*num == '+') {
-                num++;
-            } else if (*num == '-') {
-                signsubscale = -1;
-                num++; // With sign?
-            }
-
-            while (*num >= '0' && *num <= '9') {
-                subscale = (subscale * 10) + (*num++ - '0'); // Number?
-            }
-        }
-
-        // Number = +/- number.fraction * 10^+/- exponent
-        n = sign * n * pow(10.0, (scale + subscale * signsubscale));
-
-        // Assign parsed value.
+        const char* numEnd = JSON_ParseNumber(num, dValue);
         Type = JSON_Number;
-        dValue = n;
-        Value.assign(num_start, num - num_start);
-
-        return num;
+        Value.assign(num, numEnd - num);
+        return numEnd;
     }
-    const char* parseArray(const char* buff, const char** perror) {
-        std::shared_ptr<JSON> child;
+    const char* parseArray(const char* buff, const char* end, const char** perror) {
+        JSON* child;
         if (*buff != '[') {
             return AssignError(perror, "Syntax Error: Missing opening bracket");
         }
 
         Type = JSON_Array;
-        buff = skip(buff + 1);
+        buff = skip(buff + 1, end);
 
         if (*buff == ']')
             return buff + 1; // empty array.
 
-        child = std::make_shared<JSON>();
-        if (!child)
-            return nullptr; // memory fail
-        Children.push_back(child);
+        std::vector<JSON*>& stack = Arena->ParseStack;
+        const size_t first = stack.size();
+        child = Arena->Allocate();
+        stack.push_back(child);
 
-        buff = skip(child->parseValue(skip(buff), perror)); // skip any spacing, get the buff.
+        // skip any spacing, get the buff.
+        buff = skip(child->parseValue(skip(buff, end), end, perror), end);
         if (!buff)
             return 0;
 
         while (*buff == ',') {
-            std::shared_ptr<JSON> new_item = std::make_shared<JSON>();
-            if (!new_item)
-                return AssignError(perror, "Error: Failed to allocate memory");
+            JSON* new_item = Arena->Allocate();
+            stack.push_back(new_item);
 
-            Children.push_back(new_item);
-
-            buff = skip(new_item->parseValue(skip(buff + 1), perror));
+            buff = skip(new_item->parseValue(skip(buff + 1, end), end, perror), end);
             if (!buff)
                 return AssignError(perror, "Error: Failed to allocate memory");
         }
 
-        if (*buff == ']')
+        if (*buff == ']') {
+            takeChildren(first);
             return buff + 1; // end of array
+        }
 
         return AssignError(perror, "Syntax Error: Missing ending bracket");
     }
-    const char* parseObject(const char* buff, const char** perror) {
+    const char* parseObject(const char* buff, const char* end, const char** perror) {
         if (*buff != '{') {
             return AssignError(perror, "Syntax Error: Missing opening brace");
         }
 
         Type = JSON_Object;
-        buff = skip(buff + 1);
+        buff = skip(buff + 1, end);
         if (*buff == '}')
             return buff + 1; // empty array.
 
-        std::shared_ptr<JSON> child = std::make_shared<JSON>();
-        Children.push_back(child);
+        std::vector<JSON*>& stack = Arena->ParseStack;
+        const size_t first = stack.size();
+        JSON* child = Arena->Allocate();
+        stack.push_back(child);
 
-        buff = skip(child->parseString(skip(buff), perror));
+        buff = skip(child->parseString(skip(buff, end), end, perror), end);
         if (!buff)
             return 0;
-        child->Name = child->Value;
-        child->Value.clear();
+        child->setNameFromValue();
 
         if (*buff != ':') {
             return AssignError(perror, "Syntax Error: Missing colon");
         }
 
-        buff = skip(child->parseValue(skip(buff + 1), perror)); // skip any spacing, get the value.
+        // skip any spacing, get the value.
+        buff = skip(child->parseValue(skip(buff + 1, end), end, perror), end);
         if (!buff)
             return 0;
 
         while (*buff == ',') {
-            child = std::make_shared<JSON>();
-            if (!child)
-                return 0; // memory fail
-
-            Children.push_back(child);
+            child = Arena->Allocate();
+            stack.push_back(child);
 
-            buff = skip(child->parseString(skip(buff + 1), perror));
+            buff = skip(child->parseString(skip(buff + 1, end), end, perror), end);
             if (!buff)
                 return 0;
 
-            child->Name = child->Value;
-            child->Value.clear();
+            child->setNameFromValue();
 
             if (*buff != ':') {
                 return AssignError(perror, "Syntax Error: Missing colon");
             } // fail!
 
             // Skip any spacing, get the value.
-            buff = skip(child->parseValue(skip(buff + 1), perror));
+            buff = skip(child->parseValue(skip(buff + 1, end), end, perror), end);
             if (!buff)
                 return 0;
         }
 
-        if (*buff == '}')
+        if (*buff == '}') {
+            takeChildren(first);
+            updateNameIndex();
             return buff + 1; // end of array
+        }
 
         return AssignError(perror, "Syntax Error: Missing closing brace");
     }
-    const char* parseString(const char* str, const char** perror) {
-        const char* ptr = str + 1;
-        const char* p;
-        char* ptr2;
-        char* out;
-        int len = 0;
-        unsigned uc, uc2;
-
+    void takeChildren(const size_t first) {
+        std::vector<JSON*>& stack = Arena->ParseStack;
+        Children.assign(stack.begin() + first, stack.end());
+        stack.resize(first);
+    }
+    void setNameFromValue() {
+        Name.swap(Value);
+        Value.clear();
+        NameHash = JSON_HashName(Name.c_str());
+    }
+    const char* parseString(const char* str, const char* end, const char** perror) {
         if (*str != '\"') {
             return AssignError(perror, "Syntax Error: Missing quote");
         }
-
-        while (*ptr != '\"' && *ptr && ++len) {
-            if (*ptr++ == '\\') {
-                if (*ptr) {
-                    ptr++; // Skip escaped quotes.
-                } else {
-                    // we reached the end of the file too soon, stop
-                }
-            }
-        }
-
-        // This is how long we need for the string, roughly.
-        out = (char*)malloc(len + 1);
-        if (!out)
-            return 0;
-
-        ptr = str + 1;
-        ptr2 = out;
-
-        while (*ptr != '\"' && *ptr) {
-            if (*ptr != '\\') {
-                *ptr2++ = *ptr++;
-            } else {
-                ptr++;
-                switch (*ptr) {
-                    case 'b':
-                        *ptr2++ = '\b';
-                        break;
-                    case 'f':
-                        *ptr2++ = '\f';
-                        break;
-                    case 'n':
-                        *ptr2++ = '\n';
-                        break;
-                    case 'r':
-                        *ptr2++ = '\r';
-                        break;
-                    case 't':
-                        *ptr2++ = '\t';
-                        break;
-
-                    // Transcode utf16 to utf8.
-                    case 'u':
-
-                        // Get the unicode char.
-                        p = ParseHex(&uc, 4, ptr + 1);
-                        if (ptr != p)
-                            ptr = p - 1;
-
-                        if ((uc >= 0xDC00 && uc <= 0xDFFF) || uc == 0)
-                            break; // Check for invalid.
-
-                        // UTF16 surrogate pairs.
-                        if (uc >= 0xD800 && uc <= 0xDBFF) {
-                            if (ptr[1] != '\\' || ptr[2] != 'u')
-                                break; // Missing second-half of surrogate.
-
-                            p = ParseHex(&uc2, 4, ptr + 3);
-                            if (ptr != p)
-                                ptr = p - 1;
-
-                            if (uc2 < 0xDC00 || uc2 > 0xDFFF)
-                                break; // Invalid second-half of surrogate.
-
-                            uc = 0x10000 + (((uc & 0x3FF) << 10) | (uc2 & 0x3FF));
-                        }
-
-                        len = 4;
-
-                        if (uc < 0x80)
-                            len = 1;
-                        else if (uc < 0x800)
-                            len = 2;
-                        else if (uc < 0x10000)
-                            len = 3;
-
-                        ptr2 += len;
-
-                        switch (len) {
-                            case 4:
-                                *--ptr2 = static_cast<char>((uc | 0x80) & 0xBF);
-                                uc >>= 6;
-                                [[fallthrough]];
-                            case 3:
-                                *--ptr2 = static_cast<char>((uc | 0x80) & 0xBF);
-                                uc >>= 6;
-                                [[fallthrough]];
-                            case 2:
-                                *--ptr2 = static_cast<char>((uc | 0x80) & 0xBF);
-                                uc >>= 6;
-                                [[fallthrough]];
-                            case 1:
-                                *--ptr2 = (char)(uc | firstByteMark[len]);
-                                // no break
-                        }
-                        ptr2 += len;
-                        break;
-
-                    default:
-                        if (*ptr) {
-                            *ptr2++ = *ptr;
-                        }
-                        break;
-                }
-                if (*ptr) {
-                    ptr++;
-                }
-            }
-        }
-
-        *ptr2 = 0;
-        if (*ptr == '\"')
-            ptr++;
-
-        // Make a copy of the string
-        Value = out;
-        free(out);
         Type = JSON_String;
-
-        return ptr;
+        return JSON_ParseString(str, end, Value);
     }
 
     char* PrintObject(int depth, bool fmt) const {
@@ -1073,7 +1305,7 @@ class JSON {
 
         //// Retrieve all the results:
         int entry = 0;
-        for (std::shared_ptr<JSON> child : Children) {
+        for (const JSON* child : Children) {
             if (entry >= numentries)
                 break;
 
@@ -1126,9 +1358,21 @@ class JSON {
         return out;
     }
 
+    friend class JSONArena;
     friend class JsonReader;
 };
 
+inline JSON* JSONArena::Allocate() {
+    if (Used == BlockSize) {
+        BlockSize = Blocks.empty() ? FirstBlockSize : std::min(BlockSize * 2, 1024);
+        Blocks.emplace_back(new JSON[BlockSize]);
+        Used = 0;
+    }
+    JSON* node = &Blocks.back()[Used++];
+    node->Arena = this;
+    return node;
+}
+
 //-----------------------------------------------------------------------------
 // ***** JsonReader
 
@@ -1145,7 +1389,7 @@ class JSON {
 // the object names with minimal effort. If the children of a node are read
 // in the order they appear in the JSON file then using this class results in
 // only one string comparison per child. Only if the children are read out
-// of order, all children may have to be iterated to match a child name.
+// of order, the child has to be looked up by the hash of its name.
 // This should, however, only happen when the code that writes out the JSON
 // file has been changed without updating the code that reads back the data.
 // Either way this class will do the right thing as long as the JSON tree is
@@ -1186,13 +1430,9 @@ class JSON {
 
 class JsonReader {
    public:
-    JsonReader(const std::shared_ptr<JSON> json) : Parent(json) {
-        if (Parent) {
-            Child = Parent->Children.begin();
-        }
-    }
+    JsonReader(const std::shared_ptr<JSON> json) : Parent(json), Child(0) {}
 
-    JsonReader(std::list<std::shared_ptr<JSON>>::iterator it) : JsonReader(*it) {}
+    JsonReader(std::vector<JSON*>::iterator it) : JsonReader((*it)->GetShared()) {}
 
     const std::shared_ptr<JSON> AsParent() const {
         return Parent;
@@ -1209,14 +1449,13 @@ class JsonReader {
     }
     bool IsEndOfArray() const {
         OVR_ASSERT(Parent != nullptr);
-        return (Child == Parent->Children.end());
+        return (Child >= Parent->Children.size());
     }
 
-    std::list<std::shared_ptr<JSON>>::iterator GetFirstChild() const {
+    std::vector<JSON*>::iterator GetFirstChild() const {
         return Parent->Children.begin();
     }
-    std::list<std::shared_ptr<JSON>>::iterator GetNextChild(
-        std::list<std::shared_ptr<JSON>>::iterator& child) const {
+    std::vector<JSON*>::iterator GetNextChild(std::vector<JSON*>::iterator& child) const {
         auto childClone = child;
         ++childClone;
         return childClone;
@@ -1226,19 +1465,18 @@ class JsonReader {
         assert(IsObject());
 
         // Check if the the cached child pointer is valid.
-        if (Child != Parent->Children.end()) {
-            if (OVR_strcmp((*Child)->Name.c_str(), childName) == 0) {
-                const std::shared_ptr<JSON> c = *Child;
+        if (Child < Parent->Children.size()) {
+            const JSON* c = Parent->Children[Child];
+            if (OVR_strcmp(c->Name.c_str(), childName) == 0) {
                 ++Child; // Cache the next child.
-                return c;
+                return shareChild(c);
             }
         }
-        // Itereate over all children.
-        for (auto c = Parent->Children.begin(); c != Parent->Children.end(); ++c) {
-            if (OVR_strcmp((*c)->Name.c_str(), childName) == 0) {
-                Child = c; // Cache the next child.
-                return *c;
-            }
+        // Look up the child by name.
+        const int index = Parent->findItem(childName, JSON_HashName(childName));
+        if (index >= 0) {
+            Child = index + 1; // Cache the next child.
+            return shareChild(Parent->Children[index]);
         }
         return 0;
     }
@@ -1274,10 +1512,8 @@ class JsonReader {
         assert(IsArray());
 
         // Check if the the cached child pointer is valid.
-        if (Child != Parent->Children.end()) {
-            const std::shared_ptr<JSON> c = *Child;
-            ++Child; // Cache the next child.
-            return c;
+        if (Child < Parent->Children.size()) {
+            return shareChild(Parent->Children[Child++]); // Cache the next child.
         }
         return nullptr;
     }
@@ -1308,8 +1544,335 @@ class JsonReader {
     }
 
    private:
+    // Children in the same arena can share the parent's ownership, which is cheaper than
+    // getting it from the arena.
+    std::shared_ptr<JSON> shareChild(const JSON* child) const {
+        if (child->Arena != nullptr && child->Arena == Parent->Arena) {
+            return std::shared_ptr<JSON>(Parent, const_cast<JSON*>(child));
+        }
+        return JSON::shareNode(child);
+    }
+
     std::shared_ptr<JSON> Parent;
-    mutable std::list<std::shared_ptr<JSON>>::iterator Child; // cached child pointer (iterator)
+    mutable size_t Child; // cached child index
+};
+
+//-----------------------------------------------------------------------------
+// ***** JsonStreamReader
+
+// Pull reader that reads values straight from JSON text without building a tree.
+//
+// Objects are visited member by member and arrays element by element in the
+// order they appear in the text, so large arrays can be read one element at a
+// time without the memory and time needed to build all of their nodes first.
+// Unlike JsonReader, members can't be looked up by name, so code that needs
+// members in a certain order has to store them until the object is read.
+//
+// Values that are not read before moving on to the next member or element are
+// skipped, and reading a value of another type than it has skips the value and
+// returns the default, so unexpected data is ignored the same way JsonReader
+// ignores it. Skipped values are only checked for matching brackets, and text
+// after the root value is an error. After a syntax error all reads return their
+// defaults and HasError() returns true.
+//
+// Every object or array that is entered has to be read until NextMember() or
+// NextElement() returns false, the reader doesn't keep a stack of containers.
+// The text must be null terminated and has to stay valid while it is read.
+//
+//	JsonStreamReader reader( text );
+//	if ( reader.BeginObject() )
+//	{
+//		while ( reader.NextMember() )
+//		{
+//			if ( reader.IsName( "vertices" ) && reader.BeginArray() )
+//			{
+//				while ( reader.NextElement() )
+//				{
+//					if ( reader.BeginObject() )
+//					{
+//						Vector3f v( 0.0f );
+//						while ( reader.NextMember() )
+//						{
+//							if ( reader.IsName( "x" ) ) v.x = reader.ReadFloat( 0.0f );
+//							else if ( reader.IsName( "y" ) ) v.y = reader.ReadFloat( 0.0f );
+//							else if ( reader.IsName( "z" ) ) v.z = reader.ReadFloat( 0.0f );
+//						}
+//					}
+//				}
+//			}
+//		}
+//	}
+//	if ( reader.HasError() ) ...
+//
+
+class JsonStreamReader {
+   public:
+    JsonStreamReader(const char* text)
+        : Text(text),
+          End(text + strlen(text)),
+          Cur(skip(text, End)),
+          Error(nullptr),
+          ErrorOffset(0),
+          Depth(0),
+          First(false),
+          Pending(true) {}
+
+    bool HasError() const {
+        return Error != nullptr;
+    }
+    const char* GetError() const {
+        return Error;
+    }
+    // Offset of the next value in the text, or of the syntax error.
+    size_t GetOffset() const {
+        return (Error != nullptr) ? ErrorOffset : static_cast<size_t>(Cur - Text);
+    }
+
+    // Type of the next value, JSON_None at the end of an object or array.
+    JSONItemType GetType() const {
+        if (!Pending) {
+            return JSON_None;
+        }
+        switch (*Cur) {
+            case '{':
+                return JSON_Object;
+            case '[':
+                return JSON_Array;
+            case '\"':
+                return JSON_String;
+            case 't':
+            case 'f':
+                return JSON_Bool;
+            case 'n':
+                return JSON_Null;
+            default:
+                return (*Cur == '-' || (*Cur >= '0' && *Cur <= '9')) ? JSON_Number : JSON_None;
+        }
+    }
+
+    // Enters the object that is the next value. Returns false and skips the value if it is
+    // something else.
+    bool BeginObject() {
+        return beginContainer('{');
+    }
+    // Reads the name of the next member of the current object. Returns false and leaves the
+    // object after its last member.
+    bool NextMember() {
+        if (!nextItem('}')) {
+            return false;
+        }
+        if (*Cur != '\"') {
+            return setError("Syntax Error: Missing quote");
+        }
+        Cur = skip(JSON_ParseString(Cur, End, Name), End);
+        if (*Cur != ':') {
+            return setError("Syntax Error: Missing colon");
+        }
+        Cur = skip(Cur + 1, End);
+        Pending = true;
+        return true;
+    }
+    const std::string& GetName() const {
+        return Name;
+    }
+    bool IsName(const char* name) const {
+        return Name.compare(name) == 0;
+    }
+
+    // Enters the array that is the next value. Returns false and skips the value if it is
+    // something else.
+    bool BeginArray() {
+        return beginContainer('[');
+    }
+    // Moves to the next element of the current array. Returns false and leaves the array after
+    // its last element.
+    bool NextElement() {
+        if (!nextItem(']')) {
+            return false;
+        }
+        Pending = true;
+        return true;
+    }
+
+    bool ReadBool(const bool defaultValue = false) {
+        double value;
+        if (GetType() == JSON_Bool) {
+            value = (*Cur == 't') ? 1.0 : 0.0;
+            SkipValue();
+            return value != 0.0;
+        }
+        return readNumber(value) ? (value != 0.0) : defaultValue;
+    }
+    int32_t ReadInt32(const int32_t defaultValue = 0) {
+        double value;
+        return readNumber(value) ? (int32_t)value : defaultValue;
+    }
+    int64_t ReadInt64(const int64_t defaultValue = 0) {
+        double value;
+        return readNumber(value) ? (int64_t)value : defaultValue;
+    }
+    float ReadFloat(const float defaultValue = 0.0f) {
+        double value;
+        return readNumber(value) ? (float)value : defaultValue;
+    }
+    double ReadDouble(const double defaultValue = 0.0) {
+        double value;
+        return readNumber(value) ? value : defaultValue;
+    }
+    const std::string ReadString(const std::string& defaultValue = std::string("")) {
+        if (GetType() != JSON_String) {
+            SkipValue();
+            return defaultValue;
+        }
+        std::string value;
+        Cur = skip(JSON_ParseString(Cur, End, value), End);
+        Pending = false;
+        valueDone();
+        return value;
+    }
+
+    // Skips the next value, including all members or elements of objects and arrays.
+    void SkipValue() {
+        if (!Pending) {
+            return;
+        }
+        Pending = false;
+        const char* p = Cur;
+        if (*p == '{' || *p == '[') {
+            // closing characters of the open containers, reused to avoid allocations
+            Closers.clear();
+            do {
+                if (*p == '\"') {
+                    p = skipString(p);
+                    continue;
+                }
+                if (*p == '{') {
+                    Closers.push_back('}');
+                } else if (*p == '[') {
+                    Closers.push_back(']');
+                } else if (*p == '}' || *p == ']' || *p == '\0') {
+                    if (*p != Closers.back()) {
+                        Cur = p;
+                        setError(
+                            Closers.back() == '}' ? "Syntax Error: Missing closing brace"
+                                                  : "Syntax Error: Missing ending bracket");
+                        return;
+                    }
+                    Closers.pop_back();
+                }
+                p++;
+            } while (!Closers.empty());
+        } else if (*p == '\"') {
+            p = skipString(p);
+        } else if (*p == '-' || (*p >= '0' && *p <= '9')) {
+            double value;
+            p = JSON_ParseNumber(p, value);
+        } else if (!strncmp(p, "null", 4) || !strncmp(p, "true", 4)) {
+            p += 4;
+        } else if (!strncmp(p, "false", 5)) {
+            p += 5;
+        } else {
+            setError("Syntax Error: Invalid syntax");
+            return;
+        }
+        Cur = skip(p, End);
+        valueDone();
+    }
+
+   private:
+    bool setError(const char* error) {
+        if (Error != nullptr) {
+            return false;
+        }
+        // stop at the end of the text, so nothing after the error is read
+        ErrorOffset = GetOffset();
+        Error = error;
+        Cur = End;
+        Pending = false;
+        return false;
+    }
+
+    // Called after a value is read or skipped, the root value has to be the whole text.
+    void valueDone() {
+        if (Depth == 0 && *Cur != '\0') {
+            setError("Syntax Error: Extra characters after the value");
+        }
+    }
+
+    bool beginContainer(const char open) {
+        if (!Pending || *Cur != open) {
+            SkipValue();
+            return false;
+        }
+        Cur = skip(Cur + 1, End);
+        Depth++;
+        First = true;
+        Pending = false;
+        return true;
+    }
+
+    // Skips the unread value of the previous item and moves past the separator. Returns false
+    // after the closing character.
+    bool nextItem(const char close) {
+        SkipValue();
+        if (HasError()) {
+            return false;
+        }
+        if (*Cur == close) {
+            Cur = skip(Cur + 1, End);
+            Depth--;
+            First = false; // the container was a value of the enclosing one
+            valueDone();
+            return false;
+        }
+        if (!First) {
+            if (*Cur != ',') {
+                return setError(
+                    close == '}' ? "Syntax Error: Missing closing brace"
+                                 : "Syntax Error: Missing ending bracket");
+            }
+            Cur = skip(Cur + 1, End);
+        }
+        First = false;
+        return true;
+    }
+
+    bool readNumber(double& value) {
+        if (GetType() != JSON_Number) {
+            SkipValue();
+            return false;
+        }
+        Cur = skip(JSON_ParseNumber(Cur, value), End);
+        Pending = false;
+        valueDone();
+        return true;
+    }
+
+    // Returns the first character after the closing quote of the string at str.
+    const char* skipString(const char* str) {
+        const char* p = str + 1;
+        for (;;) {
+            p = JSON_FindQuoteOrEscape(p, End);
+            if (*p == '\"') {
+                return p + 1;
+            }
+            if (*p == '\0' || p[1] == '\0') {
+                return p + (*p != '\0');
+            }
+            p += 2; // escaped character
+        }
+    }
+
+    const char* Text;
+    const char* End;
+    const char* Cur;
+    const char* Error;
+    size_t ErrorOffset;
+    int Depth; // number of open objects and arrays
+    bool First; // no separator before the next item of the current container
+    bool Pending; // a value is next and hasn't been read or skipped
+    std::string Name;
+    std::string Closers;
 };
 
 } // namespace OVR
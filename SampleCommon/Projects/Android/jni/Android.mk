@@ -25,6 +25,7 @@ LOCAL_SRC_FILES := \
   ../../../Src/GUI/AnimComponents.cpp \
   ../../../Src/GUI/CollisionPrimitive.cpp \
   ../../../Src/GUI/DefaultComponent.cpp \
+  ../../../Src/GUI/DynamicBoundsTree.cpp \
   ../../../Src/GUI/Fader.cpp \
   ../../../Src/GUI/GazeCursor.cpp \
   ../../../Src/GUI/GuiSys.cpp \
@@ -74,6 +75,7 @@ LOCAL_SRC_FILES := \
   ../../../Src/Render/GlGeometry.cpp \
   ../../../Src/Render/GlProgram.cpp \
   ../../../Src/Render/GlTexture.cpp \
+  ../../../Src/Render/MeshOptimizer.cpp \
   ../../../Src/Render/PanelRenderer.cpp \
   ../../../Src/Render/ParticleSystem.cpp	\
   ../../../Src/Render/PointList.cpp \
@@ -82,6 +84,7 @@ LOCAL_SRC_FILES := \
   ../../../Src/Render/SurfaceTexture.cpp \
   ../../../Src/Render/TextureAtlas.cpp \
   ../../../Src/Render/TextureManager.cpp \
+  ../../../Src/Render/VertexLayout.cpp \
   ../../../Src/System.cpp \
 
 LOCAL_STATIC_LIBRARIES += minizip stb android_native_app_glue
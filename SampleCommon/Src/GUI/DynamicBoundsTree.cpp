@@ -0,0 +1,311 @@
+// (c) Meta Platforms, Inc. and affiliates. Confidential and proprietary.
+
+/************************************************************************************
+
+Filename    :   DynamicBoundsTree.cpp
+Content     :   Dynamic bounding volume hierarchy for moving axis-aligned bounds.
+Created     :   October 2026
+
+*************************************************************************************/
+
+#include "DynamicBoundsTree.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+
+using OVR::Bounds3f;
+using OVR::Vector3f;
+
+namespace OVRFW {
+
+static float SurfaceArea(Bounds3f const& b) {
+    Vector3f const d = b.GetSize();
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+static bool Contains(Bounds3f const& outer, Bounds3f const& inner) {
+    return outer.b[0].x <= inner.b[0].x && outer.b[0].y <= inner.b[0].y &&
+        outer.b[0].z <= inner.b[0].z && inner.b[1].x <= outer.b[1].x &&
+        inner.b[1].y <= outer.b[1].y && inner.b[1].z <= outer.b[1].z;
+}
+
+ovrDynamicBoundsTree::ovrDynamicBoundsTree(float const margin)
+    : Root(NULL_NODE), FreeList(NULL_NODE), ProxyCount(0), Margin(margin) {}
+
+void ovrDynamicBoundsTree::Clear() {
+    Nodes.clear();
+    Root = NULL_NODE;
+    FreeList = NULL_NODE;
+    ProxyCount = 0;
+}
+
+int ovrDynamicBoundsTree::AllocateNode() {
+    int nodeId;
+    if (FreeList != NULL_NODE) {
+        nodeId = FreeList;
+        FreeList = Nodes[nodeId].Parent;
+    } else {
+        nodeId = static_cast<int>(Nodes.size());
+        Nodes.push_back(ovrNode());
+    }
+    ovrNode& node = Nodes[nodeId];
+    node.Bounds.Clear();
+    node.UserData = 0;
+    node.Parent = NULL_NODE;
+    node.Child0 = NULL_NODE;
+    node.Child1 = NULL_NODE;
+    node.Height = 0;
+    return nodeId;
+}
+
+void ovrDynamicBoundsTree::FreeNode(int const nodeId) {
+    Nodes[nodeId].Parent = FreeList;
+    Nodes[nodeId].Height = -1;
+    FreeList = nodeId;
+}
+
+int ovrDynamicBoundsTree::CreateProxy(Bounds3f const& bounds, std::uint64_t const userData) {
+    int const proxyId = AllocateNode();
+    Nodes[proxyId].Bounds = Bounds3f::Expand(bounds, Vector3f(-Margin), Vector3f(Margin));
+    Nodes[proxyId].UserData = userData;
+    InsertLeaf(proxyId);
+    ProxyCount++;
+    return proxyId;
+}
+
+void ovrDynamicBoundsTree::DestroyProxy(int const proxyId) {
+    assert(proxyId >= 0 && proxyId < static_cast<int>(Nodes.size()) && Nodes[proxyId].IsLeaf());
+    RemoveLeaf(proxyId);
+    FreeNode(proxyId);
+    ProxyCount--;
+}
+
+bool ovrDynamicBoundsTree::MoveProxy(int const proxyId, Bounds3f const& bounds) {
+    if (Contains(Nodes[proxyId].Bounds, bounds)) {
+        return false;
+    }
+    RemoveLeaf(proxyId);
+    Nodes[proxyId].Bounds = Bounds3f::Expand(bounds, Vector3f(-Margin), Vector3f(Margin));
+    InsertLeaf(proxyId);
+    return true;
+}
+
+void ovrDynamicBoundsTree::InsertLeaf(int const leaf) {
+    if (Root == NULL_NODE) {
+        Root = leaf;
+        Nodes[Root].Parent = NULL_NODE;
+        return;
+    }
+
+    // descend towards the sibling that adds the least surface area
+    Bounds3f const leafBounds = Nodes[leaf].Bounds;
+    int index = Root;
+    while (!Nodes[index].IsLeaf()) {
+        ovrNode const& node = Nodes[index];
+        float const area = SurfaceArea(node.Bounds);
+        float const combinedArea = SurfaceArea(Bounds3f::Union(node.Bounds, leafBounds));
+
+        // cost of making a new parent for this node and the new leaf
+        float const cost = 2.0f * combinedArea;
+        // minimum cost of pushing the leaf further down the tree
+        float const inheritanceCost = 2.0f * (combinedArea - area);
+
+        float childCost[2];
+        int const children[2] = {node.Child0, node.Child1};
+        for (int i = 0; i < 2; ++i) {
+            ovrNode const& child = Nodes[children[i]];
+            Bounds3f const merged = Bounds3f::Union(child.Bounds, leafBounds);
+            if (child.IsLeaf()) {
+                childCost[i] = SurfaceArea(merged) + inheritanceCost;
+            } else {
+                childCost[i] = SurfaceArea(merged) - SurfaceArea(child.Bounds) + inheritanceCost;
+            }
+        }
+
+        if (cost < childCost[0] && cost < childCost[1]) {
+            break;
+        }
+        index = childCost[0] < childCost[1] ? children[0] : children[1];
+    }
+
+    int const sibling = index;
+    int const oldParent = Nodes[sibling].Parent;
+    int const newParent = AllocateNode();
+    Nodes[newParent].Parent = oldParent;
+    Nodes[newParent].Bounds = Bounds3f::Union(leafBounds, Nodes[sibling].Bounds);
+    Nodes[newParent].Height = Nodes[sibling].Height + 1;
+    Nodes[newParent].Child0 = sibling;
+    Nodes[newParent].Child1 = leaf;
+    Nodes[sibling].Parent = newParent;
+    Nodes[leaf].Parent = newParent;
+
+    if (oldParent != NULL_NODE) {
+        if (Nodes[oldParent].Child0 == sibling) {
+            Nodes[oldParent].Child0 = newParent;
+        } else {
+            Nodes[oldParent].Child1 = newParent;
+        }
+    } else {
+        Root = newParent;
+    }
+
+    RefitAncestors(Nodes[leaf].Parent);
+}
+
+void ovrDynamicBoundsTree::RemoveLeaf(int const leaf) {
+    if (leaf == Root) {
+        Root = NULL_NODE;
+        return;
+    }
+
+    int const parent = Nodes[leaf].Parent;
+    int const grandParent = Nodes[parent].Parent;
+    int const sibling = Nodes[parent].Child0 == leaf ? Nodes[parent].Child1 : Nodes[parent].Child0;
+
+    if (grandParent != NULL_NODE) {
+        // connect the sibling to the grand parent and drop the parent
+        if (Nodes[grandParent].Child0 == parent) {
+            Nodes[grandParent].Child0 = sibling;
+        } else {
+            Nodes[grandParent].Child1 = sibling;
+        }
+        Nodes[sibling].Parent = grandParent;
+        FreeNode(parent);
+        RefitAncestors(grandParent);
+    } else {
+        Root = sibling;
+        Nodes[sibling].Parent = NULL_NODE;
+        FreeNode(parent);
+    }
+    Nodes[leaf].Parent = NULL_NODE;
+}
+
+void ovrDynamicBoundsTree::RefitAncestors(int nodeId) {
+    while (nodeId != NULL_NODE) {
+        nodeId = Balance(nodeId);
+        ovrNode& node = Nodes[nodeId];
+        ovrNode const& child0 = Nodes[node.Child0];
+        ovrNode const& child1 = Nodes[node.Child1];
+        node.Height = 1 + std::max(child0.Height, child1.Height);
+        node.Bounds = Bounds3f::Union(child0.Bounds, child1.Bounds);
+        nodeId = node.Parent;
+    }
+}
+
+// Performs a left or right rotation if node a is imbalanced and returns the new subtree root.
+int ovrDynamicBoundsTree::Balance(int const a) {
+    ovrNode& A = Nodes[a];
+    if (A.IsLeaf() || A.Height < 2) {
+        return a;
+    }
+
+    int const b = A.Child0;
+    int const c = A.Child1;
+    int const balance = Nodes[c].Height - Nodes[b].Height;
+
+    // rotate the taller child up
+    int up;
+    if (balance > 1) {
+        up = c;
+    } else if (balance < -1) {
+        up = b;
+    } else {
+        return a;
+    }
+
+    ovrNode& U = Nodes[up];
+    int const f = U.Child0;
+    int const g = U.Child1;
+
+    // swap a and up
+    U.Child0 = a;
+    U.Parent = A.Parent;
+    A.Parent = up;
+
+    // a's old parent should point to up
+    if (U.Parent != NULL_NODE) {
+        if (Nodes[U.Parent].Child0 == a) {
+            Nodes[U.Parent].Child0 = up;
+        } else {
+            Nodes[U.Parent].Child1 = up;
+        }
+    } else {
+        Root = up;
+    }
+
+    // the taller grand child stays under up, the shorter one replaces up under a
+    int keep = f;
+    int move = g;
+    if (Nodes[f].Height < Nodes[g].Height) {
+        keep = g;
+        move = f;
+    }
+    U.Child1 = keep;
+    if (up == c) {
+        A.Child1 = move;
+    } else {
+        A.Child0 = move;
+    }
+    Nodes[move].Parent = a;
+
+    A.Bounds = Bounds3f::Union(Nodes[A.Child0].Bounds, Nodes[A.Child1].Bounds);
+    A.Height = 1 + std::max(Nodes[A.Child0].Height, Nodes[A.Child1].Height);
+    U.Bounds = Bounds3f::Union(A.Bounds, Nodes[keep].Bounds);
+    U.Height = 1 + std::max(A.Height, Nodes[keep].Height);
+    return up;
+}
+
+void ovrDynamicBoundsTree::RayQuery(
+    Vector3f const& start,
+    Vector3f const& dir,
+    std::vector<int>& proxyIds) const {
+    if (Root == NULL_NODE) {
+        return;
+    }
+
+    Vector3f const invDir(
+        dir.x != 0.0f ? 1.0f / dir.x : FLT_MAX,
+        dir.y != 0.0f ? 1.0f / dir.y : FLT_MAX,
+        dir.z != 0.0f ? 1.0f / dir.z : FLT_MAX);
+
+    Stack.resize(0);
+    Stack.push_back(Root);
+    while (!Stack.empty()) {
+        int const nodeId = Stack.back();
+        Stack.pop_back();
+        ovrNode const& node = Nodes[nodeId];
+
+        // slab test against [0, inf), so bounds containing the start are hit as well
+        float tMin = 0.0f;
+        float tMax = FLT_MAX;
+        bool hit = true;
+        for (int axis = 0; axis < 3 && hit; ++axis) {
+            if (dir[axis] == 0.0f) {
+                hit = start[axis] >= node.Bounds.b[0][axis] &&
+                    start[axis] <= node.Bounds.b[1][axis];
+                continue;
+            }
+            float t0 = (node.Bounds.b[0][axis] - start[axis]) * invDir[axis];
+            float t1 = (node.Bounds.b[1][axis] - start[axis]) * invDir[axis];
+            if (t0 > t1) {
+                std::swap(t0, t1);
+            }
+            tMin = std::max(tMin, t0);
+            tMax = std::min(tMax, t1);
+            hit = tMin <= tMax;
+        }
+        if (!hit) {
+            continue;
+        }
+
+        if (node.IsLeaf()) {
+            proxyIds.push_back(nodeId);
+        } else {
+            Stack.push_back(node.Child0);
+            Stack.push_back(node.Child1);
+        }
+    }
+}
+
+} // namespace OVRFW
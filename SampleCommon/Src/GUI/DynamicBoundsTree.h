@@ -0,0 +1,89 @@
+// (c) Meta Platforms, Inc. and affiliates. Confidential and proprietary.
+
+/************************************************************************************
+
+Filename    :   DynamicBoundsTree.h
+Content     :   Dynamic bounding volume hierarchy for moving axis-aligned bounds.
+Created     :   October 2026
+
+*************************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "OVR_Math.h"
+
+namespace OVRFW {
+
+//==============================================================
+// ovrDynamicBoundsTree
+//
+// Binary tree of axis-aligned bounds. Each leaf (proxy) stores its bounds enlarged by a margin,
+// so small movements do not touch the tree. A proxy is only removed and reinserted when its
+// bounds leave the enlarged bounds. Inserts pick the sibling with the lowest surface area cost,
+// and rotations keep the tree balanced.
+class ovrDynamicBoundsTree {
+   public:
+    static const int NULL_NODE = -1;
+
+    ovrDynamicBoundsTree(float const margin = 0.05f);
+
+    // Returns the proxy id
+    int CreateProxy(OVR::Bounds3f const& bounds, std::uint64_t const userData);
+    void DestroyProxy(int const proxyId);
+    // Returns true if the proxy had to be reinserted.
+    bool MoveProxy(int const proxyId, OVR::Bounds3f const& bounds);
+    void Clear();
+
+    std::uint64_t GetUserData(int const proxyId) const {
+        return Nodes[proxyId].UserData;
+    }
+    OVR::Bounds3f const& GetFatBounds(int const proxyId) const {
+        return Nodes[proxyId].Bounds;
+    }
+    int GetProxyCount() const {
+        return ProxyCount;
+    }
+    int GetHeight() const {
+        return Root == NULL_NODE ? 0 : Nodes[Root].Height;
+    }
+
+    // Appends the ids of all proxies whose enlarged bounds are hit by the ray, including proxies
+    // containing the ray start.
+    void RayQuery(
+        OVR::Vector3f const& start,
+        OVR::Vector3f const& dir,
+        std::vector<int>& proxyIds) const;
+
+   private:
+    struct ovrNode {
+        OVR::Bounds3f Bounds;
+        std::uint64_t UserData;
+        int Parent; // next free node when the node is on the free list
+        int Child0;
+        int Child1;
+        int Height; // leaf = 0, free node = -1
+
+        bool IsLeaf() const {
+            return Child0 == NULL_NODE;
+        }
+    };
+
+    int AllocateNode();
+    void FreeNode(int const nodeId);
+    void InsertLeaf(int const leaf);
+    void RemoveLeaf(int const leaf);
+    int Balance(int const a);
+    void RefitAncestors(int nodeId);
+
+    std::vector<ovrNode> Nodes;
+    int Root;
+    int FreeList;
+    int ProxyCount;
+    float Margin;
+    mutable std::vector<int> Stack;
+};
+
+} // namespace OVRFW
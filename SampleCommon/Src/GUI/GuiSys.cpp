@@ -725,6 +725,9 @@ void OvrGuiSysLocal::Frame(
         return;
     }
 
+    // create the textures that finished decoding in the background
+    TextureManager->Update();
+
     Matrix4f lastViewMatrix(vrFrame.HeadPose);
 
     const int currentRecenterCount = vrFrame.RecenterCount;
@@ -891,26 +894,27 @@ void OvrGuiSys::ovrDummySoundEffectPlayer::LoadSoundAsset(const char* name) {
 // OvrGuiSysLocal::TestRayIntersection
 HitTestResult OvrGuiSysLocal::TestRayIntersection(const Vector3f& start, const Vector3f& dir)
     const {
-    HitTestResult result;
-
+    // later menus are on top, so they win ties
+    std::vector<menuHandle_t> roots;
+    std::vector<Posef> rootPoses;
     for (int i = static_cast<int>(ActiveMenus.size()) - 1; i >= 0; --i) {
         VRMenu* curMenu = ActiveMenus[i];
         if (curMenu == nullptr) {
             continue;
         }
-        VRMenuObject* root = GetVRMenuMgr().ToObject(curMenu->GetRootHandle());
-        if (root == nullptr) {
+        if (GetVRMenuMgr().ToObject(curMenu->GetRootHandle()) == nullptr) {
             continue;
         }
+        roots.push_back(curMenu->GetRootHandle());
+        rootPoses.push_back(curMenu->GetMenuPose());
+    }
 
-        HitTestResult r;
-        menuHandle_t hitHandle = root->HitTest(
-            *this, curMenu->GetMenuPose(), start, dir, ContentFlags_t(CONTENT_SOLID), r);
-        if (hitHandle.IsValid() && r.t < result.t) {
-            result = r;
-            result.RayStart = start;
-            result.RayDir = dir;
-        }
+    HitTestResult result;
+    menuHandle_t hitHandle = GetVRMenuMgr().HitTest(
+        *this, roots, rootPoses, start, dir, ContentFlags_t(CONTENT_SOLID), result);
+    if (hitHandle.IsValid()) {
+        result.RayStart = start;
+        result.RayDir = dir;
     }
     return result;
 }
@@ -17,6 +17,7 @@ Authors     :   Jonathan E. Wright
 
 #include "VRMenuObject.h"
 #include "GuiSys.h"
+#include "DynamicBoundsTree.h"
 
 #include "OVR_Lexer2.h"
 
@@ -327,6 +328,15 @@ class VRMenuMgrLocal : public OvrVRMenuMgr {
 
     virtual GlProgram const* GetGUIGlProgram(eGUIProgramType const programType) const;
 
+    virtual menuHandle_t HitTest(
+        OvrGuiSys const& guiSys,
+        std::vector<menuHandle_t> const& roots,
+        std::vector<Posef> const& rootPoses,
+        Vector3f const& rayStart,
+        Vector3f const& rayDir,
+        ContentFlags_t const testContents,
+        HitTestResult& result) const;
+
     static VRMenuMgrLocal& ToLocal(OvrVRMenuMgr& menuMgr) {
         return *(VRMenuMgrLocal*)&menuMgr;
     }
@@ -344,6 +354,22 @@ class VRMenuMgrLocal : public OvrVRMenuMgr {
     void ExecutePendingComponentDeletions();
 
     void CondenseList();
+
+    void RefreshHitRoot(
+        OvrGuiSys const& guiSys,
+        int const rootIndex,
+        bool const full,
+        bool const refit) const;
+    bool RefreshHitProxies_r(
+        OvrGuiSys const& guiSys,
+        VRMenuObject const* obj,
+        Posef const& parentPose,
+        Vector3f const& parentScale,
+        int const rootIndex,
+        bool const full,
+        bool refit,
+        int& order) const;
+    void FreeHitProxy(int const index) const;
     void SubmitForRenderingRecursive(
         OvrGuiSys& guiSys,
         Matrix4f const& centerViewMatrix,
@@ -378,6 +404,32 @@ class VRMenuMgrLocal : public OvrVRMenuMgr {
     int NumSubmitted; // number of currently submitted menu objects
     mutable int NumToRender; // number of submitted objects to render
 
+    // hit test acceleration, refit lazily from the const HitTest using the objects' hit dirty bits
+    struct ovrHitProxy {
+        ovrHitProxy() : ProxyId(ovrDynamicBoundsTree::NULL_NODE), Order(0), RefreshCount(0) {}
+
+        int ProxyId; // leaf in HitTree, indexed by object slot
+        menuHandle_t Handle; // object in the slot when the proxy was created
+        menuHandle_t RootHandle; // root the object was reached from
+        Posef ModelPose; // hit test pose at the last refresh
+        Vector3f ParentScale;
+        int Order; // pre-order index under the root, for resolving ties
+        std::uint32_t RefreshCount;
+    };
+    struct ovrHitRoot {
+        menuHandle_t Handle;
+        Posef Pose;
+        std::uint32_t UsedFrame;
+        std::vector<int> Proxies; // slots given a proxy under this root, some may be stale
+    };
+    std::uint32_t FrameCount; // incremented in Finish
+    mutable ovrDynamicBoundsTree HitTree;
+    mutable std::vector<ovrHitProxy> HitProxies;
+    mutable std::vector<ovrHitRoot> HitRoots;
+    mutable std::vector<int> HitCandidates;
+    mutable std::vector<int> HitStaleProxies;
+    mutable std::uint32_t HitRefreshCount;
+
     GlProgram GUIProgramDiffuseOnly; // has a diffuse only
     GlProgram GUIProgramDiffuseAlphaDiscard; // diffuse, but discard fragments with 0 alpha
     GlProgram GUIProgramDiffusePlusAdditive; // has a diffuse and an additive
@@ -466,7 +518,14 @@ void VRMenuMgrLocal::DebugWordWrap(void* appPtr, const char* parms) {
 //==================================
 // VRMenuMgrLocal::VRMenuMgrLocal
 VRMenuMgrLocal::VRMenuMgrLocal(OvrGuiSys& guiSys)
-    : GuiSys(guiSys), CurrentId(0), Initialized(false), NumSubmitted(0), NumToRender(0) {}
+    : GuiSys(guiSys),
+      CurrentId(0),
+      Initialized(false),
+      NumSubmitted(0),
+      NumToRender(0),
+      FrameCount(0),
+      HitTree(0.05f),
+      HitRefreshCount(0) {}
 
 //==================================
 // VRMenuMgrLocal::~VRMenuMgrLocal
@@ -636,6 +695,10 @@ void VRMenuMgrLocal::Shutdown() {
     GlProgram::Free(GUIProgramDiffuseColorRampTarget);
     GlProgram::Free(GUIProgramAlphaDiffuse);
 
+    HitTree.Clear();
+    HitProxies.clear();
+    HitRoots.clear();
+
     Initialized = false;
 }
 
@@ -677,6 +740,7 @@ menuHandle_t VRMenuMgrLocal::CreateObject(VRMenuObjectParms const& parms) {
             obj != NULL); // this would be bad -- but we're likely just going to explode elsewhere
         return menuHandle_t();
     }
+    obj->MenuMgr = this;
 
     obj->Init(GuiSys, parms);
 
@@ -720,6 +784,8 @@ void VRMenuMgrLocal::FreeObject(menuHandle_t const handle) {
     // free all of this object's children
     obj->FreeChildren(*this);
 
+    FreeHitProxy(index);
+
     delete obj;
 
     // empty the slot
@@ -1166,6 +1232,220 @@ void VRMenuMgrLocal::SubmitForRenderingRecursive(
     }
 }
 
+//==============================
+// VRMenuMgrLocal::FreeHitProxy
+void VRMenuMgrLocal::FreeHitProxy(int const index) const {
+    if (index < static_cast<int>(HitProxies.size()) &&
+        HitProxies[index].ProxyId != ovrDynamicBoundsTree::NULL_NODE) {
+        HitTree.DestroyProxy(HitProxies[index].ProxyId);
+        HitProxies[index] = ovrHitProxy();
+    }
+}
+
+//==============================
+// VRMenuMgrLocal::RefreshHitProxies_r
+// Refits the hit proxies under obj. A full refresh visits every hittable object and renumbers
+// the proxies; otherwise only subtrees with hit dirty bits are visited, and refit is passed down
+// when a transform above the subtree changed. Returns false if an incremental refresh would have
+// to add or remove a proxy, which needs a full refresh of the root.
+bool VRMenuMgrLocal::RefreshHitProxies_r(
+    OvrGuiSys const& guiSys,
+    VRMenuObject const* obj,
+    Posef const& parentPose,
+    Vector3f const& parentScale,
+    int const rootIndex,
+    bool const full,
+    bool refit,
+    int& order) const {
+    uint8_t const dirty = obj->HitDirty;
+    obj->HitDirty = 0;
+
+    // same pruning as VRMenuObject::HitTest_r
+    VRMenuObjectFlags_t const oFlags = obj->GetFlags();
+    if ((oFlags & VRMENUOBJECT_DONT_RENDER) || (oFlags & VRMENUOBJECT_DONT_HIT_ALL)) {
+        return true;
+    }
+
+    refit = refit || full || (dirty & VRMenuObject::HIT_DIRTY_SELF) != 0;
+    if (!refit && (dirty & VRMenuObject::HIT_DIRTY_CHILD) == 0) {
+        return true;
+    }
+
+    Posef modelPose;
+    Vector3f scale;
+    obj->GetHitTestTransform(parentPose, parentScale, modelPose, scale);
+
+    if (refit) {
+        int index;
+        std::uint32_t id;
+        DecomposeHandle(obj->GetHandle(), index, id);
+        if (index >= static_cast<int>(HitProxies.size())) {
+            HitProxies.resize(ObjectList.size());
+        }
+
+        Bounds3f const bounds = obj->GetHitTestBounds(guiSys, modelPose, parentScale);
+        ovrHitProxy& proxy = HitProxies[index];
+        bool const hasProxy = proxy.ProxyId != ovrDynamicBoundsTree::NULL_NODE &&
+            proxy.Handle == obj->GetHandle();
+        if (!full && hasProxy == bounds.IsInverted()) {
+            return false;
+        }
+        if (proxy.ProxyId != ovrDynamicBoundsTree::NULL_NODE && !hasProxy) {
+            FreeHitProxy(index);
+        }
+        if (!bounds.IsInverted()) {
+            if (proxy.ProxyId == ovrDynamicBoundsTree::NULL_NODE) {
+                proxy.ProxyId = HitTree.CreateProxy(bounds, static_cast<std::uint64_t>(index));
+            } else {
+                HitTree.MoveProxy(proxy.ProxyId, bounds);
+            }
+            proxy.Handle = obj->GetHandle();
+            proxy.ModelPose = modelPose;
+            proxy.ParentScale = parentScale;
+            if (full) {
+                proxy.RootHandle = HitRoots[rootIndex].Handle;
+                proxy.Order = order++;
+                proxy.RefreshCount = HitRefreshCount;
+                HitRoots[rootIndex].Proxies.push_back(index);
+            }
+        }
+    }
+
+    for (int i = 0; i < obj->NumChildren(); ++i) {
+        VRMenuObject const* child = ToObject(obj->GetChildHandleForIndex(i));
+        if (child != NULL &&
+            !RefreshHitProxies_r(
+                guiSys, child, modelPose, scale, rootIndex, full, refit, order)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//==============================
+// VRMenuMgrLocal::RefreshHitRoot
+void VRMenuMgrLocal::RefreshHitRoot(
+    OvrGuiSys const& guiSys,
+    int const rootIndex,
+    bool const full,
+    bool const refit) const {
+    ovrHitRoot& root = HitRoots[rootIndex];
+    VRMenuObject const* obj = ToObject(root.Handle);
+    int order = 0;
+    if (!full) {
+        if (obj == NULL ||
+            RefreshHitProxies_r(
+                guiSys, obj, root.Pose, Vector3f(1.0f), rootIndex, false, refit, order)) {
+            return;
+        }
+        // a proxy has to be added or removed, so renumber everything under the root
+    }
+
+    HitRefreshCount++;
+    HitStaleProxies.swap(root.Proxies);
+    root.Proxies.resize(0);
+    if (obj != NULL) {
+        RefreshHitProxies_r(guiSys, obj, root.Pose, Vector3f(1.0f), rootIndex, true, true, order);
+    }
+
+    // drop proxies of objects that are no longer reachable or hittable under this root
+    for (int i = 0; i < static_cast<int>(HitStaleProxies.size()); ++i) {
+        ovrHitProxy const& proxy = HitProxies[HitStaleProxies[i]];
+        if (proxy.ProxyId != ovrDynamicBoundsTree::NULL_NODE && proxy.RootHandle == root.Handle &&
+            proxy.RefreshCount != HitRefreshCount) {
+            FreeHitProxy(HitStaleProxies[i]);
+        }
+    }
+    HitStaleProxies.resize(0);
+}
+
+//==============================
+// VRMenuMgrLocal::HitTest
+menuHandle_t VRMenuMgrLocal::HitTest(
+    OvrGuiSys const& guiSys,
+    std::vector<menuHandle_t> const& roots,
+    std::vector<Posef> const& rootPoses,
+    Vector3f const& rayStart,
+    Vector3f const& rayDir,
+    ContentFlags_t const testContents,
+    HitTestResult& result) const {
+    assert(roots.size() == rootPoses.size());
+
+    for (int i = 0; i < static_cast<int>(roots.size()); ++i) {
+        int rootIndex = -1;
+        for (int j = 0; j < static_cast<int>(HitRoots.size()); ++j) {
+            if (HitRoots[j].Handle == roots[i]) {
+                rootIndex = j;
+                break;
+            }
+        }
+        bool full = false;
+        if (rootIndex < 0) {
+            ovrHitRoot root;
+            root.Handle = roots[i];
+            HitRoots.push_back(root);
+            rootIndex = static_cast<int>(HitRoots.size()) - 1;
+            full = true;
+        }
+        ovrHitRoot& root = HitRoots[rootIndex];
+        root.UsedFrame = FrameCount;
+
+        // only objects whose transform, bounds or children changed since the last test are refit
+        VRMenuObject const* obj = ToObject(root.Handle);
+        uint8_t const dirty = obj != NULL ? obj->HitDirty : 0;
+        bool const moved = !(root.Pose.Translation == rootPoses[i].Translation) ||
+            !(root.Pose.Rotation == rootPoses[i].Rotation);
+        full = full || (dirty & VRMenuObject::HIT_DIRTY_STRUCTURE) != 0;
+        if (full || moved || dirty != 0) {
+            root.Pose = rootPoses[i];
+            RefreshHitRoot(guiSys, rootIndex, full, moved);
+        }
+    }
+
+    HitCandidates.resize(0);
+    HitTree.RayQuery(rayStart, rayDir, HitCandidates);
+
+    int bestRoot = 0;
+    int bestOrder = 0;
+    for (int i = 0; i < static_cast<int>(HitCandidates.size()); ++i) {
+        int const index = static_cast<int>(HitTree.GetUserData(HitCandidates[i]));
+        ovrHitProxy const& proxy = HitProxies[index];
+
+        int rootPriority = -1;
+        for (int j = 0; j < static_cast<int>(roots.size()); ++j) {
+            if (roots[j] == proxy.RootHandle) {
+                rootPriority = j;
+                break;
+            }
+        }
+        if (rootPriority < 0) {
+            continue;
+        }
+
+        VRMenuObject const* obj = ObjectList[index];
+        if (obj == NULL || obj->GetHandle() != proxy.Handle ||
+            (obj->GetFlags() & VRMENUOBJECT_DONT_RENDER) ||
+            (obj->GetFlags() & VRMENUOBJECT_DONT_HIT_ALL)) {
+            continue;
+        }
+
+        HitTestResult r;
+        if (!obj->HitTestSelf(
+                guiSys, proxy.ModelPose, proxy.ParentScale, rayStart, rayDir, testContents, r)) {
+            continue;
+        }
+        bool const closer = r.t < result.t ||
+            (r.t == result.t &&
+             (rootPriority < bestRoot || (rootPriority == bestRoot && proxy.Order < bestOrder)));
+        if (!result.HitHandle.IsValid() || closer) {
+            result = r;
+            bestRoot = rootPriority;
+            bestOrder = proxy.Order;
+        }
+    }
+    return result.HitHandle;
+}
+
 //==============================
 // VRMenuMgrLocal::SubmitForRendering
 // Submits the specified menu object and it's children
@@ -1210,6 +1490,23 @@ void VRMenuMgrLocal::Finish(Matrix4f const& viewMatrix) {
     // free any deleted component objects
     ExecutePendingComponentDeletions();
 
+    // drop the hit proxies of roots nobody tested last frame
+    FrameCount++;
+    for (int i = static_cast<int>(HitRoots.size()) - 1; i >= 0; --i) {
+        ovrHitRoot& root = HitRoots[i];
+        if (FrameCount - root.UsedFrame > 1) {
+            for (int j = 0; j < static_cast<int>(root.Proxies.size()); ++j) {
+                ovrHitProxy const& proxy = HitProxies[root.Proxies[j]];
+                if (proxy.ProxyId != ovrDynamicBoundsTree::NULL_NODE &&
+                    proxy.RootHandle == root.Handle) {
+                    FreeHitProxy(root.Proxies[j]);
+                }
+            }
+            std::swap(root, HitRoots.back());
+            HitRoots.pop_back();
+        }
+    }
+
     if (NumSubmitted == 0) {
         NumToRender = 0;
         return;
@@ -64,6 +64,21 @@ class OvrVRMenuMgr {
 
     virtual GlProgram const* GetGUIGlProgram(eGUIProgramType const programType) const = 0;
 
+    // Tests the ray against the hierarchies of the root objects placed at rootPoses and returns
+    // the closest hit. On equal distances, objects under earlier roots, then parents, then earlier
+    // siblings win, matching VRMenuObject::HitTest. The world bounds of the objects are kept in
+    // a bounding volume hierarchy, so only objects whose bounds are hit by the ray are tested.
+    // Each call first refits the objects that were changed since the last test, and the whole
+    // hierarchy of a root when its pose changes.
+    virtual menuHandle_t HitTest(
+        OvrGuiSys const& guiSys,
+        std::vector<menuHandle_t> const& roots,
+        std::vector<OVR::Posef> const& rootPoses,
+        OVR::Vector3f const& rayStart,
+        OVR::Vector3f const& rayDir,
+        ContentFlags_t const testContents,
+        HitTestResult& result) const = 0;
+
    private:
     // Called only from VRMenuObject.
     virtual void AddComponentToDeletionList(
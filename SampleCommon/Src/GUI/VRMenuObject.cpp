@@ -963,6 +963,8 @@ VRMenuObject::VRMenuObject(VRMenuObjectParms const& parms, menuHandle_t const ha
       Hilighted(false),
       Selected(false),
       TextDirty(true),
+      HitDirty(HIT_DIRTY_SELF),
+      MenuMgr(nullptr),
       MinsBoundsExpand(0.0f),
       MaxsBoundsExpand(0.0f),
       TextMetrics(),
@@ -1038,6 +1040,7 @@ void VRMenuObject::FreeChildren(OvrVRMenuMgr& menuMgr) {
         menuMgr.FreeObject(Children[i]);
     }
     Children.resize(0);
+    MarkHitDirty(HIT_DIRTY_STRUCTURE);
     // NOTE! bounds will be incorrect now until submitted for rendering
 }
 
@@ -1072,6 +1075,7 @@ void VRMenuObject::AddChild(OvrVRMenuMgr& menuMgr, menuHandle_t const handle) {
     if (child != NULL) {
         child->SetParentHandle(this->Handle);
     }
+    MarkHitDirty(HIT_DIRTY_STRUCTURE);
     // NOTE: bounds will be incorrect until submitted for rendering
 }
 void VRMenuObject::AddChild(VRMenuObject* child) {
@@ -1079,6 +1083,7 @@ void VRMenuObject::AddChild(VRMenuObject* child) {
     if (child != nullptr) {
         child->SetParentHandle(this->Handle);
     }
+    MarkHitDirty(HIT_DIRTY_STRUCTURE);
 }
 
 //==============================
@@ -1087,6 +1092,7 @@ void VRMenuObject::RemoveChild(OvrVRMenuMgr& menuMgr, menuHandle_t const handle)
     for (int i = 0; i < static_cast<int>(Children.size()); ++i) {
         if (Children[i] == handle) {
             Children.erase(Children.cbegin() + i);
+            MarkHitDirty(HIT_DIRTY_STRUCTURE);
             return;
         }
     }
@@ -1099,6 +1105,7 @@ void VRMenuObject::FreeChild(OvrVRMenuMgr& menuMgr, menuHandle_t const handle) {
         menuHandle_t childHandle = Children[i];
         if (childHandle == handle) {
             Children.erase(Children.cbegin() + i);
+            MarkHitDirty(HIT_DIRTY_STRUCTURE);
             menuMgr.FreeObject(childHandle);
             return;
         }
@@ -1213,6 +1220,117 @@ static void TransformByParentPose(
     outScale = parentScale.EntrywiseMultiply(localScale);
 }
 
+//==============================
+// VRMenuObject::GetHitTestTransform
+void VRMenuObject::GetHitTestTransform(
+    Posef const& parentPose,
+    Vector3f const& parentScale,
+    Posef& outPose,
+    Vector3f& outScale) const {
+    TransformByParentPose(parentPose, parentScale, LocalPose, GetLocalScale(), outPose, outScale);
+}
+
+//==============================
+// VRMenuObject::HitTestSelf
+bool VRMenuObject::HitTestSelf(
+    OvrGuiSys const& guiSys,
+    Posef const& modelPose,
+    Vector3f const& parentScale,
+    Vector3f const& rayStart,
+    Vector3f const& rayDir,
+    ContentFlags_t const testContents,
+    HitTestResult& result) const {
+    if (!(GetContents() & testContents)) {
+        return false;
+    }
+
+    // transform ray into local space
+    Vector3f localStart = modelPose.Rotation.Inverted().Rotate(rayStart - modelPose.Translation);
+    Vector3f localDir = modelPose.Rotation.Inverted().Rotate(rayDir).Normalized();
+
+    if (Flags & VRMENUOBJECT_BOUND_ALL) {
+        // local bounds are the union of surface bounds and text bounds
+        Bounds3f localBounds = GetLocalBounds(guiSys.GetDefaultFont()) * parentScale;
+        float t0;
+        float t1;
+        bool hit = IntersectRayBounds(
+            localStart,
+            localDir,
+            localBounds.GetMins(),
+            localBounds.GetMaxs(),
+            testContents,
+            t0,
+            t1);
+        if (hit) {
+            result.HitHandle = Handle;
+            result.t = t1;
+            result.uv = Vector2f(0.0f); // unknown
+        }
+    } else {
+        float selfT0;
+        float selfT1;
+        OvrCollisionResult cresult;
+        Bounds3f const& localBounds = GetLocalBounds(guiSys.GetDefaultFont()) * parentScale;
+        assert(!localBounds.IsInverted());
+
+        bool hit = IntersectRay(
+            localStart,
+            localDir,
+            parentScale,
+            localBounds,
+            selfT0,
+            selfT1,
+            testContents,
+            cresult);
+        if (hit) {
+            // app->ShowInfoText( 0.0f, "tri: %i", (int)cresult.TriIndex );
+            result = cresult;
+            result.HitHandle = Handle;
+        }
+
+        // also check vs. the text bounds if there is any text
+        if (!Text.empty() && GetType() != VRMENU_CONTAINER &&
+            (Flags & VRMENUOBJECT_DONT_HIT_TEXT) == 0) {
+            float textT0;
+            float textT1;
+            Bounds3f bounds = GetTextLocalBounds(guiSys.GetDefaultFont()) * parentScale;
+            bool textHit = IntersectRayBounds(
+                localStart,
+                localDir,
+                bounds.GetMins(),
+                bounds.GetMaxs(),
+                testContents,
+                textT0,
+                textT1);
+            if (textHit && textT1 < result.t) {
+                result.HitHandle = Handle;
+                result.t = textT1;
+                result.uv = Vector2f(0.0f); // unknown
+            }
+        }
+    }
+    return result.HitHandle.IsValid();
+}
+
+//==============================
+// VRMenuObject::GetHitTestBounds
+Bounds3f VRMenuObject::GetHitTestBounds(
+    OvrGuiSys const& guiSys,
+    Posef const& modelPose,
+    Vector3f const& parentScale) const {
+    Bounds3f bounds = GetLocalBounds(guiSys.GetDefaultFont()) * parentScale;
+    if (!Text.empty() && GetType() != VRMENU_CONTAINER) {
+        bounds = Bounds3f::Union(
+            bounds, GetTextLocalBounds(guiSys.GetDefaultFont()) * parentScale);
+    }
+    if (bounds.IsInverted()) {
+        return bounds;
+    }
+    // IntersectRayBounds also accepts ray starts within 0.1 of the bounds
+    bounds = Bounds3f::Expand(bounds, Vector3f(-0.1f), Vector3f(0.1f));
+    return Bounds3f::Transform(modelPose, bounds);
+}
+
 //==============================
 // VRMenuObject::HitTest_r
 bool VRMenuObject::HitTest_r(
@@ -1231,25 +1349,20 @@ bool VRMenuObject::HitTest_r(
         return false;
     }
 
-    // transform ray into local space
     Vector3f scale;
     Posef modelPose;
-    TransformByParentPose(parentPose, parentScale, LocalPose, GetLocalScale(), modelPose, scale);
+    GetHitTestTransform(parentPose, parentScale, modelPose, scale);
 
-    Vector3f localStart = modelPose.Rotation.Inverted().Rotate(rayStart - modelPose.Translation);
-    Vector3f localDir = modelPose.Rotation.Inverted().Rotate(rayDir).Normalized();
-    /*
-        LOG_WITH_TAG( "Spam", "Hit test vs '%s', start: (%.2f, %.2f, %.2f ) cull bounds( %.2f, %.2f,
-       %.2f ) -> ( %.2f, %.2f, %.2f )", GetText().c_str(), localStart.x, localStart.y, localStart.z,
-                CullBounds.b[0].x, CullBounds.b[0].y, CullBounds.b[0].z,
-                CullBounds.b[1].x, CullBounds.b[1].y, CullBounds.b[1].z );
-    */
     // test against cull bounds if we have children  ... otherwise cullBounds == localBounds
     if (Children.size() > 0) {
         if (CullBounds.IsInverted()) {
             ALOG("CullBounds are inverted!!");
             return false;
         }
+        // transform ray into local space
+        Vector3f localStart =
+            modelPose.Rotation.Inverted().Rotate(rayStart - modelPose.Translation);
+        Vector3f localDir = modelPose.Rotation.Inverted().Rotate(rayDir).Normalized();
         float cullT0;
         float cullT1;
         // any contents will hit cull bounds
@@ -1263,78 +1376,13 @@ bool VRMenuObject::HitTest_r(
             cullT0,
             cullT1);
 
-        //        LOG_WITH_TAG( "Spam", "Cull hit = %s, t0 = %.2f t1 = %.2f", hitCullBounds ? "true"
-        //        : "false", cullT0, cullT1 );
-
         if (!hitCullBounds) {
             return false;
         }
     }
 
     // test against self first, if not a container
-    if (GetContents() & testContents) {
-        if (Flags & VRMENUOBJECT_BOUND_ALL) {
-            // local bounds are the union of surface bounds and text bounds
-            Bounds3f localBounds = GetLocalBounds(guiSys.GetDefaultFont()) * parentScale;
-            float t0;
-            float t1;
-            bool hit = IntersectRayBounds(
-                localStart,
-                localDir,
-                localBounds.GetMins(),
-                localBounds.GetMaxs(),
-                testContents,
-                t0,
-                t1);
-            if (hit) {
-                result.HitHandle = Handle;
-                result.t = t1;
-                result.uv = Vector2f(0.0f); // unknown
-            }
-        } else {
-            float selfT0;
-            float selfT1;
-            OvrCollisionResult cresult;
-            Bounds3f const& localBounds = GetLocalBounds(guiSys.GetDefaultFont()) * parentScale;
-            assert(!localBounds.IsInverted());
-
-            bool hit = IntersectRay(
-                localStart,
-                localDir,
-                parentScale,
-                localBounds,
-                selfT0,
-                selfT1,
-                testContents,
-                cresult);
-            if (hit) {
-                // app->ShowInfoText( 0.0f, "tri: %i", (int)cresult.TriIndex );
-                result = cresult;
-                result.HitHandle = Handle;
-            }
-
-            // also check vs. the text bounds if there is any text
-            if (!Text.empty() && GetType() != VRMENU_CONTAINER &&
-                (Flags & VRMENUOBJECT_DONT_HIT_TEXT) == 0) {
-                float textT0;
-                float textT1;
-                Bounds3f bounds = GetTextLocalBounds(guiSys.GetDefaultFont()) * parentScale;
-                bool textHit = IntersectRayBounds(
-                    localStart,
-                    localDir,
-                    bounds.GetMins(),
-                    bounds.GetMaxs(),
-                    testContents,
-                    textT0,
-                    textT1);
-                if (textHit && textT1 < result.t) {
-                    result.HitHandle = Handle;
-                    result.t = textT1;
-                    result.uv = Vector2f(0.0f); // unknown
-                }
-            }
-        }
-    }
+    HitTestSelf(guiSys, modelPose, parentScale, rayStart, rayDir, testContents, result);
 
     // test against children
     for (int i = 0; i < static_cast<int>(Children.size()); ++i) {
@@ -1756,10 +1804,45 @@ void VRMenuObject::SetColor(Vector4f const& c) {
 
 void VRMenuObject::SetVisible(bool visible) {
     if (visible) {
-        Flags &= ~VRMenuObjectFlags_t(VRMENUOBJECT_DONT_RENDER);
+        RemoveFlags(VRMenuObjectFlags_t(VRMENUOBJECT_DONT_RENDER));
     } else {
-        Flags |= VRMenuObjectFlags_t(VRMENUOBJECT_DONT_RENDER);
+        AddFlags(VRMenuObjectFlags_t(VRMENUOBJECT_DONT_RENDER));
+    }
+}
+
+//==============================
+// VRMenuObject::MarkHitDirty
+void VRMenuObject::MarkHitDirty(uint8_t const bits) const {
+    HitDirty |= bits;
+
+    // stop at the first ancestor that is already flagged, everything above it is flagged, too
+    uint8_t const parentBits = HIT_DIRTY_CHILD | (bits & HIT_DIRTY_STRUCTURE);
+    VRMenuObject const* obj = this;
+    while (MenuMgr != nullptr && obj->ParentHandle.IsValid()) {
+        VRMenuObject const* parent = MenuMgr->ToObject(obj->ParentHandle);
+        if (parent == nullptr || (parent->HitDirty & parentBits) == parentBits) {
+            break;
+        }
+        parent->HitDirty |= parentBits;
+        obj = parent;
+    }
+}
+
+//==============================
+// VRMenuObject::MarkFlagsChanged
+void VRMenuObject::MarkFlagsChanged(VRMenuObjectFlags_t const& newFlags) const {
+    if (newFlags.GetValue() == Flags.GetValue()) {
+        return;
     }
+    // objects that are not rendered or not hittable have no hit proxies in their subtree
+    VRMenuObjectFlags_t const hitFlags =
+        VRMenuObjectFlags_t(VRMENUOBJECT_DONT_RENDER) | VRMENUOBJECT_DONT_HIT_ALL;
+    VRMenuObjectFlags_t oldHit = Flags;
+    oldHit &= hitFlags;
+    VRMenuObjectFlags_t newHit = newFlags;
+    newHit &= hitFlags;
+    MarkHitDirty(
+        oldHit.GetValue() != newHit.GetValue() ? HIT_DIRTY_STRUCTURE : HIT_DIRTY_SELF);
 }
 
 //==============================
@@ -1971,6 +2054,7 @@ void VRMenuObject::RegenerateSurfaceGeometry(
     }
 
     Surfaces[surfaceIndex].RegenerateSurfaceGeometry();
+    MarkHitDirty(HIT_DIRTY_SELF);
 }
 
 //==============================
@@ -2026,6 +2110,7 @@ void VRMenuObject::SetSurfaceBorder(int const surfaceIndex, Vector4f const& bord
 void VRMenuObject::SetLocalBoundsExpand(Vector3f const mins, Vector3f const& maxs) {
     MinsBoundsExpand = mins;
     MaxsBoundsExpand = maxs;
+    MarkHitDirty(HIT_DIRTY_SELF);
 }
 
 //==============================
@@ -2035,6 +2120,7 @@ void VRMenuObject::SetCollisionPrimitive(OvrCollisionPrimitive* c) {
         delete CollisionPrimitive;
     }
     CollisionPrimitive = c;
+    MarkHitDirty(HIT_DIRTY_SELF);
 }
 
 //==============================
@@ -2116,6 +2202,7 @@ int VRMenuObject::NumSurfaces() const {
 int VRMenuObject::AllocSurface() {
     int newIndex = static_cast<int>(Surfaces.size());
     Surfaces.emplace_back(VRMenuSurface());
+    MarkHitDirty(HIT_DIRTY_SELF);
     return newIndex;
 }
 
@@ -2127,6 +2214,7 @@ void VRMenuObject::CreateFromSurfaceParms(
     VRMenuSurfaceParms const& parms) {
     VRMenuSurface& surf = Surfaces[surfaceIndex];
     surf.CreateFromSurfaceParms(guiSys, parms);
+    MarkHitDirty(HIT_DIRTY_SELF);
 }
 
 //==============================
@@ -2134,6 +2222,7 @@ void VRMenuObject::CreateFromSurfaceParms(
 void VRMenuObject::SetText(char const* text) {
     Text = text;
     TextDirty = true;
+    MarkHitDirty(HIT_DIRTY_SELF);
 }
 
 //==============================
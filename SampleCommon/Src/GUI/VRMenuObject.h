@@ -1041,13 +1041,18 @@ class VRMenuObject {
         return Flags;
     }
     void SetFlags(VRMenuObjectFlags_t const& flags) {
+        MarkFlagsChanged(flags);
         Flags = flags;
     }
     void AddFlags(VRMenuObjectFlags_t const& flags) {
+        MarkFlagsChanged(Flags | flags);
         Flags |= flags;
     }
     void RemoveFlags(VRMenuObjectFlags_t const& flags) {
-        Flags &= ~flags;
+        VRMenuObjectFlags_t newFlags = Flags;
+        newFlags &= ~flags;
+        MarkFlagsChanged(newFlags);
+        Flags = newFlags;
     }
 
     void ModifyFlags(bool const add, VRMenuObjectFlags_t const& flags) {
@@ -1075,6 +1080,7 @@ class VRMenuObject {
 
         Text = std::string(buf.data());
         TextDirty = true;
+        MarkHitDirty(HIT_DIRTY_SELF);
     }
 
     void
@@ -1106,22 +1112,26 @@ class VRMenuObject {
     }
     void SetLocalPose(OVR::Posef const& pose) {
         LocalPose = pose;
+        MarkHitDirty(HIT_DIRTY_SELF);
     }
     OVR::Vector3f const& GetLocalPosition() const {
         return LocalPose.Translation;
     }
     void SetLocalPosition(OVR::Vector3f const& pos) {
         LocalPose.Translation = pos;
+        MarkHitDirty(HIT_DIRTY_SELF);
     }
     OVR::Quatf const& GetLocalRotation() const {
         return LocalPose.Rotation;
     }
     void SetLocalRotation(OVR::Quatf const& rot) {
         LocalPose.Rotation = rot;
+        MarkHitDirty(HIT_DIRTY_SELF);
     }
     OVR::Vector3f GetLocalScale() const;
     void SetLocalScale(OVR::Vector3f const& scale) {
         LocalScale = scale;
+        MarkHitDirty(HIT_DIRTY_SELF);
     }
 
     OVR::Posef const& GetHilightPose() const {
@@ -1129,28 +1139,33 @@ class VRMenuObject {
     }
     void SetHilightPose(OVR::Posef const& pose) {
         HilightPose = pose;
+        MarkHitDirty(HIT_DIRTY_SELF);
     }
     float GetHilightScale() const {
         return HilightScale;
     }
     void SetHilightScale(float const s) {
         HilightScale = s;
+        MarkHitDirty(HIT_DIRTY_SELF);
     }
 
     void SetTextLocalPose(OVR::Posef const& pose) {
         TextLocalPose = pose;
+        MarkHitDirty(HIT_DIRTY_SELF);
     }
     OVR::Posef const& GetTextLocalPose() const {
         return TextLocalPose;
     }
     void SetTextLocalPosition(OVR::Vector3f const& pos) {
         TextLocalPose.Translation = pos;
+        MarkHitDirty(HIT_DIRTY_SELF);
     }
     OVR::Vector3f const& GetTextLocalPosition() const {
         return TextLocalPose.Translation;
     }
     void SetTextLocalRotation(OVR::Quatf const& rot) {
         TextLocalPose.Rotation = rot;
+        MarkHitDirty(HIT_DIRTY_SELF);
     }
     OVR::Quatf const& GetTextLocalRotation() const {
         return TextLocalPose.Rotation;
@@ -1161,6 +1176,7 @@ class VRMenuObject {
     }
     void SetTextLocalScale(OVR::Vector3f const& scale) {
         TextLocalScale = scale;
+        MarkHitDirty(HIT_DIRTY_SELF);
     }
 
     void SetLocalBoundsExpand(OVR::Vector3f const mins, OVR::Vector3f const& maxs);
@@ -1205,6 +1221,7 @@ class VRMenuObject {
 
     void SetFontParms(VRMenuFontParms const& fontParms) {
         FontParms = fontParms;
+        MarkHitDirty(HIT_DIRTY_SELF);
     }
     VRMenuFontParms const& GetFontParms() const {
         return FontParms;
@@ -1303,7 +1320,10 @@ class VRMenuObject {
     VRMenuSurface const& GetSurface(int const s) const {
         return Surfaces[s];
     }
+    // the surface may be changed through the returned reference, so its bounds are assumed to
+    // change
     VRMenuSurface& GetSurface(int const s) {
+        MarkHitDirty(HIT_DIRTY_SELF);
         return Surfaces[s];
     }
     std::vector<VRMenuSurface> const& GetSurfaces() const {
@@ -1396,6 +1416,15 @@ class VRMenuObject {
     bool Selected; // true if selected
     mutable bool TextDirty; // if true, recalculate text bounds
 
+    // hit test dirty bits, read and cleared by VRMenuMgrLocal when it refits its hit proxies
+    enum eHitDirty {
+        HIT_DIRTY_SELF = 1 << 0, // transform or bounds changed, refit this object and its subtree
+        HIT_DIRTY_CHILD = 1 << 1, // some descendant has dirty bits
+        HIT_DIRTY_STRUCTURE = 1 << 2 // children or hit visibility changed here or below
+    };
+    mutable uint8_t HitDirty;
+    OvrVRMenuMgr const* MenuMgr; // manager that created this object, used to reach ancestors
+
     // cached state
     OVR::Vector3f MinsBoundsExpand; // amount to expand local bounds mins
     OVR::Vector3f MaxsBoundsExpand; // amount to expand local bounds maxs
@@ -1415,6 +1444,11 @@ class VRMenuObject {
     VRMenuObject(VRMenuObjectParms const& parms, menuHandle_t const handle);
     ~VRMenuObject();
 
+    // Sets hit dirty bits on this object and flags its ancestors so the hit proxy refresh only
+    // has to descend into changed subtrees.
+    void MarkHitDirty(uint8_t const bits) const;
+    void MarkFlagsChanged(VRMenuObjectFlags_t const& newFlags) const;
+
     bool IntersectRayBounds(
         OVR::Vector3f const& start,
         OVR::Vector3f const& dir,
@@ -1436,6 +1470,28 @@ class VRMenuObject {
         ContentFlags_t const testContents,
         HitTestResult& result) const;
 
+    // Pose and scale of this object as used for hit testing, i.e. without the hilight pose.
+    void GetHitTestTransform(
+        OVR::Posef const& parentPose,
+        OVR::Vector3f const& parentScale,
+        OVR::Posef& outPose,
+        OVR::Vector3f& outScale) const;
+    // Test the ray against this object only, not its children. modelPose is the hit test pose of
+    // this object and parentScale the scale of its parent.
+    bool HitTestSelf(
+        OvrGuiSys const& guiSys,
+        OVR::Posef const& modelPose,
+        OVR::Vector3f const& parentScale,
+        OVR::Vector3f const& rayStart,
+        OVR::Vector3f const& rayDir,
+        ContentFlags_t const testContents,
+        HitTestResult& result) const;
+    // World-space bounds of everything HitTestSelf can hit.
+    OVR::Bounds3f GetHitTestBounds(
+        OvrGuiSys const& guiSys,
+        OVR::Posef const& modelPose,
+        OVR::Vector3f const& parentScale) const;
+
     int GetComponentIndex(VRMenuComponent* component) const;
 
     void FreeTextSurface() const;
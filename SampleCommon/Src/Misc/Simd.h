@@ -0,0 +1,274 @@
+// (c) Meta Platforms, Inc. and affiliates. Confidential and proprietary.
+
+/************************************************************************************
+
+Filename    :   Simd.h
+Content     :   Minimal 4-wide float SIMD wrapper over SSE, NEON and scalar code.
+Created     :   October 2026
+
+*************************************************************************************/
+
+#pragma once
+
+#include "OVR_Types.h"
+
+#include <string.h>
+#include <cstdint>
+
+#if defined(OVR_CPU_SSE)
+#include <xmmintrin.h>
+#define OVR_SIMD_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define OVR_SIMD_NEON
+#endif
+
+namespace OVRFW {
+
+// Comparisons return a mask with all bits of a lane set where the comparison is true, so masks
+// can be combined with the bitwise functions and used with Simd4f_Select.
+
+#if defined(OVR_SIMD_SSE)
+
+typedef __m128 simd4f_t;
+
+inline simd4f_t Simd4f_Set1(const float f) {
+    return _mm_set1_ps(f);
+}
+inline simd4f_t Simd4f_Set(const float x, const float y, const float z, const float w) {
+    return _mm_setr_ps(x, y, z, w);
+}
+inline simd4f_t Simd4f_Load(const float* p) {
+    return _mm_loadu_ps(p);
+}
+inline void Simd4f_Store(float* p, const simd4f_t a) {
+    _mm_storeu_ps(p, a);
+}
+inline simd4f_t Simd4f_Add(const simd4f_t a, const simd4f_t b) {
+    return _mm_add_ps(a, b);
+}
+inline simd4f_t Simd4f_Sub(const simd4f_t a, const simd4f_t b) {
+    return _mm_sub_ps(a, b);
+}
+inline simd4f_t Simd4f_Mul(const simd4f_t a, const simd4f_t b) {
+    return _mm_mul_ps(a, b);
+}
+inline simd4f_t Simd4f_Div(const simd4f_t a, const simd4f_t b) {
+    return _mm_div_ps(a, b);
+}
+inline simd4f_t Simd4f_Min(const simd4f_t a, const simd4f_t b) {
+    return _mm_min_ps(a, b);
+}
+inline simd4f_t Simd4f_Max(const simd4f_t a, const simd4f_t b) {
+    return _mm_max_ps(a, b);
+}
+inline simd4f_t Simd4f_Abs(const simd4f_t a) {
+    return _mm_andnot_ps(_mm_set1_ps(-0.0f), a);
+}
+inline simd4f_t Simd4f_CmpLT(const simd4f_t a, const simd4f_t b) {
+    return _mm_cmplt_ps(a, b);
+}
+inline simd4f_t Simd4f_CmpLE(const simd4f_t a, const simd4f_t b) {
+    return _mm_cmple_ps(a, b);
+}
+inline simd4f_t Simd4f_CmpGT(const simd4f_t a, const simd4f_t b) {
+    return _mm_cmpgt_ps(a, b);
+}
+inline simd4f_t Simd4f_CmpGE(const simd4f_t a, const simd4f_t b) {
+    return _mm_cmpge_ps(a, b);
+}
+inline simd4f_t Simd4f_And(const simd4f_t a, const simd4f_t b) {
+    return _mm_and_ps(a, b);
+}
+inline simd4f_t Simd4f_Or(const simd4f_t a, const simd4f_t b) {
+    return _mm_or_ps(a, b);
+}
+// returns a & ~b
+inline simd4f_t Simd4f_AndNot(const simd4f_t a, const simd4f_t b) {
+    return _mm_andnot_ps(b, a);
+}
+inline simd4f_t Simd4f_Select(const simd4f_t mask, const simd4f_t a, const simd4f_t b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+// returns one bit per lane, lane 0 in bit 0
+inline int Simd4f_MoveMask(const simd4f_t mask) {
+    return _mm_movemask_ps(mask);
+}
+
+#elif defined(OVR_SIMD_NEON)
+
+typedef float32x4_t simd4f_t;
+
+inline simd4f_t Simd4f_Set1(const float f) {
+    return vdupq_n_f32(f);
+}
+inline simd4f_t Simd4f_Set(const float x, const float y, const float z, const float w) {
+    const float v[4] = {x, y, z, w};
+    return vld1q_f32(v);
+}
+inline simd4f_t Simd4f_Load(const float* p) {
+    return vld1q_f32(p);
+}
+inline void Simd4f_Store(float* p, const simd4f_t a) {
+    vst1q_f32(p, a);
+}
+inline simd4f_t Simd4f_Add(const simd4f_t a, const simd4f_t b) {
+    return vaddq_f32(a, b);
+}
+inline simd4f_t Simd4f_Sub(const simd4f_t a, const simd4f_t b) {
+    return vsubq_f32(a, b);
+}
+inline simd4f_t Simd4f_Mul(const simd4f_t a, const simd4f_t b) {
+    return vmulq_f32(a, b);
+}
+inline simd4f_t Simd4f_Div(const simd4f_t a, const simd4f_t b) {
+#if defined(__aarch64__)
+    return vdivq_f32(a, b);
+#else
+    // reciprocal estimate refined with two Newton-Raphson steps
+    float32x4_t r = vrecpeq_f32(b);
+    r = vmulq_f32(vrecpsq_f32(b, r), r);
+    r = vmulq_f32(vrecpsq_f32(b, r), r);
+    return vmulq_f32(a, r);
+#endif
+}
+inline simd4f_t Simd4f_Min(const simd4f_t a, const simd4f_t b) {
+    return vminq_f32(a, b);
+}
+inline simd4f_t Simd4f_Max(const simd4f_t a, const simd4f_t b) {
+    return vmaxq_f32(a, b);
+}
+inline simd4f_t Simd4f_Abs(const simd4f_t a) {
+    return vabsq_f32(a);
+}
+inline simd4f_t Simd4f_CmpLT(const simd4f_t a, const simd4f_t b) {
+    return vreinterpretq_f32_u32(vcltq_f32(a, b));
+}
+inline simd4f_t Simd4f_CmpLE(const simd4f_t a, const simd4f_t b) {
+    return vreinterpretq_f32_u32(vcleq_f32(a, b));
+}
+inline simd4f_t Simd4f_CmpGT(const simd4f_t a, const simd4f_t b) {
+    return vreinterpretq_f32_u32(vcgtq_f32(a, b));
+}
+inline simd4f_t Simd4f_CmpGE(const simd4f_t a, const simd4f_t b) {
+    return vreinterpretq_f32_u32(vcgeq_f32(a, b));
+}
+inline simd4f_t Simd4f_And(const simd4f_t a, const simd4f_t b) {
+    return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b)));
+}
+inline simd4f_t Simd4f_Or(const simd4f_t a, const simd4f_t b) {
+    return vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b)));
+}
+// returns a & ~b
+inline simd4f_t Simd4f_AndNot(const simd4f_t a, const simd4f_t b) {
+    return vreinterpretq_f32_u32(vbicq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b)));
+}
+inline simd4f_t Simd4f_Select(const simd4f_t mask, const simd4f_t a, const simd4f_t b) {
+    return vbslq_f32(vreinterpretq_u32_f32(mask), a, b);
+}
+// returns one bit per lane, lane 0 in bit 0
+inline int Simd4f_MoveMask(const simd4f_t mask) {
+    static const uint32_t laneBits[4] = {1, 2, 4, 8};
+    const uint32x4_t bits = vandq_u32(vreinterpretq_u32_f32(mask), vld1q_u32(laneBits));
+    uint32x2_t sum = vadd_u32(vget_low_u32(bits), vget_high_u32(bits));
+    sum = vpadd_u32(sum, sum);
+    return static_cast<int>(vget_lane_u32(sum, 0));
+}
+
+#else
+
+struct simd4f_t {
+    float v[4];
+};
+
+inline simd4f_t Simd4f_Set1(const float f) {
+    simd4f_t r = {{f, f, f, f}};
+    return r;
+}
+inline simd4f_t Simd4f_Set(const float x, const float y, const float z, const float w) {
+    simd4f_t r = {{x, y, z, w}};
+    return r;
+}
+inline simd4f_t Simd4f_Load(const float* p) {
+    simd4f_t r = {{p[0], p[1], p[2], p[3]}};
+    return r;
+}
+inline void Simd4f_Store(float* p, const simd4f_t a) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = a.v[i];
+    }
+}
+
+#define SIMD4F_SCALAR_OP(name, expr)                                 \
+    inline simd4f_t name(const simd4f_t a, const simd4f_t b) {       \
+        simd4f_t r;                                                  \
+        for (int i = 0; i < 4; i++) {                                \
+            r.v[i] = (expr);                                         \
+        }                                                            \
+        return r;                                                    \
+    }
+
+inline float Simd4f_MaskBits(const bool b) {
+    const uint32_t bits = b ? 0xFFFFFFFFu : 0u;
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+inline uint32_t Simd4f_LaneBits(const float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+inline float Simd4f_LaneFloat(const uint32_t bits) {
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+SIMD4F_SCALAR_OP(Simd4f_Add, a.v[i] + b.v[i])
+SIMD4F_SCALAR_OP(Simd4f_Sub, a.v[i] - b.v[i])
+SIMD4F_SCALAR_OP(Simd4f_Mul, a.v[i] * b.v[i])
+SIMD4F_SCALAR_OP(Simd4f_Div, a.v[i] / b.v[i])
+SIMD4F_SCALAR_OP(Simd4f_Min, a.v[i] < b.v[i] ? a.v[i] : b.v[i])
+SIMD4F_SCALAR_OP(Simd4f_Max, a.v[i] > b.v[i] ? a.v[i] : b.v[i])
+SIMD4F_SCALAR_OP(Simd4f_CmpLT, Simd4f_MaskBits(a.v[i] < b.v[i]))
+SIMD4F_SCALAR_OP(Simd4f_CmpLE, Simd4f_MaskBits(a.v[i] <= b.v[i]))
+SIMD4F_SCALAR_OP(Simd4f_CmpGT, Simd4f_MaskBits(a.v[i] > b.v[i]))
+SIMD4F_SCALAR_OP(Simd4f_CmpGE, Simd4f_MaskBits(a.v[i] >= b.v[i]))
+SIMD4F_SCALAR_OP(
+    Simd4f_And,
+    Simd4f_LaneFloat(Simd4f_LaneBits(a.v[i]) & Simd4f_LaneBits(b.v[i])))
+SIMD4F_SCALAR_OP(Simd4f_Or, Simd4f_LaneFloat(Simd4f_LaneBits(a.v[i]) | Simd4f_LaneBits(b.v[i])))
+// returns a & ~b
+SIMD4F_SCALAR_OP(
+    Simd4f_AndNot,
+    Simd4f_LaneFloat(Simd4f_LaneBits(a.v[i]) & ~Simd4f_LaneBits(b.v[i])))
+
+#undef SIMD4F_SCALAR_OP
+
+inline simd4f_t Simd4f_Abs(const simd4f_t a) {
+    simd4f_t r;
+    for (int i = 0; i < 4; i++) {
+        r.v[i] = a.v[i] < 0.0f ? -a.v[i] : a.v[i];
+    }
+    return r;
+}
+inline simd4f_t Simd4f_Select(const simd4f_t mask, const simd4f_t a, const simd4f_t b) {
+    simd4f_t r;
+    for (int i = 0; i < 4; i++) {
+        r.v[i] = Simd4f_LaneBits(mask.v[i]) != 0 ? a.v[i] : b.v[i];
+    }
+    return r;
+}
+// returns one bit per lane, lane 0 in bit 0
+inline int Simd4f_MoveMask(const simd4f_t mask) {
+    int bits = 0;
+    for (int i = 0; i < 4; i++) {
+        bits |= ((Simd4f_LaneBits(mask.v[i]) >> 31) & 1) << i;
+    }
+    return bits;
+}
+
+#endif
+
+} // namespace OVRFW
@@ -14,17 +14,53 @@ Authors     :   Peter Chan
 
 #include "Misc/Log.h"
 
+#include <algorithm>
+#include <cmath>
+
 using OVR::OVRMath_Lerp;
 using OVR::Quatf;
 using OVR::Vector3f;
 
 namespace OVRFW {
 
+// glTF cubic spline keyframes are stored as (in-tangent, value, out-tangent) triples of
+// numElements floats each. The tangents are scaled by the duration of the frame.
+static void AnimationCubicSpline(
+    const float* buffer,
+    int numElements,
+    int frame,
+    float fraction,
+    float frameDuration,
+    float* result) {
+    const float* value0 = buffer + (frame * 3 + 1) * numElements;
+    const float* outTangent0 = buffer + (frame * 3 + 2) * numElements;
+    const float* inTangent1 = buffer + (frame * 3 + 3) * numElements;
+    const float* value1 = buffer + (frame * 3 + 4) * numElements;
+
+    const float t = fraction;
+    const float t2 = t * t;
+    const float t3 = t2 * t;
+    const float h00 = 2.0f * t3 - 3.0f * t2 + 1.0f;
+    const float h10 = (t3 - 2.0f * t2 + t) * frameDuration;
+    const float h01 = -2.0f * t3 + 3.0f * t2;
+    const float h11 = (t3 - t2) * frameDuration;
+    for (int i = 0; i < numElements; ++i) {
+        result[i] = h00 * value0[i] + h10 * outTangent0[i] + h01 * value1[i] + h11 * inTangent1[i];
+    }
+}
+
 static Vector3f AnimationInterpolateVector3f(
-    float* buffer,
+    const float* buffer,
     int frame,
     float fraction,
+    float frameDuration,
     ModelAnimationInterpolation interpolationType) {
+    if (interpolationType == MODEL_ANIMATION_INTERPOLATION_CUBICSPLINE) {
+        Vector3f result;
+        AnimationCubicSpline(buffer, 3, frame, fraction, frameDuration, &result.x);
+        return result;
+    }
+
     Vector3f firstElement;
     firstElement.x = buffer[frame * 3 + 0];
     firstElement.y = buffer[frame * 3 + 1];
@@ -48,11 +84,6 @@ static Vector3f AnimationInterpolateVector3f(
         ALOGW("MODEL_ANIMATION_INTERPOLATION_CATMULLROMSPLINE not implemented");
         firstElement = firstElement.Lerp(secondElement, fraction);
         return firstElement;
-    } else if (interpolationType == MODEL_ANIMATION_INTERPOLATION_CUBICSPLINE) {
-        // #TODO implement MODEL_ANIMATION_INTERPOLATION_CUBICSPLINE
-        ALOGW("MODEL_ANIMATION_INTERPOLATION_CUBICSPLINE not implemented");
-        firstElement = firstElement.Lerp(secondElement, fraction);
-        return firstElement;
     } else {
         ALOGW("invalid interpolation type on animation");
         return firstElement;
@@ -60,10 +91,20 @@ static Vector3f AnimationInterpolateVector3f(
 }
 
 static Quatf AnimationInterpolateQuatf(
-    float* buffer,
+    const float* buffer,
     int frame,
     float fraction,
+    float frameDuration,
     ModelAnimationInterpolation interpolationType) {
+    if (interpolationType == MODEL_ANIMATION_INTERPOLATION_CUBICSPLINE) {
+        // the spline is evaluated per component and the result renormalized
+        float result[4];
+        AnimationCubicSpline(buffer, 4, frame, fraction, frameDuration, result);
+        Quatf rotation(result[0], result[1], result[2], result[3]);
+        rotation.Normalize();
+        return rotation;
+    }
+
     Quatf firstElement;
     firstElement.x = buffer[frame * 4 + 0];
     firstElement.y = buffer[frame * 4 + 1];
@@ -89,10 +130,6 @@ static Quatf AnimationInterpolateQuatf(
             "MODEL_ANIMATION_INTERPOLATION_CATMULLROMSPLINE does not make sense for quaternions.");
         firstElement = firstElement.Lerp(secondElement, fraction);
         return firstElement;
-    } else if (interpolationType == MODEL_ANIMATION_INTERPOLATION_CUBICSPLINE) {
-        ALOGW("MODEL_ANIMATION_INTERPOLATION_CUBICSPLINE does not make sense for quaternions.");
-        firstElement = firstElement.Lerp(secondElement, fraction);
-        return firstElement;
     } else {
         ALOGW("invalid interpolation type on animation");
         return firstElement;
@@ -104,13 +141,20 @@ static std::vector<float> AnimationInterpolateWeights(
     int numWeightsPerFrame,
     int frame,
     float fraction,
+    float frameDuration,
     ModelAnimationInterpolation interpolationType) {
+    std::vector<float> result(numWeightsPerFrame, 0.0f);
+    if (interpolationType == MODEL_ANIMATION_INTERPOLATION_CUBICSPLINE) {
+        AnimationCubicSpline(
+            buffer, numWeightsPerFrame, frame, fraction, frameDuration, result.data());
+        return result;
+    }
+
     const int firstElementIndex = frame * numWeightsPerFrame;
     const int secondElementIndex = firstElementIndex + numWeightsPerFrame;
     const float* firstElement = buffer + firstElementIndex;
     const float* secondElement = buffer + secondElementIndex;
 
-    std::vector<float> result(numWeightsPerFrame, 0.0f);
     if (interpolationType == MODEL_ANIMATION_INTERPOLATION_LINEAR) {
         for (int i = 0; i < numWeightsPerFrame; ++i) {
             result[i] = OVRMath_Lerp(firstElement[i], secondElement[i], fraction);
@@ -130,17 +174,27 @@ static std::vector<float> AnimationInterpolateWeights(
         for (int i = 0; i < numWeightsPerFrame; ++i) {
             result[i] = OVRMath_Lerp(firstElement[i], secondElement[i], fraction);
         }
-    } else if (interpolationType == MODEL_ANIMATION_INTERPOLATION_CUBICSPLINE) {
-        ALOGW("MODEL_ANIMATION_INTERPOLATION_CUBICSPLINE not implemented, treating as linear");
-        for (int i = 0; i < numWeightsPerFrame; ++i) {
-            result[i] = OVRMath_Lerp(firstElement[i], secondElement[i], fraction);
-        }
     } else {
         ALOGW("invalid interpolation type on animation");
     }
     return result;
 }
 
+static float TimeLineFrameDuration(const ModelAnimationTimeLineState& timeLineState) {
+    // the last frame, e.g. of a single sample timeline, has no next sample
+    if (timeLineState.frame + 1 >= timeLineState.timeline->sampleCount) {
+        return 0.0f;
+    }
+    const float* sampleTimes = timeLineState.timeline->sampleTimes;
+    return sampleTimes[timeLineState.frame + 1] - sampleTimes[timeLineState.frame];
+}
+
+static int ChannelMorphWeightCount(const ModelAnimationChannel& channel) {
+    const int valuesPerFrame =
+        (channel.sampler->interpolation == MODEL_ANIMATION_INTERPOLATION_CUBICSPLINE) ? 3 : 1;
+    return channel.sampler->output->count / (channel.sampler->input->count * valuesPerFrame);
+}
+
 void ApplyAnimation(ModelState& modelState, int animationIndex) {
     const ModelAnimation& animation = modelState.mf->Animations[animationIndex];
     for (const ModelAnimationChannel& channel : animation.channels) {
@@ -149,35 +203,49 @@ void ApplyAnimation(ModelState& modelState, int animationIndex) {
             modelState.animationTimelineStates[channel.sampler->timeLineIndex];
 
         float* bufferData = (float*)(channel.sampler->output->BufferData());
+        const float frameDuration = TimeLineFrameDuration(timeLineState);
+        bool rtsChanged = false;
         if (channel.path == MODEL_ANIMATION_PATH_TRANSLATION) {
             Vector3f translation = AnimationInterpolateVector3f(
                 bufferData,
                 timeLineState.frame,
                 timeLineState.fraction,
+                frameDuration,
                 channel.sampler->interpolation);
-            nodeState.translation = translation;
+            if (!(nodeState.translation == translation)) {
+                nodeState.translation = translation;
+                rtsChanged = true;
+            }
         } else if (channel.path == MODEL_ANIMATION_PATH_SCALE) {
             Vector3f scale = AnimationInterpolateVector3f(
                 bufferData,
                 timeLineState.frame,
                 timeLineState.fraction,
+                frameDuration,
                 channel.sampler->interpolation);
-            nodeState.scale = scale;
+            if (!(nodeState.scale == scale)) {
+                nodeState.scale = scale;
+                rtsChanged = true;
+            }
         } else if (channel.path == MODEL_ANIMATION_PATH_ROTATION) {
             Quatf rotation = AnimationInterpolateQuatf(
                 bufferData,
                 timeLineState.frame,
                 timeLineState.fraction,
+                frameDuration,
                 channel.sampler->interpolation);
-            nodeState.rotation = rotation;
+            if (!(nodeState.rotation == rotation)) {
+                nodeState.rotation = rotation;
+                rtsChanged = true;
+            }
         } else if (channel.path == MODEL_ANIMATION_PATH_WEIGHTS) {
-            const int numWeightsPerFrame =
-                channel.sampler->output->count / channel.sampler->input->count;
+            const int numWeightsPerFrame = ChannelMorphWeightCount(channel);
             std::vector<float> weights = AnimationInterpolateWeights(
                 bufferData,
                 numWeightsPerFrame,
                 timeLineState.frame,
                 timeLineState.fraction,
+                frameDuration,
                 channel.sampler->interpolation);
             if (nodeState.weights.size() != weights.size()) {
                 ALOGE(
@@ -198,7 +266,398 @@ void ApplyAnimation(ModelState& modelState, int animationIndex) {
             ALOGW("Bad animation path on channel '%s'", animation.name.c_str());
         }
 
-        nodeState.CalculateLocalTransform();
+        // only nodes whose transform changed need to be updated by ModelState::UpdateTransforms
+        if (rtsChanged) {
+            nodeState.CalculateLocalTransform();
+        }
+    }
+}
+
+//==============================================================
+// ModelAnimationMixer
+
+void ModelAnimationMixer::Initialize(ModelState& state) {
+    modelState = &state;
+    const ModelFile* mf = state.mf;
+
+    clips.resize(mf->Animations.size());
+    for (int i = 0; i < static_cast<int>(mf->Animations.size()); i++) {
+        Clip& clip = clips[i];
+        clip.startTime = 0.0f;
+        clip.endTime = 0.0f;
+        clip.timeLines.clear();
+        for (const ModelAnimationSampler& sampler : mf->Animations[i].samplers) {
+            if (sampler.timeLineIndex < 0 ||
+                std::find(clip.timeLines.begin(), clip.timeLines.end(), sampler.timeLineIndex) !=
+                    clip.timeLines.end()) {
+                continue;
+            }
+            const ModelAnimationTimeLine& timeLine = mf->AnimationTimeLines[sampler.timeLineIndex];
+            if (clip.timeLines.empty()) {
+                clip.startTime = timeLine.startTime;
+                clip.endTime = timeLine.endTime;
+            } else {
+                clip.startTime = std::min(clip.startTime, timeLine.startTime);
+                clip.endTime = std::max(clip.endTime, timeLine.endTime);
+            }
+            clip.timeLines.push_back(sampler.timeLineIndex);
+        }
+    }
+
+    const int nodeCount = static_cast<int>(state.nodeStates.size());
+    morphOffsets.resize(nodeCount + 1);
+    morphOffsets[0] = 0;
+    for (int i = 0; i < nodeCount; i++) {
+        morphOffsets[i + 1] =
+            morphOffsets[i] + static_cast<int>(state.nodeStates[i].weights.size());
+    }
+
+    for (std::vector<float>* array :
+         {&pose.tx,
+          &pose.ty,
+          &pose.tz,
+          &pose.rx,
+          &pose.ry,
+          &pose.rz,
+          &pose.rw,
+          &pose.sx,
+          &pose.sy,
+          &pose.sz,
+          &pose.translationWeight,
+          &pose.rotationWeight,
+          &pose.scaleWeight,
+          &pose.morphWeightSum}) {
+        array->assign(nodeCount, 0.0f);
+    }
+    pose.morphWeights.assign(morphOffsets[nodeCount], 0.0f);
+    pose.morphAdditive.assign(morphOffsets[nodeCount], 0.0f);
+    pose.touched.assign(nodeCount, false);
+
+    layers.clear();
+}
+
+int ModelAnimationMixer::AddLayer(int animationIndex, ModelAnimationBlendMode mode, float weight) {
+    if (modelState == nullptr || animationIndex < 0 ||
+        animationIndex >= static_cast<int>(clips.size())) {
+        ALOGW("ModelAnimationMixer::AddLayer: invalid animation %d", animationIndex);
+        return -1;
+    }
+    const ModelFile* mf = modelState->mf;
+    Layer layer;
+    layer.animationIndex = animationIndex;
+    layer.mode = mode;
+    layer.weight = weight;
+    layer.timeInSeconds = clips[animationIndex].startTime;
+    layer.timeLineStates.resize(mf->AnimationTimeLines.size());
+    for (int i = 0; i < static_cast<int>(mf->AnimationTimeLines.size()); i++) {
+        layer.timeLineStates[i].timeline = &mf->AnimationTimeLines[i];
+    }
+    layers.push_back(layer);
+    return static_cast<int>(layers.size()) - 1;
+}
+
+void ModelAnimationMixer::SetLayerAnimation(int layerIndex, int animationIndex) {
+    if (animationIndex < 0 || animationIndex >= static_cast<int>(clips.size())) {
+        ALOGW("ModelAnimationMixer::SetLayerAnimation: invalid animation %d", animationIndex);
+        return;
+    }
+    layers[layerIndex].animationIndex = animationIndex;
+    layers[layerIndex].timeInSeconds = clips[animationIndex].startTime;
+}
+
+void ModelAnimationMixer::SetLayerTime(
+    int layerIndex,
+    float timeInSeconds,
+    ModelAnimationTimeType type) {
+    Layer& layer = layers[layerIndex];
+    const Clip& clip = clips[layer.animationIndex];
+    const float duration = clip.endTime - clip.startTime;
+    if (duration <= 0.0f) {
+        layer.timeInSeconds = clip.startTime;
+        return;
+    }
+    switch (type) {
+        case MODEL_ANIMATION_TIME_TYPE_ONCE_FORWARD: {
+            timeInSeconds = std::max(0.0f, std::min(timeInSeconds, duration));
+        } break;
+        case MODEL_ANIMATION_TIME_TYPE_LOOP_FORWARD: {
+            timeInSeconds = fmodf(timeInSeconds, duration);
+            if (timeInSeconds < 0.0f) {
+                timeInSeconds += duration;
+            }
+        } break;
+        case MODEL_ANIMATION_TIME_TYPE_LOOP_FORWARD_AND_BACK: {
+            timeInSeconds = fmodf(timeInSeconds, duration * 2.0f);
+            if (timeInSeconds < 0.0f) {
+                timeInSeconds += duration * 2.0f;
+            }
+            if (timeInSeconds > duration) {
+                timeInSeconds = duration * 2.0f - timeInSeconds;
+            }
+        } break;
+    }
+    layer.timeInSeconds = clip.startTime + timeInSeconds;
+}
+
+void ModelAnimationMixer::SetLayerWeight(int layerIndex, float weight) {
+    layers[layerIndex].weight = weight;
+}
+
+void ModelAnimationMixer::CrossFade(int fromLayerIndex, int toLayerIndex, float fraction) {
+    fraction = std::max(0.0f, std::min(fraction, 1.0f));
+    layers[fromLayerIndex].weight = 1.0f - fraction;
+    layers[toLayerIndex].weight = fraction;
+}
+
+void ModelAnimationMixer::EvaluateLayer(Layer& layer, bool additive) {
+    const float weight = layer.weight;
+    if (weight <= 0.0f) {
+        return;
+    }
+    for (const int timeLineIndex : clips[layer.animationIndex].timeLines) {
+        layer.timeLineStates[timeLineIndex].CalculateFrameAndFraction(layer.timeInSeconds);
+    }
+
+    const ModelAnimation& animation = modelState->mf->Animations[layer.animationIndex];
+    for (const ModelAnimationChannel& channel : animation.channels) {
+        const int n = channel.nodeIndex;
+        const ModelNode& node = *modelState->nodeStates[n].node;
+        const ModelAnimationTimeLineState& timeLineState =
+            layer.timeLineStates[channel.sampler->timeLineIndex];
+        const float frameDuration = TimeLineFrameDuration(timeLineState);
+        const float* bufferData = (const float*)(channel.sampler->output->BufferData());
+        const ModelAnimationInterpolation interpolation = channel.sampler->interpolation;
+        pose.touched[n] = true;
+
+        if (channel.path == MODEL_ANIMATION_PATH_TRANSLATION ||
+            channel.path == MODEL_ANIMATION_PATH_SCALE) {
+            const Vector3f value = AnimationInterpolateVector3f(
+                bufferData,
+                timeLineState.frame,
+                timeLineState.fraction,
+                frameDuration,
+                interpolation);
+            const bool isTranslation = (channel.path == MODEL_ANIMATION_PATH_TRANSLATION);
+            float& x = isTranslation ? pose.tx[n] : pose.sx[n];
+            float& y = isTranslation ? pose.ty[n] : pose.sy[n];
+            float& z = isTranslation ? pose.tz[n] : pose.sz[n];
+            if (additive) {
+                const Vector3f reference =
+                    AnimationInterpolateVector3f(bufferData, 0, 0.0f, frameDuration, interpolation);
+                if (isTranslation) {
+                    x += weight * (value.x - reference.x);
+                    y += weight * (value.y - reference.y);
+                    z += weight * (value.z - reference.z);
+                } else {
+                    x *= OVRMath_Lerp(
+                        1.0f, reference.x != 0.0f ? value.x / reference.x : 1.0f, weight);
+                    y *= OVRMath_Lerp(
+                        1.0f, reference.y != 0.0f ? value.y / reference.y : 1.0f, weight);
+                    z *= OVRMath_Lerp(
+                        1.0f, reference.z != 0.0f ? value.z / reference.z : 1.0f, weight);
+                }
+            } else {
+                x += weight * value.x;
+                y += weight * value.y;
+                z += weight * value.z;
+                (isTranslation ? pose.translationWeight[n] : pose.scaleWeight[n]) += weight;
+            }
+        } else if (channel.path == MODEL_ANIMATION_PATH_ROTATION) {
+            Quatf value = AnimationInterpolateQuatf(
+                bufferData,
+                timeLineState.frame,
+                timeLineState.fraction,
+                frameDuration,
+                interpolation);
+            if (additive) {
+                const Quatf reference =
+                    AnimationInterpolateQuatf(bufferData, 0, 0.0f, frameDuration, interpolation);
+                // scale the difference to the reference by lerping from identity
+                Quatf delta = reference.Inverse() * value;
+                if (delta.w < 0.0f) {
+                    delta = delta * -1.0f;
+                }
+                delta = (Quatf() * (1.0f - weight) + delta * weight).Normalized();
+                Quatf rotation(pose.rx[n], pose.ry[n], pose.rz[n], pose.rw[n]);
+                rotation = (rotation * delta).Normalized();
+                pose.rx[n] = rotation.x;
+                pose.ry[n] = rotation.y;
+                pose.rz[n] = rotation.z;
+                pose.rw[n] = rotation.w;
+            } else {
+                // keep all contributions in the hemisphere of the rest pose so they average
+                if (value.Dot(node.rotation) < 0.0f) {
+                    value = value * -1.0f;
+                }
+                pose.rx[n] += weight * value.x;
+                pose.ry[n] += weight * value.y;
+                pose.rz[n] += weight * value.z;
+                pose.rw[n] += weight * value.w;
+                pose.rotationWeight[n] += weight;
+            }
+        } else if (channel.path == MODEL_ANIMATION_PATH_WEIGHTS) {
+            const int numWeightsPerFrame = ChannelMorphWeightCount(channel);
+            const int offset = morphOffsets[n];
+            if (numWeightsPerFrame != morphOffsets[n + 1] - offset) {
+                ALOGE(
+                    "Mismatch animation weights count, node:%d, expected:%d, actual:%d, "
+                    "channel:%d, '%s'",
+                    n,
+                    morphOffsets[n + 1] - offset,
+                    numWeightsPerFrame,
+                    static_cast<int>(&channel - animation.channels.data()),
+                    animation.name.c_str());
+                continue;
+            }
+            const std::vector<float> weights = AnimationInterpolateWeights(
+                bufferData,
+                numWeightsPerFrame,
+                timeLineState.frame,
+                timeLineState.fraction,
+                frameDuration,
+                interpolation);
+            if (additive) {
+                const std::vector<float> reference = AnimationInterpolateWeights(
+                    bufferData, numWeightsPerFrame, 0, 0.0f, frameDuration, interpolation);
+                for (int i = 0; i < numWeightsPerFrame; i++) {
+                    pose.morphWeights[offset + i] += weight * (weights[i] - reference[i]);
+                }
+            } else if (channel.additiveWeightIndex >= 0) {
+                pose.morphAdditive[offset + channel.additiveWeightIndex] +=
+                    weight * weights[channel.additiveWeightIndex];
+            } else {
+                for (int i = 0; i < numWeightsPerFrame; i++) {
+                    pose.morphWeights[offset + i] += weight * weights[i];
+                }
+                pose.morphWeightSum[n] += weight;
+            }
+        }
+    }
+}
+
+void ModelAnimationMixer::Apply() {
+    if (modelState == nullptr) {
+        return;
+    }
+    const int nodeCount = static_cast<int>(modelState->nodeStates.size());
+
+    std::fill(pose.tx.begin(), pose.tx.end(), 0.0f);
+    std::fill(pose.ty.begin(), pose.ty.end(), 0.0f);
+    std::fill(pose.tz.begin(), pose.tz.end(), 0.0f);
+    std::fill(pose.rx.begin(), pose.rx.end(), 0.0f);
+    std::fill(pose.ry.begin(), pose.ry.end(), 0.0f);
+    std::fill(pose.rz.begin(), pose.rz.end(), 0.0f);
+    std::fill(pose.rw.begin(), pose.rw.end(), 0.0f);
+    std::fill(pose.sx.begin(), pose.sx.end(), 0.0f);
+    std::fill(pose.sy.begin(), pose.sy.end(), 0.0f);
+    std::fill(pose.sz.begin(), pose.sz.end(), 0.0f);
+    std::fill(pose.translationWeight.begin(), pose.translationWeight.end(), 0.0f);
+    std::fill(pose.rotationWeight.begin(), pose.rotationWeight.end(), 0.0f);
+    std::fill(pose.scaleWeight.begin(), pose.scaleWeight.end(), 0.0f);
+    std::fill(pose.morphWeights.begin(), pose.morphWeights.end(), 0.0f);
+    std::fill(pose.morphWeightSum.begin(), pose.morphWeightSum.end(), 0.0f);
+    std::fill(pose.morphAdditive.begin(), pose.morphAdditive.end(), 0.0f);
+    std::fill(pose.touched.begin(), pose.touched.end(), false);
+
+    for (Layer& layer : layers) {
+        if (layer.mode == MODEL_ANIMATION_BLEND_OVERRIDE) {
+            EvaluateLayer(layer, false);
+        }
+    }
+
+    // Normalize the blended values. Weights below one are filled up with the rest pose and nodes
+    // without any override contribution start from the rest pose, so the additive layers never
+    // accumulate on top of the previous frame.
+    for (int n = 0; n < nodeCount; n++) {
+        const ModelNode& node = *modelState->nodeStates[n].node;
+
+        float w = pose.translationWeight[n];
+        if (w <= 0.0f) {
+            pose.tx[n] = node.translation.x;
+            pose.ty[n] = node.translation.y;
+            pose.tz[n] = node.translation.z;
+        } else if (w < 1.0f) {
+            pose.tx[n] += (1.0f - w) * node.translation.x;
+            pose.ty[n] += (1.0f - w) * node.translation.y;
+            pose.tz[n] += (1.0f - w) * node.translation.z;
+        } else {
+            pose.tx[n] /= w;
+            pose.ty[n] /= w;
+            pose.tz[n] /= w;
+        }
+
+        w = pose.scaleWeight[n];
+        if (w <= 0.0f) {
+            pose.sx[n] = node.scale.x;
+            pose.sy[n] = node.scale.y;
+            pose.sz[n] = node.scale.z;
+        } else if (w < 1.0f) {
+            pose.sx[n] += (1.0f - w) * node.scale.x;
+            pose.sy[n] += (1.0f - w) * node.scale.y;
+            pose.sz[n] += (1.0f - w) * node.scale.z;
+        } else {
+            pose.sx[n] /= w;
+            pose.sy[n] /= w;
+            pose.sz[n] /= w;
+        }
+
+        w = pose.rotationWeight[n];
+        Quatf rotation = node.rotation;
+        if (w > 0.0f) {
+            const float restWeight = std::max(0.0f, 1.0f - w);
+            Quatf blended(
+                pose.rx[n] + restWeight * node.rotation.x,
+                pose.ry[n] + restWeight * node.rotation.y,
+                pose.rz[n] + restWeight * node.rotation.z,
+                pose.rw[n] + restWeight * node.rotation.w);
+            // opposing rotations can cancel out, keep the rest pose in that case
+            rotation = (blended.LengthSq() > 1e-12f) ? blended.Normalized() : node.rotation;
+        }
+        pose.rx[n] = rotation.x;
+        pose.ry[n] = rotation.y;
+        pose.rz[n] = rotation.z;
+        pose.rw[n] = rotation.w;
+
+        w = pose.morphWeightSum[n];
+        for (int i = morphOffsets[n]; i < morphOffsets[n + 1]; i++) {
+            const int j = i - morphOffsets[n];
+            const float restWeight =
+                (j < static_cast<int>(node.weights.size())) ? node.weights[j] : 0.0f;
+            if (w <= 0.0f) {
+                pose.morphWeights[i] = restWeight;
+            } else if (w < 1.0f) {
+                pose.morphWeights[i] += (1.0f - w) * restWeight;
+            } else {
+                pose.morphWeights[i] /= w;
+            }
+            pose.morphWeights[i] += pose.morphAdditive[i];
+        }
+    }
+
+    for (Layer& layer : layers) {
+        if (layer.mode == MODEL_ANIMATION_BLEND_ADDITIVE) {
+            EvaluateLayer(layer, true);
+        }
+    }
+
+    for (int n = 0; n < nodeCount; n++) {
+        if (!pose.touched[n]) {
+            continue;
+        }
+        ModelNodeState& nodeState = modelState->nodeStates[n];
+        const Vector3f translation(pose.tx[n], pose.ty[n], pose.tz[n]);
+        const Quatf rotation(pose.rx[n], pose.ry[n], pose.rz[n], pose.rw[n]);
+        const Vector3f scale(pose.sx[n], pose.sy[n], pose.sz[n]);
+        if (!(nodeState.translation == translation) || !(nodeState.rotation == rotation) ||
+            !(nodeState.scale == scale)) {
+            nodeState.translation = translation;
+            nodeState.rotation = rotation;
+            nodeState.scale = scale;
+            nodeState.CalculateLocalTransform();
+        }
+        for (int i = morphOffsets[n]; i < morphOffsets[n + 1]; i++) {
+            nodeState.weights[i - morphOffsets[n]] = pose.morphWeights[i];
+        }
     }
 }
 
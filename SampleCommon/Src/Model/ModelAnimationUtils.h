@@ -13,8 +13,82 @@ Authors     :   Peter Chan
 
 #include "ModelDef.h"
 
+#include <vector>
+
 namespace OVRFW {
 
 void ApplyAnimation(ModelState& modelState, int animationIndex);
 
+enum ModelAnimationBlendMode {
+    MODEL_ANIMATION_BLEND_OVERRIDE, // weighted average with the other override layers
+    MODEL_ANIMATION_BLEND_ADDITIVE, // adds the difference to the first frame of the clip
+};
+
+// Evaluates several animation clips into one pose and writes each animated node once.
+// Override layers are blended by weight; where their weights sum to less than one the
+// node's rest pose makes up the remainder. Additive layers are applied on top in layer order.
+// Call ModelState::UpdateTransforms after Apply.
+class ModelAnimationMixer {
+   public:
+    ModelAnimationMixer() : modelState(nullptr) {}
+
+    void Initialize(ModelState& state);
+
+    int AddLayer(
+        int animationIndex,
+        ModelAnimationBlendMode mode = MODEL_ANIMATION_BLEND_OVERRIDE,
+        float weight = 1.0f);
+    int GetLayerCount() const {
+        return static_cast<int>(layers.size());
+    }
+    void SetLayerAnimation(int layerIndex, int animationIndex);
+    // The time is relative to the start of the layer's clip.
+    void SetLayerTime(
+        int layerIndex,
+        float timeInSeconds,
+        ModelAnimationTimeType type = MODEL_ANIMATION_TIME_TYPE_LOOP_FORWARD);
+    void SetLayerWeight(int layerIndex, float weight);
+    // Sets the weights of two layers for a cross-fade from one to the other.
+    void CrossFade(int fromLayerIndex, int toLayerIndex, float fraction);
+
+    void Apply();
+
+   private:
+    struct Clip {
+        float startTime;
+        float endTime;
+        std::vector<int> timeLines;
+    };
+
+    struct Layer {
+        int animationIndex;
+        ModelAnimationBlendMode mode;
+        float weight;
+        float timeInSeconds;
+        std::vector<ModelAnimationTimeLineState> timeLineStates;
+    };
+
+    // The pose is kept as structure of arrays indexed by node.
+    struct Pose {
+        std::vector<float> tx, ty, tz;
+        std::vector<float> rx, ry, rz, rw;
+        std::vector<float> sx, sy, sz;
+        std::vector<float> translationWeight;
+        std::vector<float> rotationWeight;
+        std::vector<float> scaleWeight;
+        std::vector<float> morphWeights; // all nodes' morph target weights, see morphOffsets
+        std::vector<float> morphWeightSum; // summed layer weight per node
+        std::vector<float> morphAdditive;
+        std::vector<bool> touched;
+    };
+
+    void EvaluateLayer(Layer& layer, bool additive);
+
+    ModelState* modelState;
+    std::vector<Clip> clips;
+    std::vector<Layer> layers;
+    std::vector<int> morphOffsets;
+    Pose pose;
+};
+
 } // namespace OVRFW
@@ -12,6 +12,7 @@ Authors     :   J.M.P. van Waveren
 #include "ModelCollision.h"
 
 #include <math.h>
+#include <algorithm>
 
 namespace OVRFW {
 
@@ -97,12 +98,176 @@ bool CollisionPolytope::PopOut(OVR::Vector3f& p) const {
     return true;
 }
 
+// Polytopes that reach this far out are considered unbounded.
+const float COLLISION_MAX_EXTENT = 100000.0f;
+
+bool CollisionPolytope::CalculateBounds(OVR::Bounds3f& bounds) const {
+    // Clip against a huge box so unbounded polytopes still have vertices.
+    std::vector<OVR::Planef> planes = Planes;
+    for (int i = 0; i < 3; i++) {
+        OVR::Vector3f n(0.0f);
+        n[i] = 1.0f;
+        planes.push_back(OVR::Planef(n, -COLLISION_MAX_EXTENT));
+        planes.push_back(OVR::Planef(-n, -COLLISION_MAX_EXTENT));
+    }
+
+    // The vertices are the intersections of any three planes that are inside all other planes.
+    bounds.Clear();
+    const int numPlanes = static_cast<int>(planes.size());
+    for (int i = 0; i < numPlanes; i++) {
+        for (int j = i + 1; j < numPlanes; j++) {
+            const OVR::Vector3f nj = planes[i].N.Cross(planes[j].N);
+            for (int k = j + 1; k < numPlanes; k++) {
+                const float det = nj.Dot(planes[k].N);
+                if (fabsf(det) < 1e-6f) {
+                    continue;
+                }
+                const OVR::Vector3f v = (planes[j].N.Cross(planes[k].N) * -planes[i].D +
+                                         planes[k].N.Cross(planes[i].N) * -planes[j].D +
+                                         nj * -planes[k].D) /
+                    det;
+                bool inside = true;
+                for (int l = 0; l < numPlanes && inside; l++) {
+                    inside = planes[l].TestSide(v) <= COLLISION_EPSILON;
+                }
+                if (inside) {
+                    bounds.AddPoint(v);
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < 3; i++) {
+        if (bounds.b[0][i] <= -COLLISION_MAX_EXTENT * 0.5f ||
+            bounds.b[1][i] >= COLLISION_MAX_EXTENT * 0.5f) {
+            return false;
+        }
+    }
+    return true;
+}
+
 //-----------------------------------------------------------------------------
 //	ModelCollision
 //-----------------------------------------------------------------------------
 
-bool ModelCollision::TestPoint(const OVR::Vector3f& p) const {
+static bool BoundsOverlap(const OVR::Bounds3f& a, const OVR::Bounds3f& b) {
+    return a.b[0].x <= b.b[1].x && a.b[0].y <= b.b[1].y && a.b[0].z <= b.b[1].z &&
+        a.b[1].x >= b.b[0].x && a.b[1].y >= b.b[0].y && a.b[1].z >= b.b[0].z;
+}
+
+static int BuildBvhNode(
+    std::vector<collisionBvhNode_t>& nodes,
+    std::vector<int>& polytopes,
+    const std::vector<OVR::Bounds3f>& polytopeBounds,
+    const int first,
+    const int count) {
+    const int MAX_LEAF_POLYTOPES = 4;
+
+    const int nodeIndex = static_cast<int>(nodes.size());
+    nodes.emplace_back();
+    nodes[nodeIndex].bounds.Clear();
+    for (int i = first; i < first + count; i++) {
+        nodes[nodeIndex].bounds =
+            OVR::Bounds3f::Union(nodes[nodeIndex].bounds, polytopeBounds[polytopes[i]]);
+    }
+
+    if (count <= MAX_LEAF_POLYTOPES) {
+        nodes[nodeIndex].firstPolytope = first;
+        nodes[nodeIndex].numPolytopes = count;
+        nodes[nodeIndex].rightChild = -1;
+        return nodeIndex;
+    }
+
+    // Split at the median of the polytope centers along the longest axis.
+    const OVR::Vector3f size = nodes[nodeIndex].bounds.GetSize();
+    const int axis = (size.x > size.y) ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+    const int half = count / 2;
+    std::nth_element(
+        polytopes.begin() + first,
+        polytopes.begin() + first + half,
+        polytopes.begin() + first + count,
+        [&polytopeBounds, axis](const int a, const int b) {
+            return polytopeBounds[a].GetCenter()[axis] < polytopeBounds[b].GetCenter()[axis];
+        });
+
+    nodes[nodeIndex].firstPolytope = 0;
+    nodes[nodeIndex].numPolytopes = 0;
+    BuildBvhNode(nodes, polytopes, polytopeBounds, first, half);
+    const int rightChild =
+        BuildBvhNode(nodes, polytopes, polytopeBounds, first + half, count - half);
+    nodes[nodeIndex].rightChild = rightChild;
+    return nodeIndex;
+}
+
+void ModelCollision::BuildBvh() {
+    BvhNodes.clear();
+    BvhPolytopes.clear();
+    UnboundedPolytopes.clear();
+
+    std::vector<OVR::Bounds3f> polytopeBounds(Polytopes.size());
     for (int i = 0; i < static_cast<int>(Polytopes.size()); i++) {
+        if (Polytopes[i].CalculateBounds(polytopeBounds[i])) {
+            // Account for the tolerance of the queries.
+            const OVR::Vector3f expand(2.0f * COLLISION_EPSILON);
+            polytopeBounds[i] = OVR::Bounds3f::Expand(polytopeBounds[i], -expand, expand);
+            BvhPolytopes.push_back(i);
+        } else {
+            UnboundedPolytopes.push_back(i);
+        }
+    }
+
+    if (!BvhPolytopes.empty()) {
+        BuildBvhNode(
+            BvhNodes, BvhPolytopes, polytopeBounds, 0, static_cast<int>(BvhPolytopes.size()));
+    }
+    BvhPolytopeCount = static_cast<int>(Polytopes.size());
+}
+
+void ModelCollision::FindCandidates(const OVR::Bounds3f& bounds, std::vector<int>& candidates)
+    const {
+    candidates.resize(0);
+    if (BvhPolytopeCount != static_cast<int>(Polytopes.size()) || BvhPolytopeCount == 0) {
+        for (int i = 0; i < static_cast<int>(Polytopes.size()); i++) {
+            candidates.push_back(i);
+        }
+        return;
+    }
+
+    candidates.insert(candidates.end(), UnboundedPolytopes.begin(), UnboundedPolytopes.end());
+    if (!BvhNodes.empty()) {
+        int stack[64];
+        int stackDepth = 0;
+        stack[stackDepth++] = 0;
+        while (stackDepth > 0) {
+            const collisionBvhNode_t& node = BvhNodes[stack[--stackDepth]];
+            if (!BoundsOverlap(node.bounds, bounds)) {
+                continue;
+            }
+            if (node.numPolytopes > 0) {
+                candidates.insert(
+                    candidates.end(),
+                    BvhPolytopes.begin() + node.firstPolytope,
+                    BvhPolytopes.begin() + node.firstPolytope + node.numPolytopes);
+            } else {
+                const int nodeIndex = static_cast<int>(&node - BvhNodes.data());
+                stack[stackDepth++] = node.rightChild;
+                stack[stackDepth++] = nodeIndex + 1;
+            }
+        }
+    }
+
+    // Visit the polytopes in the same order as the linear search.
+    std::sort(candidates.begin(), candidates.end());
+}
+
+bool ModelCollision::TestPoint(const OVR::Vector3f& p) const {
+    std::vector<int> scratch;
+    return TestPoint(p, scratch);
+}
+
+bool ModelCollision::TestPoint(const OVR::Vector3f& p, std::vector<int>& scratch) const {
+    FindCandidates(OVR::Bounds3f(p, p), scratch);
+    for (const int i : scratch) {
         if (Polytopes[i].TestPoint(p)) {
             return true;
         }
@@ -110,6 +275,8 @@ bool ModelCollision::TestPoint(const OVR::Vector3f& p) const {
     return false;
 }
 
+// CollisionPolytope::TestRay can clip a ray against a polytope that the ray passes outside of, so
+// the polytopes can't be culled by bounds without changing the result.
 bool ModelCollision::TestRay(
     const OVR::Vector3f& start,
     const OVR::Vector3f& dir,
@@ -133,7 +300,13 @@ bool ModelCollision::TestRay(
 }
 
 bool ModelCollision::PopOut(OVR::Vector3f& p) const {
-    for (int i = 0; i < static_cast<int>(Polytopes.size()); i++) {
+    std::vector<int> scratch;
+    return PopOut(p, scratch);
+}
+
+bool ModelCollision::PopOut(OVR::Vector3f& p, std::vector<int>& scratch) const {
+    FindCandidates(OVR::Bounds3f(p, p), scratch);
+    for (const int i : scratch) {
         if (Polytopes[i].PopOut(p)) {
             return true;
         }
@@ -155,11 +328,30 @@ OVR::Vector3f SlideMove(
     const float moveDistance,
     const ModelCollision& collisionModel,
     const ModelCollision& groundCollisionModel) {
+    std::vector<int> scratch;
+    return SlideMove(
+        footPos,
+        eyeHeight,
+        moveDirection,
+        moveDistance,
+        collisionModel,
+        groundCollisionModel,
+        scratch);
+}
+
+OVR::Vector3f SlideMove(
+    const OVR::Vector3f& footPos,
+    const float eyeHeight,
+    const OVR::Vector3f& moveDirection,
+    const float moveDistance,
+    const ModelCollision& collisionModel,
+    const ModelCollision& groundCollisionModel,
+    std::vector<int>& scratch) {
     // Check for collisions at eye level to prevent slipping under walls.
     OVR::Vector3f eyePos = footPos + UpVector * eyeHeight;
 
     // Pop out of any collision models.
-    collisionModel.PopOut(eyePos);
+    collisionModel.PopOut(eyePos, scratch);
 
     {
         OVR::Planef fowardCollisionPlane;
@@ -39,15 +39,30 @@ class CollisionPolytope {
     // Pops the given point out of the polytope if inside.
     bool PopOut(OVR::Vector3f& p) const;
 
+    // Calculates the bounds of the polytope from the intersections of its planes.
+    // Returns false if the polytope is unbounded.
+    bool CalculateBounds(OVR::Bounds3f& bounds) const;
+
    public:
     std::string Name;
     std::vector<OVR::Planef> Planes;
 };
 
+struct collisionBvhNode_t {
+    OVR::Bounds3f bounds;
+    int firstPolytope; // index into BvhPolytopes for leaves
+    int numPolytopes; // 0 for inner nodes
+    int rightChild; // the left child directly follows an inner node
+};
+
 class ModelCollision {
    public:
+    // TestPoint and PopOut take an optional scratch buffer for the candidate polytopes, so
+    // callers that query every frame can reuse its allocation.
+
     // Returns true if the given point is inside solid.
     bool TestPoint(const OVR::Vector3f& p) const;
+    bool TestPoint(const OVR::Vector3f& p, std::vector<int>& scratch) const;
 
     // Returns true if the ray hits solid.
     // The length of the ray is clipped to the point where the ray enters solid.
@@ -60,9 +75,27 @@ class ModelCollision {
 
     // Pops the given point out of any collision geometry the point may be inside of.
     bool PopOut(OVR::Vector3f& p) const;
+    bool PopOut(OVR::Vector3f& p, std::vector<int>& scratch) const;
+
+    // Builds a bounding volume hierarchy over the polytopes so TestPoint and PopOut skip the
+    // polytopes whose bounds do not contain the point. The remaining polytopes are tested in
+    // index order with the same per-polytope tests, so the results are the same as without it.
+    // TestRay always tests all polytopes.
+    // Must be called again after the polytopes change, until then all polytopes are tested.
+    void BuildBvh();
 
    public:
     std::vector<CollisionPolytope> Polytopes;
+
+   private:
+    // Fills candidates with the indices of the polytopes whose bounds overlap the given bounds
+    // in ascending order. Without a valid hierarchy this is every polytope.
+    void FindCandidates(const OVR::Bounds3f& bounds, std::vector<int>& candidates) const;
+
+    std::vector<collisionBvhNode_t> BvhNodes;
+    std::vector<int> BvhPolytopes;
+    std::vector<int> UnboundedPolytopes;
+    int BvhPolytopeCount = 0;
 };
 
 OVR::Vector3f SlideMove(
@@ -72,5 +105,13 @@ OVR::Vector3f SlideMove(
     const float moveDistance,
     const ModelCollision& collisionModel,
     const ModelCollision& groundCollisionModel);
+OVR::Vector3f SlideMove(
+    const OVR::Vector3f& footPos,
+    const float eyeHeight,
+    const OVR::Vector3f& moveDirection,
+    const float moveDistance,
+    const ModelCollision& collisionModel,
+    const ModelCollision& groundCollisionModel,
+    std::vector<int>& scratch);
 
 } // namespace OVRFW
@@ -32,13 +32,19 @@ struct MaterialParms {
           EnableDiffuseAniso(false),
           EnableEmissiveLodClamp(true),
           Transparent(false),
-          PolygonOffset(false) {}
+          PolygonOffset(false),
+          Force16BitIndices(false),
+          OptimizeMeshes(false),
+          BuildTraceModel(false) {}
 
     bool UseSrgbTextureFormats; // use sRGB textures
     bool EnableDiffuseAniso; // enable anisotropic filtering on the diffuse texture
     bool EnableEmissiveLodClamp; // enable LOD clamp on the emissive texture to avoid light bleeding
     bool Transparent; // surfaces with this material flag need to render in a transparent pass
     bool PolygonOffset; // render with polygon offset enabled
+    bool Force16BitIndices; // split meshes with too many vertices instead of using 32 bit indices
+    bool OptimizeMeshes; // reorder triangles and vertices for the vertex cache and less overdraw
+    bool BuildTraceModel; // build a kd-tree for ModelFile::TraceModel when loading glTF models
     std::function<bool(ModelFile&, const std::string&)> ImageUriHandler; // custom image URI handler
 };
 
@@ -107,6 +113,25 @@ enum ModelAccessorType {
     ACCESSOR_MAT4
 };
 
+// The elements of a sparse accessor that differ from its buffer view data, or from zeros when the
+// accessor has no buffer view.
+struct ModelSparseAccessor {
+    ModelSparseAccessor()
+        : count(0),
+          indicesBufferView(nullptr),
+          indicesByteOffset(0),
+          indicesComponentType(0),
+          valuesBufferView(nullptr),
+          valuesByteOffset(0) {}
+
+    int count;
+    const ModelBufferView* indicesBufferView;
+    size_t indicesByteOffset;
+    int indicesComponentType;
+    const ModelBufferView* valuesBufferView;
+    size_t valuesByteOffset;
+};
+
 #define MAX_MODEL_ACCESSOR_COMPONENT_SIZE 16
 class ModelAccessor {
    public:
@@ -142,7 +167,8 @@ class ModelAccessor {
     float floatMin[MAX_MODEL_ACCESSOR_COMPONENT_SIZE];
     float floatMax[MAX_MODEL_ACCESSOR_COMPONENT_SIZE];
     bool normalized;
-    // #TODO: implement Sparse Accessors
+    // Only the vertex and index data of meshes is read through sparse accessors.
+    ModelSparseAccessor sparse;
 };
 
 struct ModelTexture {
@@ -398,9 +424,18 @@ class ModelNodeState {
           translation(0.0f, 0.0f, 0.0f),
           scale(1.0f, 1.0f, 1.0f),
           localTransform(OVR::Matrix4f::Identity()),
-          globalTransform(OVR::Matrix4f::Identity()) {}
+          globalTransform(OVR::Matrix4f::Identity()),
+          subtreeCullable(true),
+          boundsDirty(true),
+          subtreeBoundsDirty(true),
+          transformDirty(true),
+          globalTransformChanged(false) {
+        worldBounds.Clear();
+        subtreeBounds.Clear();
+    }
 
     void GenerateStateFromNode(const ModelNode* _node, ModelState* _modelState);
+    // Both flag the node for ModelState::UpdateTransforms.
     void CalculateLocalTransform();
     void SetLocalTransform(const OVR::Matrix4f matrix);
     OVR::Matrix4f GetLocalTransform() const {
@@ -416,6 +451,22 @@ class ModelNodeState {
 
     void AddNodesToEmitList(std::vector<ModelNodeState*>& emitList);
 
+    // Recalculates the world bounds of the nodes in this subtree whose global transform or
+    // surface bounds changed since the last update. Subtrees without changes are skipped.
+    void UpdateBounds();
+    // Must be called after the localBounds of a surface of this node's model changed.
+    void MarkSurfaceBoundsDirty() {
+        MarkBoundsDirty();
+    }
+    // World space bounds of the surfaces of this node and all of its children.
+    const OVR::Bounds3f& GetSubtreeBounds() const {
+        return subtreeBounds;
+    }
+    // False if the subtree contains a skinned node, the bounds of those are not kept up to date.
+    bool IsSubtreeCullable() const {
+        return subtreeCullable;
+    }
+
     const ModelNode* node;
     ModelState* state;
     OVR::Quatf rotation;
@@ -424,8 +475,19 @@ class ModelNodeState {
     std::vector<float> weights;
 
    private:
+    friend class ModelState;
+
+    void MarkBoundsDirty();
+
     OVR::Matrix4f localTransform;
     OVR::Matrix4f globalTransform;
+    OVR::Bounds3f worldBounds; // bounds of the surfaces of this node only
+    OVR::Bounds3f subtreeBounds;
+    bool subtreeCullable;
+    bool boundsDirty; // the global transform or the surface bounds of this node changed
+    bool subtreeBoundsDirty; // the bounds of a node in this subtree are dirty
+    bool transformDirty; // the local transform changed since the global transform was calculated
+    bool globalTransformChanged; // set during ModelState::UpdateTransforms
 };
 
 enum ModelAnimationTimeType {
@@ -440,7 +502,7 @@ class ModelAnimationTimeLineState {
 
     void CalculateFrameAndFraction(float timeInSeconds);
 
-    int frame;
+    int frame; // also the cursor the next lookup starts from
     float fraction;
     const ModelAnimationTimeLine* timeline;
 };
@@ -459,15 +521,21 @@ class ModelSubSceneState {
 
 class ModelState {
    public:
-    ModelState() : DontRenderForClientUid(0), mf(nullptr) {
+    ModelState() : DontRenderForClientUid(0), mf(nullptr), matrixDirty(true) {
         modelMatrix.Identity();
     }
 
     void GenerateStateFromModelFile(const ModelFile* _mf);
     void SetMatrix(const OVR::Matrix4f matrix);
+    // Recalculates the global transforms of the nodes whose local transform changed and of all
+    // of their descendants in a single pass over the nodes, parents before children.
+    void UpdateTransforms();
     OVR::Matrix4f GetMatrix() const {
         return modelMatrix;
     }
+    // Marks the bounds of every node that uses the model dirty, must be called after the
+    // localBounds of any of its surfaces changed.
+    void MarkModelBoundsDirty(const Model* model);
 
     void CalculateAnimationFrameAndFraction(const ModelAnimationTimeType type, float timeInSeconds);
 
@@ -481,6 +549,8 @@ class ModelState {
 
    private:
     OVR::Matrix4f modelMatrix;
+    bool matrixDirty;
+    std::vector<int> nodeOrder; // node indices sorted so parents come before their children
 };
 
 struct ModelGlPrograms {
@@ -548,7 +618,7 @@ struct ModelGlPrograms {
 
 struct ModelGeo {
     std::vector<OVR::Vector3f> positions;
-    std::vector<TriangleIndex> indices;
+    std::vector<uint32_t> indices;
 };
 
 } // namespace OVRFW
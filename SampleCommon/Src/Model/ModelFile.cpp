@@ -158,6 +158,38 @@ void LoadModelFileTexture(
     model.Textures.push_back(tex);
 }
 
+void LoadModelFileTextureRGBA(
+    ModelFile& model,
+    const char* textureName,
+    uint8_t* rgba,
+    const int width,
+    const int height,
+    const MaterialParms& materialParms) {
+    const TextureFlags_t flags = materialParms.UseSrgbTextureFormats
+        ? TextureFlags_t(TEXTUREFLAG_USE_SRGB)
+        : TextureFlags_t();
+    ModelTexture tex;
+    tex.name = textureName;
+    tex.name = tex.name.substr(0, tex.name.rfind("."));
+    tex.texid = LoadTextureFromRGBABuffer(textureName, rgba, width, height, flags);
+
+    if (!tex.texid.IsValid()) {
+        // let LoadTextureFromBuffer create the default texture
+        ALOGW("Failed to upload %s", textureName);
+        int defaultWidth;
+        int defaultHeight;
+        tex.texid =
+            LoadTextureFromBuffer(textureName, nullptr, 0, flags, defaultWidth, defaultHeight);
+    }
+
+    // file name metadata for enabling clamp mode
+    if (strstr(textureName, "_c.")) {
+        MakeTextureClamped(tex.texid);
+    }
+
+    model.Textures.push_back(tex);
+}
+
 static ModelFile* LoadZippedModelFile(
     unzFile zfp,
     const char* fileName,
@@ -453,20 +485,15 @@ ModelFile* LoadModelFileFromOtherApplicationPackage(
     const char* nameInZip,
     const ModelGlPrograms& programs,
     const MaterialParms& materialParms) {
-    void* buffer;
-    int bufferLength;
-
-    ovr_ReadFileFromOtherApplicationPackage(zipFile, nameInZip, bufferLength, buffer);
-    if (buffer == nullptr) {
+    // stored models are read straight from the mapped package
+    ovrPackageFileView view;
+    if (!ovr_MapFileFromOtherApplicationPackage(zipFile, nameInZip, view)) {
         ALOGW("Failed to load model file '%s' from apk", nameInZip);
         return nullptr;
     }
 
-    ModelFile* scene =
-        LoadModelFileFromMemory(nameInZip, buffer, bufferLength, programs, materialParms);
-
-    free(buffer);
-    return scene;
+    return LoadModelFileFromMemory(
+        nameInZip, view.GetData(), static_cast<int>(view.GetSize()), programs, materialParms);
 }
 
 ModelFile* LoadModelFileFromApplicationPackage(
@@ -522,8 +549,11 @@ void ModelAnimationTimeLine::Initialize(const ModelAccessor* _accessor) {
     sampleTimes = (float*)(accessor->BufferData());
     startTime = sampleTimes[0];
     endTime = sampleTimes[sampleCount - 1];
-    float duration = endTime - startTime;
-    const float step = duration / sampleCount;
+    rcpStep = 0.0f;
+    if (sampleCount < 2 || endTime <= startTime) {
+        return;
+    }
+    const float step = (endTime - startTime) / (sampleCount - 1);
     rcpStep = 1.0f / step;
     for (int keyFrameIndex = 0; keyFrameIndex < sampleCount; keyFrameIndex++) {
         const float delta =
@@ -537,32 +567,63 @@ void ModelAnimationTimeLine::Initialize(const ModelAccessor* _accessor) {
 }
 
 void ModelAnimationTimeLineState::CalculateFrameAndFraction(float timeInSeconds) {
+    const float* sampleTimes = timeline->sampleTimes;
+    const int lastFrame = timeline->sampleCount - 2;
+    if (lastFrame < 0) {
+        frame = 0;
+        fraction = 0.0f;
+        return;
+    }
     if (timeInSeconds <= timeline->startTime) {
         frame = 0;
         fraction = 0.0f;
-    } else if (timeInSeconds >= timeline->endTime) {
-        frame = timeline->sampleCount - 2;
+        return;
+    }
+    if (timeInSeconds >= timeline->endTime) {
+        frame = lastFrame;
         fraction = 1.0f;
+        return;
+    }
+
+    // The previous frame is the cursor. Playback usually stays in the same interval or moves to
+    // the next one, so try those before falling back to a search.
+    if (frame < 0 || frame > lastFrame) {
+        frame = 0;
+    }
+    if (timeInSeconds >= sampleTimes[frame] && timeInSeconds < sampleTimes[frame + 1]) {
+        // still in the same interval
+    } else if (
+        frame < lastFrame && timeInSeconds >= sampleTimes[frame + 1] &&
+        timeInSeconds < sampleTimes[frame + 2]) {
+        frame++;
+    } else if (timeline->rcpStep != 0.0f) {
+        // Use direct lookup if this is a fixed rate animation.
+        frame = (int)((timeInSeconds - timeline->startTime) * timeline->rcpStep);
+        frame = std::max(0, std::min(frame, lastFrame));
+        // the key times are only within a tolerance of the fixed rate
+        if (frame > 0 && timeInSeconds < sampleTimes[frame]) {
+            frame--;
+        } else if (frame < lastFrame && timeInSeconds >= sampleTimes[frame + 1]) {
+            frame++;
+        }
     } else {
-        if (timeline->rcpStep != 0.0f) {
-            // Use direct lookup if this is a fixed rate animation.
-            frame = (int)((timeInSeconds - timeline->startTime) * timeline->rcpStep);
-        } else {
-            // Use a binary search to find the key frame.
-            frame = 0;
-            // Use a binary search to find the key frame.
-            for (int sampleCount = timeline->sampleCount; sampleCount > 1; sampleCount >>= 1) {
-                const int mid = sampleCount >> 1;
-                if (timeInSeconds >= timeline->sampleTimes[frame + mid]) {
-                    frame += mid;
-                    sampleCount = (sampleCount - mid) * 2;
-                }
+        // Use a binary search for the last key frame at or before the time.
+        int low = 0;
+        int high = lastFrame;
+        while (low < high) {
+            const int mid = (low + high + 1) >> 1;
+            if (timeInSeconds >= sampleTimes[mid]) {
+                low = mid;
+            } else {
+                high = mid - 1;
             }
         }
-
-        fraction = (timeInSeconds - timeline->sampleTimes[frame]) /
-            (timeline->sampleTimes[frame + 1] - timeline->sampleTimes[frame]);
+        frame = low;
     }
+
+    const float frameDuration = sampleTimes[frame + 1] - sampleTimes[frame];
+    fraction = (frameDuration > 0.0f) ? (timeInSeconds - sampleTimes[frame]) / frameDuration : 0.0f;
+    fraction = std::max(0.0f, std::min(fraction, 1.0f));
 }
 
 void ModelState::CalculateAnimationFrameAndFraction(
@@ -605,14 +666,19 @@ void ModelNodeState::GenerateStateFromNode(const ModelNode* _node, ModelState* _
     // These values should be calculated already.
     localTransform = node->GetLocalTransform();
     globalTransform = node->GetGlobalTransform();
+
+    boundsDirty = true;
+    subtreeBoundsDirty = true;
 }
 
 void ModelNodeState::CalculateLocalTransform() {
     CalculateTransformFromRTS(&localTransform, rotation, translation, scale);
+    transformDirty = true;
 }
 
 void ModelNodeState::SetLocalTransform(const Matrix4f matrix) {
     localTransform = matrix;
+    transformDirty = true;
 }
 
 void ModelNodeState::RecalculateMatrix() {
@@ -621,6 +687,8 @@ void ModelNodeState::RecalculateMatrix() {
     } else {
         globalTransform = state->nodeStates[node->parentIndex].globalTransform * localTransform;
     }
+    transformDirty = false;
+    MarkBoundsDirty();
 
     for (int i = 0; i < static_cast<int>(node->children.size()); i++) {
         state->nodeStates[node->children[i]].RecalculateMatrix();
@@ -634,6 +702,50 @@ void ModelNodeState::AddNodesToEmitList(std::vector<ModelNodeState*>& emitList)
     }
 }
 
+void ModelNodeState::MarkBoundsDirty() {
+    boundsDirty = true;
+    // flag the path up to the root so UpdateBounds can skip the subtrees that did not change
+    for (ModelNodeState* nodeState = this; nodeState != nullptr && !nodeState->subtreeBoundsDirty;
+         nodeState = nodeState->node->parentIndex >= 0
+             ? &state->nodeStates[nodeState->node->parentIndex]
+             : nullptr) {
+        nodeState->subtreeBoundsDirty = true;
+    }
+}
+
+void ModelNodeState::UpdateBounds() {
+    if (!subtreeBoundsDirty) {
+        return;
+    }
+    subtreeBoundsDirty = false;
+
+    if (boundsDirty) {
+        boundsDirty = false;
+        worldBounds.Clear();
+        if (node->model != nullptr) {
+            for (int i = 0; i < static_cast<int>(node->model->surfaces.size()); i++) {
+                const Bounds3f& localBounds = node->model->surfaces[i].surfaceDef.geo.localBounds;
+                // empty bounds are always culled, see BuildModelSurfaceList
+                if (localBounds.b[1].x == localBounds.b[0].x &&
+                    localBounds.b[1].y == localBounds.b[0].y) {
+                    continue;
+                }
+                worldBounds =
+                    Bounds3f::Union(worldBounds, Bounds3f::Transform(globalTransform, localBounds));
+            }
+        }
+    }
+
+    subtreeBounds = worldBounds;
+    subtreeCullable = node->skinIndex < 0;
+    for (int i = 0; i < static_cast<int>(node->children.size()); i++) {
+        ModelNodeState& child = state->nodeStates[node->children[i]];
+        child.UpdateBounds();
+        subtreeBounds = Bounds3f::Union(subtreeBounds, child.subtreeBounds);
+        subtreeCullable = subtreeCullable && child.subtreeCullable;
+    }
+}
+
 void ModelSubSceneState::GenerateStateFromSubScene(const ModelSubScene* _subScene) {
     subScene = _subScene;
     visible = subScene->visible;
@@ -665,15 +777,64 @@ void ModelState::GenerateStateFromModelFile(const ModelFile* _mf) {
     for (int i = 0; i < static_cast<int>(mf->SubScenes.size()); i++) {
         subSceneStates[i].GenerateStateFromSubScene(&mf->SubScenes[i]);
     }
+
+    // breadth first from the root nodes, so every parent is placed before its children
+    nodeOrder.clear();
+    nodeOrder.reserve(mf->Nodes.size());
+    for (int i = 0; i < static_cast<int>(mf->Nodes.size()); i++) {
+        if (mf->Nodes[i].parentIndex < 0) {
+            nodeOrder.push_back(i);
+        }
+    }
+    for (int i = 0; i < static_cast<int>(nodeOrder.size()); i++) {
+        const ModelNode& node = mf->Nodes[nodeOrder[i]];
+        nodeOrder.insert(nodeOrder.end(), node.children.begin(), node.children.end());
+    }
+    if (nodeOrder.size() != mf->Nodes.size()) {
+        ALOGW(
+            "ModelState: %d of %d nodes are not reachable from a root node in %s",
+            static_cast<int>(mf->Nodes.size() - nodeOrder.size()),
+            static_cast<int>(mf->Nodes.size()),
+            mf->FileName.c_str());
+    }
+    // the node states start out with the global transforms calculated by the loader
+    matrixDirty = false;
 }
 
 void ModelState::SetMatrix(const Matrix4f matrix) {
     modelMatrix = matrix;
-    for (int i = 0; i < static_cast<int>(subSceneStates.size()); i++) {
-        for (int j = 0; j < static_cast<int>(subSceneStates[i].nodeStates.size()); j++) {
-            nodeStates[subSceneStates[i].nodeStates[j]].RecalculateMatrix();
+    matrixDirty = true;
+    UpdateTransforms();
+}
+
+void ModelState::MarkModelBoundsDirty(const Model* model) {
+    for (int i = 0; i < static_cast<int>(nodeStates.size()); i++) {
+        if (nodeStates[i].node != nullptr && nodeStates[i].node->model == model) {
+            nodeStates[i].MarkBoundsDirty();
+        }
+    }
+}
+
+void ModelState::UpdateTransforms() {
+    for (int i = 0; i < static_cast<int>(nodeOrder.size()); i++) {
+        ModelNodeState& nodeState = nodeStates[nodeOrder[i]];
+        const int parentIndex = nodeState.node->parentIndex;
+        const bool parentChanged = (parentIndex < 0)
+            ? matrixDirty
+            : nodeStates[parentIndex].globalTransformChanged;
+        nodeState.globalTransformChanged = parentChanged || nodeState.transformDirty;
+        if (nodeState.globalTransformChanged) {
+            if (parentIndex < 0) {
+                nodeState.globalTransform = modelMatrix * nodeState.localTransform;
+            } else {
+                nodeState.globalTransform =
+                    nodeStates[parentIndex].globalTransform * nodeState.localTransform;
+            }
+            nodeState.transformDirty = false;
+            nodeState.MarkBoundsDirty();
         }
     }
+    matrixDirty = false;
 }
 
 } // namespace OVRFW
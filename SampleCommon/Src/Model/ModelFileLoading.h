@@ -38,6 +38,15 @@ void LoadModelFileTexture(
     const int size,
     const MaterialParms& materialParms);
 
+// Same as LoadModelFileTexture for an image already decoded with LoadImageToRGBABuffer.
+void LoadModelFileTextureRGBA(
+    ModelFile& model,
+    const char* textureName,
+    uint8_t* rgba,
+    const int width,
+    const int height,
+    const MaterialParms& materialParms);
+
 bool LoadModelFile_OvrScene(
     ModelFile* modelPtr,
     unzFile zfp,
@@ -315,10 +315,10 @@ bool LoadModelFile_OvrScene_Json(
                             modelSurface.surfaceDef.geo.localBounds,
                             surface.GetChildStringByName("bounds").c_str());
 
-                        TriangleIndex indexOffset = 0;
+                        uint32_t indexOffset = 0;
                         if (outModelGeo != nullptr) {
                             indexOffset =
-                                static_cast<TriangleIndex>((*outModelGeo).positions.size());
+                                static_cast<uint32_t>((*outModelGeo).positions.size());
                         }
                         //
                         // Vertices
@@ -610,6 +610,8 @@ bool LoadModelFile_OvrScene_Json(
                         polytope.GetChildStringByName("planes").c_str());
                 }
             }
+
+            modelFile.Collisions.BuildBvh();
         }
 
         //
@@ -635,6 +637,8 @@ bool LoadModelFile_OvrScene_Json(
                         polytope.GetChildStringByName("planes").c_str());
                 }
             }
+
+            modelFile.GroundCollisions.BuildBvh();
         }
 
         //
@@ -653,11 +657,6 @@ bool LoadModelFile_OvrScene_Json(
             traceModel.header.numNodes = raytrace_model.GetChildInt32ByName("numNodes");
             traceModel.header.numLeafs = raytrace_model.GetChildInt32ByName("numLeafs");
             traceModel.header.numOverflow = raytrace_model.GetChildInt32ByName("numOverflow");
-            if (!traceModel.Validate(true)) {
-                // this is a fatal error so that a model file from an untrusted source is never able
-                // to cause out-of-bounds reads.
-                ALOGE_FAIL("Invalid model data");
-            }
 
             OVR::StringUtils::StringTo(
                 traceModel.header.bounds, raytrace_model.GetChildStringByName("bounds").c_str());
@@ -725,6 +724,12 @@ bool LoadModelFile_OvrScene_Json(
                 raytrace_model.GetChildStringByName("overflow").c_str(),
                 bin,
                 traceModel.header.numOverflow);
+
+            if (!traceModel.Validate(true)) {
+                // this is a fatal error so that a model file from an untrusted source is never able
+                // to cause out-of-bounds reads.
+                ALOGE_FAIL("Invalid model data");
+            }
         }
     }
 
@@ -18,7 +18,13 @@ Authors     :   John Carmack, J.M.P. van Waveren
 
 #include "Misc/Log.h"
 #include "OVR_BinaryFile2.h"
+#include "PackageFiles.h"
+#include "Render/MeshOptimizer.h"
 
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <type_traits>
 #include <unordered_map>
 
 using OVR::Bounds3f;
@@ -138,6 +144,11 @@ static size_t getComponentCount(ModelAccessorType type) {
     }
 }
 
+static bool IsIndexComponentType(const int componentType) {
+    return componentType == GL_UNSIGNED_BYTE || componentType == GL_UNSIGNED_SHORT ||
+        componentType == GL_UNSIGNED_INT;
+}
+
 static size_t getComponentSize(int componentType) {
     switch (componentType) {
         case MODEL_COMPONENT_TYPE_UNSIGNED_BYTE:
@@ -154,260 +165,409 @@ static size_t getComponentSize(int componentType) {
     }
 }
 
+// Runs job( 0 ) .. job( count - 1 ) on a pool of worker threads. The calling thread takes jobs
+// as well, so the jobs must not touch GL.
+static void ParallelForJobs(const int count, const std::function<void(int)>& job) {
+    const int numThreads =
+        std::max(1, std::min(static_cast<int>(std::thread::hardware_concurrency()), count));
+    std::atomic<int> nextJob(0);
+    auto worker = [&]() {
+        for (int i = nextJob++; i < count; i = nextJob++) {
+            job(i);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 1; i < numThreads; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+// An image referenced by the glTF file. All images are gathered first, the stb_image formats are
+// decoded on worker threads, and the textures are then created in order on the context thread.
+struct ModelImageLoad {
+    std::string name;
+    std::string uri;
+    const uint8_t* buffer = nullptr;
+    int bufferLength = 0;
+    bool ownsBuffer = false; // buffer was allocated with new[] by the zip reader
+    bool useUriHandler = false;
+    uint8_t* rgba = nullptr;
+    int width = 0;
+    int height = 0;
+};
+
+static void DecodeModelImages(std::vector<ModelImageLoad>& images) {
+    ParallelForJobs(static_cast<int>(images.size()), [&images](const int index) {
+        ModelImageLoad& image = images[index];
+        if (image.buffer != nullptr && image.bufferLength > 0) {
+            // returns nullptr for compressed container formats, those are loaded directly
+            image.rgba = LoadImageToRGBABuffer(
+                image.name.c_str(), image.buffer, image.bufferLength, image.width, image.height);
+        }
+    });
+}
+
+static void CreateModelImageTextures(
+    ModelFile& modelFile,
+    std::vector<ModelImageLoad>& images,
+    const MaterialParms& materialParms) {
+    for (ModelImageLoad& image : images) {
+        if (image.rgba != nullptr) {
+            LoadModelFileTextureRGBA(
+                modelFile,
+                image.name.c_str(),
+                image.rgba,
+                image.width,
+                image.height,
+                materialParms);
+            FreeRGBABuffer(image.rgba);
+            image.rgba = nullptr;
+        } else if (image.useUriHandler) {
+            if (materialParms.ImageUriHandler(modelFile, image.uri)) {
+                LOGV("LoadModelFile_glB: uri processed by custom handler");
+            } else {
+                ALOGW(
+                    "Loading images from othen then bufferView currently unsupported in glBfd, defaulting image");
+                LoadModelFileTexture(modelFile, "DefaultImage", nullptr, 0, materialParms);
+            }
+        } else {
+            LoadModelFileTexture(
+                modelFile,
+                image.name.c_str(),
+                (const char*)image.buffer,
+                image.bufferLength,
+                materialParms);
+        }
+        if (image.ownsBuffer) {
+            delete[] image.buffer;
+        }
+        image.buffer = nullptr;
+    }
+}
+
+// CPU copy of the triangles of a mesh, kept until the node transforms are known so the
+// ray-trace model can be built.
+struct TraceMeshGeo {
+    std::vector<Vector3f> positions;
+    std::vector<Vector2f> uvs;
+    std::vector<int> indices;
+};
+
+static void BuildTraceModel(ModelFile& modelFile, const std::vector<TraceMeshGeo>& traceMeshGeos) {
+    std::vector<Vector3f> vertices;
+    std::vector<Vector2f> uvs;
+    std::vector<int> indices;
+    for (const ModelNode& node : modelFile.Nodes) {
+        if (node.model == nullptr) {
+            continue;
+        }
+        const int meshIndex = static_cast<int>(node.model - modelFile.Models.data());
+        if (meshIndex < 0 || meshIndex >= static_cast<int>(traceMeshGeos.size())) {
+            continue;
+        }
+        const TraceMeshGeo& geo = traceMeshGeos[meshIndex];
+        const Matrix4f transform = node.GetGlobalTransform();
+        const int firstVertex = static_cast<int>(vertices.size());
+        for (const Vector3f& position : geo.positions) {
+            vertices.push_back(transform.Transform(position));
+        }
+        uvs.insert(uvs.end(), geo.uvs.begin(), geo.uvs.end());
+        for (const int index : geo.indices) {
+            indices.push_back(index + firstVertex);
+        }
+    }
+
+    if (indices.empty()) {
+        return;
+    }
+    if (!modelFile.TraceModel.Build(vertices, uvs, indices)) {
+        ALOGW("Could not build ray-trace model for '%s'", modelFile.FileName.c_str());
+        modelFile.TraceModel = ModelTrace();
+    }
+}
+
+// Integer components are normalized when they are read as floats. Signed integers map to the whole
+// [-1.0f, 1.0f] range while keeping 0 exactly at 0.0f, so for bytes -128 and -127 both map to
+// -1.0f and 127 maps to 1.0f. Floats read as integers are not scaled.
+static inline void ConvertAccessorComponent(float& dst, const int8_t src) {
+    dst = std::max(static_cast<float>(src) / 127.0f, -1.0f);
+}
+static inline void ConvertAccessorComponent(float& dst, const uint8_t src) {
+    dst = static_cast<float>(src) / 255.0f;
+}
+static inline void ConvertAccessorComponent(float& dst, const int16_t src) {
+    dst = std::max(static_cast<float>(src) / 32767.0f, -1.0f);
+}
+static inline void ConvertAccessorComponent(float& dst, const uint16_t src) {
+    dst = static_cast<float>(src) / 65535.0f;
+}
+static inline void ConvertAccessorComponent(float& dst, const uint32_t src) {
+    dst = static_cast<float>(static_cast<double>(src) / 4294967295.0);
+}
+static inline void ConvertAccessorComponent(float& dst, const float src) {
+    dst = src;
+}
+template <typename _dst_, typename _src_>
+static inline void ConvertAccessorComponent(_dst_& dst, const _src_ src) {
+    dst = static_cast<_dst_>(src);
+}
+
+// Copies 'count' elements from a strided source to consecutive destination elements, or to the
+// destination elements given by 'dstIndices' for the values of a sparse accessor.
+template <typename _dst_, typename _src_, int _components_>
+static void CopyAccessorElements(
+    _dst_* dst,
+    const uint8_t* src,
+    const size_t srcStride,
+    const int count,
+    const uint32_t* dstIndices) {
+    if (count <= 0) {
+        return;
+    }
+    if (dstIndices == nullptr && srcStride == sizeof(_src_) * _components_ &&
+        std::is_same<_dst_, _src_>::value) {
+        memcpy(dst, src, count * srcStride);
+    } else if (dstIndices == nullptr) {
+        for (int i = 0; i < count; i++, src += srcStride, dst += _components_) {
+            const _src_* value = reinterpret_cast<const _src_*>(src);
+            for (int j = 0; j < _components_; j++) {
+                ConvertAccessorComponent(dst[j], value[j]);
+            }
+        }
+    } else {
+        for (int i = 0; i < count; i++, src += srcStride) {
+            const _src_* value = reinterpret_cast<const _src_*>(src);
+            _dst_* valueDst = dst + dstIndices[i] * _components_;
+            for (int j = 0; j < _components_; j++) {
+                ConvertAccessorComponent(valueDst[j], value[j]);
+            }
+        }
+    }
+}
+
+template <typename _dst_, int _components_>
+static void CopyAccessorElements(
+    _dst_* dst,
+    const uint8_t* src,
+    const int srcComponentType,
+    const size_t srcStride,
+    const int count,
+    const uint32_t* dstIndices) {
+    switch (srcComponentType) {
+        case MODEL_COMPONENT_TYPE_BYTE:
+            CopyAccessorElements<_dst_, int8_t, _components_>(
+                dst, src, srcStride, count, dstIndices);
+            break;
+        case MODEL_COMPONENT_TYPE_UNSIGNED_BYTE:
+            CopyAccessorElements<_dst_, uint8_t, _components_>(
+                dst, src, srcStride, count, dstIndices);
+            break;
+        case MODEL_COMPONENT_TYPE_SHORT:
+            CopyAccessorElements<_dst_, int16_t, _components_>(
+                dst, src, srcStride, count, dstIndices);
+            break;
+        case MODEL_COMPONENT_TYPE_UNSIGNED_SHORT:
+            CopyAccessorElements<_dst_, uint16_t, _components_>(
+                dst, src, srcStride, count, dstIndices);
+            break;
+        case MODEL_COMPONENT_TYPE_UNSIGNED_INT:
+            CopyAccessorElements<_dst_, uint32_t, _components_>(
+                dst, src, srcStride, count, dstIndices);
+            break;
+        case MODEL_COMPONENT_TYPE_FLOAT:
+            CopyAccessorElements<_dst_, float, _components_>(
+                dst, src, srcStride, count, dstIndices);
+            break;
+    }
+}
+
+// The component count is a template parameter so the inner loops are fully unrolled.
+template <typename _dst_>
+static void CopyAccessorElements(
+    _dst_* dst,
+    const uint8_t* src,
+    const ModelAccessorType type,
+    const int srcComponentType,
+    const size_t srcStride,
+    const int count,
+    const uint32_t* dstIndices) {
+    switch (getComponentCount(type)) {
+        case 1:
+            CopyAccessorElements<_dst_, 1>(
+                dst, src, srcComponentType, srcStride, count, dstIndices);
+            break;
+        case 2:
+            CopyAccessorElements<_dst_, 2>(
+                dst, src, srcComponentType, srcStride, count, dstIndices);
+            break;
+        case 3:
+            CopyAccessorElements<_dst_, 3>(
+                dst, src, srcComponentType, srcStride, count, dstIndices);
+            break;
+        case 4:
+            CopyAccessorElements<_dst_, 4>(
+                dst, src, srcComponentType, srcStride, count, dstIndices);
+            break;
+        case 9:
+            CopyAccessorElements<_dst_, 9>(
+                dst, src, srcComponentType, srcStride, count, dstIndices);
+            break;
+        case 16:
+            CopyAccessorElements<_dst_, 16>(
+                dst, src, srcComponentType, srcStride, count, dstIndices);
+            break;
+    }
+}
+
+// Component type of the vectors the accessors are read into.
+template <typename _type_>
+struct AccessorComponent {
+    typedef float Type;
+};
+template <>
+struct AccessorComponent<uint32_t> {
+    typedef uint32_t Type;
+};
+template <>
+struct AccessorComponent<OVR::Vector4i> {
+    typedef int Type;
+};
+
+// Returns a pointer to the elements of a buffer view if 'count' elements of 'elementSize' bytes at
+// 'byteOffset' with the given stride fit in the buffer.
+static const uint8_t* GetAccessorData(
+    const ModelBufferView* bufferView,
+    const size_t byteOffset,
+    const size_t stride,
+    const size_t elementSize,
+    const int count) {
+    if (bufferView == nullptr || bufferView->buffer == nullptr) {
+        return nullptr;
+    }
+    const size_t offset = bufferView->byteOffset + byteOffset;
+    const size_t size = (count > 0) ? (count - 1) * stride + elementSize : 0;
+    if (offset + size > bufferView->buffer->bufferData.size() ||
+        offset + size > bufferView->buffer->byteLength) {
+        return nullptr;
+    }
+    return bufferView->buffer->bufferData.data() + offset;
+}
+
+// Reads an accessor in one pass into 'out', converting the components to the component type of
+// '_type_'. Strided, normalized integer and sparse accessors are handled by the copy kernels.
 template <typename _type_>
 bool ReadSurfaceDataFromAccessor(
     std::vector<_type_>& out,
     ModelFile& modelFile,
     const int index,
     const ModelAccessorType type,
-    const int componentType,
     const int count,
     const bool append) {
-    bool loaded = true;
-    if (index >= 0) {
-        if (index >= int(modelFile.Accessors.size())) {
-            ALOGW(
-                "Error: Invalid index on gltfPrimitive accessor %d %d",
-                index,
-                static_cast<int>(modelFile.Accessors.size()));
-            loaded = false;
-        }
-
-        const ModelAccessor* accessor = &(modelFile.Accessors[index]);
-        const ModelBufferView* bufferView = accessor->bufferView;
-        const ModelBuffer* buffer = bufferView->buffer;
+    typedef typename AccessorComponent<_type_>::Type _component_;
+    static_assert(sizeof(_type_) % sizeof(_component_) == 0, "unexpected accessor element type");
 
-        if (count >= 0 && accessor->count != count) {
-            ALOGW(
-                "Error: Invalid count on gltfPrimitive accessor %d %d %d",
-                index,
-                count,
-                accessor->count);
-            loaded = false;
-        }
-        if (accessor->type != type) {
-            ALOGW(
-                "Error: Invalid type on gltfPrimitive accessor %d %d %d",
-                index,
-                type,
-                accessor->type);
-            loaded = false;
-        }
+    if (index < 0) {
+        return true;
+    }
+    if (index >= static_cast<int>(modelFile.Accessors.size())) {
+        ALOGW(
+            "Error: Invalid index on gltfPrimitive accessor %d %d",
+            index,
+            static_cast<int>(modelFile.Accessors.size()));
+        return false;
+    }
 
-        int srcComponentSize = getComponentSize(accessor->componentType);
-        int srcComponentCount = getComponentCount(accessor->type);
-        int srcValueSize = srcComponentSize * srcComponentCount;
+    const ModelAccessor& accessor = modelFile.Accessors[index];
+    if (count >= 0 && accessor.count != count) {
+        ALOGW(
+            "Error: Invalid count on gltfPrimitive accessor %d %d %d",
+            index,
+            count,
+            accessor.count);
+        return false;
+    }
+    if (accessor.type != type || getComponentCount(type) * sizeof(_component_) != sizeof(_type_)) {
+        ALOGW("Error: Invalid type on gltfPrimitive accessor %d %d %d", index, type, accessor.type);
+        return false;
+    }
+    const size_t srcValueSize = getComponentSize(accessor.componentType) * getComponentCount(type);
+    if (srcValueSize == 0 || accessor.count < 0) {
+        ALOGW(
+            "Error: Invalid componentType on gltfPrimitive accessor %d %d",
+            index,
+            accessor.componentType);
+        return false;
+    }
 
-        int readStride = srcValueSize;
-        if (bufferView->byteStride > 0) {
-            readStride = bufferView->byteStride;
+    const uint8_t* src = nullptr;
+    size_t readStride = srcValueSize;
+    if (accessor.bufferView != nullptr) {
+        if (accessor.bufferView->byteStride > 0) {
+            readStride = accessor.bufferView->byteStride;
         }
+        src = GetAccessorData(
+            accessor.bufferView, accessor.byteOffset, readStride, srcValueSize, accessor.count);
+        if (src == nullptr || readStride < srcValueSize) {
+            ALOGW("Error: accessor requesting too much data in gltfPrimitive %d", index);
+            return false;
+        }
+    }
 
-        size_t dstComponentSize = getComponentSize(componentType);
-        size_t dstComponentCount = getComponentCount(type);
-        size_t dstValueSize = dstComponentSize * dstComponentCount;
-
-        const size_t offset = accessor->byteOffset + bufferView->byteOffset;
-
-        const size_t srcRequiredSize = accessor->count * readStride;
+    const size_t startIndex = append ? out.size() : 0;
+    out.resize(startIndex + accessor.count);
+    _component_* dst = reinterpret_cast<_component_*>(out.data() + startIndex);
+    if (src != nullptr) {
+        CopyAccessorElements(
+            dst, src, type, accessor.componentType, readStride, accessor.count, nullptr);
+    } else if (accessor.count > 0) {
+        // an accessor without a buffer view starts out as zeros
+        memset(dst, 0, accessor.count * sizeof(_type_));
+    }
 
-        if ((offset + srcRequiredSize) > buffer->byteLength) {
-            ALOGW(
-                "Error: accessor requesting too much data in gltfPrimitive %d %d %d",
-                index,
-                (int)accessor->bufferView->byteLength,
-                (int)(offset + srcRequiredSize));
-            loaded = false;
+    const ModelSparseAccessor& sparse = accessor.sparse;
+    if (sparse.count > 0) {
+        const size_t indexSize = getComponentSize(sparse.indicesComponentType);
+        const uint8_t* sparseIndices = GetAccessorData(
+            sparse.indicesBufferView, sparse.indicesByteOffset, indexSize, indexSize, sparse.count);
+        const uint8_t* sparseValues = GetAccessorData(
+            sparse.valuesBufferView,
+            sparse.valuesByteOffset,
+            srcValueSize,
+            srcValueSize,
+            sparse.count);
+        if (sparseIndices == nullptr || sparseValues == nullptr || sparse.count > accessor.count) {
+            ALOGW("Error: Invalid sparse data on gltfPrimitive accessor %d", index);
+            return false;
         }
-
-        if (loaded) {
-            const size_t startIndex = append ? out.size() : 0;
-            out.resize(startIndex + accessor->count);
-            int valueCount = (int)(accessor->count);
-            const char* src = (char*)buffer->bufferData.data() + offset;
-            if (accessor->componentType != componentType) {
-                if (componentType == MODEL_COMPONENT_TYPE_FLOAT) {
-                    float* dst = (float*)&out[0];
-                    // for normalized signed integers, we need them to map to whole [-1.0f, 1.0f]
-                    // while having the 0 exactly at 0.0f for byte:
-                    //-128 -> - 1.0f
-                    // 0 ->  0.0f
-                    // 127 ->  1.0f
-                    // to achieve that we do std::max((float)value / MaxValue, -1.0f);
-                    switch (accessor->componentType) {
-                        case MODEL_COMPONENT_TYPE_BYTE:
-                            for (int i = 0; i < valueCount; i++) {
-                                const int8_t* valueSrc = (int8_t*)(src + i * readStride);
-                                float* valueDst = (float*)(dst + i * srcComponentCount);
-                                for (int j = 0; j < srcComponentCount; j++) {
-                                    valueDst[j] = std::max(((float)valueSrc[j]) / 127.0f, -1.0f);
-                                }
-                            }
-                            break;
-                        case MODEL_COMPONENT_TYPE_UNSIGNED_BYTE:
-                        default:
-                            for (int i = 0; i < valueCount; i++) {
-                                const uint8_t* valueSrc = (uint8_t*)(src + i * readStride);
-                                float* valueDst = (float*)(dst + i * srcComponentCount);
-                                for (int j = 0; j < srcComponentCount; j++) {
-                                    valueDst[j] = ((float)valueSrc[j]) / 255.0f;
-                                }
-                            }
-                            break;
-                        case MODEL_COMPONENT_TYPE_SHORT:
-                            for (int i = 0; i < valueCount; i++) {
-                                const int16_t* valueSrc = (int16_t*)(src + i * readStride);
-                                float* valueDst = (float*)(dst + i * srcComponentCount);
-                                for (int j = 0; j < srcComponentCount; j++) {
-                                    valueDst[j] = std::max(((float)valueSrc[j]) / 32767.0f, -1.0f);
-                                }
-                            }
-                            break;
-                        case MODEL_COMPONENT_TYPE_UNSIGNED_SHORT:
-                            for (int i = 0; i < valueCount; i++) {
-                                const uint16_t* valueSrc = (uint16_t*)(src + i * readStride);
-                                float* valueDst = (float*)(dst + i * srcComponentCount);
-                                for (int j = 0; j < srcComponentCount; j++) {
-                                    valueDst[j] = ((float)valueSrc[j]) / 65535.0f;
-                                }
-                            }
-                            break;
-                        case MODEL_COMPONENT_TYPE_UNSIGNED_INT:
-                            for (int i = 0; i < valueCount; i++) {
-                                const uint32_t* valueSrc = (uint32_t*)(src + i * readStride);
-                                float* valueDst = (float*)(dst + i * srcComponentCount);
-                                for (int j = 0; j < srcComponentCount; j++) {
-                                    valueDst[j] = (float)(((double)valueSrc[j]) / 4294967295.0);
-                                }
-                            }
-                            break;
-                    }
-                } else {
-                    // slow path for rare cases
-                    if (accessor->componentType == MODEL_COMPONENT_TYPE_FLOAT ||
-                        componentType == MODEL_COMPONENT_TYPE_FLOAT) {
-                        char* dst = (char*)&out[0];
-                        for (int i = 0; i < valueCount; i++) {
-                            for (int j = 0; j < srcComponentCount; j++) {
-                                float value;
-                                const char* valueSrc = src + i * readStride + j * srcComponentSize;
-                                switch (accessor->componentType) {
-                                    case MODEL_COMPONENT_TYPE_BYTE:
-                                        value =
-                                            std::max(((float)(*(int8_t*)valueSrc)) / 127.0f, -1.0f);
-                                        break;
-                                    case MODEL_COMPONENT_TYPE_UNSIGNED_BYTE:
-                                    default:
-                                        value = ((float)(*(uint8_t*)valueSrc)) / 255.0f;
-                                        break;
-                                    case MODEL_COMPONENT_TYPE_SHORT:
-                                        value = std::max(
-                                            ((float)(*(int16_t*)valueSrc)) / 32767.0f, -1.0f);
-                                        break;
-                                    case MODEL_COMPONENT_TYPE_UNSIGNED_SHORT:
-                                        value = ((float)(*(uint16_t*)valueSrc)) / 65535.0f;
-                                        break;
-                                    case MODEL_COMPONENT_TYPE_UNSIGNED_INT:
-                                        value =
-                                            (float)(((double)(*(uint32_t*)valueSrc)) / 4294967295.0);
-                                        break;
-                                    case MODEL_COMPONENT_TYPE_FLOAT:
-                                        value = (*(float*)valueSrc);
-                                        break;
-                                }
-                                char* valueDst = dst + i * dstValueSize + j * dstComponentSize;
-                                switch (componentType) {
-                                    case MODEL_COMPONENT_TYPE_BYTE:
-                                        // -1.0f -> -128, 1.0f -> +127, 0.0f -> 0
-                                        *(int8_t*)valueDst = (int8_t)(value * 128.0f);
-                                        break;
-                                    case MODEL_COMPONENT_TYPE_UNSIGNED_BYTE:
-                                    default:
-                                        *(uint8_t*)valueDst = (uint8_t)(value * 255.0f);
-                                        break;
-                                        // SPECIAL CASES, we don't know if the float is normalized
-                                        // or not normalized we assume that the float was not a
-                                        // normalized value when someone asks for an uint16 or
-                                        // uint32
-                                    case MODEL_COMPONENT_TYPE_SHORT:
-                                        *(int16_t*)valueDst = (int16_t)(value);
-                                        break;
-                                    case MODEL_COMPONENT_TYPE_UNSIGNED_SHORT:
-                                        *(uint16_t*)valueDst = (uint16_t)(value);
-                                        break;
-                                    case MODEL_COMPONENT_TYPE_UNSIGNED_INT:
-                                        *(uint32_t*)valueDst = (uint32_t)(value);
-                                        break;
-                                    case MODEL_COMPONENT_TYPE_FLOAT:
-                                        *(float*)valueDst = value;
-                                        break;
-                                }
-                            }
-                        }
-                    } else {
-                        // integer to integer, no "proportional" conversion, just change of storage
-                        char* dst = (char*)&out[0];
-                        for (int i = 0; i < valueCount; i++) {
-                            for (int j = 0; j < srcComponentCount; j++) {
-                                int64_t value;
-                                const char* valueSrc = src + i * readStride + j * srcComponentSize;
-                                switch (accessor->componentType) {
-                                    case MODEL_COMPONENT_TYPE_BYTE:
-                                        value = (int64_t)(*(int8_t*)valueSrc);
-                                        break;
-                                    case MODEL_COMPONENT_TYPE_UNSIGNED_BYTE:
-                                    default:
-                                        value = (int64_t)(*(uint8_t*)valueSrc);
-                                        break;
-                                    case MODEL_COMPONENT_TYPE_SHORT:
-                                        value = (int64_t)(*(int16_t*)valueSrc);
-                                        break;
-                                    case MODEL_COMPONENT_TYPE_UNSIGNED_SHORT:
-                                        value = (int64_t)(*(uint16_t*)valueSrc);
-                                        break;
-                                    case MODEL_COMPONENT_TYPE_UNSIGNED_INT:
-                                        value = (int64_t)(*(uint32_t*)valueSrc);
-                                        break;
-                                }
-                                char* valueDst = dst + i * dstValueSize + j * dstComponentSize;
-                                switch (componentType) {
-                                    case MODEL_COMPONENT_TYPE_BYTE:
-                                        *(int8_t*)valueDst = (int8_t)value;
-                                        break;
-                                    case MODEL_COMPONENT_TYPE_UNSIGNED_BYTE:
-                                    default:
-                                        *(uint8_t*)valueDst = (uint8_t)value;
-                                        break;
-                                    case MODEL_COMPONENT_TYPE_SHORT:
-                                        *(int16_t*)valueDst = (int16_t)value;
-                                        break;
-                                    case MODEL_COMPONENT_TYPE_UNSIGNED_SHORT:
-                                        *(uint8_t*)valueDst = (uint16_t)value;
-                                        break;
-                                    case MODEL_COMPONENT_TYPE_UNSIGNED_INT:
-                                        *(uint32_t*)valueDst = (uint32_t)value;
-                                        break;
-                                }
-                            }
-                        }
-                    }
-                }
-            } else {
-                if (readStride == srcValueSize) {
-                    memcpy(&out[startIndex], buffer->bufferData.data() + offset, srcRequiredSize);
-                } else {
-                    char* dst = (char*)&out[0];
-                    for (int i = 0; i < valueCount; i++) {
-                        const char* valueSrc = src + i * readStride;
-                        char* valueDst = dst + i * srcValueSize;
-                        memcpy(valueDst, valueSrc, srcValueSize);
-                    }
-                }
+        std::vector<uint32_t> dstIndices(sparse.count);
+        CopyAccessorElements<uint32_t>(
+            dstIndices.data(),
+            sparseIndices,
+            ACCESSOR_SCALAR,
+            sparse.indicesComponentType,
+            indexSize,
+            sparse.count,
+            nullptr);
+        for (const uint32_t dstIndex : dstIndices) {
+            if (dstIndex >= static_cast<uint32_t>(accessor.count)) {
+                ALOGW("Error: Invalid sparse index on gltfPrimitive accessor %d", index);
+                return false;
             }
         }
+        CopyAccessorElements(
+            dst,
+            sparseValues,
+            type,
+            accessor.componentType,
+            srcValueSize,
+            sparse.count,
+            dstIndices.data());
     }
-
-    return loaded;
+    return true;
 }
 
 bool ReadVertexAttributes(
@@ -433,7 +593,7 @@ bool ReadVertexAttributes(
         }
 
         loaded = ReadSurfaceDataFromAccessor(
-            attribs.position, modelFile, positionIndex, ACCESSOR_VEC3, GL_FLOAT, -1, false);
+            attribs.position, modelFile, positionIndex, ACCESSOR_VEC3, -1, false);
     }
 
     // attribute count must match positions unless this is a morph target
@@ -445,7 +605,6 @@ bool ReadVertexAttributes(
             modelFile,
             attributes.GetChildInt32ByName("NORMAL", -1),
             ACCESSOR_VEC3,
-            GL_FLOAT,
             numVertices,
             false);
     }
@@ -457,7 +616,6 @@ bool ReadVertexAttributes(
     //     //     modelFile,
     //     //     attributes.GetChildInt32ByName("TANGENT", -1),
     //     //     ACCESSOR_VEC4,
-    //     //     GL_FLOAT,
     //     //     numVertices,
     //     //     false);
     // }
@@ -467,7 +625,6 @@ bool ReadVertexAttributes(
             modelFile,
             attributes.GetChildInt32ByName("BINORMAL", -1),
             ACCESSOR_VEC3,
-            GL_FLOAT,
             numVertices,
             false);
     }
@@ -477,7 +634,6 @@ bool ReadVertexAttributes(
             modelFile,
             attributes.GetChildInt32ByName("COLOR", -1),
             ACCESSOR_VEC4,
-            GL_FLOAT,
             numVertices,
             false);
     }
@@ -487,7 +643,6 @@ bool ReadVertexAttributes(
             modelFile,
             attributes.GetChildInt32ByName("TEXCOORD_0", -1),
             ACCESSOR_VEC2,
-            GL_FLOAT,
             numVertices,
             false);
     }
@@ -497,7 +652,6 @@ bool ReadVertexAttributes(
             modelFile,
             attributes.GetChildInt32ByName("TEXCOORD_1", -1),
             ACCESSOR_VEC2,
-            GL_FLOAT,
             numVertices,
             false);
     }
@@ -506,7 +660,7 @@ bool ReadVertexAttributes(
     // if ( loaded ) { loaded = ReadSurfaceDataFromAccessor(
     // attribs.uv2, modelFile,
     // attributes.GetChildInt32ByName( "TEXCOORD_2", -1 ),
-    // ACCESSOR_VEC2, GL_FLOAT, static_cast< int
+    // ACCESSOR_VEC2, static_cast< int
     // >( newPrimitive.attribs.position.size() ) ); }
     // #TODO: get weights of type unsigned_byte and unsigned_short
     // working.
@@ -516,7 +670,6 @@ bool ReadVertexAttributes(
             modelFile,
             attributes.GetChildInt32ByName("WEIGHTS_0", -1),
             ACCESSOR_VEC4,
-            GL_FLOAT,
             numVertices,
             false);
     }
@@ -524,44 +677,12 @@ bool ReadVertexAttributes(
     if (loaded) {
         int jointIndex = attributes.GetChildInt32ByName("JOINTS_0", -1);
         if (jointIndex >= 0 && jointIndex < static_cast<int>(modelFile.Accessors.size())) {
-            ModelAccessor& acc = modelFile.Accessors[jointIndex];
-            if (acc.componentType == GL_UNSIGNED_SHORT) {
-                attribs.jointIndices.resize(acc.count);
-                for (int accIndex = 0; accIndex < acc.count; accIndex++) {
-                    attribs.jointIndices[accIndex].x =
-                        (int)((unsigned short*)(acc.BufferData()))[accIndex * 4 + 0];
-                    attribs.jointIndices[accIndex].y =
-                        (int)((unsigned short*)(acc.BufferData()))[accIndex * 4 + 1];
-                    attribs.jointIndices[accIndex].z =
-                        (int)((unsigned short*)(acc.BufferData()))[accIndex * 4 + 2];
-                    attribs.jointIndices[accIndex].w =
-                        (int)((unsigned short*)(acc.BufferData()))[accIndex * 4 + 3];
-                }
-            } else if (acc.componentType == GL_BYTE || acc.componentType == GL_UNSIGNED_BYTE) {
-                attribs.jointIndices.resize(acc.count);
-                for (int accIndex = 0; accIndex < acc.count; accIndex++) {
-                    attribs.jointIndices[accIndex].x =
-                        (int)((uint8_t*)(acc.BufferData()))[accIndex * 4 + 0];
-                    attribs.jointIndices[accIndex].y =
-                        (int)((uint8_t*)(acc.BufferData()))[accIndex * 4 + 1];
-                    attribs.jointIndices[accIndex].z =
-                        (int)((uint8_t*)(acc.BufferData()))[accIndex * 4 + 2];
-                    attribs.jointIndices[accIndex].w =
-                        (int)((uint8_t*)(acc.BufferData()))[accIndex * 4 + 3];
-                }
-            } else if (acc.componentType == GL_FLOAT) { // not officially in spec, but it's what
-                                                        // our exporter spits out.
-                attribs.jointIndices.resize(acc.count);
-                for (int accIndex = 0; accIndex < acc.count; accIndex++) {
-                    attribs.jointIndices[accIndex].x =
-                        (int)((float*)(acc.BufferData()))[accIndex * 4 + 0];
-                    attribs.jointIndices[accIndex].y =
-                        (int)((float*)(acc.BufferData()))[accIndex * 4 + 1];
-                    attribs.jointIndices[accIndex].z =
-                        (int)((float*)(acc.BufferData()))[accIndex * 4 + 2];
-                    attribs.jointIndices[accIndex].w =
-                        (int)((float*)(acc.BufferData()))[accIndex * 4 + 3];
-                }
+            const ModelAccessor& acc = modelFile.Accessors[jointIndex];
+            // GL_FLOAT is not officially in spec, but it's what our exporter spits out.
+            if (acc.componentType == GL_UNSIGNED_SHORT || acc.componentType == GL_BYTE ||
+                acc.componentType == GL_UNSIGNED_BYTE || acc.componentType == GL_FLOAT) {
+                loaded = ReadSurfaceDataFromAccessor(
+                    attribs.jointIndices, modelFile, jointIndex, ACCESSOR_VEC4, numVertices, false);
             } else {
                 ALOGW(
                     "invalid component type %d on joints_0 accessor on model %s",
@@ -593,18 +714,241 @@ bool ReadVertexAttributes(
     return loaded;
 }
 
-// Requires the buffers and images to already be loaded in the model
+// Vertex and index data of a glTF primitive. The accessors of all primitives are read on worker
+// threads before the meshes are created, so only the GL buffer creation remains serial.
+struct PrimitiveGeo {
+    VertexAttribs attribs;
+    std::vector<VertexAttribs> targets;
+    std::vector<uint32_t> indices;
+    bool attribsLoaded = false;
+    bool targetsLoaded = true;
+    MeshOptimizerStats optimizerStats;
+};
+
+static void ReadPrimitiveGeo(
+    const std::shared_ptr<OVR::JSON>& primitiveJson,
+    ModelFile& modelFile,
+    const bool optimize,
+    PrimitiveGeo& geo) {
+    const OVR::JsonReader primitive(primitiveJson);
+
+    // VERTICES
+    geo.attribsLoaded = ReadVertexAttributes(
+        primitive.GetChildByName("attributes"), modelFile, geo.attribs, false /*isMorphTarget*/);
+
+    // MORPH TARGETS
+    const OVR::JsonReader targets(primitive.GetChildByName("targets"));
+    if (geo.attribsLoaded && targets.IsArray()) {
+        while (!targets.IsEndOfArray() && geo.targetsLoaded) {
+            const OVR::JsonReader target(targets.GetNextArrayElement());
+            VertexAttribs targetAttribs;
+            geo.targetsLoaded =
+                ReadVertexAttributes(target, modelFile, targetAttribs, true /*isMorphTarget*/);
+            if (geo.targetsLoaded) {
+                geo.targets.emplace_back(std::move(targetAttribs));
+            }
+        }
+    }
+
+    // TRIANGLES
+    const int indicesIndex = primitive.GetChildInt32ByName("indices", -1);
+    if (geo.attribsLoaded && indicesIndex >= 0 &&
+        indicesIndex < static_cast<int>(modelFile.Accessors.size()) &&
+        IsIndexComponentType(modelFile.Accessors[indicesIndex].componentType)) {
+        ReadSurfaceDataFromAccessor(
+            geo.indices, modelFile, indicesIndex, ACCESSOR_SCALAR, -1, false);
+    }
+
+    if (optimize && geo.targetsLoaded && !geo.indices.empty()) {
+        geo.optimizerStats = OptimizeMesh(geo.attribs, geo.indices, &geo.targets);
+    }
+}
+
+// The digested geometry of a glTF file is kept in the package cache, so loading the same file again
+// neither decodes and optimizes the accessors nor builds the ray-trace model. Cache entries are
+// keyed by a hash of the source files and of the settings the geometry depends on.
+static const uint32_t MODEL_CACHE_MAGIC = 0x6d72766f; // "ovrm"
+static const uint32_t MODEL_CACHE_VERSION = 2; // bump when the digested geometry changes
+static const uint64_t MODEL_CACHE_HASH_SEED = 14695981039346656037ULL;
+
+static uint64_t HashModelCacheKey(uint64_t hash, const void* data, const size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL; // FNV-1a
+    }
+    return hash;
+}
+
+template <typename _type_>
+static void WriteModelCacheArray(BinaryWriter& out, const std::vector<_type_>& array) {
+    out.WriteUInt32(static_cast<uint32_t>(array.size()));
+    out.WriteArray(array);
+}
+
+template <typename _type_>
+static bool ReadModelCacheArray(const BinaryReader& in, std::vector<_type_>& array) {
+    const uint32_t count = in.ReadUInt32();
+    return count <= INT_MAX && in.ReadArray(array, static_cast<int>(count));
+}
+
+static void WriteModelCacheAttribs(BinaryWriter& out, const VertexAttribs& attribs) {
+    WriteModelCacheArray(out, attribs.position);
+    WriteModelCacheArray(out, attribs.normal);
+    WriteModelCacheArray(out, attribs.tangent);
+    WriteModelCacheArray(out, attribs.binormal);
+    WriteModelCacheArray(out, attribs.color);
+    WriteModelCacheArray(out, attribs.uv0);
+    WriteModelCacheArray(out, attribs.uv1);
+    WriteModelCacheArray(out, attribs.jointIndices);
+    WriteModelCacheArray(out, attribs.jointWeights);
+}
+
+static bool ReadModelCacheAttribs(const BinaryReader& in, VertexAttribs& attribs) {
+    return ReadModelCacheArray(in, attribs.position) && ReadModelCacheArray(in, attribs.normal) &&
+        ReadModelCacheArray(in, attribs.tangent) && ReadModelCacheArray(in, attribs.binormal) &&
+        ReadModelCacheArray(in, attribs.color) && ReadModelCacheArray(in, attribs.uv0) &&
+        ReadModelCacheArray(in, attribs.uv1) && ReadModelCacheArray(in, attribs.jointIndices) &&
+        ReadModelCacheArray(in, attribs.jointWeights);
+}
+
+static void WriteModelCacheGeo(BinaryWriter& out, const std::vector<PrimitiveGeo>& geos) {
+    out.WriteUInt32(MODEL_CACHE_MAGIC);
+    out.WriteUInt32(MODEL_CACHE_VERSION);
+    out.WriteUInt32(static_cast<uint32_t>(geos.size()));
+    for (const PrimitiveGeo& geo : geos) {
+        out.WriteUInt32((geo.attribsLoaded ? 1 : 0) | (geo.targetsLoaded ? 2 : 0));
+        WriteModelCacheAttribs(out, geo.attribs);
+        out.WriteUInt32(static_cast<uint32_t>(geo.targets.size()));
+        for (const VertexAttribs& target : geo.targets) {
+            WriteModelCacheAttribs(out, target);
+        }
+        WriteModelCacheArray(out, geo.indices);
+    }
+}
+
+// An empty trace model is written for models without triangles.
+static void WriteModelCacheTrace(BinaryWriter& out, const ModelTrace& trace) {
+    const bool built = !trace.nodes.empty();
+    out.WriteUInt32(built ? 1 : 0);
+    if (built) {
+        out.Write(trace.header);
+        WriteModelCacheArray(out, trace.vertices);
+        WriteModelCacheArray(out, trace.uvs);
+        WriteModelCacheArray(out, trace.indices);
+        WriteModelCacheArray(out, trace.nodes);
+        WriteModelCacheArray(out, trace.leafs);
+        WriteModelCacheArray(out, trace.overflow);
+    }
+}
+
+// Returns false if the data was written by another version or doesn't match the primitive count.
+static bool ReadModelCache(
+    const uint8_t* data,
+    const size_t size,
+    const int primitiveCount,
+    std::vector<PrimitiveGeo>& geos,
+    ModelTrace& trace) {
+    if (size > INT_MAX) {
+        return false;
+    }
+    const BinaryReader in(data, static_cast<int>(size));
+    if (in.ReadUInt32() != MODEL_CACHE_MAGIC || in.ReadUInt32() != MODEL_CACHE_VERSION ||
+        in.ReadUInt32() != static_cast<uint32_t>(primitiveCount)) {
+        return false;
+    }
+    geos.resize(primitiveCount);
+    for (PrimitiveGeo& geo : geos) {
+        const uint32_t flags = in.ReadUInt32();
+        geo.attribsLoaded = (flags & 1) != 0;
+        geo.targetsLoaded = (flags & 2) != 0;
+        if (!ReadModelCacheAttribs(in, geo.attribs)) {
+            return false;
+        }
+        const uint32_t targetCount = in.ReadUInt32();
+        for (uint32_t i = 0; i < targetCount; i++) {
+            VertexAttribs target;
+            if (!ReadModelCacheAttribs(in, target)) {
+                return false;
+            }
+            geo.targets.emplace_back(std::move(target));
+        }
+        if (!ReadModelCacheArray(in, geo.indices)) {
+            return false;
+        }
+    }
+    trace = ModelTrace();
+    if (in.ReadUInt32() != 0) {
+        if (!in.Read(trace.header) || !ReadModelCacheArray(in, trace.vertices) ||
+            !ReadModelCacheArray(in, trace.uvs) || !ReadModelCacheArray(in, trace.indices) ||
+            !ReadModelCacheArray(in, trace.nodes) || !ReadModelCacheArray(in, trace.leafs) ||
+            !ReadModelCacheArray(in, trace.overflow) || !trace.Validate(true)) {
+            return false;
+        }
+    }
+    return in.IsAtEnd();
+}
+
+// Adds one surface per chunk of a primitive that was split to keep 16 bit indices.
+static void AddMeshChunkSurfaces(
+    Model& model,
+    const ModelSurface& surface,
+    const VertexAttribs& attribs,
+    std::vector<MeshChunk>& chunks,
+    const bool optimize) {
+    for (MeshChunk& chunk : chunks) {
+        ModelSurface chunkSurface;
+        chunkSurface.material = surface.material;
+        chunkSurface.surfaceDef = surface.surfaceDef;
+        for (const VertexAttribs& target : surface.targets) {
+            chunkSurface.targets.emplace_back(GatherVertexAttribs(target, chunk.vertices));
+        }
+
+        VertexAttribs chunkAttribs = GatherVertexAttribs(attribs, chunk.vertices);
+        if (optimize) {
+            // splitting grows chunks breadth first, which undoes the cache order
+            OptimizeMesh(chunkAttribs, chunk.indices, &chunkSurface.targets);
+        }
+        chunkSurface.surfaceDef.geo.Create(
+            chunkAttribs, chunk.indices, VertexLayout::Compact(chunkAttribs));
+
+        // Retain original vertex data if we use morph targets
+        if (!chunkSurface.targets.empty()) {
+            chunkSurface.attribs = std::move(chunkAttribs);
+        }
+        model.surfaces.emplace_back(std::move(chunkSurface));
+    }
+}
+
+// Requires the buffers and images to already be loaded in the model.
+// sourceHash identifies the contents of the source files for the geometry cache, 0 disables it.
 bool LoadModelFile_glTF_Json(
     ModelFile& modelFile,
     const char* modelsJson,
     const ModelGlPrograms& programs,
     const MaterialParms& materialParms,
-    ModelGeo* outModelGeo) {
+    ModelGeo* outModelGeo,
+    const uint64_t sourceHash) {
     ALOG("LoadModelFile_glTF_Json parsing %s", modelFile.FileName.c_str());
     // LOGCPUTIME( "LoadModelFile_glTF_Json" );
 
     bool loaded = true;
 
+    std::vector<TraceMeshGeo> traceMeshGeos;
+
+    // the optimizer changes the cached geometry, and the trace model is only cached when built
+    uint64_t cacheKey = 0;
+    if (sourceHash != 0) {
+        const uint32_t settings[3] = {
+            MODEL_CACHE_VERSION,
+            materialParms.OptimizeMeshes ? 1u : 0u,
+            materialParms.BuildTraceModel ? 1u : 0u};
+        cacheKey = HashModelCacheKey(sourceHash, settings, sizeof(settings));
+    }
+    BinaryWriter cacheWriter; // filled when the geometry is not cached yet
+    bool cacheMissed = false;
+    bool geometryCached = false;
+    ModelTrace cachedTraceModel;
+
     const char* error = nullptr;
     auto json = OVR::JSON::Parse(modelsJson, &error);
     if (json == nullptr) {
@@ -641,7 +985,7 @@ bool LoadModelFile_glTF_Json(
                             ModelAccessor newGltfAccessor;
 
                             newGltfAccessor.name = accessor.GetChildStringByName("name");
-                            const int bufferView = accessor.GetChildInt32ByName("bufferView");
+                            const int bufferView = accessor.GetChildInt32ByName("bufferView", -1);
                             newGltfAccessor.byteOffset = accessor.GetChildInt32ByName("byteOffset");
                             newGltfAccessor.componentType =
                                 accessor.GetChildInt32ByName("componentType");
@@ -649,8 +993,36 @@ bool LoadModelFile_glTF_Json(
                             const std::string type = accessor.GetChildStringByName("type");
                             newGltfAccessor.normalized = accessor.GetChildBoolByName("normalized");
 
-                            if (bufferView < 0 ||
-                                bufferView >= (const int)modelFile.BufferViews.size()) {
+                            const OVR::JsonReader sparse(accessor.GetChildByName("sparse"));
+                            if (sparse.IsObject()) {
+                                const OVR::JsonReader indices(sparse.GetChildByName("indices"));
+                                const OVR::JsonReader values(sparse.GetChildByName("values"));
+                                const int indicesView =
+                                    indices.GetChildInt32ByName("bufferView", -1);
+                                const int valuesView = values.GetChildInt32ByName("bufferView", -1);
+                                ModelSparseAccessor& newSparse = newGltfAccessor.sparse;
+                                newSparse.count = sparse.GetChildInt32ByName("count");
+                                newSparse.indicesByteOffset =
+                                    indices.GetChildInt32ByName("byteOffset");
+                                newSparse.indicesComponentType =
+                                    indices.GetChildInt32ByName("componentType");
+                                newSparse.valuesByteOffset =
+                                    values.GetChildInt32ByName("byteOffset");
+                                if (newSparse.count <= 0 || indicesView < 0 ||
+                                    indicesView >= (const int)modelFile.BufferViews.size() ||
+                                    valuesView < 0 ||
+                                    valuesView >= (const int)modelFile.BufferViews.size() ||
+                                    !IsIndexComponentType(newSparse.indicesComponentType)) {
+                                    ALOGW("Error: Invalid sparse gltfAccessor");
+                                    loaded = false;
+                                } else {
+                                    newSparse.indicesBufferView =
+                                        &modelFile.BufferViews[indicesView];
+                                    newSparse.valuesBufferView = &modelFile.BufferViews[valuesView];
+                                }
+                            }
+
+                            if (bufferView >= (const int)modelFile.BufferViews.size()) {
                                 ALOGW("Error: Invalid bufferView Index in gltfAccessor");
                                 loaded = false;
                             }
@@ -707,7 +1079,9 @@ bool LoadModelFile_glTF_Json(
                                 newGltfAccessor.minMaxSet = true;
                             }
 
-                            newGltfAccessor.bufferView = &modelFile.BufferViews[bufferView];
+                            if (loaded && bufferView >= 0) {
+                                newGltfAccessor.bufferView = &modelFile.BufferViews[bufferView];
+                            }
                             modelFile.Accessors.push_back(newGltfAccessor);
 
                             count++;
@@ -988,14 +1362,89 @@ bool LoadModelFile_glTF_Json(
                 }
             } // END MATERIALS
 
+            std::vector<PrimitiveGeo> primitiveGeos;
+            if (loaded) { // PRIMITIVE GEOMETRY
+                // read the accessors of all primitives in parallel
+                std::vector<std::shared_ptr<OVR::JSON>> primitiveJsons;
+                const OVR::JsonReader meshes(models.GetChildByName("meshes"));
+                if (meshes.IsArray()) {
+                    while (!meshes.IsEndOfArray()) {
+                        const OVR::JsonReader mesh(meshes.GetNextArrayElement());
+                        if (mesh.IsObject()) {
+                            const OVR::JsonReader primitives(mesh.GetChildByName("primitives"));
+                            if (primitives.IsArray()) {
+                                while (!primitives.IsEndOfArray()) {
+                                    primitiveJsons.push_back(primitives.GetNextArrayElement());
+                                }
+                            }
+                        }
+                    }
+                }
+
+                ovrPackageFileView cached;
+                if (cacheKey != 0 && ovr_FindCachedData(cacheKey, cached)) {
+                    geometryCached = ReadModelCache(
+                        cached.GetData(),
+                        cached.GetSize(),
+                        static_cast<int>(primitiveJsons.size()),
+                        primitiveGeos,
+                        cachedTraceModel);
+                    if (!geometryCached) {
+                        ALOGW(
+                            "Ignoring outdated geometry cache for %s",
+                            modelFile.FileName.c_str());
+                        primitiveGeos.clear();
+                    } else {
+                        ALOG("Loaded geometry of %s from the cache", modelFile.FileName.c_str());
+                    }
+                }
+
+                if (!geometryCached) {
+                    primitiveGeos.resize(primitiveJsons.size());
+                    ParallelForJobs(
+                        static_cast<int>(primitiveJsons.size()),
+                        [&primitiveJsons, &primitiveGeos, &modelFile, &materialParms](
+                            const int index) {
+                            ReadPrimitiveGeo(
+                                primitiveJsons[index],
+                                modelFile,
+                                materialParms.OptimizeMeshes,
+                                primitiveGeos[index]);
+                        });
+
+                    // the surfaces take the geometry, so it is written out before they are made
+                    if (cacheKey != 0) {
+                        cacheMissed = true;
+                        WriteModelCacheGeo(cacheWriter, primitiveGeos);
+                    }
+                }
+
+                if (materialParms.OptimizeMeshes && !geometryCached) {
+                    MeshOptimizerStats total;
+                    for (const PrimitiveGeo& geo : primitiveGeos) {
+                        total.triangleCount += geo.optimizerStats.triangleCount;
+                        total.transformedBefore += geo.optimizerStats.transformedBefore;
+                        total.transformedAfter += geo.optimizerStats.transformedAfter;
+                    }
+                    ALOG(
+                        "Optimized %d triangles in %s, ACMR %.3f -> %.3f",
+                        total.triangleCount,
+                        modelFile.FileName.c_str(),
+                        total.AcmrBefore(),
+                        total.AcmrAfter());
+                }
+            } // END PRIMITIVE GEOMETRY
+
             if (loaded) { // MODELS (gltf mesh)
                 LOGV("Loading meshes");
+                int primitiveIndex = 0;
                 const OVR::JsonReader meshes(models.GetChildByName("meshes"));
                 if (meshes.IsArray()) {
                     while (!meshes.IsEndOfArray() && loaded) {
                         const OVR::JsonReader mesh(meshes.GetNextArrayElement());
                         if (mesh.IsObject()) {
                             Model newGltfModel;
+                            TraceMeshGeo traceMeshGeo;
 
                             newGltfModel.name = mesh.GetChildStringByName("name");
 
@@ -1050,16 +1499,16 @@ bool LoadModelFile_glTF_Json(
                                         loaded = false;
                                     }
 
-                                    TriangleIndex outGeoIndexOffset = 0;
+                                    uint32_t outGeoIndexOffset = 0;
                                     if (outModelGeo != nullptr) {
-                                        outGeoIndexOffset = static_cast<TriangleIndex>(
+                                        outGeoIndexOffset = static_cast<uint32_t>(
                                             (*outModelGeo).positions.size());
                                     }
 
                                     // VERTICES
-                                    VertexAttribs attribs;
-                                    loaded = ReadVertexAttributes(
-                                        attributes, modelFile, attribs, false /*isMorphTarget*/);
+                                    PrimitiveGeo& primitiveGeo = primitiveGeos[primitiveIndex++];
+                                    VertexAttribs& attribs = primitiveGeo.attribs;
+                                    loaded = primitiveGeo.attribsLoaded;
 
                                     // MORPH TARGETS
                                     const OVR::JsonReader targets(
@@ -1069,31 +1518,31 @@ bool LoadModelFile_glTF_Json(
                                             ALOGW("Error: Invalid targets on primitive");
                                             loaded = false;
                                         }
+                                        if (!primitiveGeo.targetsLoaded) {
+                                            loaded = false;
+                                        }
 
-                                        while (!targets.IsEndOfArray() && loaded) {
-                                            const OVR::JsonReader target(
-                                                targets.GetNextArrayElement());
-                                            VertexAttribs targetAttribs;
-                                            loaded = ReadVertexAttributes(
-                                                target,
-                                                modelFile,
-                                                targetAttribs,
-                                                true /*isMorphTarget*/);
-                                            if (loaded) {
-                                                // for each morph target attribute, an original
-                                                // attribute MUST be present in the mesh primitive
+                                        for (int targetIndex = 0; targetIndex <
+                                                 static_cast<int>(primitiveGeo.targets.size()) &&
+                                             loaded;
+                                             targetIndex++) {
+                                            VertexAttribs& targetAttribs =
+                                                primitiveGeo.targets[targetIndex];
+                                            // for each morph target attribute, an original
+                                            // attribute MUST be present in the mesh primitive
 #define CHECK_ATTRIB_COUNT(ATTRIB)                                                               \
     if (!targetAttribs.ATTRIB.empty() && targetAttribs.ATTRIB.size() != attribs.ATTRIB.size()) { \
         ALOGW("Error: target " #ATTRIB " count mismatch on gltfPrimitive");                      \
         loaded = false;                                                                          \
     }
-                                                CHECK_ATTRIB_COUNT(position);
-                                                CHECK_ATTRIB_COUNT(normal);
-                                                CHECK_ATTRIB_COUNT(tangent);
-                                                CHECK_ATTRIB_COUNT(color);
-                                                CHECK_ATTRIB_COUNT(uv0);
-                                                CHECK_ATTRIB_COUNT(uv1);
+                                            CHECK_ATTRIB_COUNT(position);
+                                            CHECK_ATTRIB_COUNT(normal);
+                                            CHECK_ATTRIB_COUNT(tangent);
+                                            CHECK_ATTRIB_COUNT(color);
+                                            CHECK_ATTRIB_COUNT(uv0);
+                                            CHECK_ATTRIB_COUNT(uv1);
 #undef CHECK_ATTRIB_COUNT
+                                            if (loaded) {
                                                 newGltfSurface.targets.emplace_back(
                                                     std::move(targetAttribs));
                                             }
@@ -1101,7 +1550,8 @@ bool LoadModelFile_glTF_Json(
                                     }
 
                                     // TRIANGLES
-                                    std::vector<TriangleIndex> indices;
+                                    const std::vector<uint32_t>& indices =
+                                        primitiveGeo.indices;
                                     const int indicesIndex =
                                         primitive.GetChildInt32ByName("indices", -1);
                                     if (indicesIndex < 0 ||
@@ -1109,29 +1559,66 @@ bool LoadModelFile_glTF_Json(
                                             static_cast<int>(modelFile.Accessors.size())) {
                                         ALOGW("Error: Invalid indices index on gltfPrimitive");
                                         loaded = false;
-                                    }
-
-                                    if (modelFile.Accessors[indicesIndex].componentType !=
-                                        GL_UNSIGNED_SHORT) {
+                                    } else if (!IsIndexComponentType(
+                                                   modelFile.Accessors[indicesIndex]
+                                                       .componentType)) {
                                         ALOGW(
-                                            "Error: Currently, only componentType of %d supported for indices, %d requested",
-                                            GL_UNSIGNED_SHORT,
+                                            "Error: Invalid componentType %d for indices",
                                             modelFile.Accessors[indicesIndex].componentType);
                                         loaded = false;
                                     }
+                                    for (const uint32_t index : indices) {
+                                        if (index >= attribs.position.size()) {
+                                            ALOGW("Error: index out of range on gltfPrimitive");
+                                            loaded = false;
+                                            break;
+                                        }
+                                    }
 
-                                    if (loaded) {
-                                        ReadSurfaceDataFromAccessor(
+                                    // primitives that must keep 16 bit indices are split into
+                                    // several surfaces
+                                    std::vector<MeshChunk> chunks;
+                                    if (loaded && materialParms.Force16BitIndices &&
+                                        static_cast<int>(attribs.position.size()) >
+                                            GlGeometry::GetMaxGeometryVertices()) {
+                                        SplitMesh(
                                             indices,
-                                            modelFile,
-                                            primitive.GetChildInt32ByName("indices", -1),
-                                            ACCESSOR_SCALAR,
-                                            GL_UNSIGNED_SHORT,
-                                            -1,
-                                            false);
+                                            static_cast<int>(attribs.position.size()),
+                                            GlGeometry::GetMaxGeometryVertices(),
+                                            chunks);
+                                        ALOG(
+                                            "Split %d vertices into %d surfaces",
+                                            static_cast<int>(attribs.position.size()),
+                                            static_cast<int>(chunks.size()));
+                                    } else {
+                                        // quantized attributes are read unchanged by the model
+                                        // shaders
+                                        newGltfSurface.surfaceDef.geo.Create(
+                                            attribs, indices, VertexLayout::Compact(attribs));
                                     }
 
-                                    newGltfSurface.surfaceDef.geo.Create(attribs, indices);
+                                    if (loaded && !geometryCached &&
+                                        materialParms.BuildTraceModel) {
+                                        const int firstVertex =
+                                            static_cast<int>(traceMeshGeo.positions.size());
+                                        traceMeshGeo.positions.insert(
+                                            traceMeshGeo.positions.end(),
+                                            attribs.position.begin(),
+                                            attribs.position.end());
+                                        if (attribs.uv0.size() == attribs.position.size()) {
+                                            traceMeshGeo.uvs.insert(
+                                                traceMeshGeo.uvs.end(),
+                                                attribs.uv0.begin(),
+                                                attribs.uv0.end());
+                                        } else {
+                                            traceMeshGeo.uvs.resize(
+                                                traceMeshGeo.positions.size(), Vector2f(0.0f));
+                                        }
+                                        for (const uint32_t index : indices) {
+                                            traceMeshGeo.indices.push_back(
+                                                static_cast<int>(index) + firstVertex);
+                                        }
+                                    }
                                     bool skinned =
                                         (attribs.jointIndices.size() == attribs.position.size() &&
                                          attribs.jointWeights.size() == attribs.position.size());
@@ -1273,11 +1760,21 @@ bool LoadModelFile_glTF_Json(
                                             .cullEnable = false;
                                     }
 
-                                    // Retain original vertex data if we use morph targets
-                                    if (!newGltfSurface.targets.empty()) {
-                                        newGltfSurface.attribs = std::move(attribs);
+                                    if (!chunks.empty()) {
+                                        AddMeshChunkSurfaces(
+                                            newGltfModel,
+                                            newGltfSurface,
+                                            attribs,
+                                            chunks,
+                                            materialParms.OptimizeMeshes);
+                                    } else {
+                                        // Retain original vertex data if we use morph targets
+                                        if (!newGltfSurface.targets.empty()) {
+                                            newGltfSurface.attribs = std::move(attribs);
+                                        }
+                                        newGltfModel.surfaces.emplace_back(
+                                            std::move(newGltfSurface));
                                     }
-                                    newGltfModel.surfaces.emplace_back(std::move(newGltfSurface));
                                 }
                             } // END SURFACES
 
@@ -1316,6 +1813,7 @@ bool LoadModelFile_glTF_Json(
                             } // END WEIGHTS
 
                             modelFile.Models.emplace_back(std::move(newGltfModel));
+                            traceMeshGeos.emplace_back(std::move(traceMeshGeo));
                         }
                     }
                 }
@@ -1657,6 +2155,19 @@ bool LoadModelFile_glTF_Json(
                                                 &modelFile.Accessors[outputIndex];
                                         }
 
+                                        // the samples are read in place from the buffer
+                                        if (loaded &&
+                                            (modelAnimationSampler.input->BufferData() == nullptr ||
+                                             modelAnimationSampler.output->BufferData() ==
+                                                 nullptr ||
+                                             modelAnimationSampler.input->sparse.count > 0 ||
+                                             modelAnimationSampler.output->sparse.count > 0)) {
+                                            ALOGW(
+                                                "animation sampler without buffer data on '%s'",
+                                                modelAnimation.name.c_str());
+                                            loaded = false;
+                                        }
+
                                         std::string interpolation =
                                             sampler.GetChildStringByName("interpolation", "LINEAR");
                                         if (OVR::OVR_stricmp(interpolation.c_str(), "LINEAR") ==
@@ -1817,7 +2328,7 @@ bool LoadModelFile_glTF_Json(
                                                 } else if (
                                                     sampler->interpolation ==
                                                     MODEL_ANIMATION_INTERPOLATION_CUBICSPLINE) {
-                                                    if (inputCount != (outputCount * 3)) {
+                                                    if ((inputCount * 3) != outputCount) {
                                                         ALOGW(
                                                             "input and output have invalid counts on sampler on animation '%s'",
                                                             modelAnimation.name.c_str());
@@ -1945,17 +2456,18 @@ bool LoadModelFile_glTF_Json(
                                     modelFile.FileName.c_str());
                                 loaded = false;
                             } else if (bindMatricesAccessorIndex >= 0) {
-                                ModelAccessor& acc = modelFile.Accessors[bindMatricesAccessorIndex];
                                 newSkin.inverseBindMatricesAccessor =
                                     &modelFile.Accessors[bindMatricesAccessorIndex];
-                                for (int i = 0; i < acc.count; i++) {
-                                    Matrix4f matrix;
-                                    memcpy(
-                                        matrix.M[0],
-                                        ((float*)(acc.BufferData())) + i * 16,
-                                        sizeof(float) * 16);
+                                loaded = ReadSurfaceDataFromAccessor(
+                                    newSkin.inverseBindMatrices,
+                                    modelFile,
+                                    bindMatricesAccessorIndex,
+                                    ACCESSOR_MAT4,
+                                    -1,
+                                    false);
+                                // glTF matrices are column major
+                                for (Matrix4f& matrix : newSkin.inverseBindMatrices) {
                                     matrix.Transpose();
-                                    newSkin.inverseBindMatrices.push_back(matrix);
                                 }
                             }
 
@@ -2067,6 +2579,21 @@ bool LoadModelFile_glTF_Json(
                 }
             }
 
+            if (loaded && materialParms.BuildTraceModel) { // RAY-TRACE MODEL
+                if (geometryCached) {
+                    modelFile.TraceModel = std::move(cachedTraceModel);
+                } else {
+                    LOGV("Building ray-trace model");
+                    BuildTraceModel(modelFile, traceMeshGeos);
+                }
+            } // END RAY-TRACE MODEL
+
+            if (loaded && cacheMissed) {
+                WriteModelCacheTrace(cacheWriter, modelFile.TraceModel);
+                ovr_StoreCachedData(
+                    cacheKey, cacheWriter.GetData().data(), cacheWriter.GetData().size());
+            }
+
             // print out the scene info
             if (loaded) {
                 LOGV("Model Loaded:     '%s'", modelFile.FileName.c_str());
@@ -2090,8 +2617,7 @@ bool LoadModelFile_glTF_Json(
             }
 
             // #TODO: what to do with our collision?  One possible answer is extras on the data
-            // tagging certain models as collision. Collision Model Ground Collision Model Ray-Trace
-            // Model
+            // tagging certain models as collision. Collision Model Ground Collision Model
         } else {
             loaded = false;
         }
@@ -2114,6 +2640,8 @@ bool LoadModelFile_glTF_OvrScene(
     // Since we are doing a zip file, we are going to parse through the zip file many times to find
     // the different data points.
     const char* gltfJson = nullptr;
+    // the zip directory has the CRC of every file, which identifies the contents for the cache
+    uint64_t sourceHash = MODEL_CACHE_HASH_SEED;
     {
         // LOGCPUTIME( "Loading GLTF file" );
         for (int ret = unzGoToFirstFile(zfp); ret == UNZ_OK; ret = unzGoToNextFile(zfp)) {
@@ -2123,6 +2651,9 @@ bool LoadModelFile_glTF_OvrScene(
                 zfp, &finfo, entryName, sizeof(entryName), nullptr, 0, nullptr, 0);
             const size_t entryLength = strlen(entryName);
             const char* extension = (entryLength >= 5) ? &entryName[entryLength - 5] : entryName;
+            const uint64_t entryInfo[2] = {finfo.crc, finfo.uncompressed_size};
+            sourceHash = HashModelCacheKey(sourceHash, entryName, entryLength);
+            sourceHash = HashModelCacheKey(sourceHash, entryInfo, sizeof(entryInfo));
 
             if (OVR::OVR_stricmp(extension, ".gltf") == 0) {
                 LOGV("found %s", entryName);
@@ -2261,6 +2792,8 @@ bool LoadModelFile_glTF_OvrScene(
             if (loaded) { // IMAGES
                 // LOGCPUTIME( "Loading image textures" );
                 // gather all the images, and try to load them from the zip file.
+                // The zip file can only be read from this thread, the decoding is done in parallel.
+                std::vector<ModelImageLoad> imageLoads;
                 const OVR::JsonReader images(models.GetChildByName("images"));
                 if (images.IsArray()) {
                     while (!images.IsEndOfArray()) {
@@ -2269,13 +2802,13 @@ bool LoadModelFile_glTF_OvrScene(
                             const std::string name = image.GetChildStringByName("name");
                             const std::string uri = image.GetChildStringByName("uri");
                             int bufferView = image.GetChildInt32ByName("bufferView", -1);
+                            ModelImageLoad imageLoad;
                             if (bufferView >= 0) {
                                 // #TODO: support bufferView index for image files.
                                 ALOGW(
                                     "Loading images from bufferView currently unsupported, defaulting image");
                                 // Create a default texture.
-                                LoadModelFileTexture(
-                                    modelFile, "DefaultImage", nullptr, 0, materialParms);
+                                imageLoad.name = "DefaultImage";
                             } else {
                                 // check to make sure the image is ktx.
                                 if (OVR::OVR_stricmp(uri.c_str() + (uri.length() - 4), ".ktx") !=
@@ -2285,35 +2818,25 @@ bool LoadModelFile_glTF_OvrScene(
                                     ALOGW(
                                         "Loading images other then ktx is not advised. %s",
                                         uri.c_str());
-
-                                    int bufferLength = 0;
-                                    uint8_t* buffer = ReadFileBufferFromZipFile(
-                                        zfp, uri.c_str(), bufferLength, (const uint8_t*)fileData);
-                                    const char* imageName = uri.c_str();
-
-                                    LoadModelFileTexture(
-                                        modelFile,
-                                        imageName,
-                                        (const char*)buffer,
-                                        bufferLength,
-                                        materialParms);
-                                } else {
-                                    int bufferLength = 0;
-                                    uint8_t* buffer = ReadFileBufferFromZipFile(
-                                        zfp, uri.c_str(), bufferLength, (const uint8_t*)fileData);
-                                    const char* imageName = uri.c_str();
-
-                                    LoadModelFileTexture(
-                                        modelFile,
-                                        imageName,
-                                        (const char*)buffer,
-                                        bufferLength,
-                                        materialParms);
                                 }
+
+                                int bufferLength = 0;
+                                uint8_t* buffer = ReadFileBufferFromZipFile(
+                                    zfp, uri.c_str(), bufferLength, (const uint8_t*)fileData);
+                                imageLoad.name = uri;
+                                imageLoad.buffer = buffer;
+                                imageLoad.bufferLength = bufferLength;
+                                imageLoad.ownsBuffer = buffer != nullptr &&
+                                    (fileData == nullptr || buffer < (const uint8_t*)fileData ||
+                                     buffer >= (const uint8_t*)fileData + fileDataLength);
                             }
+                            imageLoads.emplace_back(std::move(imageLoad));
                         }
                     }
                 }
+
+                DecodeModelImages(imageLoads);
+                CreateModelImageTextures(modelFile, imageLoads, materialParms);
             } // END images
             // End of section dependent on zip file.
         } else {
@@ -2322,8 +2845,8 @@ bool LoadModelFile_glTF_OvrScene(
         }
 
         if (loaded) {
-            loaded =
-                LoadModelFile_glTF_Json(modelFile, gltfJson, programs, materialParms, outModelGeo);
+            loaded = LoadModelFile_glTF_Json(
+                modelFile, gltfJson, programs, materialParms, outModelGeo, sourceHash);
         }
     }
 
@@ -2552,7 +3075,8 @@ ModelFile* LoadModelFile_glB(
 
                 if (loaded) { // IMAGES
                     LOGV("Loading image textures");
-                    // gather all the images, and try to load them from the zip file.
+                    // gather all the images, decode them in parallel and then create the textures.
+                    std::vector<ModelImageLoad> imageLoads;
                     const OVR::JsonReader images(models.GetChildByName("images"));
                     if (images.IsArray()) {
                         while (!images.IsEndOfArray()) {
@@ -2567,42 +3091,38 @@ ModelFile* LoadModelFile_glB(
                                     name.c_str(),
                                     uri.c_str(),
                                     bufferView);
+                                ModelImageLoad imageLoad;
                                 if (bufferView >= 0 &&
                                     bufferView < static_cast<int>(modelFile.BufferViews.size())) {
                                     ModelBufferView* pBufferView =
                                         &modelFile.BufferViews[bufferView];
-                                    int imageBufferLength = (int)pBufferView->byteLength;
-                                    uint8_t* imageBuffer =
+                                    imageLoad.bufferLength = (int)pBufferView->byteLength;
+                                    imageLoad.buffer =
                                         (uint8_t*)pBufferView->buffer->bufferData.data() +
                                         pBufferView->byteOffset;
 
-                                    std::string path = name;
+                                    imageLoad.name = name;
                                     const char* ext = strrchr(mimeType.c_str(), '/');
                                     if (ext) {
-                                        path += ".";
-                                        path += ext + 1;
+                                        imageLoad.name += ".";
+                                        imageLoad.name += ext + 1;
                                     }
-
-                                    LoadModelFileTexture(
-                                        modelFile,
-                                        path.c_str(),
-                                        (const char*)imageBuffer,
-                                        imageBufferLength,
-                                        materialParms);
-                                } else if (
-                                    materialParms.ImageUriHandler &&
-                                    materialParms.ImageUriHandler(modelFile, uri)) {
-                                    LOGV("LoadModelFile_glB: uri processed by custom handler");
+                                } else if (materialParms.ImageUriHandler) {
+                                    imageLoad.uri = uri;
+                                    imageLoad.useUriHandler = true;
                                 } else {
                                     ALOGW(
                                         "Loading images from othen then bufferView currently unsupported in glBfd, defaulting image");
                                     // Create a default texture.
-                                    LoadModelFileTexture(
-                                        modelFile, "DefaultImage", nullptr, 0, materialParms);
+                                    imageLoad.name = "DefaultImage";
                                 }
+                                imageLoads.emplace_back(std::move(imageLoad));
                             }
                         }
                     }
+
+                    DecodeModelImages(imageLoads);
+                    CreateModelImageTextures(modelFile, imageLoads, materialParms);
                 } // END images
 
                 // End of section dependent on buffer data in the glB file.
@@ -2610,8 +3130,16 @@ ModelFile* LoadModelFile_glB(
         }
 
         if (loaded) {
-            loaded =
-                LoadModelFile_glTF_Json(modelFile, gltfJson, programs, materialParms, outModelGeo);
+            // only hash the file when there is a cache to look in
+            uint64_t sourceHash = 0;
+            if (ovr_GetApplicationPackageCachePath()[0] != '\0') {
+                const uint64_t fileInfo[2] = {
+                    crc32(0L, (const Bytef*)fileData, static_cast<uInt>(fileDataLength)),
+                    static_cast<uint64_t>(fileDataLength)};
+                sourceHash = HashModelCacheKey(MODEL_CACHE_HASH_SEED, fileInfo, sizeof(fileInfo));
+            }
+            loaded = LoadModelFile_glTF_Json(
+                modelFile, gltfJson, programs, materialParms, outModelGeo, sourceHash);
         }
     }
 
@@ -15,6 +15,7 @@ Authors     :   John Carmack
 #include <algorithm>
 
 #include "Misc/Log.h"
+#include "Misc/Simd.h"
 #include "Render/Egl.h"
 
 using OVR::Bounds3f;
@@ -25,92 +26,105 @@ using OVR::Vector4f;
 
 namespace OVRFW {
 
-// Returns 0 if the bounds is culled by the mvp, otherwise returns the max W
-// value of the bounds corners so it can be sorted into roughly front to back
+// Computes a key for each bounds that is 0 if the bounds is culled by its mvp, otherwise
+// the max W value of the bounds corners so it can be sorted into roughly front to back
 // order for more efficient Z cull.  Sorting bounds in increasing order of
 // their farthest W value usually makes characters and objects draw before
 // the environments they are in, and draws sky boxes last, which is what we want.
-static float BoundsSortCullKey(const Bounds3f& bounds, const Matrix4f& mvp) {
-    // Always cull empty bounds, which can be used to disable a surface.
-    // Don't just check a single axis, or billboards would be culled.
-    if (bounds.b[1].x == bounds.b[0].x && bounds.b[1].y == bounds.b[0].y) {
-        return 0;
-    }
-
-    // Not very efficient code...
-    Vector4f c[8];
-    for (int i = 0; i < 8; i++) {
-        Vector4f world;
-        world.x = bounds.b[(i & 1)].x;
-        world.y = bounds.b[(i & 2) >> 1].y;
-        world.z = bounds.b[(i & 4) >> 2].z;
-        world.w = 1.0f;
-
-        c[i] = mvp.Transform(world);
-    }
-
-    int i;
-    for (i = 0; i < 8; i++) {
-        if (c[i].x > -c[i].w) {
-            break;
-        }
-    }
-    if (i == 8) {
-        return 0; // all off one side
-    }
-    for (i = 0; i < 8; i++) {
-        if (c[i].x < c[i].w) {
-            break;
+//
+// Four bounds are processed at a time in structure-of-arrays form. Instead of transforming
+// the 8 corners, each clip plane is evaluated at the bounds center and the extents are added
+// weighted by the absolute plane normal, which gives the largest value the plane takes over
+// the corners. A bounds is culled when that value is <= 0 for any plane.
+static void BoundsSortCullKeys(
+    const Bounds3f* const* bounds,
+    const Matrix4f* mvps,
+    float* keys,
+    const int count) {
+    for (int first = 0; first < count; first += 4) {
+        float center[3][4];
+        float extent[3][4];
+        float rows[4][4][4]; // [row][column][lane]
+        for (int lane = 0; lane < 4; lane++) {
+            // repeat the last bounds to fill up the final group
+            const int index = std::min(first + lane, count - 1);
+            const Bounds3f& b = *bounds[index];
+            for (int axis = 0; axis < 3; axis++) {
+                center[axis][lane] = (b.b[0][axis] + b.b[1][axis]) * 0.5f;
+                extent[axis][lane] = (b.b[1][axis] - b.b[0][axis]) * 0.5f;
+            }
+            for (int r = 0; r < 4; r++) {
+                for (int c = 0; c < 4; c++) {
+                    rows[r][c][lane] = mvps[index].M[r][c];
+                }
+            }
         }
-    }
-    if (i == 8) {
-        return 0; // all off one side
-    }
 
-    for (i = 0; i < 8; i++) {
-        if (c[i].y > -c[i].w) {
-            break;
+        const simd4f_t centerX = Simd4f_Load(center[0]);
+        const simd4f_t centerY = Simd4f_Load(center[1]);
+        const simd4f_t centerZ = Simd4f_Load(center[2]);
+        const simd4f_t extentX = Simd4f_Load(extent[0]);
+        const simd4f_t extentY = Simd4f_Load(extent[1]);
+        const simd4f_t extentZ = Simd4f_Load(extent[2]);
+
+        // largest value of the plane equation over the bounds corners
+        auto planeMax = [&](const simd4f_t plane[4]) {
+            const simd4f_t dist = Simd4f_Add(
+                Simd4f_Add(Simd4f_Mul(plane[0], centerX), Simd4f_Mul(plane[1], centerY)),
+                Simd4f_Add(Simd4f_Mul(plane[2], centerZ), plane[3]));
+            const simd4f_t radius = Simd4f_Add(
+                Simd4f_Add(
+                    Simd4f_Mul(Simd4f_Abs(plane[0]), extentX),
+                    Simd4f_Mul(Simd4f_Abs(plane[1]), extentY)),
+                Simd4f_Mul(Simd4f_Abs(plane[2]), extentZ));
+            return Simd4f_Add(dist, radius);
+        };
+
+        simd4f_t rowW[4];
+        for (int c = 0; c < 4; c++) {
+            rowW[c] = Simd4f_Load(rows[3][c]);
         }
-    }
-    if (i == 8) {
-        return 0; // all off one side
-    }
-    for (i = 0; i < 8; i++) {
-        if (c[i].y < c[i].w) {
-            break;
-        }
-    }
-    if (i == 8) {
-        return 0; // all off one side
-    }
 
-    for (i = 0; i < 8; i++) {
-        if (c[i].z > -c[i].w) {
-            break;
-        }
-    }
-    if (i == 8) {
-        return 0; // all off one side
-    }
-    for (i = 0; i < 8; i++) {
-        if (c[i].z < c[i].w) {
-            break;
+        const simd4f_t zero = Simd4f_Set1(0.0f);
+        simd4f_t culled = Simd4f_Set1(0.0f);
+        for (int axis = 0; axis < 3; axis++) {
+            simd4f_t inside[4]; // w + x >= 0
+            simd4f_t outside[4]; // w - x >= 0
+            for (int c = 0; c < 4; c++) {
+                const simd4f_t row = Simd4f_Load(rows[axis][c]);
+                inside[c] = Simd4f_Add(rowW[c], row);
+                outside[c] = Simd4f_Sub(rowW[c], row);
+            }
+            culled = Simd4f_Or(culled, Simd4f_CmpLE(planeMax(inside), zero));
+            culled = Simd4f_Or(culled, Simd4f_CmpLE(planeMax(outside), zero));
         }
-    }
-    if (i == 8) {
-        return 0; // all off one side
-    }
 
-    // calculate the farthest W point for front to back sorting
-    float maxW = 0;
-    for (i = 0; i < 8; i++) {
-        const float w = c[i].w;
-        if (w > maxW) {
-            maxW = w;
+        // calculate the farthest W point for front to back sorting
+        const simd4f_t maxW = Simd4f_Max(planeMax(rowW), zero);
+
+        float groupKeys[4];
+        Simd4f_Store(groupKeys, Simd4f_Select(culled, zero, maxW));
+        for (int lane = 0; lane < 4 && first + lane < count; lane++) {
+            const Bounds3f& b = *bounds[first + lane];
+            // Always cull empty bounds, which can be used to disable a surface.
+            // Don't just check a single axis, or billboards would be culled.
+            if (b.b[1].x == b.b[0].x && b.b[1].y == b.b[0].y) {
+                keys[first + lane] = 0.0f;
+            } else {
+                keys[first + lane] = groupKeys[lane];
+            }
         }
     }
+}
 
-    return maxW; // couldn't cull
+bool IsBoundsCulled(const Bounds3f& bounds, const Matrix4f& mvp) {
+    if (bounds.IsInverted()) {
+        return true;
+    }
+    const Bounds3f* boundsPtr = &bounds;
+    float key;
+    BoundsSortCullKeys(&boundsPtr, &mvp, &key, 1);
+    return key == 0.0f;
 }
 
 struct bsort_t {
@@ -155,6 +169,63 @@ void BuildModelSurfaceList(
     int numSurfaces = 0;
     int cullCount = 0;
 
+    // Surfaces are gathered in batches so the cull keys can be computed together.
+    static const int CULL_BATCH_SIZE = 64;
+    const Bounds3f* batchBounds[CULL_BATCH_SIZE];
+    Matrix4f batchMvps[CULL_BATCH_SIZE];
+    float batchKeys[CULL_BATCH_SIZE];
+    Matrix4f batchModelMatrices[CULL_BATCH_SIZE];
+    const ovrSurfaceDef* batchSurfaces[CULL_BATCH_SIZE];
+    bool batchAllowCulling[CULL_BATCH_SIZE];
+    int batchCount = 0;
+
+    auto flushBatch = [&]() {
+        BoundsSortCullKeys(batchBounds, batchMvps, batchKeys, batchCount);
+        for (int i = 0; i < batchCount; i++) {
+            const ovrSurfaceDef& surfaceDef = *batchSurfaces[i];
+            const float sort = batchKeys[i];
+            if (sort == 0) {
+                if (batchAllowCulling[i]) {
+                    if (LogRenderSurfaces) {
+                        ALOG("Culled %s", surfaceDef.surfaceName.c_str());
+                    }
+                    cullCount++;
+                    continue;
+                } else {
+                    if (LogRenderSurfaces) {
+                        ALOG("Skipped Culling of %s", surfaceDef.surfaceName.c_str());
+                    }
+                }
+            }
+
+            if (numSurfaces == MAX_DRAW_SURFACES) {
+                continue;
+            }
+
+            bsort[numSurfaces].key = sort;
+            bsort[numSurfaces].modelMatrix = batchModelMatrices[i];
+            bsort[numSurfaces].surface = &surfaceDef;
+            bsort[numSurfaces].transparent =
+                (surfaceDef.graphicsCommand.GpuState.blendEnable != ovrGpuState::BLEND_DISABLE);
+            numSurfaces++;
+        }
+        batchCount = 0;
+    };
+
+    auto addToBatch = [&](const ovrSurfaceDef& surfaceDef,
+                          const Matrix4f& modelMatrix,
+                          const bool allowCulling) {
+        batchBounds[batchCount] = &surfaceDef.geo.localBounds;
+        batchMvps[batchCount] = vpMatrix * modelMatrix;
+        batchModelMatrices[batchCount] = modelMatrix;
+        batchSurfaces[batchCount] = &surfaceDef;
+        batchAllowCulling[batchCount] = allowCulling;
+        batchCount++;
+        if (batchCount == CULL_BATCH_SIZE) {
+            flushBatch();
+        }
+    };
+
     for (int nodeNum = 0; nodeNum < static_cast<int>(emitNodes.size()); nodeNum++) {
         const ModelNodeState& nodeState = *emitNodes[nodeNum];
         if (nodeState.GetNode() != NULL && nodeState.GetNode()->model != NULL) {
@@ -165,124 +236,24 @@ void BuildModelSurfaceList(
                 allowCulling = false;
             }
 
-            if (nodeState.GetNode()->model != nullptr) {
-                const Model& modelDef = *nodeState.GetNode()->model;
-                for (int surfaceNum = 0; surfaceNum < static_cast<int>(modelDef.surfaces.size());
-                     surfaceNum++) {
-                    const ovrSurfaceDef& surfaceDef = modelDef.surfaces[surfaceNum].surfaceDef;
-                    const float sort = BoundsSortCullKey(
-                        surfaceDef.geo.localBounds, vpMatrix * nodeState.GetGlobalTransform());
-                    if (sort == 0) {
-                        if (allowCulling) {
-                            if (LogRenderSurfaces) {
-                                ALOG("Culled %s", surfaceDef.surfaceName.c_str());
-                            }
-                            cullCount++;
-                            continue;
-                        } else {
-                            if (LogRenderSurfaces) {
-                                ALOG("Skipped Culling of %s", surfaceDef.surfaceName.c_str());
-                            }
-                        }
-                    }
-
-                    if (numSurfaces == MAX_DRAW_SURFACES) {
-                        break;
-                    }
-
-                    /*
-                                        // Update the Joint Uniform Buffer
-                                        if ( nodeState.node->skinIndex >= 0 )
-                                        {
-                                            const ModelSkin & skin =
-                       nodeState.state->mf->Skins[nodeState.node->skinIndex];
-
-                                            static Matrix4f transposedJoints[MAX_JOINTS];
-                                            const int numJoints = std::min( static_cast< int >(
-                       skin.jointIndexes.size() ), MAX_JOINTS );
-
-
-                                            ALOGW( "### Skinning using skin #%d",
-                       nodeState.node->skinIndex );
-
-                                            Matrix4f inverseGlobalSkeletonTransform;
-                                            if ( skin.skeletonRootIndex >= 0 )
-                                            {
-                                                inverseGlobalSkeletonTransform =
-                       nodeState.state->nodeStates[skin.skeletonRootIndex].GetGlobalTransform().Inverted();
-                                            }
-                                            else
-                                            {
-                                                inverseGlobalSkeletonTransform =
-                       nodeState.state->nodeStates[nodeState.node->parentIndex].GetGlobalTransform().Inverted();
-                                            }
-
-                                            for ( int j = 0; j < numJoints; j++ )
-                                            {
-                                                Matrix4f globalTransform  =
-                       nodeState.state->nodeStates[skin.jointIndexes[j]].GetGlobalTransform();
-                                                Matrix4f tempTransform;
-                                                Matrix4f::Multiply( &tempTransform,
-                       inverseGlobalSkeletonTransform, globalTransform ); Matrix4f
-                       localJointTransform;
-
-                                                if ( skin.inverseBindMatrices.size() > 0 )
-                                                {
-                                                    Matrix4f::Multiply( &localJointTransform,
-                       tempTransform, skin.inverseBindMatrices[j] );
-                                                }
-                                                else
-                                                {
-                                                    ALOGW( "No inverse bind on modle" );
-                                                    localJointTransform = tempTransform;
-                                                }
-
-                                                transposedJoints[j] =
-                       localJointTransform.Transposed();
-                                            }
-                                            const size_t updateSize = numJoints * sizeof( Matrix4f
-                       ); surfaceDef.graphicsCommand.uniformJoints.Update( updateSize,
-                       &transposedJoints[0] );
-                                        }
-                    */
-
-                    bsort[numSurfaces].key = sort;
-                    bsort[numSurfaces].modelMatrix = nodeState.GetGlobalTransform();
-                    bsort[numSurfaces].surface = &surfaceDef;
-                    bsort[numSurfaces].transparent =
-                        (surfaceDef.graphicsCommand.GpuState.blendEnable !=
-                         ovrGpuState::BLEND_DISABLE);
-                    numSurfaces++;
-                }
+            const Model& modelDef = *nodeState.GetNode()->model;
+            for (int surfaceNum = 0; surfaceNum < static_cast<int>(modelDef.surfaces.size());
+                 surfaceNum++) {
+                addToBatch(
+                    modelDef.surfaces[surfaceNum].surfaceDef,
+                    nodeState.GetGlobalTransform(),
+                    allowCulling);
             }
         }
     }
 
     for (int i = 0; i < static_cast<int>(emitSurfaces.size()); i++) {
         const ovrDrawSurface& drawSurf = emitSurfaces[i];
-        const ovrSurfaceDef& surfaceDef = *drawSurf.surface;
-        const float sort =
-            BoundsSortCullKey(surfaceDef.geo.localBounds, vpMatrix * drawSurf.modelMatrix);
-        if (sort == 0) {
-            if (LogRenderSurfaces) {
-                ALOG("Culled %s", surfaceDef.surfaceName.c_str());
-            }
-            cullCount++;
-            continue;
-        }
-
-        if (numSurfaces == MAX_DRAW_SURFACES) {
-            break;
-        }
-
-        bsort[numSurfaces].key = sort;
-        bsort[numSurfaces].modelMatrix = drawSurf.modelMatrix;
-        bsort[numSurfaces].surface = &surfaceDef;
-        bsort[numSurfaces].transparent =
-            (surfaceDef.graphicsCommand.GpuState.blendEnable != ovrGpuState::BLEND_DISABLE);
-        numSurfaces++;
+        addToBatch(*drawSurf.surface, drawSurf.modelMatrix, true);
     }
 
+    flushBatch();
+
     // ALOG( "Culled %i, draw %i", cullCount, numSurfaces );
 
     // sort by the far W and transparency
@@ -29,4 +29,8 @@ void BuildModelSurfaceList(
     const OVR::Matrix4f& viewMatrix,
     const OVR::Matrix4f& projectionMatrix);
 
+// Returns true if the bounds are culled by the mvp the same way BuildModelSurfaceList culls
+// surfaces: completely outside one of the clip planes, behind the eye, or empty.
+bool IsBoundsCulled(const OVR::Bounds3f& bounds, const OVR::Matrix4f& mvp);
+
 } // namespace OVRFW
@@ -13,10 +13,13 @@ Authors     :   J.M.P. van Waveren
 
 #include <math.h>
 #include <algorithm>
+#include <memory>
+#include <thread>
 #include <vector>
 #include <assert.h>
 
 #include "Misc/Log.h"
+#include "Misc/Simd.h"
 
 using OVR::Bounds3f;
 using OVR::Matrix4f;
@@ -157,7 +160,7 @@ bool ModelTrace::Validate(const bool fullVerify) const {
     invalid |= header.numNodes != static_cast<int>(nodes.size());
     invalid |= header.numLeafs != static_cast<int>(leafs.size());
     invalid |= header.numOverflow != static_cast<int>(overflow.size());
-    if (!invalid) {
+    if (invalid) {
         ALOG("ModelTrace::Verify - invalid header");
         return false;
     }
@@ -196,7 +199,7 @@ bool ModelTrace::Validate(const bool fullVerify) const {
             }
         }
         const int numTris = static_cast<int>(indices.size()) / 3;
-        if (numTris * 3 != static_cast<int>(indices.size()) * 3) {
+        if (numTris * 3 != static_cast<int>(indices.size())) {
             ALOG("ModelTrace::Verify - Orphaned indices");
             return false;
         }
@@ -237,8 +240,9 @@ bool ModelTrace::Validate(const bool fullVerify) const {
             }
         }
         // verify overflow list doesn't point to any out-of-range triangles
+        // -1 terminates the triangle list of a leaf
         for (int i = 0; i < static_cast<int>(overflow.size()); ++i) {
-            if (overflow[i] < 0 || overflow[i] >= numTris) {
+            if (overflow[i] < -1 || overflow[i] >= numTris) {
                 ALOG(
                     "ModelTrace::Verify - overflow index %i value %i is out of range, max %i",
                     i,
@@ -262,16 +266,45 @@ bool ModelTrace::Validate(const bool fullVerify) const {
     return true;
 }
 
+static traceResult_t ResolveTraceResult(
+    const ModelTrace& trace,
+    const int triangleIndex,
+    const float distance,
+    const float rayLengthRcp,
+    const Vector2f& uv) {
+    traceResult_t result;
+    result.triangleIndex = triangleIndex;
+    result.fraction = 1.0f;
+    result.uv = Vector2f(0.0f);
+    result.normal = Vector3f(0.0f);
+
+    if (result.triangleIndex != -1) {
+        const std::vector<int>& indices = trace.indices;
+        result.fraction = distance * rayLengthRcp;
+        // return default uvs if the model has no uvs
+        if (static_cast<int>(trace.uvs.size()) == 0) {
+            result.uv = Vector2f(0.0f, 0.0f);
+        } else {
+            result.uv = trace.uvs[indices[result.triangleIndex + 0]] * (1.0f - uv.x - uv.y) +
+                trace.uvs[indices[result.triangleIndex + 1]] * uv.x +
+                trace.uvs[indices[result.triangleIndex + 2]] * uv.y;
+        }
+        const Vector3f d1 = trace.vertices[indices[result.triangleIndex + 1]] -
+            trace.vertices[indices[result.triangleIndex + 0]];
+        const Vector3f d2 = trace.vertices[indices[result.triangleIndex + 2]] -
+            trace.vertices[indices[result.triangleIndex + 0]];
+        result.normal = d1.Cross(d2).Normalized();
+    }
+
+    return result;
+}
+
 traceResult_t ModelTrace::Trace(const Vector3f& start, const Vector3f& end) const {
     // in debug, at least warn programmers if they're loading a model
     // that fails simple validation.
     assert(Validate(false));
 
-    traceResult_t result;
-    result.triangleIndex = -1;
-    result.fraction = 1.0f;
-    result.uv = Vector2f(0.0f);
-    result.normal = Vector3f(0.0f);
+    int triangleIndex = -1;
 
     const Vector3f rayDelta = end - start;
     const float rayLengthSqr = rayDelta.LengthSq();
@@ -308,8 +341,9 @@ traceResult_t ModelTrace::Trace(const Vector3f& start, const Vector3f& end) cons
     const float t0 = std::max(minX, std::max(minY, minZ));
     const float t1 = std::min(maxX, std::min(maxY, maxZ));
 
-    if (t0 >= t1) {
-        return result;
+    // Rays that only touch the bounds are kept, so flat models are not missed.
+    if (t0 > t1) {
+        return ResolveTraceResult(*this, -1, 0.0f, 0.0f, Vector2f(0.0f));
     }
 
     float entryDistance = std::max(t0, 0.0f);
@@ -371,7 +405,7 @@ traceResult_t ModelTrace::Trace(const Vector3f& start, const Vector3f& end) cons
                 if (distance >= 0.0f && distance < bestDistance) {
                     bestDistance = distance;
 
-                    result.triangleIndex = currentTriangle * 3;
+                    triangleIndex = currentTriangle * 3;
                     uv.x = u;
                     uv.y = v;
                 }
@@ -412,24 +446,7 @@ traceResult_t ModelTrace::Trace(const Vector3f& start, const Vector3f& end) cons
         currentNode = &nodes[exitNodeIndex];
     }
 
-    if (result.triangleIndex != -1) {
-        result.fraction = bestDistance * rayLengthRcp;
-        // return default uvs if the model has no uvs
-        if (static_cast<int>(uvs.size()) == 0) {
-            result.uv = Vector2f(0.0f, 0.0f);
-        } else {
-            result.uv = uvs[indices[result.triangleIndex + 0]] * (1.0f - uv.x - uv.y) +
-                uvs[indices[result.triangleIndex + 1]] * uv.x +
-                uvs[indices[result.triangleIndex + 2]] * uv.y;
-        }
-        const Vector3f d1 = vertices[indices[result.triangleIndex + 1]] -
-            vertices[indices[result.triangleIndex + 0]];
-        const Vector3f d2 = vertices[indices[result.triangleIndex + 2]] -
-            vertices[indices[result.triangleIndex + 0]];
-        result.normal = d1.Cross(d2).Normalized();
-    }
-
-    return result;
+    return ResolveTraceResult(*this, triangleIndex, bestDistance, rayLengthRcp, uv);
 }
 
 traceResult_t ModelTrace::Trace_Exhaustive(const Vector3f& start, const Vector3f& end) const {
@@ -437,11 +454,7 @@ traceResult_t ModelTrace::Trace_Exhaustive(const Vector3f& start, const Vector3f
     // that fails simple validation.
     assert(Validate(false));
 
-    traceResult_t result;
-    result.triangleIndex = -1;
-    result.fraction = 1.0f;
-    result.uv = Vector2f(0.0f);
-    result.normal = Vector3f(0.0f);
+    int triangleIndex = -1;
 
     const Vector3f rayDelta = end - start;
     const float rayLengthSqr = rayDelta.LengthSq();
@@ -470,31 +483,667 @@ traceResult_t ModelTrace::Trace_Exhaustive(const Vector3f& start, const Vector3f
             if (distance >= 0.0f && distance < bestDistance) {
                 bestDistance = distance;
 
-                result.triangleIndex = i;
+                triangleIndex = i;
                 uv.x = u;
                 uv.y = v;
             }
         }
     }
 
-    if (result.triangleIndex != -1) {
-        result.fraction = bestDistance * rayLengthRcp;
-        // return default uvs if the model has no uvs
-        if (static_cast<int>(uvs.size()) == 0) {
-            result.uv = Vector2f(0.0f, 0.0f);
+    return ResolveTraceResult(*this, triangleIndex, bestDistance, rayLengthRcp, uv);
+}
+
+/*
+
+    Interactive Rendering with Coherent Ray Tracing
+    Ingo Wald, Philipp Slusallek, Carsten Benthin, Markus Wagner
+    Eurographics, Volume 20, Number 3, 2001
+
+    A packet of rays walks the kd-tree together with a small stack, as long as all rays in the
+    packet have the same direction signs. Each ray keeps its own [tmin, tmax] interval and a
+    lane mask, and the triangles of each visited leaf are tested against all rays at once.
+
+*/
+
+const int RT_KDTREE_PACKET_STACK_SIZE = 64;
+
+struct kdtreePacketStackEntry_t {
+    int nodeIndex;
+    simd4f_t tmin;
+    simd4f_t tmax;
+};
+
+// returns a mask with the lanes set for each set bit, lane 0 in bit 0
+static simd4f_t LaneMask(const int lanes) {
+    return Simd4f_CmpGT(
+        Simd4f_Set(
+            static_cast<float>(lanes & 1),
+            static_cast<float>(lanes & 2),
+            static_cast<float>(lanes & 4),
+            static_cast<float>(lanes & 8)),
+        Simd4f_Set1(0.0f));
+}
+
+static simd4f_t SafeRcp(const simd4f_t v) {
+    const simd4f_t valid =
+        Simd4f_CmpGT(Simd4f_Abs(v), Simd4f_Set1(MATH_FLOAT_SMALLEST_NON_DENORMAL));
+    const simd4f_t safe = Simd4f_Select(valid, v, Simd4f_Set1(1.0f));
+    return Simd4f_Select(
+        valid,
+        Simd4f_Div(Simd4f_Set1(1.0f), safe),
+        Simd4f_Set1(MATH_FLOAT_HUGE_NUMBER));
+}
+
+void ModelTrace::TraceBatch(
+    const Vector3f* starts,
+    const Vector3f* ends,
+    traceResult_t* results,
+    const int count) const {
+    assert(Validate(false));
+
+    for (int first = 0; first < count; first += RT_KDTREE_PACKET_SIZE) {
+        const int numRays = std::min(count - first, RT_KDTREE_PACKET_SIZE);
+
+        // Gather the rays of this packet in SoA form. Unused lanes repeat the first ray
+        // and are masked out.
+        float rayStart[3][RT_KDTREE_PACKET_SIZE];
+        float rayDir[3][RT_KDTREE_PACKET_SIZE];
+        float rayLength[RT_KDTREE_PACKET_SIZE];
+        float rayLengthRcp[RT_KDTREE_PACKET_SIZE];
+        int dirSigns[3] = {0, 0, 0};
+        for (int lane = 0; lane < RT_KDTREE_PACKET_SIZE; lane++) {
+            const int ray = first + std::min(lane, numRays - 1);
+            const Vector3f rayDelta = ends[ray] - starts[ray];
+            const float lengthSqr = rayDelta.LengthSq();
+            rayLengthRcp[lane] = OVR::RcpSqrt(lengthSqr);
+            rayLength[lane] = lengthSqr * rayLengthRcp[lane];
+            for (int axis = 0; axis < 3; axis++) {
+                rayStart[axis][lane] = starts[ray][axis];
+                rayDir[axis][lane] = rayDelta[axis] * rayLengthRcp[lane];
+                // Same threshold as SafeRcp, so near zero directions traverse as positive.
+                dirSigns[axis] |=
+                    (rayDir[axis][lane] < -MATH_FLOAT_SMALLEST_NON_DENORMAL) ? 2 : 1;
+            }
+        }
+
+        // The kd-tree traversal order requires all rays to have the same direction signs.
+        if (dirSigns[0] == 3 || dirSigns[1] == 3 || dirSigns[2] == 3) {
+            for (int lane = 0; lane < numRays; lane++) {
+                results[first + lane] = Trace(starts[first + lane], ends[first + lane]);
+            }
+            continue;
+        }
+
+        const simd4f_t startX = Simd4f_Load(rayStart[0]);
+        const simd4f_t startY = Simd4f_Load(rayStart[1]);
+        const simd4f_t startZ = Simd4f_Load(rayStart[2]);
+        const simd4f_t dirX = Simd4f_Load(rayDir[0]);
+        const simd4f_t dirY = Simd4f_Load(rayDir[1]);
+        const simd4f_t dirZ = Simd4f_Load(rayDir[2]);
+        const simd4f_t starts4[3] = {startX, startY, startZ};
+        const simd4f_t rcpDirs4[3] = {SafeRcp(dirX), SafeRcp(dirY), SafeRcp(dirZ)};
+
+        const int activeLanes = (1 << numRays) - 1;
+
+        // Clip the rays against the model bounds.
+        simd4f_t tmin = Simd4f_Set1(0.0f);
+        simd4f_t tmax = Simd4f_Load(rayLength);
+        for (int axis = 0; axis < 3; axis++) {
+            const simd4f_t s = Simd4f_Mul(
+                Simd4f_Sub(Simd4f_Set1(header.bounds.GetMins()[axis]), starts4[axis]),
+                rcpDirs4[axis]);
+            const simd4f_t t = Simd4f_Mul(
+                Simd4f_Sub(Simd4f_Set1(header.bounds.GetMaxs()[axis]), starts4[axis]),
+                rcpDirs4[axis]);
+            tmin = Simd4f_Max(tmin, Simd4f_Min(s, t));
+            tmax = Simd4f_Min(tmax, Simd4f_Max(s, t));
+        }
+
+        simd4f_t bestDistance = Simd4f_Load(rayLength);
+        simd4f_t bestU = Simd4f_Set1(0.0f);
+        simd4f_t bestV = Simd4f_Set1(0.0f);
+        int bestTriangle[RT_KDTREE_PACKET_SIZE] = {-1, -1, -1, -1};
+        int finishedLanes = 0;
+
+        kdtreePacketStackEntry_t stack[RT_KDTREE_PACKET_STACK_SIZE];
+        int stackDepth = 0;
+        int nodeIndex = 0;
+        bool stackOverflow = false;
+
+        for (;;) {
+            int lanes = activeLanes & ~finishedLanes & Simd4f_MoveMask(Simd4f_CmpLE(tmin, tmax));
+            if (lanes != 0) {
+                // Step down the tree until a leaf node is found.
+                while ((nodes[nodeIndex].data & 1) == 0) {
+                    const kdtree_node_t& node = nodes[nodeIndex];
+                    const int nodePlane = ((node.data >> 1) & 3);
+                    const int childIndex = node.data >> 3;
+                    const int nearChild = childIndex + (dirSigns[nodePlane] == 2 ? 1 : 0);
+                    const int farChild = childIndex + (dirSigns[nodePlane] == 2 ? 0 : 1);
+
+                    const simd4f_t tsplit = Simd4f_Mul(
+                        Simd4f_Sub(Simd4f_Set1(node.dist), starts4[nodePlane]),
+                        rcpDirs4[nodePlane]);
+                    const int nearLanes = lanes & Simd4f_MoveMask(Simd4f_CmpLE(tmin, tsplit));
+                    const int farLanes = lanes & Simd4f_MoveMask(Simd4f_CmpGE(tmax, tsplit));
+
+                    if (farLanes == 0) {
+                        nodeIndex = nearChild;
+                    } else if (nearLanes == 0) {
+                        nodeIndex = farChild;
+                    } else {
+                        if (stackDepth >= RT_KDTREE_PACKET_STACK_SIZE) {
+                            stackOverflow = true;
+                            break;
+                        }
+                        stack[stackDepth].nodeIndex = farChild;
+                        stack[stackDepth].tmin = Simd4f_Max(tmin, tsplit);
+                        stack[stackDepth].tmax = tmax;
+                        stackDepth++;
+                        nodeIndex = nearChild;
+                        tmax = Simd4f_Min(tmax, tsplit);
+                        lanes = nearLanes;
+                    }
+                }
+                if (stackOverflow) {
+                    break;
+                }
+
+                // Check for intersections of all rays with the triangles in this leaf.
+                const kdtree_leaf_t& leaf = leafs[nodes[nodeIndex].data >> 3];
+                const int* leafTriangles = leaf.triangles;
+                int leafTriangleCount = RT_KDTREE_MAX_LEAF_TRIANGLES;
+                for (int j = 0; j < leafTriangleCount; j++) {
+                    int currentTriangle = leafTriangles[j];
+                    if (currentTriangle < 0) {
+                        if (currentTriangle == -1) {
+                            break;
+                        }
+
+                        const int offset = (currentTriangle & 0x7FFFFFFF);
+                        leafTriangles = &overflow[offset];
+                        leafTriangleCount = header.numOverflow - offset;
+                        j = 0;
+                        currentTriangle = leafTriangles[0];
+                    }
+
+                    const Vector3f& v0 = vertices[indices[currentTriangle * 3 + 0]];
+                    const Vector3f edge1 = vertices[indices[currentTriangle * 3 + 1]] - v0;
+                    const Vector3f edge2 = vertices[indices[currentTriangle * 3 + 2]] - v0;
+
+                    const simd4f_t e1X = Simd4f_Set1(edge1.x);
+                    const simd4f_t e1Y = Simd4f_Set1(edge1.y);
+                    const simd4f_t e1Z = Simd4f_Set1(edge1.z);
+                    const simd4f_t e2X = Simd4f_Set1(edge2.x);
+                    const simd4f_t e2Y = Simd4f_Set1(edge2.y);
+                    const simd4f_t e2Z = Simd4f_Set1(edge2.z);
+
+                    const simd4f_t tvX = Simd4f_Sub(startX, Simd4f_Set1(v0.x));
+                    const simd4f_t tvY = Simd4f_Sub(startY, Simd4f_Set1(v0.y));
+                    const simd4f_t tvZ = Simd4f_Sub(startZ, Simd4f_Set1(v0.z));
+
+                    // pv = rayDir x edge2
+                    const simd4f_t pvX = Simd4f_Sub(Simd4f_Mul(dirY, e2Z), Simd4f_Mul(dirZ, e2Y));
+                    const simd4f_t pvY = Simd4f_Sub(Simd4f_Mul(dirZ, e2X), Simd4f_Mul(dirX, e2Z));
+                    const simd4f_t pvZ = Simd4f_Sub(Simd4f_Mul(dirX, e2Y), Simd4f_Mul(dirY, e2X));
+                    // qv = tv x edge1
+                    const simd4f_t qvX = Simd4f_Sub(Simd4f_Mul(tvY, e1Z), Simd4f_Mul(tvZ, e1Y));
+                    const simd4f_t qvY = Simd4f_Sub(Simd4f_Mul(tvZ, e1X), Simd4f_Mul(tvX, e1Z));
+                    const simd4f_t qvZ = Simd4f_Sub(Simd4f_Mul(tvX, e1Y), Simd4f_Mul(tvY, e1X));
+
+                    const simd4f_t det = Simd4f_Add(
+                        Simd4f_Add(Simd4f_Mul(e1X, pvX), Simd4f_Mul(e1Y, pvY)),
+                        Simd4f_Mul(e1Z, pvZ));
+                    const simd4f_t s = Simd4f_Add(
+                        Simd4f_Add(Simd4f_Mul(tvX, pvX), Simd4f_Mul(tvY, pvY)),
+                        Simd4f_Mul(tvZ, pvZ));
+                    const simd4f_t t = Simd4f_Add(
+                        Simd4f_Add(Simd4f_Mul(dirX, qvX), Simd4f_Mul(dirY, qvY)),
+                        Simd4f_Mul(dirZ, qvZ));
+
+                    // Triangles are back-face culled, same as Intersect_RayTriangle.
+                    const simd4f_t zero = Simd4f_Set1(0.0f);
+                    simd4f_t hit =
+                        Simd4f_CmpGT(det, Simd4f_Set1(MATH_FLOAT_SMALLEST_NON_DENORMAL));
+                    hit = Simd4f_And(hit, Simd4f_CmpGE(s, zero));
+                    hit = Simd4f_And(hit, Simd4f_CmpLE(s, det));
+                    hit = Simd4f_And(hit, Simd4f_CmpGE(t, zero));
+                    hit = Simd4f_And(hit, Simd4f_CmpLE(Simd4f_Add(s, t), det));
+                    if (Simd4f_MoveMask(hit) == 0) {
+                        continue;
+                    }
+
+                    const simd4f_t rcpDet =
+                        Simd4f_Div(Simd4f_Set1(1.0f), Simd4f_Select(hit, det, Simd4f_Set1(1.0f)));
+                    const simd4f_t distance = Simd4f_Mul(
+                        Simd4f_Add(
+                            Simd4f_Add(Simd4f_Mul(e2X, qvX), Simd4f_Mul(e2Y, qvY)),
+                            Simd4f_Mul(e2Z, qvZ)),
+                        rcpDet);
+                    hit = Simd4f_And(hit, Simd4f_CmpGE(distance, zero));
+                    hit = Simd4f_And(hit, Simd4f_CmpLT(distance, bestDistance));
+
+                    const int hitLanes = lanes & Simd4f_MoveMask(hit);
+                    if (hitLanes == 0) {
+                        continue;
+                    }
+                    const simd4f_t laneHit = LaneMask(hitLanes);
+                    bestDistance = Simd4f_Select(laneHit, distance, bestDistance);
+                    bestU = Simd4f_Select(laneHit, Simd4f_Mul(s, rcpDet), bestU);
+                    bestV = Simd4f_Select(laneHit, Simd4f_Mul(t, rcpDet), bestV);
+                    for (int lane = 0; lane < RT_KDTREE_PACKET_SIZE; lane++) {
+                        if ((hitLanes >> lane) & 1) {
+                            bestTriangle[lane] = currentTriangle;
+                        }
+                    }
+                }
+
+                // Rays that hit something inside this cell cannot hit anything closer later.
+                finishedLanes |= lanes & Simd4f_MoveMask(Simd4f_CmpLE(bestDistance, tmax));
+                if ((activeLanes & ~finishedLanes) == 0) {
+                    break;
+                }
+            }
+
+            if (stackDepth == 0) {
+                break;
+            }
+            stackDepth--;
+            nodeIndex = stack[stackDepth].nodeIndex;
+            tmin = stack[stackDepth].tmin;
+            tmax = Simd4f_Min(stack[stackDepth].tmax, bestDistance);
+        }
+
+        // A tree that is too deep for the packet stack, e.g. one loaded from a file, would drop
+        // the far subtrees, so trace the rays of this packet one at a time instead.
+        if (stackOverflow) {
+            for (int lane = 0; lane < numRays; lane++) {
+                results[first + lane] = Trace(starts[first + lane], ends[first + lane]);
+            }
+            continue;
+        }
+
+        float distances[RT_KDTREE_PACKET_SIZE];
+        float us[RT_KDTREE_PACKET_SIZE];
+        float vs[RT_KDTREE_PACKET_SIZE];
+        Simd4f_Store(distances, bestDistance);
+        Simd4f_Store(us, bestU);
+        Simd4f_Store(vs, bestV);
+        for (int lane = 0; lane < numRays; lane++) {
+            results[first + lane] = ResolveTraceResult(
+                *this,
+                bestTriangle[lane] == -1 ? -1 : bestTriangle[lane] * 3,
+                distances[lane],
+                rayLengthRcp[lane],
+                Vector2f(us[lane], vs[lane]));
+        }
+    }
+}
+
+/*
+
+    On building fast kd-Trees for Ray Tracing, and on doing that in O(N log N)
+    Ingo Wald, Vlastimil Havran
+    IEEE Symposium on Interactive Ray Tracing, 2006
+
+    The split planes are chosen with a binned surface area heuristic over the
+    triangle bounds clipped to the node cell. Subtrees are built in parallel
+    and then flattened into the kd-tree layout used by Trace(), after which the
+    ropes are linked from the cell bounds of every leaf.
+
+*/
+
+const int RT_KDTREE_BUILD_BINS = 32;
+const int RT_KDTREE_BUILD_MAX_DEPTH = 48;
+const float RT_KDTREE_BUILD_TRAVERSAL_COST = 1.0f;
+const float RT_KDTREE_BUILD_INTERSECT_COST = 1.5f;
+const float RT_KDTREE_BUILD_EMPTY_BONUS = 0.8f;
+
+struct kdtreeBuildNode_t {
+    kdtreeBuildNode_t() : plane(-1), dist(0.0f) {}
+
+    int plane; // -1 for a leaf
+    float dist;
+    std::unique_ptr<kdtreeBuildNode_t> children[2];
+    std::vector<int> triangles;
+};
+
+struct kdtreeBuildContext_t {
+    const std::vector<Bounds3f>* triangleBounds;
+    int maxDepth;
+};
+
+static float HalfSurfaceArea(const Bounds3f& bounds) {
+    const Vector3f size = bounds.GetSize();
+    return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+static Bounds3f ClipBounds(const Bounds3f& bounds, const Bounds3f& cell) {
+    Bounds3f clipped;
+    for (int i = 0; i < 3; i++) {
+        clipped.b[0][i] = std::max(bounds.b[0][i], cell.b[0][i]);
+        clipped.b[1][i] = std::min(bounds.b[1][i], cell.b[1][i]);
+    }
+    return clipped;
+}
+
+static void BuildKdTreeNode(
+    const kdtreeBuildContext_t& context,
+    kdtreeBuildNode_t* node,
+    std::vector<int>& triangles,
+    const Bounds3f& cell,
+    const int depth,
+    const int threadDepth) {
+    const int numTriangles = static_cast<int>(triangles.size());
+    const float cellArea = HalfSurfaceArea(cell);
+    const float leafCost = RT_KDTREE_BUILD_INTERSECT_COST * numTriangles;
+
+    float bestCost = leafCost;
+    int bestPlane = -1;
+    float bestDist = 0.0f;
+
+    if (numTriangles > RT_KDTREE_MAX_LEAF_TRIANGLES && depth < context.maxDepth &&
+        cellArea > 0.0f) {
+        const float rcpCellArea = 1.0f / cellArea;
+        for (int plane = 0; plane < 3; plane++) {
+            const float cellMin = cell.b[0][plane];
+            const float cellMax = cell.b[1][plane];
+            const float extent = cellMax - cellMin;
+            if (extent <= MATH_FLOAT_SMALLEST_NON_DENORMAL) {
+                continue;
+            }
+
+            // Count the triangles that start and end in each bin.
+            int minBins[RT_KDTREE_BUILD_BINS] = {};
+            int maxBins[RT_KDTREE_BUILD_BINS] = {};
+            const float binScale = RT_KDTREE_BUILD_BINS / extent;
+            for (int i = 0; i < numTriangles; i++) {
+                const Bounds3f bounds =
+                    ClipBounds((*context.triangleBounds)[triangles[i]], cell);
+                const int minBin = std::min(
+                    std::max(static_cast<int>((bounds.b[0][plane] - cellMin) * binScale), 0),
+                    RT_KDTREE_BUILD_BINS - 1);
+                const int maxBin = std::min(
+                    std::max(static_cast<int>((bounds.b[1][plane] - cellMin) * binScale), 0),
+                    RT_KDTREE_BUILD_BINS - 1);
+                minBins[minBin]++;
+                maxBins[maxBin]++;
+            }
+
+            // Sweep the bin boundaries and evaluate the cost of splitting at each one.
+            int numLeft = 0;
+            int numRight = numTriangles;
+            for (int bin = 1; bin < RT_KDTREE_BUILD_BINS; bin++) {
+                numLeft += minBins[bin - 1];
+                numRight -= maxBins[bin - 1];
+
+                const float dist = cellMin + bin * (extent / RT_KDTREE_BUILD_BINS);
+                Bounds3f leftCell = cell;
+                Bounds3f rightCell = cell;
+                leftCell.b[1][plane] = dist;
+                rightCell.b[0][plane] = dist;
+
+                const float bonus =
+                    (numLeft == 0 || numRight == 0) ? RT_KDTREE_BUILD_EMPTY_BONUS : 1.0f;
+                const float cost = RT_KDTREE_BUILD_TRAVERSAL_COST +
+                    bonus * RT_KDTREE_BUILD_INTERSECT_COST * rcpCellArea *
+                        (HalfSurfaceArea(leftCell) * numLeft +
+                         HalfSurfaceArea(rightCell) * numRight);
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestPlane = plane;
+                    bestDist = dist;
+                }
+            }
+        }
+    }
+
+    if (bestPlane == -1) {
+        node->triangles.swap(triangles);
+        return;
+    }
+
+    // Triangles that straddle or lie in the split plane are referenced by both children.
+    std::vector<int> childTriangles[2];
+    for (int i = 0; i < numTriangles; i++) {
+        const Bounds3f bounds = ClipBounds((*context.triangleBounds)[triangles[i]], cell);
+        if (bounds.b[0][bestPlane] <= bestDist) {
+            childTriangles[0].push_back(triangles[i]);
+        }
+        if (bounds.b[1][bestPlane] >= bestDist) {
+            childTriangles[1].push_back(triangles[i]);
+        }
+    }
+    std::vector<int>().swap(triangles);
+
+    node->plane = bestPlane;
+    node->dist = bestDist;
+    node->children[0].reset(new kdtreeBuildNode_t());
+    node->children[1].reset(new kdtreeBuildNode_t());
+
+    Bounds3f childCells[2] = {cell, cell};
+    childCells[0].b[1][bestPlane] = bestDist;
+    childCells[1].b[0][bestPlane] = bestDist;
+
+    if (threadDepth > 0) {
+        std::thread leftThread(
+            BuildKdTreeNode,
+            std::cref(context),
+            node->children[0].get(),
+            std::ref(childTriangles[0]),
+            std::cref(childCells[0]),
+            depth + 1,
+            threadDepth - 1);
+        BuildKdTreeNode(
+            context,
+            node->children[1].get(),
+            childTriangles[1],
+            childCells[1],
+            depth + 1,
+            threadDepth - 1);
+        leftThread.join();
+    } else {
+        for (int child = 0; child < 2; child++) {
+            BuildKdTreeNode(
+                context,
+                node->children[child].get(),
+                childTriangles[child],
+                childCells[child],
+                depth + 1,
+                0);
+        }
+    }
+}
+
+static void
+FlattenKdTreeNode(ModelTrace& trace, const kdtreeBuildNode_t* node, const int nodeIndex) {
+    if (node->plane == -1) {
+        const int leafIndex = static_cast<int>(trace.leafs.size());
+        trace.nodes[nodeIndex].data = (static_cast<unsigned int>(leafIndex) << 3) | 1;
+        trace.nodes[nodeIndex].dist = 0.0f;
+
+        kdtree_leaf_t leaf;
+        for (int i = 0; i < RT_KDTREE_MAX_LEAF_TRIANGLES; i++) {
+            leaf.triangles[i] = -1;
+        }
+        for (int i = 0; i < 6; i++) {
+            leaf.ropes[i] = -1;
+        }
+        leaf.bounds = Bounds3f(Vector3f(0.0f), Vector3f(0.0f));
+
+        const int numTriangles = static_cast<int>(node->triangles.size());
+        if (numTriangles <= RT_KDTREE_MAX_LEAF_TRIANGLES) {
+            for (int i = 0; i < numTriangles; i++) {
+                leaf.triangles[i] = node->triangles[i];
+            }
         } else {
-            result.uv = uvs[indices[result.triangleIndex + 0]] * (1.0f - uv.x - uv.y) +
-                uvs[indices[result.triangleIndex + 1]] * uv.x +
-                uvs[indices[result.triangleIndex + 2]] * uv.y;
+            // Store as many triangles in the leaf as possible and continue the list
+            // in the overflow, terminated with -1.
+            const int numInLeaf = RT_KDTREE_MAX_LEAF_TRIANGLES - 1;
+            for (int i = 0; i < numInLeaf; i++) {
+                leaf.triangles[i] = node->triangles[i];
+            }
+            leaf.triangles[numInLeaf] =
+                static_cast<int>(0x80000000u | static_cast<unsigned int>(trace.overflow.size()));
+            trace.overflow.insert(
+                trace.overflow.end(), node->triangles.begin() + numInLeaf, node->triangles.end());
+            trace.overflow.push_back(-1);
         }
-        const Vector3f d1 = vertices[indices[result.triangleIndex + 1]] -
-            vertices[indices[result.triangleIndex + 0]];
-        const Vector3f d2 = vertices[indices[result.triangleIndex + 2]] -
-            vertices[indices[result.triangleIndex + 0]];
-        result.normal = d1.Cross(d2).Normalized();
+        trace.leafs.push_back(leaf);
+        return;
     }
 
-    return result;
+    const int childIndex = static_cast<int>(trace.nodes.size());
+    trace.nodes.resize(childIndex + 2);
+    trace.nodes[nodeIndex].data = (static_cast<unsigned int>(childIndex) << 3) |
+        (static_cast<unsigned int>(node->plane) << 1);
+    trace.nodes[nodeIndex].dist = node->dist;
+
+    FlattenKdTreeNode(trace, node->children[0].get(), childIndex + 0);
+    FlattenKdTreeNode(trace, node->children[1].get(), childIndex + 1);
+}
+
+static void LinkKdTreeRopes(
+    ModelTrace& trace,
+    const int nodeIndex,
+    const Bounds3f& cell,
+    const int (&ropes)[6]) {
+    const kdtree_node_t& node = trace.nodes[nodeIndex];
+    if ((node.data & 1) != 0) {
+        kdtree_leaf_t& leaf = trace.leafs[node.data >> 3];
+        leaf.bounds = cell;
+
+        // Push each rope down to the deepest node that still covers the whole face of the leaf.
+        for (int face = 0; face < 6; face++) {
+            const int facePlane = face >> 1;
+            const int faceSide = face & 1;
+            int rope = ropes[face];
+            while (rope != -1 && (trace.nodes[rope].data & 1) == 0) {
+                const kdtree_node_t& ropeNode = trace.nodes[rope];
+                const int ropePlane = (ropeNode.data >> 1) & 3;
+                const int ropeChild = ropeNode.data >> 3;
+                if (ropePlane == facePlane) {
+                    rope = ropeChild + (faceSide ^ 1);
+                } else if (ropeNode.dist <= cell.b[0][ropePlane]) {
+                    rope = ropeChild + 1;
+                } else if (ropeNode.dist >= cell.b[1][ropePlane]) {
+                    rope = ropeChild + 0;
+                } else {
+                    break;
+                }
+            }
+            leaf.ropes[face] = rope;
+        }
+        return;
+    }
+
+    const int plane = (node.data >> 1) & 3;
+    const int childIndex = node.data >> 3;
+
+    Bounds3f leftCell = cell;
+    Bounds3f rightCell = cell;
+    leftCell.b[1][plane] = node.dist;
+    rightCell.b[0][plane] = node.dist;
+
+    int leftRopes[6];
+    int rightRopes[6];
+    for (int i = 0; i < 6; i++) {
+        leftRopes[i] = ropes[i];
+        rightRopes[i] = ropes[i];
+    }
+    leftRopes[(plane << 1) | 1] = childIndex + 1;
+    rightRopes[(plane << 1) | 0] = childIndex + 0;
+
+    LinkKdTreeRopes(trace, childIndex + 0, leftCell, leftRopes);
+    LinkKdTreeRopes(trace, childIndex + 1, rightCell, rightRopes);
+}
+
+bool ModelTrace::Build(
+    const std::vector<Vector3f>& inVertices,
+    const std::vector<Vector2f>& inUvs,
+    const std::vector<int>& inIndices,
+    const int numThreads) {
+    if (!inUvs.empty() && inUvs.size() != inVertices.size()) {
+        ALOG("ModelTrace::Build - model must have no uvs, or the same number of uvs as vertices");
+        return false;
+    }
+    if (inIndices.size() % 3 != 0) {
+        ALOG("ModelTrace::Build - Orphaned indices");
+        return false;
+    }
+    for (int i = 0; i < static_cast<int>(inIndices.size()); i++) {
+        if (inIndices[i] < 0 || inIndices[i] >= static_cast<int>(inVertices.size())) {
+            ALOG("ModelTrace::Build - index %i value %i is out of range", i, inIndices[i]);
+            return false;
+        }
+    }
+
+    vertices = inVertices;
+    uvs = inUvs;
+    indices = inIndices;
+    nodes.clear();
+    leafs.clear();
+    overflow.clear();
+
+    const int numTriangles = static_cast<int>(indices.size()) / 3;
+
+    std::vector<Bounds3f> triangleBounds(numTriangles);
+    std::vector<int> triangles(numTriangles);
+    Bounds3f bounds(Bounds3f::Init);
+    for (int i = 0; i < numTriangles; i++) {
+        Bounds3f& triBounds = triangleBounds[i];
+        triBounds.Clear();
+        triBounds.AddPoint(vertices[indices[i * 3 + 0]]);
+        triBounds.AddPoint(vertices[indices[i * 3 + 1]]);
+        triBounds.AddPoint(vertices[indices[i * 3 + 2]]);
+        bounds = Bounds3f::Union(bounds, triBounds);
+        triangles[i] = i;
+    }
+    if (numTriangles == 0) {
+        bounds = Bounds3f(Vector3f(0.0f), Vector3f(0.0f));
+    } else {
+        // Pad the bounds so the cells of axis-aligned flat meshes have some thickness.
+        float extent = 1.0f;
+        for (int i = 0; i < 3; i++) {
+            extent = std::max(extent, std::max(fabsf(bounds.b[0][i]), fabsf(bounds.b[1][i])));
+        }
+        const Vector3f pad(extent * 1e-5f);
+        bounds = Bounds3f::Expand(bounds, -pad, pad);
+    }
+
+    // Spawn a thread at each of the top levels of the tree until all threads are busy.
+    const int maxThreads = (numThreads > 0)
+        ? numThreads
+        : std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+    int threadDepth = 0;
+    while ((1 << threadDepth) < maxThreads) {
+        threadDepth++;
+    }
+
+    kdtreeBuildContext_t context;
+    context.triangleBounds = &triangleBounds;
+    context.maxDepth = std::min(
+        RT_KDTREE_BUILD_MAX_DEPTH,
+        8 + static_cast<int>(1.3f * log2f(static_cast<float>(std::max(numTriangles, 1)))));
+
+    kdtreeBuildNode_t root;
+    BuildKdTreeNode(context, &root, triangles, bounds, 0, threadDepth);
+
+    nodes.resize(1);
+    FlattenKdTreeNode(*this, &root, 0);
+
+    const int noRopes[6] = {-1, -1, -1, -1, -1, -1};
+    LinkKdTreeRopes(*this, 0, bounds, noRopes);
+
+    header.numVertices = static_cast<int>(vertices.size());
+    header.numUvs = static_cast<int>(uvs.size());
+    header.numIndices = static_cast<int>(indices.size());
+    header.numNodes = static_cast<int>(nodes.size());
+    header.numLeafs = static_cast<int>(leafs.size());
+    header.numOverflow = static_cast<int>(overflow.size());
+    header.bounds = bounds;
+
+    return Validate(true);
 }
 
 void ModelTrace::PrintStatsToLog() const {
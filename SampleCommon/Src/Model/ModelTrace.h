@@ -18,6 +18,7 @@ Authors     :   J.M.P. van Waveren
 namespace OVRFW {
 
 const int RT_KDTREE_MAX_LEAF_TRIANGLES = 4;
+const int RT_KDTREE_PACKET_SIZE = 4;
 
 struct kdtree_header_t {
     int numVertices;
@@ -57,9 +58,27 @@ class ModelTrace {
 
     bool Validate(const bool fullVerify) const;
 
+    // Builds the kd-tree nodes, leafs, ropes and overflow list for an indexed triangle list
+    // using the surface area heuristic. The uvs must either be empty or match the vertices.
+    // Subtrees are built on up to 'numThreads' threads, 0 uses the hardware concurrency.
+    bool Build(
+        const std::vector<OVR::Vector3f>& inVertices,
+        const std::vector<OVR::Vector2f>& inUvs,
+        const std::vector<int>& inIndices,
+        const int numThreads = 0);
+
     traceResult_t Trace(const OVR::Vector3f& start, const OVR::Vector3f& end) const;
     traceResult_t Trace_Exhaustive(const OVR::Vector3f& start, const OVR::Vector3f& end) const;
 
+    // Traces 'count' rays from starts[i] to ends[i] and stores the results in results[i].
+    // Rays are traversed in packets of RT_KDTREE_PACKET_SIZE with SIMD, which is fastest when
+    // consecutive rays are coherent. Packets with diverging directions fall back to Trace().
+    void TraceBatch(
+        const OVR::Vector3f* starts,
+        const OVR::Vector3f* ends,
+        traceResult_t* results,
+        const int count) const;
+
     void PrintStatsToLog() const;
 
    public:
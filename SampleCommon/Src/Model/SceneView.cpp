@@ -385,9 +385,7 @@ void ModelInScene::AnimateJoints(const double timeInSeconds) {
                 ApplyAnimation(State, i);
             }
 
-            for (int i = 0; i < static_cast<int>(State.nodeStates.size()); i++) {
-                State.nodeStates[i].RecalculateMatrix();
-            }
+            State.UpdateTransforms();
         }
     }
 }
@@ -787,6 +785,24 @@ void OvrSceneView::GetFrameMatrices(
     frameMatrices.EyeProjection[1] = GetEyeProjectionMatrix(1, fovDegreesX, fovDegreesY);
 }
 
+// Adds the node and its children to the emit list, skipping any subtree whose bounds are culled.
+// The surfaces of the nodes that are added are still culled individually.
+static void AddVisibleNodesToEmitList(
+    ModelNodeState& nodeState,
+    const Matrix4f& cullMatrix,
+    std::vector<ModelNodeState*>& emitNodes) {
+    if (nodeState.IsSubtreeCullable() &&
+        IsBoundsCulled(nodeState.GetSubtreeBounds(), cullMatrix)) {
+        return;
+    }
+    emitNodes.push_back(&nodeState);
+    const ModelNode* node = nodeState.GetNode();
+    for (int i = 0; i < static_cast<int>(node->children.size()); i++) {
+        AddVisibleNodesToEmitList(
+            nodeState.state->nodeStates[node->children[i]], cullMatrix, emitNodes);
+    }
+}
+
 void OvrSceneView::GenerateFrameSurfaceList(
     const FrameMatrices& frameMatrices,
     std::vector<ovrDrawSurface>& surfaceList) const {
@@ -800,6 +816,8 @@ void OvrSceneView::GenerateFrameSurfaceList(
     Matrix4f centerEyeCullViewMatrix =
         Matrix4f::Translation(0, 0, -moveBackDistance) * frameMatrices.CenterView;
 
+    const Matrix4f cullMatrix = symmetricEyeProjectionMatrix * centerEyeCullViewMatrix;
+
     std::vector<ModelNodeState*> emitNodes;
     for (int i = 0; i < static_cast<int>(Models.size()); i++) {
         if (Models[i] != NULL) {
@@ -811,7 +829,9 @@ void OvrSceneView::GenerateFrameSurfaceList(
                 ModelSubSceneState& subSceneState = state.subSceneStates[j];
                 if (subSceneState.visible) {
                     for (int k = 0; k < static_cast<int>(subSceneState.nodeStates.size()); k++) {
-                        state.nodeStates[subSceneState.nodeStates[k]].AddNodesToEmitList(emitNodes);
+                        ModelNodeState& nodeState = state.nodeStates[subSceneState.nodeStates[k]];
+                        nodeState.UpdateBounds();
+                        AddVisibleNodesToEmitList(nodeState, cullMatrix, emitNodes);
                     }
                 }
             }
@@ -1042,7 +1062,8 @@ void OvrSceneView::Frame(
                 orientationVector,
                 moveDistance,
                 WorldModel.Definition->Collisions,
-                WorldModel.Definition->GroundCollisions);
+                WorldModel.Definition->GroundCollisions,
+                CollisionScratch);
         } else { // no scene loaded, walk without any collisions
             ModelCollision collisionModel;
             ModelCollision groundCollisionModel;
@@ -234,6 +234,9 @@ class OvrSceneView {
     // Modified by joypad movement and collision detection
     OVR::Vector3f FootPos;
 
+    // Candidate polytopes of the collision queries, reused between frames
+    std::vector<int> CollisionScratch;
+
     // Calculated in Frame()
     OVR::Matrix4f CenterEyeTransform;
     OVR::Matrix4f CenterEyeViewMatrix;
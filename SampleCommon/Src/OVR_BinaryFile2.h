@@ -15,7 +15,8 @@ Authors     :   J.M.P. van Waveren
 #include <vector>
 
 /*
-    This is a simple helper class to read binary data next to a JSON file.
+    This is a simple helper class to read binary data next to a JSON file,
+    or data written with BinaryWriter.
 */
 
 namespace OVRFW {
@@ -38,9 +39,20 @@ class BinaryReader {
     }
 
     template <typename _type_>
-    bool ReadArray(std::vector<_type_>& out, const int numElements) const {
-        const int bytes = numElements * sizeof(out[0]);
+    bool Read(_type_& out) const {
+        const int bytes = sizeof(out);
         if (Data == NULL || bytes > Size - Offset) {
+            return false;
+        }
+        memcpy(&out, &Data[Offset], bytes);
+        Offset += bytes;
+        return true;
+    }
+
+    template <typename _type_>
+    bool ReadArray(std::vector<_type_>& out, const int numElements) const {
+        const int64_t bytes = static_cast<int64_t>(numElements) * sizeof(out[0]);
+        if (Data == NULL || numElements < 0 || bytes > Size - Offset) {
             out.resize(0);
             return false;
         }
@@ -61,6 +73,36 @@ class BinaryReader {
     bool Allocated;
 };
 
+class BinaryWriter {
+   public:
+    void WriteUInt32(const uint32_t value) {
+        Write(&value, sizeof(value));
+    }
+
+    template <typename _type_>
+    void Write(const _type_& value) {
+        Write(&value, sizeof(value));
+    }
+
+    // Writes the elements only, the count has to be written separately.
+    template <typename _type_>
+    void WriteArray(const std::vector<_type_>& in) {
+        Write(in.data(), in.size() * sizeof(_type_));
+    }
+
+    const std::vector<uint8_t>& GetData() const {
+        return Data;
+    }
+
+   private:
+    void Write(const void* data, const size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        Data.insert(Data.end(), bytes, bytes + size);
+    }
+
+    std::vector<uint8_t> Data;
+};
+
 std::vector<uint8_t> MemBufferFile(const char* fileName);
 
 } // namespace OVRFW
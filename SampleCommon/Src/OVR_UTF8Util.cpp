@@ -31,6 +31,13 @@ Notes       :   Much useful info at "UTF-8 and Unicode FAQ"
 
 #include "OVR_UTF8Util.h"
 #include <assert.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 namespace OVRFW {
 namespace UTF8Util {
@@ -315,6 +322,113 @@ size_t DecodeString(wchar_t* pbuff, const char* putf8str, intptr_t bytesLen) {
     return pbuff - pbegin;
 }
 
+// Returns true and widens the 16 bytes at p to 16 characters if they are all 7-bit ASCII.
+static inline bool DecodeAscii16(const char* p, uint32_t* out) {
+#if defined(__SSE2__)
+    __m128i const bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    if (_mm_movemask_epi8(bytes) != 0) {
+        return false;
+    }
+    __m128i const zero = _mm_setzero_si128();
+    __m128i const lo = _mm_unpacklo_epi8(bytes, zero);
+    __m128i const hi = _mm_unpackhi_epi8(bytes, zero);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 0), _mm_unpacklo_epi16(lo, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4), _mm_unpackhi_epi16(lo, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8), _mm_unpacklo_epi16(hi, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 12), _mm_unpackhi_epi16(hi, zero));
+    return true;
+#elif defined(__aarch64__)
+    uint8x16_t const bytes = vld1q_u8(reinterpret_cast<const uint8_t*>(p));
+    if (vmaxvq_u8(bytes) >= 0x80) {
+        return false;
+    }
+    uint16x8_t const lo = vmovl_u8(vget_low_u8(bytes));
+    uint16x8_t const hi = vmovl_high_u8(bytes);
+    vst1q_u32(out + 0, vmovl_u16(vget_low_u16(lo)));
+    vst1q_u32(out + 4, vmovl_high_u16(lo));
+    vst1q_u32(out + 8, vmovl_u16(vget_low_u16(hi)));
+    vst1q_u32(out + 12, vmovl_high_u16(hi));
+    return true;
+#else
+    uint64_t words[2];
+    memcpy(words, p, sizeof(words));
+    if (((words[0] | words[1]) & 0x8080808080808080ULL) != 0) {
+        return false;
+    }
+    for (int i = 0; i < 16; ++i) {
+        out[i] = static_cast<uint8_t>(p[i]);
+    }
+    return true;
+#endif
+}
+
+void DecodeChars(
+    const char* putf8str,
+    std::vector<uint32_t>& chars,
+    std::vector<int32_t>* byteOffsets) {
+    // the string has at most as many characters as bytes, and knowing the length up front
+    // keeps the 16 byte loads inside it
+    intptr_t const length = strlen(putf8str);
+    chars.resize(length);
+    if (byteOffsets != nullptr) {
+        byteOffsets->resize(length);
+    }
+
+    uint32_t* out = chars.data();
+    int32_t* offsets = byteOffsets != nullptr ? byteOffsets->data() : nullptr;
+    intptr_t count = 0;
+    const char* p = putf8str;
+    const char* end = putf8str + length;
+    while (p < end) {
+        if (end - p >= 16 && DecodeAscii16(p, out + count)) {
+            if (offsets != nullptr) {
+                int32_t const first = static_cast<int32_t>(p - putf8str);
+                for (int i = 0; i < 16; ++i) {
+                    offsets[count + i] = first + i;
+                }
+            }
+            count += 16;
+            p += 16;
+            continue;
+        }
+
+        // decode the characters starting in the next 16 bytes one at a time
+        const char* const windowEnd = end - p > 16 ? p + 16 : end;
+        while (p < windowEnd) {
+            const char* const start = p;
+            uint32_t ch;
+            uint8_t const c0 = static_cast<uint8_t>(p[0]);
+            if (c0 < 0x80) {
+                ch = c0;
+                p++;
+            } else if (
+                (c0 & 0xE0) == 0xC0 && (p[1] & 0xC0) == 0x80 &&
+                (ch = ((c0 & 0x1Fu) << 6) | (p[1] & 0x3Fu)) >= 0x80) {
+                p += 2; // well-formed two-byte sequence
+            } else if (
+                (c0 & 0xF0) == 0xE0 && (p[1] & 0xC0) == 0x80 && (p[2] & 0xC0) == 0x80 &&
+                (ch = ((c0 & 0x0Fu) << 12) | ((p[1] & 0x3Fu) << 6) | (p[2] & 0x3Fu)) >= 0x800) {
+                p += 3; // well-formed three-byte sequence
+            } else {
+                ch = DecodeNextChar(&p);
+                if (ch == 0) {
+                    p = end; // truncated sequence at the end of the string
+                    break;
+                }
+            }
+            if (offsets != nullptr) {
+                offsets[count] = static_cast<int32_t>(start - putf8str);
+            }
+            out[count++] = ch;
+        }
+    }
+
+    chars.resize(count);
+    if (byteOffsets != nullptr) {
+        byteOffsets->resize(count);
+    }
+}
+
 #ifdef UTF8_UNIT_TEST
 
 // Compile this test case with something like:
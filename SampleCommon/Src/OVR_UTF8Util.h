@@ -27,7 +27,9 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <vector>
 
 namespace OVRFW {
 namespace UTF8Util {
@@ -61,6 +63,14 @@ void EncodeString(char* pbuff, const wchar_t* pchar, intptr_t length = -1);
 // Returns the length of resulting string (number of characters)
 size_t DecodeString(wchar_t* pbuff, const char* putf8str, intptr_t bytesLen = -1);
 
+// Decodes a null terminated UTF8 string into UCS characters, with the same results as calling
+// DecodeNextChar until it returns 0. If byteOffsets is not null, it receives the byte offset
+// each character starts at. Runs of 7-bit ASCII are converted 16 bytes at a time.
+void DecodeChars(
+    const char* putf8str,
+    std::vector<uint32_t>& chars,
+    std::vector<int32_t>* byteOffsets = nullptr);
+
 // *** Individual character Encoding/Decoding.
 
 // Determined the number of bytes necessary to encode a UCS character.
@@ -13,6 +13,7 @@ Authors     :   John Carmack
 
 #include "Misc/Log.h"
 #include "OVR_Std.h"
+#include "OVR_MappedFile.h"
 
 #include <unzip.h>
 
@@ -21,12 +22,21 @@ Authors     :   John Carmack
 #include <fcntl.h>
 
 #if !defined(OVR_OS_WIN32)
+#include <dirent.h>
+#include <sys/time.h>
 #include <unistd.h>
 #endif
 
+#include <algorithm>
+#include <ctime>
+
 #include <thread>
 #include <mutex>
+#include <shared_mutex>
 #include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
 
 namespace OVRFW {
 
@@ -43,12 +53,503 @@ OvrApkFile::~OvrApkFile() {
     ovr_CloseOtherApplicationPackage(ZipFile);
 }
 
+//==============================================================
+// ovrZipPackage
+// Index of the central directory of an open package, so files are found without scanning the
+// directory, and a pool of zip handles, so reads on different threads decompress in parallel.
+// The index is only written when the package is opened.
+//==============================================================
+class ovrZipPackage {
+   public:
+    struct ovrEntry {
+        unz_file_pos Pos;
+        unz_file_info Info;
+    };
+
+    explicit ovrZipPackage(const char* path) : Path(path), Mapping(nullptr), MappingLength(0) {}
+    ~ovrZipPackage() {
+        for (unzFile reader : Readers) {
+            unzClose(reader);
+        }
+    }
+
+    void BuildIndex(unzFile zipFile);
+    ovrEntry const* FindEntry(const char* nameInZip) const;
+
+    // Returns a zip handle that no other thread is using, or 0 if the package can't be opened.
+    unzFile AcquireReader();
+    void ReleaseReader(unzFile reader);
+
+    // Returns the whole package mapped read-only, or nullptr if it can't be mapped.
+    const uint8_t* GetMapping(size_t& length);
+    // Finds where the data of an entry starts in the package file.
+    bool GetDataOffset(ovrEntry const& entry, uint64_t& offset);
+
+   private:
+    std::string Path;
+    std::unordered_map<std::string, ovrEntry> Entries; // keyed by the lower case name
+    std::mutex ReaderMutex; // only held to take or return a handle
+    std::vector<unzFile> Readers; // idle handles
+
+    std::once_flag MapOnce;
+    MappedFile MapFile;
+    MappedView MapView;
+    const uint8_t* Mapping;
+    size_t MappingLength;
+};
+
+// unzLocateFile with case insensitive matching only folds ASCII letters
+static std::string ZipLookupName(const char* name) {
+    std::string lower(name);
+    for (char& c : lower) {
+        if (c >= 'A' && c <= 'Z') {
+            c += 'a' - 'A';
+        }
+    }
+    return lower;
+}
+
+void ovrZipPackage::BuildIndex(unzFile zipFile) {
+    unz_global_info globalInfo;
+    if (unzGetGlobalInfo(zipFile, &globalInfo) == UNZ_OK) {
+        Entries.reserve(globalInfo.number_entry);
+    }
+    for (int ret = unzGoToFirstFile(zipFile); ret == UNZ_OK; ret = unzGoToNextFile(zipFile)) {
+        char fileName[1024];
+        ovrEntry entry;
+        if (unzGetCurrentFileInfo(
+                zipFile, &entry.Info, fileName, sizeof(fileName), NULL, 0, NULL, 0) != UNZ_OK ||
+            unzGetFilePos(zipFile, &entry.Pos) != UNZ_OK) {
+            continue;
+        }
+        // like unzLocateFile, the first of several names that only differ in case wins
+        Entries.emplace(ZipLookupName(fileName), entry);
+    }
+}
+
+ovrZipPackage::ovrEntry const* ovrZipPackage::FindEntry(const char* nameInZip) const {
+    auto it = Entries.find(ZipLookupName(nameInZip));
+    return it != Entries.end() ? &it->second : nullptr;
+}
+
+unzFile ovrZipPackage::AcquireReader() {
+    {
+        std::lock_guard<std::mutex> lock(ReaderMutex);
+        if (!Readers.empty()) {
+            unzFile reader = Readers.back();
+            Readers.pop_back();
+            return reader;
+        }
+    }
+    return unzOpen(Path.c_str());
+}
+
+void ovrZipPackage::ReleaseReader(unzFile reader) {
+    if (reader == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(ReaderMutex);
+    Readers.push_back(reader);
+}
+
+const uint8_t* ovrZipPackage::GetMapping(size_t& length) {
+#if defined(OVR_OS_ANDROID)
+    std::call_once(MapOnce, [this]() {
+        // the mapping only reserves address space, pages are read in as they are touched
+        if (MapFile.OpenRead(Path.c_str()) && MapView.Open(&MapFile)) {
+            Mapping = MapView.MapView();
+            MappingLength = Mapping != nullptr ? MapFile.GetLength() : 0;
+        }
+        if (Mapping == nullptr) {
+            ALOGW("Failed to map package '%s', stored files will be copied", Path.c_str());
+        }
+    });
+#endif
+    length = MappingLength;
+    return Mapping;
+}
+
+bool ovrZipPackage::GetDataOffset(ovrEntry const& entry, uint64_t& offset) {
+    // the local header in front of the data can have a different extra field than the central
+    // directory, so let minizip read it
+    unzFile reader = AcquireReader();
+    unz_file_pos pos = entry.Pos;
+    bool const found = reader != 0 && unzGoToFilePos(reader, &pos) == UNZ_OK &&
+        unzOpenCurrentFile(reader) == UNZ_OK;
+    if (found) {
+        offset = unzGetCurrentFileZStreamPos64(reader);
+        unzCloseCurrentFile(reader);
+    }
+    ReleaseReader(reader);
+    return found;
+}
+
+#if !defined(OVR_OS_WIN32)
+
+//==============================================================
+// ovrCachedFile
+// Contents of a file in the package cache.
+//==============================================================
+struct ovrCachedFile {
+    ovrCachedFile() : Data(nullptr), Size(0), Crc(0) {}
+
+#if defined(OVR_OS_ANDROID)
+    MappedFile File;
+    MappedView View;
+#endif
+    std::vector<uint8_t> Buffer; // used where files can't be mapped
+    const uint8_t* Data;
+    size_t Size;
+    uint32_t Crc;
+};
+
+//==============================================================
+// ovrPackageCache
+// Decompressed package files on disk, named by the CRC and size of their contents, so they can
+// be shared between packages and launches. Data derived from files is stored the same way under
+// a key chosen by the caller. Each file starts with a header that carries the cache version, and
+// its data is checked against the CRC when it is read. The least recently used files are deleted
+// when the cache grows past its limit.
+//==============================================================
+class ovrPackageCache {
+   public:
+    static const uint32_t VERSION = 2;
+    static const size_t DEFAULT_MAX_SIZE = 256 * 1024 * 1024;
+    static const size_t MIN_FILE_SIZE = 64 * 1024; // smaller files inflate about as fast as a read
+
+    ovrPackageCache() : MaxSize(DEFAULT_MAX_SIZE), TotalSize(0) {}
+
+    // Uses a directory inside cachePath, and deletes files that the cache didn't name this way
+    // and what is over the size limit. The first time, also deletes the files that older
+    // versions extracted into cachePath itself.
+    void SetPath(const char* cachePath);
+    void SetMaxSize(size_t maxSize);
+
+    bool IsEnabled() const {
+        return !Dir.empty();
+    }
+    bool ShouldCache(size_t size) const {
+        return IsEnabled() && size >= MIN_FILE_SIZE;
+    }
+
+    // Returns nullptr if the file is not cached, or its cached copy is invalid.
+    std::shared_ptr<ovrCachedFile> Find(uint32_t crc, size_t size);
+    void Store(uint32_t crc, const void* data, size_t size);
+
+    // Same for derived data of any size.
+    std::shared_ptr<ovrCachedFile> FindData(uint64_t key);
+    void StoreData(uint64_t key, const void* data, size_t size);
+
+   private:
+    struct ovrHeader {
+        uint32_t Magic;
+        uint32_t Version;
+        uint32_t Crc;
+        uint32_t Pad;
+        uint64_t Size;
+        uint64_t Key; // 0 for package files
+    };
+    static const uint32_t MAGIC = 0x4352564f; // "OVRC"
+
+    struct ovrFile {
+        size_t Size; // on disk, including the header
+        time_t LastUse;
+    };
+
+    std::string FileName(uint32_t crc, size_t size) const;
+    std::string DataFileName(uint64_t key) const;
+    static bool IsCacheFileName(const char* name);
+    static bool IsOldCacheFileName(const char* name);
+    // size is SIZE_MAX when any size is fine
+    std::shared_ptr<ovrCachedFile> Load(std::string const& name, uint64_t key, size_t size);
+    void Save(std::string const& name, uint64_t key, uint32_t crc, const void* data, size_t size);
+    void Remove(std::string const& name);
+    void Trim(); // must hold Mutex
+
+    std::mutex Mutex; // guards Files and TotalSize
+    std::string Dir;
+    size_t MaxSize;
+    size_t TotalSize;
+    std::unordered_map<std::string, ovrFile> Files; // by file name
+};
+
+static ovrPackageCache PackageCache;
+
+std::string ovrPackageCache::FileName(uint32_t crc, size_t size) const {
+    char name[64];
+    snprintf(name, sizeof(name), "%08x_%zx.bin", (unsigned)crc, size);
+    return name;
+}
+
+std::string ovrPackageCache::DataFileName(uint64_t key) const {
+    char name[64];
+    snprintf(name, sizeof(name), "%016llx.dat", (unsigned long long)key);
+    return name;
+}
+
+static const char* SkipLowerHex(const char* p) {
+    while ((*p >= '0' && *p <= '9') || (*p >= 'a' && *p <= 'f')) {
+        p++;
+    }
+    return p;
+}
+
+// True for the names made by FileName and DataFileName. Anything else in the directory was left
+// behind by an older naming scheme or by a write that didn't finish.
+bool ovrPackageCache::IsCacheFileName(const char* name) {
+    const char* p = SkipLowerHex(name);
+    if (p - name == 8 && *p == '_') {
+        const char* size = p + 1;
+        p = SkipLowerHex(size);
+        return p > size && p - size <= 16 && strcmp(p, ".bin") == 0;
+    }
+    return p - name == 16 && strcmp(p, ".dat") == 0;
+}
+
+// Older versions extracted files straight into the cache path as <crc %08x>.bin, written
+// through <crc %08x>.tmp.
+bool ovrPackageCache::IsOldCacheFileName(const char* name) {
+    const char* p = SkipLowerHex(name);
+    return p - name == 8 && (strcmp(p, ".bin") == 0 || strcmp(p, ".tmp") == 0);
+}
+
+void ovrPackageCache::SetPath(const char* cachePath) {
+    std::lock_guard<std::mutex> lock(Mutex);
+    Files.clear();
+    TotalSize = 0;
+    Dir = std::string(cachePath) + "/ovr_package_cache";
+    if (mkdir(Dir.c_str(), S_IRWXU) == 0) {
+        // first launch with the cache directory, delete what older versions left in cachePath
+        if (DIR* oldDir = opendir(cachePath)) {
+            while (struct dirent* ent = readdir(oldDir)) {
+                if (IsOldCacheFileName(ent->d_name)) {
+                    unlink((std::string(cachePath) + "/" + ent->d_name).c_str());
+                }
+            }
+            closedir(oldDir);
+        }
+    } else if (errno != EEXIST) {
+        ALOG("Failed to create package cache '%s'", Dir.c_str());
+        Dir.clear();
+        return;
+    }
+
+    DIR* dir = opendir(Dir.c_str());
+    if (dir == nullptr) {
+        Dir.clear();
+        return;
+    }
+    while (struct dirent* ent = readdir(dir)) {
+        std::string const path = Dir + "/" + ent->d_name;
+        struct stat st;
+        if (ent->d_name[0] == '.' || stat(path.c_str(), &st) == -1 || !S_ISREG(st.st_mode)) {
+            continue;
+        }
+        if (!IsCacheFileName(ent->d_name)) {
+            unlink(path.c_str());
+            continue;
+        }
+        ovrFile file;
+        file.Size = static_cast<size_t>(st.st_size);
+        file.LastUse = st.st_mtime;
+        Files[ent->d_name] = file;
+        TotalSize += file.Size;
+    }
+    closedir(dir);
+    Trim();
+}
+
+void ovrPackageCache::SetMaxSize(size_t maxSize) {
+    std::lock_guard<std::mutex> lock(Mutex);
+    MaxSize = maxSize;
+    Trim();
+}
+
+void ovrPackageCache::Remove(std::string const& name) {
+    unlink((Dir + "/" + name).c_str());
+    std::lock_guard<std::mutex> lock(Mutex);
+    auto it = Files.find(name);
+    if (it != Files.end()) {
+        TotalSize -= it->second.Size;
+        Files.erase(it);
+    }
+}
+
+void ovrPackageCache::Trim() {
+    if (TotalSize <= MaxSize) {
+        return;
+    }
+    std::vector<std::pair<time_t, std::string>> byAge;
+    byAge.reserve(Files.size());
+    for (auto const& it : Files) {
+        byAge.push_back(std::make_pair(it.second.LastUse, it.first));
+    }
+    std::sort(byAge.begin(), byAge.end());
+    // deleting a file that is still mapped is fine, the mapping keeps its pages
+    for (int i = 0; i < static_cast<int>(byAge.size()) && TotalSize > MaxSize; ++i) {
+        unlink((Dir + "/" + byAge[i].second).c_str());
+        TotalSize -= Files[byAge[i].second].Size;
+        Files.erase(byAge[i].second);
+    }
+}
+
+std::shared_ptr<ovrCachedFile> ovrPackageCache::Find(uint32_t crc, size_t size) {
+    std::shared_ptr<ovrCachedFile> cached = Load(FileName(crc, size), 0, size);
+    return (cached != nullptr && cached->Crc == crc) ? cached : nullptr;
+}
+
+void ovrPackageCache::Store(uint32_t crc, const void* data, size_t size) {
+    Save(FileName(crc, size), 0, crc, data, size);
+}
+
+std::shared_ptr<ovrCachedFile> ovrPackageCache::FindData(uint64_t key) {
+    return Load(DataFileName(key), key, SIZE_MAX);
+}
+
+void ovrPackageCache::StoreData(uint64_t key, const void* data, size_t size) {
+    const uint32_t crc = crc32(0L, static_cast<const Bytef*>(data), static_cast<uInt>(size));
+    Save(DataFileName(key), key, crc, data, size);
+}
+
+std::shared_ptr<ovrCachedFile>
+ovrPackageCache::Load(std::string const& name, uint64_t key, size_t size) {
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        if (Files.find(name) == Files.end()) {
+            return nullptr;
+        }
+    }
+    std::string const path = Dir + "/" + name;
+
+    std::shared_ptr<ovrCachedFile> cached = std::make_shared<ovrCachedFile>();
+    const uint8_t* contents = nullptr;
+    size_t length = 0;
+#if defined(OVR_OS_ANDROID)
+    if (cached->File.OpenRead(path.c_str()) && cached->File.GetLength() >= sizeof(ovrHeader) &&
+        cached->View.Open(&cached->File)) {
+        contents = cached->View.MapView();
+        length = static_cast<size_t>(cached->File.GetLength());
+    }
+#else
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd != -1) {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(ovrHeader)) {
+            cached->Buffer.resize(static_cast<size_t>(st.st_size));
+            if (read(fd, cached->Buffer.data(), cached->Buffer.size()) ==
+                static_cast<ssize_t>(cached->Buffer.size())) {
+                contents = cached->Buffer.data();
+                length = cached->Buffer.size();
+            }
+        }
+        close(fd);
+    }
+#endif
+
+    ovrHeader header;
+    if (contents != nullptr) {
+        memcpy(&header, contents, sizeof(header));
+    }
+    if (contents == nullptr || header.Magic != MAGIC || header.Version != VERSION ||
+        header.Key != key || header.Size != length - sizeof(header) ||
+        (size != SIZE_MAX && header.Size != size) ||
+        crc32(0L, contents + sizeof(header), static_cast<uInt>(header.Size)) != header.Crc) {
+        ALOG("Discarding invalid package cache file %s", name.c_str());
+        Remove(name);
+        return nullptr;
+    }
+    cached->Data = contents + sizeof(header);
+    cached->Size = static_cast<size_t>(header.Size);
+    cached->Crc = header.Crc;
+
+    // the modification time orders files for eviction across launches
+    utimes(path.c_str(), nullptr);
+    std::lock_guard<std::mutex> lock(Mutex);
+    auto it = Files.find(name);
+    if (it != Files.end()) {
+        it->second.LastUse = time(nullptr);
+    }
+    return cached;
+}
+
+void ovrPackageCache::Save(
+    std::string const& name,
+    uint64_t key,
+    uint32_t crc,
+    const void* data,
+    size_t size) {
+    {
+        // don't evict everything else for a file that wouldn't stay cached anyway
+        std::lock_guard<std::mutex> lock(Mutex);
+        if (sizeof(ovrHeader) + size > MaxSize) {
+            return;
+        }
+    }
+    std::string const path = Dir + "/" + name;
+
+    // threads can extract the same file at the same time, so each writes its own temp file
+    char tempSuffix[32];
+    snprintf(
+        tempSuffix,
+        sizeof(tempSuffix),
+        ".%zx.tmp",
+        std::hash<std::thread::id>()(std::this_thread::get_id()));
+    std::string const tempPath = path + tempSuffix;
+
+    ovrHeader header = {};
+    header.Magic = MAGIC;
+    header.Version = VERSION;
+    header.Crc = crc;
+    header.Size = size;
+    header.Key = key;
+
+    const int fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (fd == -1) {
+        ALOG("Failed to open new cache file %s", tempPath.c_str());
+        return;
+    }
+    bool const written = write(fd, &header, sizeof(header)) == sizeof(header) &&
+        write(fd, data, size) == static_cast<ssize_t>(size);
+    close(fd);
+    if (!written || rename(tempPath.c_str(), path.c_str()) == -1) {
+        ALOG("Failed to write cache file %s", path.c_str());
+        unlink(tempPath.c_str());
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(Mutex);
+    ovrFile& file = Files[name];
+    TotalSize -= file.Size; // replaced if another thread stored it first
+    file.Size = sizeof(header) + size;
+    file.LastUse = time(nullptr);
+    TotalSize += file.Size;
+    Trim();
+}
+
+#endif // !defined(OVR_OS_WIN32)
+
+// Packages opened with ovr_OpenOtherApplicationPackage, by the handle returned to the caller.
+static std::shared_mutex PackagesMutex;
+static std::unordered_map<void*, std::shared_ptr<ovrZipPackage>> Packages;
+
+static std::shared_ptr<ovrZipPackage> FindPackage(void* zipFile) {
+    std::shared_lock<std::shared_mutex> lock(PackagesMutex);
+    auto it = Packages.find(zipFile);
+    return it != Packages.end() ? it->second : nullptr;
+}
+
 //--------------------------------------------------------------
 // Functions for reading assets from other application packages
 //--------------------------------------------------------------
 
 void* ovr_OpenOtherApplicationPackage(const char* packageCodePath) {
     void* zipFile = unzOpen(packageCodePath);
+    if (zipFile != 0) {
+        std::shared_ptr<ovrZipPackage> package = std::make_shared<ovrZipPackage>(packageCodePath);
+        package->BuildIndex(zipFile);
+        std::unique_lock<std::shared_mutex> lock(PackagesMutex);
+        Packages[zipFile] = package;
+    }
 
 // enable the following block if you need to see the list of files in the application package
 // This is useful for finding a file added in one of the res/ sub-folders (necesary if you want
@@ -76,29 +577,30 @@ void ovr_CloseOtherApplicationPackage(void*& zipFile) {
     if (zipFile == 0) {
         return;
     }
+    {
+        // reads still in progress keep the package alive until they return their handle
+        std::unique_lock<std::shared_mutex> lock(PackagesMutex);
+        Packages.erase(zipFile);
+    }
     unzClose(zipFile);
     zipFile = 0;
 }
 
-static std::mutex PackageFileMutex;
-
 bool ovr_OtherPackageFileExists(void* zipFile, const char* nameInZip) {
-    std::lock_guard<std::mutex> mutex(PackageFileMutex);
-
-    const int locateRet = unzLocateFile(zipFile, nameInZip, 2 /* case insensitive */);
-    if (locateRet != UNZ_OK) {
+    std::shared_ptr<ovrZipPackage> package = FindPackage(zipFile);
+    ovrZipPackage::ovrEntry const* entry =
+        package != nullptr ? package->FindEntry(nameInZip) : nullptr;
+    if (entry == nullptr) {
         ALOG("File '%s' not found in apk!", nameInZip);
         return false;
     }
 
-    const int openRet = unzOpenCurrentFile(zipFile);
-    if (openRet != UNZ_OK) {
+    // unzOpenCurrentFile only fails on a valid entry for unsupported compression methods
+    if (entry->Info.compression_method != 0 && entry->Info.compression_method != Z_DEFLATED) {
         ALOGW("Error opening file '%s' from apk!", nameInZip);
         return false;
     }
 
-    unzCloseCurrentFile(zipFile);
-
     return true;
 }
 
@@ -116,71 +618,47 @@ static bool ovr_ReadFileFromOtherApplicationPackageInternal(
     }
 
 #if !defined(OVR_OS_WIN32)
-    std::lock_guard<std::mutex> mutex(PackageFileMutex);
-
-    const int locateRet = unzLocateFile(zipFile, nameInZip, 2 /* case insensitive */);
+    std::shared_ptr<ovrZipPackage> package = FindPackage(zipFile);
+    ovrZipPackage::ovrEntry const* entry =
+        package != nullptr ? package->FindEntry(nameInZip) : nullptr;
 
-    if (locateRet != UNZ_OK) {
+    if (entry == nullptr) {
         ALOG("File '%s' not found in apk!", nameInZip);
         return false;
     }
 
-    unz_file_info info;
-    const int getRet = unzGetCurrentFileInfo(zipFile, &info, NULL, 0, NULL, 0, NULL, 0);
-
-    if (getRet != UNZ_OK) {
-        ALOGW("File info error reading '%s' from apk!", nameInZip);
-        return false;
-    }
-
-    // Check for an already extracted cache file based on the CRC if
-    // the file is compressed.
-    if (info.compression_method != 0 && CachePath[0]) {
-        char cacheName[1024];
-        snprintf(cacheName, sizeof(cacheName), "%s/%08x.bin", CachePath, (unsigned)info.crc);
-        const int fd = open(cacheName, O_RDONLY);
-        if (fd > 0) {
-            struct stat s = {};
-
-            if (fstat(fd, &s) != -1) {
-                //				LOG( "Loading cached file for: %s", nameInZip );
-                length = s.st_size;
-                if (length != (int)info.uncompressed_size) {
-                    ALOG(
-                        "Cached file for %s has length %i != %lu",
-                        nameInZip,
-                        length,
-                        info.uncompressed_size);
-                    // Fall through to normal load.
-                } else {
-                    buffer = allocBuffer(length);
-                    const int r = read(fd, buffer, length);
-                    close(fd);
-                    if (r != length) {
-                        ALOG("Cached file for %s only read %i != %i", nameInZip, r, length);
-                        freeBuffer(buffer);
-                        // Fall through to normal load.
-                    } else { // Got the cached file.
-                        return true;
-                    }
-                }
-            }
-            close(fd);
+    const unz_file_info& info = entry->Info;
+
+    // compressed files may already be decompressed in the cache
+    bool const cached =
+        info.compression_method != 0 && PackageCache.ShouldCache(info.uncompressed_size);
+    if (cached) {
+        std::shared_ptr<ovrCachedFile> file = PackageCache.Find(info.crc, info.uncompressed_size);
+        if (file != nullptr) {
+            length = static_cast<int>(file->Size);
+            buffer = allocBuffer(length);
+            memcpy(buffer, file->Data, length);
+            return true;
         }
-    } else {
-        //		LOG( "Not compressed: %s", nameInZip );
     }
 
-    const int openRet = unzOpenCurrentFile(zipFile);
-    if (openRet != UNZ_OK) {
+    // decompress with a handle of our own, so other threads can read at the same time
+    unzFile reader = package->AcquireReader();
+    unz_file_pos pos = entry->Pos;
+    if (reader == 0 || unzGoToFilePos(reader, &pos) != UNZ_OK ||
+        unzOpenCurrentFile(reader) != UNZ_OK) {
         ALOGW("Error opening file '%s' from apk!", nameInZip);
+        package->ReleaseReader(reader);
         return false;
     }
 
     length = info.uncompressed_size;
     buffer = allocBuffer(length);
 
-    const int readRet = unzReadCurrentFile(zipFile, buffer, length);
+    const int readRet = unzReadCurrentFile(reader, buffer, length);
+    // the CRC is only checked once the whole file has been read
+    const int closeRet = unzCloseCurrentFile(reader);
+    package->ReleaseReader(reader);
     if (readRet != length) {
         ALOGW("Error reading file '%s' from apk!", nameInZip);
         freeBuffer(buffer);
@@ -189,31 +667,8 @@ static bool ovr_ReadFileFromOtherApplicationPackageInternal(
         return false;
     }
 
-    unzCloseCurrentFile(zipFile);
-
-    // Optionally write out to the cache directory
-    if (info.compression_method != 0 && CachePath[0]) {
-        char tempName[1024];
-        snprintf(tempName, sizeof(tempName), "%s/%08x.tmp", CachePath, (unsigned)info.crc);
-
-        char cacheName[1024];
-        snprintf(cacheName, sizeof(cacheName), "%s/%08x.bin", CachePath, (unsigned)info.crc);
-        const int fd = open(tempName, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
-        if (fd > 0) {
-            const int r = write(fd, buffer, length);
-            close(fd);
-            if (r == length) {
-                if (rename(tempName, cacheName) == -1) {
-                    ALOG("Failed to rename cache file for %s", nameInZip);
-                } else {
-                    ALOG("Cache file generated for %s", nameInZip);
-                }
-            } else {
-                ALOG("Only wrote %i of %i for cached %s", r, length, nameInZip);
-            }
-        } else {
-            ALOG("Failed to open new cache file for %s: %s", nameInZip, tempName);
-        }
+    if (cached && closeRet == UNZ_OK) {
+        PackageCache.Store(info.crc, buffer, length);
     }
 
     return true;
@@ -257,6 +712,64 @@ bool ovr_ReadFileFromOtherApplicationPackage(
         zipFile, nameInZip, length, buffer, allocBuffer, freeBuffer);
 }
 
+void ovrPackageFileView::Reset() {
+    Owner = nullptr;
+    Buffer.clear();
+    Data = nullptr;
+    Size = 0;
+}
+
+bool ovr_MapFileFromOtherApplicationPackage(
+    void* zipFile,
+    const char* nameInZip,
+    ovrPackageFileView& view) {
+    view.Reset();
+
+    std::shared_ptr<ovrZipPackage> package = FindPackage(zipFile);
+    ovrZipPackage::ovrEntry const* entry =
+        package != nullptr ? package->FindEntry(nameInZip) : nullptr;
+    if (entry == nullptr) {
+        ALOG("File '%s' not found in apk!", nameInZip);
+        return false;
+    }
+
+    // stored files that aren't encrypted are used in place
+    if (entry->Info.compression_method == 0 && (entry->Info.flag & 1) == 0) {
+        size_t mappingLength = 0;
+        const uint8_t* mapping = package->GetMapping(mappingLength);
+        uint64_t offset = 0;
+        if (mapping != nullptr && package->GetDataOffset(*entry, offset) &&
+            offset + entry->Info.uncompressed_size <= mappingLength) {
+            view.Owner = package;
+            view.Data = mapping + offset;
+            view.Size = entry->Info.uncompressed_size;
+            return true;
+        }
+    }
+
+#if !defined(OVR_OS_WIN32)
+    // compressed files that were decompressed before are used from the cache
+    if (entry->Info.compression_method != 0 &&
+        PackageCache.ShouldCache(entry->Info.uncompressed_size)) {
+        std::shared_ptr<ovrCachedFile> file =
+            PackageCache.Find(entry->Info.crc, entry->Info.uncompressed_size);
+        if (file != nullptr) {
+            view.Owner = file;
+            view.Data = file->Data;
+            view.Size = file->Size;
+            return true;
+        }
+    }
+#endif
+
+    if (!ovr_ReadFileFromOtherApplicationPackage(zipFile, nameInZip, view.Buffer)) {
+        return false;
+    }
+    view.Data = view.Buffer.data();
+    view.Size = view.Buffer.size();
+    return true;
+}
+
 //--------------------------------------------------------------
 // Functions for reading assets from this process's application package
 //--------------------------------------------------------------
@@ -273,10 +786,43 @@ void ovr_OpenApplicationPackage(const char* packageCodePath, const char* cachePa
     }
     if (cachePath_ != NULL) {
         OVR::OVR_strncpy(CachePath, sizeof(CachePath), cachePath_, sizeof(CachePath) - 1);
+#if !defined(OVR_OS_WIN32)
+        PackageCache.SetPath(CachePath);
+#endif
     }
     packageZipFile = ovr_OpenOtherApplicationPackage(packageCodePath);
 }
 
+void ovr_SetApplicationPackageCacheSize(size_t maxSize) {
+#if !defined(OVR_OS_WIN32)
+    PackageCache.SetMaxSize(maxSize);
+#endif
+}
+
+bool ovr_FindCachedData(uint64_t key, ovrPackageFileView& view) {
+    view.Reset();
+#if !defined(OVR_OS_WIN32)
+    if (PackageCache.IsEnabled()) {
+        std::shared_ptr<ovrCachedFile> file = PackageCache.FindData(key);
+        if (file != nullptr) {
+            view.Owner = file;
+            view.Data = file->Data;
+            view.Size = file->Size;
+            return true;
+        }
+    }
+#endif
+    return false;
+}
+
+void ovr_StoreCachedData(uint64_t key, const void* data, size_t size) {
+#if !defined(OVR_OS_WIN32)
+    if (PackageCache.IsEnabled()) {
+        PackageCache.StoreData(key, data, size);
+    }
+#endif
+}
+
 bool ovr_PackageFileExists(const char* nameInZip) {
     return ovr_OtherPackageFileExists(packageZipFile, nameInZip);
 }
@@ -289,4 +835,8 @@ bool ovr_ReadFileFromApplicationPackage(const char* nameInZip, std::vector<uint8
     return ovr_ReadFileFromOtherApplicationPackage(packageZipFile, nameInZip, buffer);
 }
 
+bool ovr_MapFileFromApplicationPackage(const char* nameInZip, ovrPackageFileView& view) {
+    return ovr_MapFileFromOtherApplicationPackage(packageZipFile, nameInZip, view);
+}
+
 } // namespace OVRFW
@@ -11,6 +11,8 @@ Authors     :   John Carmack
 
 #pragma once
 
+#include <cstdint>
+#include <memory>
 #include <vector>
 
 // The application package is the moral equivalent of the filesystem, so
@@ -40,6 +42,44 @@ class OvrApkFile {
     void* ZipFile;
 };
 
+//==============================================================
+// ovrPackageFileView
+// Read-only contents of a file in an application package. Files stored without compression
+// point straight into a memory mapping of the package, and compressed files into a mapping of
+// their decompressed copy in the package cache. Other files are decompressed into a buffer owned
+// by the view. Mappings stay valid while views into them exist.
+//==============================================================
+class ovrPackageFileView {
+   public:
+    ovrPackageFileView() : Data(nullptr), Size(0) {}
+
+    const uint8_t* GetData() const {
+        return Data;
+    }
+    size_t GetSize() const {
+        return Size;
+    }
+    // True if the data is in a mapped file rather than in the view's own buffer.
+    bool IsMapped() const {
+        return Owner != nullptr;
+    }
+
+    void Reset();
+
+   private:
+    ovrPackageFileView(ovrPackageFileView const&) = delete;
+    ovrPackageFileView& operator=(ovrPackageFileView const&) = delete;
+
+    friend bool
+    ovr_MapFileFromOtherApplicationPackage(void*, const char*, ovrPackageFileView&);
+    friend bool ovr_FindCachedData(uint64_t, ovrPackageFileView&);
+
+    std::shared_ptr<const void> Owner; // keeps the mapping alive
+    std::vector<uint8_t> Buffer;
+    const uint8_t* Data;
+    size_t Size;
+};
+
 //--------------------------------------------------------------
 // Functions for reading assets from other application packages
 //--------------------------------------------------------------
@@ -51,7 +91,8 @@ void* ovr_OpenOtherApplicationPackage(const char* packageName);
 // Call this to close another application package after loading resources from it.
 void ovr_CloseOtherApplicationPackage(void*& zipFile);
 
-// These are probably NOT thread safe!
+// Lookups and reads can be made from several threads at once, but not while the package is being
+// opened or closed.
 bool ovr_OtherPackageFileExists(void* zipFile, const char* nameInZip);
 
 // Returns NULL buffer if the file is not found.
@@ -65,6 +106,12 @@ bool ovr_ReadFileFromOtherApplicationPackage(
     const char* nameInZip,
     std::vector<uint8_t>& buffer);
 
+// Returns the file without copying it if it is stored uncompressed, otherwise decompresses it.
+bool ovr_MapFileFromOtherApplicationPackage(
+    void* zipFile,
+    const char* nameInZip,
+    ovrPackageFileView& view);
+
 //--------------------------------------------------------------
 // Functions for reading assets from this process's application package
 //--------------------------------------------------------------
@@ -79,12 +126,24 @@ void* ovr_GetApplicationPackageFile();
 const char* ovr_GetApplicationPackageCachePath();
 
 // App.cpp calls this very shortly after startup.
-// If cachePath is not NULL, compressed files that are read will be written
-// out to the cachePath with the CRC as the filename so they can be read
-// back in much faster.
+// If cachePath is not NULL, large compressed files that are read will be written
+// out to a directory in cachePath, named by their CRC and size, so they can be
+// mapped back in without decompressing them again. Cached files are checked
+// against the CRC when they are read, and the least recently used ones are
+// deleted when the cache grows past its size limit.
 void ovr_OpenApplicationPackage(const char* packageName, const char* cachePath);
 
-// These are probably NOT thread safe!
+// Sets the size limit of the package cache on disk, 256 MB by default.
+void ovr_SetApplicationPackageCacheSize(size_t maxSize);
+
+// Data derived from package files, such as digested models, can be kept in the package cache
+// too. The key has to change with everything the data is derived from, so a hash of the source
+// files and of the settings used. Nothing is cached before ovr_OpenApplicationPackage was called
+// with a cache path.
+bool ovr_FindCachedData(uint64_t key, ovrPackageFileView& view);
+void ovr_StoreCachedData(uint64_t key, const void* data, size_t size);
+
+// Lookups and reads can be made from several threads at once.
 bool ovr_PackageFileExists(const char* nameInZip);
 
 // Returns NULL buffer if the file is not found.
@@ -93,4 +152,7 @@ bool ovr_ReadFileFromApplicationPackage(const char* nameInZip, int& length, void
 // Returns an empty MemBufferFile if the file is not found.
 bool ovr_ReadFileFromApplicationPackage(const char* nameInZip, std::vector<uint8_t>& buffer);
 
+// Returns the file without copying it if it is stored uncompressed, otherwise decompresses it.
+bool ovr_MapFileFromApplicationPackage(const char* nameInZip, ovrPackageFileView& view);
+
 } // namespace OVRFW
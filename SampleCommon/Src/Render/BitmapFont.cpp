@@ -20,6 +20,8 @@ Authors     :   Jonathan E. Wright
 #include <errno.h>
 #include <math.h>
 #include <sys/stat.h>
+#include <string.h>
+#include <unordered_map>
 
 #include "OVR_UTF8Util.h"
 #include "OVR_JSON.h"
@@ -251,6 +253,66 @@ class ovrFontWeight {
     float ColorCenterOffset;
 };
 
+//==============================================================
+// ovrGlyphMap
+//
+// Maps character codes to glyph indices with two levels of pages. The high bits of a character
+// code select a page of PAGE_SIZE entries and pages only exist where the font has glyphs, so the
+// memory used follows the glyphs present instead of the highest character code.
+class ovrGlyphMap {
+   public:
+    static constexpr uint16_t INVALID_GLYPH = 0xFFFF;
+
+    void Build(std::vector<FontGlyphType> const& glyphs);
+
+    int32_t Find(uint32_t const charCode) const {
+        uint32_t const page = charCode >> PAGE_BITS;
+        if (page >= PageIndex.size()) {
+            return -1;
+        }
+        uint16_t const glyph = Pages[(PageIndex[page] << PAGE_BITS) + (charCode & PAGE_MASK)];
+        return glyph == INVALID_GLYPH ? -1 : glyph;
+    }
+
+    size_t GetMemoryUsed() const {
+        return PageIndex.size() * sizeof(PageIndex[0]) + Pages.size() * sizeof(Pages[0]);
+    }
+
+   private:
+    static constexpr int PAGE_BITS = 7;
+    static constexpr uint32_t PAGE_SIZE = 1u << PAGE_BITS;
+    static constexpr uint32_t PAGE_MASK = PAGE_SIZE - 1;
+
+    std::vector<uint16_t> PageIndex; // page of each range of character codes, 0 = empty page
+    std::vector<uint16_t> Pages; // glyph index of each character code in a page
+};
+
+void ovrGlyphMap::Build(std::vector<FontGlyphType> const& glyphs) {
+    PageIndex.clear();
+    Pages.assign(PAGE_SIZE, INVALID_GLYPH);
+
+    for (int i = 0; i < static_cast<int>(glyphs.size()) && i < INVALID_GLYPH; ++i) {
+        uint32_t const charCode = static_cast<uint32_t>(glyphs[i].CharCode);
+        if (charCode > 0x10FFFF) {
+            ALOGW("ovrGlyphMap: invalid character code %u", charCode);
+            continue;
+        }
+        uint32_t const page = charCode >> PAGE_BITS;
+        if (page >= PageIndex.size()) {
+            PageIndex.resize(page + 1, 0);
+        }
+        if (PageIndex[page] == 0) {
+            if ((Pages.size() >> PAGE_BITS) > 0xFFFF) {
+                ALOGW("ovrGlyphMap: too many pages for character code %u", charCode);
+                continue;
+            }
+            PageIndex[page] = static_cast<uint16_t>(Pages.size() >> PAGE_BITS);
+            Pages.resize(Pages.size() + PAGE_SIZE, INVALID_GLYPH);
+        }
+        Pages[(PageIndex[page] << PAGE_BITS) + (charCode & PAGE_MASK)] = static_cast<uint16_t>(i);
+    }
+}
+
 class FontInfoType {
    public:
     static const int FNT_FILE_VERSION;
@@ -298,8 +360,7 @@ class FontInfoType {
     float EdgeWidth; // adjust the edge falloff. Helps with fonts that have smaller glyph sizes in
                      // the texture (CJK)
     std::vector<FontGlyphType> Glyphs; // info about each glyph in the font
-    std::vector<int32_t>
-        CharCodeMap; // index by character code to get the index of a glyph for the character
+    ovrGlyphMap CharCodeMap; // character code to the index of the glyph for the character
     std::vector<ovrFontWeight> FontWeights;
 
    private:
@@ -1016,6 +1077,64 @@ ovrSurfaceDef BitmapFontLocal::TextSurface(
     return s;
 }
 
+// Number of frames a text layout stays cached after it was last drawn.
+static const int MAX_UNUSED_LAYOUT_FRAMES = 60;
+
+// Dirty vertex ranges closer than this are uploaded with a single call.
+static const int MIN_UPLOAD_GAP_VERTICES = 64;
+
+//==============================================================
+// ovrTextLayout
+// Glyph vertices of a string in its own space, x to the right and y up, so text that does not
+// change can be drawn again from here wherever it is placed.
+//==============================================================
+struct ovrTextLayout {
+    ovrTextLayout()
+        : Font(nullptr),
+          Scale(0.0f),
+          Color(0),
+          Hash(0),
+          Serial(0),
+          LastUsedFrame(0),
+          ToNextLine(0.0f) {}
+
+    // the text and everything else the vertices depend on
+    std::string Text;
+    BitmapFont const* Font;
+    fontParms_t Parms; // Billboard and TrackRoll are ignored, they only change the transform
+    float Scale;
+    uint32_t Color; // ABGR
+    uint64_t Hash;
+
+    uint32_t Serial; // changes whenever the vertices are generated again
+    long long LastUsedFrame;
+    std::vector<fontVertex_t> Verts;
+    Vector3f ToNextLine;
+};
+
+//==============================================================
+// ovrTextBlock
+// A text layout placed in the world for the current frame.
+//==============================================================
+struct ovrTextBlock {
+    int Layout;
+    Vector3f Pivot;
+    Matrix4f Transform; // layout to world space, only set for text that is not billboarded
+    bool Billboard;
+    bool TrackRoll;
+};
+
+//==============================================================
+// ovrTextSlot
+// What Finish wrote to a range of the vertex buffer for one text block.
+//==============================================================
+struct ovrTextSlot {
+    uint32_t Serial; // serial of the layout the vertices came from
+    int FirstVertex;
+    Matrix4f Transform;
+    Bounds3f Bounds; // world space bounds of the vertices
+};
+
 //==================================================================================================
 // BitmapFontSurfaceLocal
 //
@@ -1090,8 +1209,27 @@ class BitmapFontSurfaceLocal : public BitmapFontSurface {
     int CurIndex; // reset every Render()
     bool Initialized;
 
-    std::vector<VertexBlockType>
-        VertexBlocks; // each pointer in the array points to an allocated block ov
+    std::vector<ovrTextBlock> TextBlocks; // text drawn since the last Finish
+
+    // text layouts, looked up by a hash of their key
+    std::vector<ovrTextLayout> Layouts;
+    std::vector<int> FreeLayouts;
+    std::unordered_multimap<uint64_t, int> LayoutLookup;
+    uint32_t NextSerial;
+    long long FrameNumber;
+
+    // blocks written to the vertex buffer by the last Finish, in draw order
+    std::vector<ovrTextSlot> Slots;
+    std::vector<ovrTextSlot> NewSlots;
+    std::vector<std::pair<int, int>> DirtyRanges; // first vertex, end vertex
+
+    int FindLayout(
+        BitmapFont const& font,
+        fontParms_t const& parms,
+        float const scale,
+        Vector4f const& color,
+        char const* text);
+    void EvictLayouts();
 };
 
 //==================================================================================================
@@ -1108,7 +1246,9 @@ bool FontInfoType::Load(ovrFileSys& fileSys, char const* uri) {
     }
     ALOG("FontInfoType::Load ReadFile OK buffer size = '%d' ", (int)buffer.size());
 
-    bool result = LoadFromBuffer(buffer.data(), buffer.size());
+    // the JSON text has to be null terminated
+    buffer.push_back('\0');
+    bool result = LoadFromBuffer(buffer.data(), buffer.size() - 1);
     // enable the block below to rewrite the font
     /*
         if ( result )
@@ -1124,63 +1264,141 @@ bool FontInfoType::Load(ovrFileSys& fileSys, char const* uri) {
 //==============================
 // FontInfoType::LoadFromBuffer
 bool FontInfoType::LoadFromBuffer(void const* buffer, size_t const bufferSize) {
-    char const* errorMsg = NULL;
-    std::shared_ptr<OVR::JSON> jsonRoot =
-        OVR::JSON::Parse(reinterpret_cast<char const*>(buffer), &errorMsg);
-    if (jsonRoot == NULL) {
-        ALOGW("OVR::JSON Error: %s", (errorMsg != NULL) ? errorMsg : "<NULL>");
-        ALOG(
-            "FontInfoType::LoadFromBuffer FAIL OVR::JSON ERROR = '%s' ",
-            (errorMsg != NULL) ? errorMsg : "<NULL>");
-        return false;
-    }
-
-    int32_t maxCharCode = -1;
-    // currently we're only supporting the first unicode plane up to 65k. If we were to support
-    // other planes we could conceivably end up with a very sparse 1,114,111 byte type for mapping
-    // character codes to glyphs and if that's the case we may just want to use a hash, or use a
-    // combination of tables for the first 65K and hashes for the other, less-frequently-used
-    // characters.
+    // glyph indices are stored as 16 bit values in CharCodeMap
     static const int MAX_GLYPHS = 0xffff;
 
-    // load the glyphs
-    const OVR::JsonReader jsonGlyphs(jsonRoot);
-    if (!jsonGlyphs.IsObject()) {
+    // Read the members straight from the text instead of building a JSON tree first, fonts can
+    // have tens of thousands of glyphs. The members can be in any order, so values that depend
+    // on others are only scaled once the whole file is read.
+    OVR::JsonStreamReader reader(reinterpret_cast<char const*>(buffer));
+    if (!reader.BeginObject()) {
         ALOG("FontInfoType::LoadFromBuffer FAIL ==> jsonGlyphs.IsObject() = FALSE ");
         return false;
     }
 
-    // OVR::JSON doesn't have ints so cast from float to an int
-    int Version = static_cast<int>(jsonGlyphs.GetChildFloatByName("Version"));
+    int Version = 0;
+    int numGlyphs = 0;
+    float horizontalPad = 0.0f;
+    float verticalPad = 0.0f;
+    float fontHeight = 0.0f;
+    FontName.clear();
+    CommandLine.clear();
+    ImageFileName.clear();
+    NaturalWidth = 0.0f;
+    NaturalHeight = 0.0f;
+    CenterOffset = 0.0f;
+    TweakScale = 1.0f;
+    EdgeWidth = 32.0f;
+    Glyphs.clear();
+    std::vector<bool> glyphRead; // false for array elements that are not glyph objects
+
+    while (reader.NextMember()) {
+        if (reader.IsName("Glyphs")) {
+            if (reader.BeginArray()) {
+                while (reader.NextElement()) {
+                    // only the first NumGlyphs glyphs are used, and NumGlyphs is at most
+                    // MAX_GLYPHS, so the rest are skipped instead of stored
+                    if (static_cast<int>(Glyphs.size()) >= MAX_GLYPHS) {
+                        continue;
+                    }
+                    Glyphs.emplace_back();
+                    glyphRead.push_back(reader.BeginObject());
+                    if (!glyphRead.back()) {
+                        continue;
+                    }
+                    FontGlyphType& g = Glyphs.back();
+                    while (reader.NextMember()) {
+                        if (reader.IsName("CharCode")) {
+                            g.CharCode = reader.ReadInt32();
+                        } else if (reader.IsName("X")) {
+                            g.X = reader.ReadFloat();
+                        } else if (reader.IsName("Y")) {
+                            g.Y = reader.ReadFloat();
+                        } else if (reader.IsName("Width")) {
+                            g.Width = reader.ReadFloat();
+                        } else if (reader.IsName("Height")) {
+                            g.Height = reader.ReadFloat();
+                        } else if (reader.IsName("AdvanceX")) {
+                            g.AdvanceX = reader.ReadFloat();
+                        } else if (reader.IsName("AdvanceY")) {
+                            g.AdvanceY = reader.ReadFloat();
+                        } else if (reader.IsName("BearingX")) {
+                            g.BearingX = reader.ReadFloat();
+                        } else if (reader.IsName("BearingY")) {
+                            g.BearingY = reader.ReadFloat();
+                        }
+                    }
+                }
+            }
+        } else if (reader.IsName("Weights")) {
+            if (reader.BeginArray()) {
+                while (reader.NextElement()) {
+                    if (reader.BeginObject()) {
+                        ovrFontWeight w;
+                        while (reader.NextMember()) {
+                            if (reader.IsName("AlphaCenterOffset")) {
+                                w.AlphaCenterOffset = reader.ReadFloat();
+                            } else if (reader.IsName("ColorCenterOffset")) {
+                                w.ColorCenterOffset = reader.ReadFloat();
+                            }
+                        }
+                        FontWeights.push_back(w);
+                    }
+                }
+            }
+        } else if (reader.IsName("Version")) {
+            // OVR::JSON doesn't have ints so cast from float to an int
+            Version = static_cast<int>(reader.ReadFloat());
+        } else if (reader.IsName("FontName")) {
+            FontName = reader.ReadString();
+        } else if (reader.IsName("CommandLine")) {
+            CommandLine = reader.ReadString();
+        } else if (reader.IsName("ImageFileName")) {
+            ImageFileName = reader.ReadString();
+        } else if (reader.IsName("NumGlyphs")) {
+            numGlyphs = reader.ReadInt32();
+        } else if (reader.IsName("NaturalWidth")) {
+            NaturalWidth = reader.ReadFloat();
+        } else if (reader.IsName("NaturalHeight")) {
+            NaturalHeight = reader.ReadFloat();
+        } else if (reader.IsName("HorizontalPad")) {
+            horizontalPad = reader.ReadFloat();
+        } else if (reader.IsName("VerticalPad")) {
+            verticalPad = reader.ReadFloat();
+        } else if (reader.IsName("FontHeight")) {
+            fontHeight = reader.ReadFloat();
+        } else if (reader.IsName("CenterOffset")) {
+            CenterOffset = reader.ReadFloat();
+        } else if (reader.IsName("TweakScale")) {
+            TweakScale = reader.ReadFloat(1.0f);
+        } else if (reader.IsName("EdgeWidth")) {
+            EdgeWidth = reader.ReadFloat(32.0f);
+        }
+    }
+    if (reader.HasError()) {
+        ALOGW("OVR::JSON Error: %s at offset %zu", reader.GetError(), reader.GetOffset());
+        ALOG("FontInfoType::LoadFromBuffer FAIL OVR::JSON ERROR = '%s' ", reader.GetError());
+        return false;
+    }
+
     if (Version != FNT_FILE_VERSION) {
         ALOG("FontInfoType::LoadFromBuffer FAIL ==> Version != FNT_FILE_VERSION ");
         return false;
     }
-
-    FontName = jsonGlyphs.GetChildStringByName("FontName");
-    CommandLine = jsonGlyphs.GetChildStringByName("CommandLine");
-    ImageFileName = jsonGlyphs.GetChildStringByName("ImageFileName");
-    const int numGlyphs = jsonGlyphs.GetChildInt32ByName("NumGlyphs");
     if (numGlyphs < 0 || numGlyphs > MAX_GLYPHS) {
         OVR_ASSERT(numGlyphs > 0 && numGlyphs <= MAX_GLYPHS);
         ALOG("FontInfoType::LoadFromBuffer FAIL ==> numGlyphs < 0 || numGlyphs > MAX_GLYPHS ");
         return false;
     }
 
-    NaturalWidth = jsonGlyphs.GetChildFloatByName("NaturalWidth");
-    NaturalHeight = jsonGlyphs.GetChildFloatByName("NaturalHeight");
-
     // we scale everything after loading integer values from the OVR::JSON file because the OVR
     // OVR::JSON writer loses precision on floats
     float nwScale = 1.0f / NaturalWidth;
     float nhScale = 1.0f / NaturalHeight;
 
-    HorizontalPad = jsonGlyphs.GetChildFloatByName("HorizontalPad") * nwScale;
-    VerticalPad = jsonGlyphs.GetChildFloatByName("VerticalPad") * nhScale;
-    FontHeight = jsonGlyphs.GetChildFloatByName("FontHeight") * nhScale;
-    CenterOffset = jsonGlyphs.GetChildFloatByName("CenterOffset");
-    TweakScale = jsonGlyphs.GetChildFloatByName("TweakScale", 1.0f);
-    EdgeWidth = jsonGlyphs.GetChildFloatByName("EdgeWidth", 32.0f);
+    HorizontalPad = horizontalPad * nwScale;
+    VerticalPad = verticalPad * nhScale;
+    FontHeight = fontHeight * nhScale;
 
 #if defined(OVR_BUILD_DEBUG)
     ALOG("FontName = %s", FontName.c_str());
@@ -1203,83 +1421,42 @@ bool FontInfoType::LoadFromBuffer(void const* buffer, size_t const bufferSize) {
     }
     /// HACK: end hack
 
-    const OVR::JsonReader jsonWeightArray(jsonGlyphs.GetChildByName("Weights"));
-    if (jsonWeightArray.IsValid()) {
-#if defined(OVR_BUILD_DEBUG)
-        ALOG("jsonWeightArray valid");
-#endif
-
-        for (int i = 0; !jsonWeightArray.IsEndOfArray(); ++i) {
-            const OVR::JsonReader jsonWeight(jsonWeightArray.GetNextArrayElement());
-            if (jsonWeight.IsObject()) {
-                ovrFontWeight w;
-                w.AlphaCenterOffset = jsonWeight.GetChildFloatByName("AlphaCenterOffset");
-                w.ColorCenterOffset = jsonWeight.GetChildFloatByName("ColorCenterOffset");
-                FontWeights.push_back(w);
-#if defined(OVR_BUILD_DEBUG)
-///				ALOG( "FontWeights[%d] --> AlphaCenterOffset=%.3f ColorCenterOffset=%.3f", i,
-/// w.AlphaCenterOffset, w.ColorCenterOffset );
-#endif
-            }
-        }
-    }
-
-#if defined(OVR_BUILD_DEBUG)
-    ALOG("jsonWeightArray DONE");
-#endif
-
-    Glyphs.resize(numGlyphs);
-    const OVR::JsonReader jsonGlyphArray(jsonGlyphs.GetChildByName("Glyphs"));
-
+    int32_t maxCharCode = -1;
     double oWidth = 0.0;
     double oHeight = 0.0;
 
-    if (jsonGlyphArray.IsArray()) {
-        for (int i = 0; i < static_cast<int>(Glyphs.size()) && !jsonGlyphArray.IsEndOfArray();
-             i++) {
-            const OVR::JsonReader jsonGlyph(jsonGlyphArray.GetNextArrayElement());
-            if (jsonGlyph.IsObject()) {
-                FontGlyphType& g = Glyphs[i];
-                g.CharCode = jsonGlyph.GetChildInt32ByName("CharCode");
-                g.X = jsonGlyph.GetChildFloatByName("X");
-                g.Y = jsonGlyph.GetChildFloatByName("Y");
-                g.Width = jsonGlyph.GetChildFloatByName("Width");
-                g.Height = jsonGlyph.GetChildFloatByName("Height");
-                g.AdvanceX = jsonGlyph.GetChildFloatByName("AdvanceX");
-                g.AdvanceY = jsonGlyph.GetChildFloatByName("AdvanceY");
-                g.BearingX = jsonGlyph.GetChildFloatByName("BearingX");
-                g.BearingY = jsonGlyph.GetChildFloatByName("BearingY");
-
-                if (g.CharCode == 'O') {
-                    oWidth = g.Width;
-                    oHeight = g.Height;
-                }
-
-                g.X *= nwScale;
-                g.Y *= nhScale;
-                g.Width *= nwScale;
-                g.Height *= nhScale;
-                g.AdvanceX *= nwScale;
-                g.AdvanceY *= nhScale;
-                g.BearingX *= nwScale;
-                g.BearingY *= nhScale;
-
-                float const ascent = g.BearingY;
-                float const descent = g.Height - g.BearingY;
-                if (ascent > MaxAscent) {
-                    MaxAscent = ascent;
-                }
-                if (descent > MaxDescent) {
-                    MaxDescent = descent;
-                }
-
-#if defined(OVR_BUILD_DEBUG)
-///				ALOG( "Glyphs[%d] --> X=%.3f Y=%.3f CharCode=%d", i, g.X, g.Y, g.CharCode );
-#endif
+    // glyphs past NumGlyphs are ignored, missing ones are left default initialized
+    glyphRead.resize(numGlyphs, false);
+    Glyphs.resize(numGlyphs);
+    for (int i = 0; i < static_cast<int>(Glyphs.size()); i++) {
+        if (!glyphRead[i]) {
+            continue;
+        }
+        FontGlyphType& g = Glyphs[i];
+        if (g.CharCode == 'O') {
+            oWidth = g.Width;
+            oHeight = g.Height;
+        }
 
-                maxCharCode = std::max<int32_t>(maxCharCode, g.CharCode);
-            }
+        g.X *= nwScale;
+        g.Y *= nhScale;
+        g.Width *= nwScale;
+        g.Height *= nhScale;
+        g.AdvanceX *= nwScale;
+        g.AdvanceY *= nhScale;
+        g.BearingX *= nwScale;
+        g.BearingY *= nhScale;
+
+        float const ascent = g.BearingY;
+        float const descent = g.Height - g.BearingY;
+        if (ascent > MaxAscent) {
+            MaxAscent = ascent;
         }
+        if (descent > MaxDescent) {
+            MaxDescent = descent;
+        }
+
+        maxCharCode = std::max<int32_t>(maxCharCode, g.CharCode);
     }
 
 #if defined(OVR_BUILD_DEBUG)
@@ -1301,23 +1478,10 @@ bool FontInfoType::LoadFromBuffer(void const* buffer, size_t const bufferSize) {
     ScaleFactorX = DEFAULT_SCALE_FACTOR * DEFAULT_TEXT_SCALE * widthScaleFactor * TweakScale;
     ScaleFactorY = DEFAULT_SCALE_FACTOR * DEFAULT_TEXT_SCALE * heightScaleFactor * TweakScale;
 
-    // This is not intended for wide or ucf character sets -- depending on the size range of
-    // character codes lookups may need to be changed to use a hash.
-    if (maxCharCode >= MAX_GLYPHS) {
-        OVR_ASSERT(maxCharCode <= MAX_GLYPHS);
-        maxCharCode = MAX_GLYPHS;
-    }
-
-    // resize the array to the maximum glyph value
-    CharCodeMap.resize(maxCharCode + 1);
-
-    // init to empty value
-    CharCodeMap.assign(CharCodeMap.size(), -1);
-
-    for (int i = 0; i < static_cast<int>(Glyphs.size()); ++i) {
-        FontGlyphType const& g = Glyphs[i];
-        CharCodeMap[g.CharCode] = i;
-    }
+    CharCodeMap.Build(Glyphs);
+#if defined(OVR_BUILD_DEBUG)
+    ALOG("CharCodeMap uses %zu bytes", CharCodeMap.GetMemoryUsed());
+#endif
 
     ALOG("FontInfoType load SUCCESS");
     return true;
@@ -1409,19 +1573,15 @@ bool FontInfoType::Save(char const* path) {
 //==============================
 // FontInfoType::GlyphForCharCode
 FontGlyphType const& FontInfoType::GlyphForCharCode(uint32_t const charCode) const {
-    auto lookupGlyph = [this](uint32_t const ch) {
-        return ch >= CharCodeMap.size() ? -1 : CharCodeMap[ch];
-    };
+    auto lookupGlyph = [this](uint32_t const ch) { return CharCodeMap.Find(ch); };
 
-    int glyphIndex =
-        lookupGlyph(charCode); // charCode >= CharCodeMap.size() ? -1 : CharCodeMap[charCode];
+    int glyphIndex = lookupGlyph(charCode);
     if (glyphIndex < 0 || glyphIndex >= static_cast<int>(Glyphs.size())) {
 #if defined(OVR_BUILD_DEBUG)
         OVR_WARN(
-            "FontInfoType::GlyphForCharCode FAILED TO FIND GLYPH FOR CHARACTER! charCode %u => %i [mapsize=%zu] [glyphsize=%i]",
+            "FontInfoType::GlyphForCharCode FAILED TO FIND GLYPH FOR CHARACTER! charCode %u => %i [glyphsize=%i]",
             charCode,
             glyphIndex,
-            CharCodeMap.size(),
             static_cast<int>(Glyphs.size()));
 #endif
 
@@ -1636,6 +1796,33 @@ bool BitmapFontLocal::WordWrapText(
     return WordWrapText(inOutText, widthMeters, std::vector<std::string>(), fontScale);
 }
 
+//==============================
+// IsPostLineBreakChar
+// Characters after which a line break can be added.
+static bool IsPostLineBreakChar(uint32_t const ch) {
+    switch (ch) {
+        case ',':
+        case '.':
+        case ':':
+        case ';':
+        case '>':
+        case '!':
+        case '?':
+        case ')':
+        case ']':
+        case '-':
+        case '=':
+        case '+':
+        case '*':
+        case '\\':
+        case '/':
+        case 0x3002: // Chinese 'full-stop
+            return true;
+        default:
+            return false;
+    }
+}
+
 //==============================
 // BitmapFontLocal::WordWrapText
 bool BitmapFontLocal::WordWrapText(
@@ -1653,64 +1840,17 @@ bool BitmapFontLocal::WordWrapText(
 ///	ALOG( "Word-wrapping '%s' ... ", source );
 #endif
 
-    // we will change characters in the new string and can potentially add line breaks after some
-    // characters so it may grow larger than the original string. While determining the length of
-    // the string, find any characters that may potentially have a line break added after them and
-    // increase the string length by 1 for each.
-    auto IsPostLineBreakChar = [](uint32_t const ch) {
-        // array of characters after which we can add line breaks.
-        uint32_t const postLineBreakChars[] = {
-            ',',
-            '.',
-            ':',
-            ';',
-            '>',
-            '!',
-            '?',
-            ')',
-            ']',
-            '-',
-            '=',
-            '+',
-            '*',
-            '\\',
-            '/',
-            0x3002, // Chinese 'full-stop
-            '\0' // list terminator
-        };
-
-        for (int i = 0; postLineBreakChars[i] != 0; ++i) {
-            if (ch == postLineBreakChars[i]) {
-                return true;
-            }
-        }
-        return false;
-    };
-
-    size_t lengthInBytes = 0;
-    char const* cur = source;
-    for (;;) {
-        char const* prev = cur;
-        uint32_t const charCode = UTF8Util::DecodeNextChar(&cur);
-        ptrdiff_t const numBytes = cur - prev;
-
-        if (charCode == '\0') {
-            break;
-        }
-
-        lengthInBytes += static_cast<int>(numBytes);
-
-        if (IsPostLineBreakChar(charCode)) {
-            ++lengthInBytes; // add one byte for '\n'
-        }
-    }
+    // decode the whole string once, the byte offsets are needed to copy formatting escapes
+    std::vector<uint32_t> chars;
+    std::vector<int32_t> offsets;
+    UTF8Util::DecodeChars(source, chars, &offsets);
+    int const numChars = static_cast<int>(chars.size());
 
-    // we now have the maximum possible length of the string with line-breaks.
-    char* dest = new char[lengthInBytes + 1];
-    dest[lengthInBytes] = '\0';
-    intptr_t destOffset = 0;
+    // line breaks are either written over a space or inserted after a break character, inserting
+    // only moves the characters after the last break point on the current line.
+    std::string dest;
+    dest.reserve(inOutText.length() + inOutText.length() / 8 + 1);
 
-    cur = source; // reset
     intptr_t lastLineBreakOfs = -1;
     intptr_t lastPostLineBreakOfs = -1;
 
@@ -1718,31 +1858,30 @@ bool BitmapFontLocal::WordWrapText(
     double lineWidthAtLastBreak = 0.0;
     double lineWidth = 0.0;
 
-    while (*cur != '\0') {
+    for (int i = 0; i < numChars;) {
         // skip over formatting
         uint32_t color;
         uint32_t weight;
+        char const* cur = source + offsets[i];
         char const* p = cur;
         while (CheckForFormatEscape(&p, color, weight)) {
         }
-        ptrdiff_t numFormatChars = p - cur;
-        if (numFormatChars > 0) {
+        if (p > cur) {
             // copy the formatting to the destination
-            memcpy(dest + destOffset, cur, numFormatChars);
-            cur += numFormatChars;
-            destOffset += numFormatChars;
+            dest.append(cur, p - cur);
+            int32_t const formatEnd = static_cast<int32_t>(p - source);
+            while (i < numChars && offsets[i] < formatEnd) {
+                ++i;
+            }
+            if (i == numChars) {
+                break;
+            }
         }
 
         double lastLineWidth = lineWidth;
-        intptr_t lastDestOffset = destOffset;
+        intptr_t lastDestOffset = static_cast<intptr_t>(dest.length());
 
-        char const* pre = cur;
-        uint32_t charCode = UTF8Util::DecodeNextChar(&cur);
-        if (charCode == '\0') {
-            UTF8Util::EncodeChar(dest, &destOffset, '\0');
-            break;
-        }
-        intptr_t const charCodeSize = cur - pre;
+        uint32_t charCode = chars[i++];
 
         // replace tabs with a space
         if (charCode == '\t') {
@@ -1750,25 +1889,23 @@ bool BitmapFontLocal::WordWrapText(
         }
 
         if (charCode == ' ') {
-            lastLineBreakOfs = destOffset;
+            lastLineBreakOfs = static_cast<intptr_t>(dest.length());
             lineWidthAtLastBreak = lineWidth; // line width *before* the space
         } else if (charCode == '\\') {
             // replace verbatim  and "\r" with explicit breaks
-            char const* temp = cur;
-            uint32_t nextCode = UTF8Util::DecodeNextChar(&temp);
-            if (nextCode == 'r' || nextCode == 'n') {
+            if (i < numChars && (chars[i] == 'r' || chars[i] == 'n')) {
                 lineWidth = 0.0;
                 lineWidthAtLastBreak = 0.0;
-                cur = temp; // skip the next character
+                i++; // skip the next character
                 // output a linefeed
-                UTF8Util::EncodeChar(dest, &destOffset, '\n');
+                dest += '\n';
                 continue;
             }
         } else if (charCode == '\r' || charCode == '\n') {
             lineWidth = 0.0;
             lineWidthAtLastBreak = 0.0;
             // output a linefeed
-            UTF8Util::EncodeChar(dest, &destOffset, '\n');
+            dest += '\n';
             continue;
         }
 
@@ -1785,51 +1922,21 @@ bool BitmapFontLocal::WordWrapText(
                     // some arbitrary character. This is fine for Chinese, but not for western
                     // languages. It's also relatively rare for western languages since they use
                     // spaces between each word.
-                    /*if ( !isCJK )
-                    {
-                        return false;
-                    }*/
                     // just break at the last character that didn't exceed the line width
                     lastPostLineBreakOfs = lastDestOffset;
                     lineWidthAtLastBreak = lastLineWidth;
                 }
 
-                intptr_t bestBreakOfs = lastLineBreakOfs > lastPostLineBreakOfs
+                intptr_t const bestBreakOfs = lastLineBreakOfs > lastPostLineBreakOfs
                     ? lastLineBreakOfs
                     : lastPostLineBreakOfs;
 
-                char* destBreakPoint = dest + bestBreakOfs;
-
-                bool const overwrite = bestBreakOfs != lastPostLineBreakOfs;
-                if (overwrite) {
-                    // we overwrote with a single byte, but we could have overwritten a multi-byte
-                    // unicode character so we may need to shift the entire destination string down
-                    // by (sizeof overwritten char) - 1 bytes. decode the character at the bestBreak
-                    // point to determine how many bytes we need to skip
-                    char const* afterDestBreakPoint = destBreakPoint;
-                    uint32_t const overwrittenCode = UTF8Util::DecodeNextChar(&afterDestBreakPoint);
-                    OVR_UNUSED(overwrittenCode);
-
-                    // encode the line feed over the last break point.
-                    UTF8Util::EncodeChar(dest, &bestBreakOfs, '\n');
-
-                    // determine if we need to shift the dest text down
-                    ptrdiff_t numBytesToSkip = afterDestBreakPoint - destBreakPoint;
-                    if (numBytesToSkip > 1) {
-                        memcpy(
-                            dest + bestBreakOfs + 1,
-                            dest + bestBreakOfs + numBytesToSkip,
-                            lengthInBytes - bestBreakOfs);
-                        destOffset -= numBytesToSkip - 1;
-                    }
+                if (bestBreakOfs != lastPostLineBreakOfs) {
+                    // the break point is a space, replace it with the line feed
+                    dest[bestBreakOfs] = '\n';
                 } else {
-                    // move the buffer contents after the insertion point to make room for 1 byte
-                    for (intptr_t ofs = destOffset; ofs > bestBreakOfs; --ofs) {
-                        dest[ofs] = dest[ofs - 1];
-                    }
-                    // encode the line feed after the last break point
-                    UTF8Util::EncodeChar(dest, &bestBreakOfs, '\n');
-                    destOffset++;
+                    // insert the line feed after the break character
+                    dest.insert(dest.begin() + bestBreakOfs, '\n');
                 }
             }
 
@@ -1841,33 +1948,20 @@ bool BitmapFontLocal::WordWrapText(
             lineWidth -= lineWidthAtLastBreak;
         }
 
+        // output the current character to the destination buffer
+        char encoded[8];
+        intptr_t encodedSize = 0;
+        UTF8Util::EncodeChar(encoded, &encodedSize, charCode);
+
         if (IsPostLineBreakChar(charCode)) {
-            lastPostLineBreakOfs = destOffset + charCodeSize;
+            lastPostLineBreakOfs = static_cast<intptr_t>(dest.length()) + encodedSize;
             lineWidthAtLastBreak = lineWidth; // line width *after* the break char
         }
 
-        // output the current character to the destination buffer
-        UTF8Util::EncodeChar(dest, &destOffset, charCode);
-
-        // in CJK cases we cannot be absolutely certain of the number of breaks until we've scanned
-        // everything and computed the width (because we may break at any character). In that case,
-        // we may need to expand the buffer.
-        if (destOffset + 6 >
-            static_cast<intptr_t>(lengthInBytes)) // 6 bytes is max UTF-8 encoding size
-        {
-            size_t newLen = (lengthInBytes * 3) / 2;
-            char* newDest = new char[newLen + 1];
-            memcpy(newDest, dest, destOffset);
-            newDest[newLen] = '\0';
-            delete[] dest;
-            dest = newDest;
-            lengthInBytes = newLen;
-        }
+        dest.append(encoded, encodedSize);
     }
 
-    dest[destOffset] = '\0';
     inOutText = dest;
-    delete[] dest;
 
 #if defined(OVR_BUILD_DEBUG)
 ///	ALOG( "Word-wrapping '%s' -> '%s' DONE", source, inOutText.c_str() );
@@ -1885,24 +1979,27 @@ float BitmapFontLocal::GetFirstFitChars(
         return 0;
     }
 
+    std::vector<uint32_t> chars;
+    std::vector<int32_t> offsets;
+    UTF8Util::DecodeChars(inOutText.c_str(), chars, &offsets);
+
     float const xScale = FontInfo.ScaleFactorX * fontScale;
     float lineWidth = 0.0f;
     int remainingLines = numLines;
 
-    for (int32_t pos = 0; pos < static_cast<int32_t>(inOutText.length()); ++pos) {
-        uint32_t charCode = UTF8Util::GetCharAt(pos, inOutText.c_str());
+    for (int i = 0; i < static_cast<int>(chars.size()); ++i) {
+        uint32_t const charCode = chars[i];
         if (charCode == '\n') {
             remainingLines--;
             if (remainingLines == 0) {
-                inOutText = inOutText.substr(0, pos);
+                inOutText.resize(offsets[i]);
                 return widthMeters - lineWidth;
             }
-        } else if (charCode != '\0') {
+        } else {
             FontGlyphType const& glyph = GlyphForCharCode(charCode);
             lineWidth += glyph.AdvanceX * xScale;
             if (lineWidth > widthMeters) {
-                inOutText =
-                    inOutText.substr(0, pos - 1); // -1 to not include current char that didn't fit.
+                inOutText.resize(offsets[i]); // don't include the current char that didn't fit.
                 return widthMeters - (lineWidth - glyph.AdvanceX * xScale);
             }
         }
@@ -1919,16 +2016,20 @@ float BitmapFontLocal::GetLastFitChars(
         return 0;
     }
 
+    std::vector<uint32_t> chars;
+    std::vector<int32_t> offsets;
+    UTF8Util::DecodeChars(inOutText.c_str(), chars, &offsets);
+
     float const xScale = FontInfo.ScaleFactorX * fontScale;
     float lineWidth = 0.0f;
 
-    for (int32_t pos = static_cast<int32_t>(inOutText.length()) - 1; pos >= 0; --pos) {
-        uint32_t charCode = UTF8Util::GetCharAt(pos, inOutText.c_str());
-        FontGlyphType const& glyph = GlyphForCharCode(charCode);
+    int const numChars = static_cast<int>(chars.size());
+    for (int i = numChars - 1; i >= 0; --i) {
+        FontGlyphType const& glyph = GlyphForCharCode(chars[i]);
         lineWidth += glyph.AdvanceX * xScale;
         if (lineWidth > widthMeters) {
-            inOutText = inOutText.substr(
-                pos + 1, inOutText.length()); // +1 to not include current char that didn't fit.
+            // don't include the current char that didn't fit.
+            inOutText.erase(0, i + 1 < numChars ? offsets[i + 1] : inOutText.length());
             return widthMeters - (lineWidth - glyph.AdvanceX * xScale);
         }
     }
@@ -2120,7 +2221,9 @@ BitmapFontSurfaceLocal::BitmapFontSurfaceLocal()
       MaxIndices(0),
       CurVertex(0),
       CurIndex(0),
-      Initialized(false) {}
+      Initialized(false),
+      NextSerial(1),
+      FrameNumber(0) {}
 
 //==============================
 // BitmapFontSurfaceLocal::~BitmapFontSurfaceLocal
@@ -2151,6 +2254,7 @@ void BitmapFontSurfaceLocal::Init(const int maxVertices) {
 
     CurVertex = 0;
     CurIndex = 0;
+    Slots.clear();
 
     Bounds3f localBounds(Bounds3f::Init);
     FontSurfaceDef.geo = FontGeometry(MaxVertices / 4, localBounds);
@@ -2200,14 +2304,138 @@ Vector3f BitmapFontSurfaceLocal::DrawText3D(
     if (text == NULL || text[0] == '\0') {
         return Vector3f::ZERO; // nothing to do here, move along
     }
-    Vector3f toNextLine;
-    VertexBlockType vb =
-        DrawTextToVertexBlock(font, parms, pos, normal, up, scale, color, text, &toNextLine);
+    OVR_ASSERT(parms.Billboard || (normal.IsNormalized() && up.IsNormalized()));
+
+    int const layoutIndex = FindLayout(font, parms, scale, color, text);
+    ovrTextLayout const& layout = Layouts[layoutIndex];
+
+    ovrTextBlock block;
+    block.Layout = layoutIndex;
+    block.Pivot = pos;
+    block.Billboard = parms.Billboard;
+    block.TrackRoll = parms.TrackRoll;
+    if (parms.Billboard) {
+        TextBlocks.push_back(block);
+        return layout.ToNextLine;
+    }
+
+    // the layout's x and y axes become the text's right and up
+    Vector3f const right = up.Cross(normal);
+    block.Transform.SetXBasis(right);
+    block.Transform.SetYBasis(up);
+    block.Transform.SetZBasis(normal);
+    block.Transform.SetTranslation(pos);
+    TextBlocks.push_back(block);
+
+    return right * layout.ToNextLine.x + up * layout.ToNextLine.y + normal * layout.ToNextLine.z;
+}
+
+//==============================
+// HashTextLayout
+static uint64_t HashTextLayout(
+    BitmapFont const& font,
+    fontParms_t const& parms,
+    float const scale,
+    uint32_t const color,
+    char const* text) {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    auto hashBytes = [&hash](void const* data, size_t const size) {
+        uint8_t const* bytes = static_cast<uint8_t const*>(data);
+        for (size_t i = 0; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * 1099511628211ULL;
+        }
+    };
+    hashBytes(text, strlen(text));
+    BitmapFont const* fontPtr = &font;
+    int const align[2] = {static_cast<int>(parms.AlignHoriz), static_cast<int>(parms.AlignVert)};
+    float const values[3] = {parms.AlphaCenter, parms.ColorCenter, scale};
+    hashBytes(&fontPtr, sizeof(fontPtr));
+    hashBytes(align, sizeof(align));
+    hashBytes(values, sizeof(values));
+    hashBytes(&color, sizeof(color));
+    return hash;
+}
+
+//==============================
+// BitmapFontSurfaceLocal::FindLayout
+// Returns the cached layout of the text, laying it out first if it is not in the cache.
+int BitmapFontSurfaceLocal::FindLayout(
+    BitmapFont const& font,
+    fontParms_t const& parms,
+    float const scale,
+    Vector4f const& color,
+    char const* text) {
+    uint32_t const abgr = ColorToABGR(color);
+    uint64_t const hash = HashTextLayout(font, parms, scale, abgr, text);
+
+    auto range = LayoutLookup.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        ovrTextLayout& layout = Layouts[it->second];
+        if (layout.Font == &font && layout.Parms.AlignHoriz == parms.AlignHoriz &&
+            layout.Parms.AlignVert == parms.AlignVert &&
+            layout.Parms.AlphaCenter == parms.AlphaCenter &&
+            layout.Parms.ColorCenter == parms.ColorCenter && layout.Scale == scale &&
+            layout.Color == abgr && layout.Text == text) {
+            layout.LastUsedFrame = FrameNumber;
+            return it->second;
+        }
+    }
+
+    int layoutIndex;
+    if (!FreeLayouts.empty()) {
+        layoutIndex = FreeLayouts.back();
+        FreeLayouts.pop_back();
+    } else {
+        layoutIndex = static_cast<int>(Layouts.size());
+        Layouts.push_back(ovrTextLayout());
+    }
+    LayoutLookup.emplace(hash, layoutIndex);
+
+    ovrTextLayout& layout = Layouts[layoutIndex];
+    layout.Text = text;
+    layout.Font = &font;
+    layout.Parms = parms;
+    layout.Scale = scale;
+    layout.Color = abgr;
+    layout.Hash = hash;
+    layout.Serial = NextSerial++;
+    layout.LastUsedFrame = FrameNumber;
+
+    // lay the text out facing +z with y up, DrawText3D and Finish rotate it into place
+    VertexBlockType vb = DrawTextToVertexBlock(
+        font,
+        parms,
+        Vector3f(0.0f),
+        Vector3f(0.0f, 0.0f, 1.0f),
+        Vector3f(0.0f, 1.0f, 0.0f),
+        scale,
+        color,
+        text,
+        &layout.ToNextLine);
+    layout.Verts.assign(vb.Verts, vb.Verts + vb.NumVerts);
+    vb.Free();
 
-    // add the new vertex block to the array of vertex blocks
-    VertexBlocks.push_back(vb);
+    return layoutIndex;
+}
 
-    return toNextLine;
+//==============================
+// BitmapFontSurfaceLocal::EvictLayouts
+// Frees the layouts of text that has not been drawn for a while.
+void BitmapFontSurfaceLocal::EvictLayouts() {
+    for (auto it = LayoutLookup.begin(); it != LayoutLookup.end();) {
+        ovrTextLayout& layout = Layouts[it->second];
+        if (FrameNumber - layout.LastUsedFrame <= MAX_UNUSED_LAYOUT_FRAMES) {
+            ++it;
+            continue;
+        }
+        FreeLayouts.push_back(it->second);
+        layout.Text.clear();
+        layout.Font = nullptr;
+        layout.Serial = 0;
+        std::vector<fontVertex_t>().swap(layout.Verts);
+        it = LayoutLookup.erase(it);
+    }
 }
 
 //==============================
@@ -2302,88 +2530,137 @@ void BitmapFontSurfaceLocal::Finish(Matrix4f const& viewMatrix) {
     Vector3f viewUp = GetViewMatrixUp(viewMatrix);
 
     // sort vertex blocks indices based on distance to pivot
-    int const MAX_VERTEX_BLOCKS = 256;
-    vbSort_t vbSort[MAX_VERTEX_BLOCKS];
-    int const n = VertexBlocks.size();
+    int const n = static_cast<int>(TextBlocks.size());
+    std::vector<vbSort_t> vbSort(n);
     for (int i = 0; i < n; ++i) {
         vbSort[i].VertexBlockIndex = i;
-        VertexBlockType& vb = VertexBlocks[i];
-        vbSort[i].DistanceSquared = (vb.Pivot - viewPos).LengthSq();
+        vbSort[i].DistanceSquared = (TextBlocks[i].Pivot - viewPos).LengthSq();
     }
 
-    qsort(vbSort, n, sizeof(vbSort[0]), VertexBlockSortFn);
+    qsort(vbSort.data(), n, sizeof(vbSort[0]), VertexBlockSortFn);
 
     // transform the vertex blocks into the vertices array
     CurIndex = 0;
     CurVertex = 0;
+    NewSlots.clear();
+    DirtyRanges.clear();
 
     // TODO:
     // To add multiple-font-per-surface support, we need to add a 3rd component to s and t,
     // then get the font for each vertex block, and set the texture index on each vertex in
     // the third texture coordinate.
-    for (int i = 0; i < static_cast<int>(VertexBlocks.size()); ++i) {
-        VertexBlockType& vb = VertexBlocks[vbSort[i].VertexBlockIndex];
+    for (int i = 0; i < n; ++i) {
+        ovrTextBlock const& block = TextBlocks[vbSort[i].VertexBlockIndex];
+        ovrTextLayout const& layout = Layouts[block.Layout];
+        int const numVerts = static_cast<int>(layout.Verts.size());
+        if (numVerts == 0) {
+            continue;
+        }
+
         Matrix4f transform;
-        if (vb.Billboard) {
-            if (vb.TrackRoll) {
+        if (block.Billboard) {
+            if (block.TrackRoll) {
                 transform = invViewMatrix;
             } else {
-                Vector3f textNormal = viewPos - vb.Pivot;
+                Vector3f textNormal = viewPos - block.Pivot;
                 float const len = textNormal.Length();
                 if (len < MATH_FLOAT_SMALLEST_NON_DENORMAL) {
-                    vb.Free();
                     continue;
                 }
                 textNormal *= 1.0f / len;
                 transform = Matrix4f::CreateFromBasisVectors(textNormal, viewUp * -1.0f);
             }
-            transform.SetTranslation(vb.Pivot);
+            transform.SetTranslation(block.Pivot);
         } else {
-            transform.SetIdentity();
-            transform.SetTranslation(vb.Pivot);
+            transform = block.Transform;
         }
 
-        for (int j = 0; j < vb.NumVerts; j++) {
-            fontVertex_t const& v = vb.Verts[j];
-            Vector3f const position = transform.Transform(v.xyz);
+        // If you hit this assert you're likely trying to draw
+        // too much text for the current buffer size,
+        // most likely need to update the value
+        // passed to fontSurface->Init() in OvrGuiSysLocal::Init
+        //
+        // Note: Vertices is *not* a dynamic std::vector
+        // because it gets copies into GPU memory, which is reserved
+        // separately. If you decide to make this system dynamic
+        // remember to scale re-allocate the OpenGL VBOs as well
+        if (CurVertex + numVerts > MaxVertices) {
+            OVR_FAIL(
+                "Application tried to draw more text than there is buffer for. "
+                "This failure protects agains a buffer overflow");
+        }
 
-            // If you hit this assert you're likely trying to draw
-            // too much text for the current buffer size,
-            // most likely need to update the value
-            // passed to fontSurface->Init() in OvrGuiSysLocal::Init
-            //
-            // Note: Vertices is *not* a dynamic std::vector
-            // because it gets copies into GPU memory, which is reserved
-            // separately. If you decide to make this system dynamic
-            // remember to scale re-allocate the OpenGL VBOs as well
-            if (CurVertex >= MaxVertices) {
-                OVR_FAIL(
-                    "Application tried to draw more text than there is buffer for. "
-                    "This failure protects agains a buffer overflow");
+        // the vertices are already in the buffer if the same layout was written to the same place
+        // with the same transform last frame
+        int const slotIndex = static_cast<int>(NewSlots.size());
+        if (slotIndex < static_cast<int>(Slots.size())) {
+            ovrTextSlot const& prev = Slots[slotIndex];
+            if (prev.Serial == layout.Serial && prev.FirstVertex == CurVertex &&
+                prev.Transform == transform) {
+                NewSlots.push_back(prev);
+                FontSurfaceDef.geo.localBounds =
+                    Bounds3f::Union(FontSurfaceDef.geo.localBounds, prev.Bounds);
+                CurVertex += numVerts;
+                CurIndex += (numVerts / 2) * 3;
+                continue;
             }
+        }
+
+        ovrTextSlot slot;
+        slot.Serial = layout.Serial;
+        slot.FirstVertex = CurVertex;
+        slot.Transform = transform;
+        slot.Bounds.Clear();
+        for (int j = 0; j < numVerts; j++) {
+            fontVertex_t const& v = layout.Verts[j];
+            Vector3f const position = transform.Transform(v.xyz);
 
-            Vertices[CurVertex].xyz = position;
-            Vertices[CurVertex].s = v.s;
-            Vertices[CurVertex].t = v.t;
-            *(std::uint32_t*)(&Vertices[CurVertex].rgba[0]) = *(std::uint32_t*)(&v.rgba[0]);
-            *(std::uint32_t*)(&Vertices[CurVertex].fontParms[0]) =
+            Vertices[CurVertex + j].xyz = position;
+            Vertices[CurVertex + j].s = v.s;
+            Vertices[CurVertex + j].t = v.t;
+            *(std::uint32_t*)(&Vertices[CurVertex + j].rgba[0]) = *(std::uint32_t*)(&v.rgba[0]);
+            *(std::uint32_t*)(&Vertices[CurVertex + j].fontParms[0]) =
                 *(std::uint32_t*)(&v.fontParms[0]);
-            CurVertex++;
 
-            FontSurfaceDef.geo.localBounds.AddPoint(position);
+            slot.Bounds.AddPoint(position);
+        }
+        NewSlots.push_back(slot);
+        FontSurfaceDef.geo.localBounds =
+            Bounds3f::Union(FontSurfaceDef.geo.localBounds, slot.Bounds);
+
+        if (!DirtyRanges.empty() &&
+            DirtyRanges.back().second + MIN_UPLOAD_GAP_VERTICES >= CurVertex) {
+            DirtyRanges.back().second = CurVertex + numVerts;
+        } else {
+            DirtyRanges.push_back(std::make_pair(CurVertex, CurVertex + numVerts));
         }
-        CurIndex += (vb.NumVerts / 2) * 3;
-        // free this vertex block
-        vb.Free();
+
+        CurVertex += numVerts;
+        CurIndex += (numVerts / 2) * 3;
     }
     // remove all elements from the vertex block (but don't free the memory since it's likely to be
     // needed on the next frame.
-    VertexBlocks.clear();
-
-    glBindVertexArray(FontSurfaceDef.geo.vertexArrayObject);
-    glBindBuffer(GL_ARRAY_BUFFER, FontSurfaceDef.geo.vertexBuffer);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, CurVertex * sizeof(fontVertex_t), (void*)Vertices);
-    glBindVertexArray(0);
+    TextBlocks.clear();
+    Slots.swap(NewSlots);
+
+    FrameNumber++;
+    EvictLayouts();
+
+    // only upload the ranges of the buffer that changed
+    if (!DirtyRanges.empty()) {
+        glBindVertexArray(FontSurfaceDef.geo.vertexArrayObject);
+        glBindBuffer(GL_ARRAY_BUFFER, FontSurfaceDef.geo.vertexBuffer);
+        for (int i = 0; i < static_cast<int>(DirtyRanges.size()); ++i) {
+            int const first = DirtyRanges[i].first;
+            int const count = DirtyRanges[i].second - first;
+            glBufferSubData(
+                GL_ARRAY_BUFFER,
+                first * sizeof(fontVertex_t),
+                count * sizeof(fontVertex_t),
+                (void*)(Vertices + first));
+        }
+        glBindVertexArray(0);
+    }
     FontSurfaceDef.geo.indexCount = CurIndex;
 }
 
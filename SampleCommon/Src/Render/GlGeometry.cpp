@@ -43,65 +43,136 @@ GlGeometry::TransformScope::~TransformScope() {
     geometryTransfom = previousTransform;
 }
 
-unsigned GlGeometry::IndexType = (sizeof(TriangleIndex) == 2) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
-
-template <typename _attrib_type_>
-void PackVertexAttribute(
-    std::vector<uint8_t>& packed,
-    const std::vector<_attrib_type_>& attrib,
-    const int glLocation,
-    const int glType,
-    const int glComponents) {
-    if (attrib.size() > 0) {
-        const size_t offset = packed.size();
-        const size_t size = attrib.size() * sizeof(attrib[0]);
-
-        packed.resize(offset + size);
-        memcpy(&packed[offset], attrib.data(), size);
-
-        glEnableVertexAttribArray(glLocation);
+static void SetVertexAttribPointers(const std::vector<VertexAttributeBinding>& bindings) {
+    static const int locations[VERTEX_ATTRIBUTE_MAX] = {
+        VERTEX_ATTRIBUTE_LOCATION_POSITION,
+        VERTEX_ATTRIBUTE_LOCATION_NORMAL,
+        VERTEX_ATTRIBUTE_LOCATION_TANGENT,
+        VERTEX_ATTRIBUTE_LOCATION_BINORMAL,
+        VERTEX_ATTRIBUTE_LOCATION_COLOR,
+        VERTEX_ATTRIBUTE_LOCATION_UV0,
+        VERTEX_ATTRIBUTE_LOCATION_UV1,
+        VERTEX_ATTRIBUTE_LOCATION_JOINT_INDICES,
+        VERTEX_ATTRIBUTE_LOCATION_JOINT_WEIGHTS};
+
+    bool enabled[VERTEX_ATTRIBUTE_MAX] = {};
+    for (const VertexAttributeBinding& b : bindings) {
+        GLenum glType = GL_FLOAT;
+        GLboolean normalized = GL_FALSE;
+        switch (b.format) {
+            case VERTEX_FORMAT_NONE:
+            case VERTEX_FORMAT_FLOAT:
+                glType = GL_FLOAT;
+                break;
+            case VERTEX_FORMAT_HALF:
+                glType = GL_HALF_FLOAT;
+                break;
+            case VERTEX_FORMAT_SNORM16:
+            case VERTEX_FORMAT_OCTAHEDRAL16:
+                glType = GL_SHORT;
+                normalized = GL_TRUE;
+                break;
+            case VERTEX_FORMAT_SNORM8:
+                glType = GL_BYTE;
+                normalized = GL_TRUE;
+                break;
+            case VERTEX_FORMAT_UNORM16:
+                glType = GL_UNSIGNED_SHORT;
+                normalized = GL_TRUE;
+                break;
+            case VERTEX_FORMAT_UNORM8:
+                glType = GL_UNSIGNED_BYTE;
+                normalized = GL_TRUE;
+                break;
+            // integer attributes are read as floats, like the GL_INT joint indices always were
+            case VERTEX_FORMAT_INT32:
+                glType = GL_INT;
+                break;
+            case VERTEX_FORMAT_UINT16:
+                glType = GL_UNSIGNED_SHORT;
+                break;
+            case VERTEX_FORMAT_UINT8:
+                glType = GL_UNSIGNED_BYTE;
+                break;
+        }
+        const int location = locations[b.attribute];
+        glEnableVertexAttribArray(location);
         glVertexAttribPointer(
-            glLocation, glComponents, glType, false, sizeof(attrib[0]), (void*)(offset));
-    } else {
-        glDisableVertexAttribArray(glLocation);
+            location, b.components, glType, normalized, b.stride, (void*)(size_t)(b.offset));
+        enabled[b.attribute] = true;
+    }
+    for (int i = 0; i < VERTEX_ATTRIBUTE_MAX; ++i) {
+        if (!enabled[i]) {
+            glDisableVertexAttribArray(locations[i]);
+        }
     }
 }
 
 void GlGeometry::Create(const VertexAttribs& attribs, const std::vector<TriangleIndex>& indices) {
-    vertexCount = attribs.position.size();
+    Create(attribs, indices, VertexLayout());
+}
+
+void GlGeometry::Create(
+    const VertexAttribs& attribs,
+    const std::vector<TriangleIndex>& indices,
+    const VertexLayout& vertexLayout) {
     indexCount = indices.size();
+    indexType = GL_UNSIGNED_SHORT;
+    CreateBuffers(attribs, indices.data(), indices.size() * sizeof(indices[0]), vertexLayout);
+}
 
-    const bool t = enableGeometryTransfom;
+void GlGeometry::Create(
+    const VertexAttribs& attribs,
+    const std::vector<uint32_t>& indices,
+    const VertexLayout& vertexLayout) {
+    if (static_cast<int>(attribs.position.size()) <= MAX_GEOMETRY_VERTICES) {
+        std::vector<TriangleIndex> shortIndices(indices.size());
+        for (int i = 0; i < static_cast<int>(indices.size()); ++i) {
+            shortIndices[i] = static_cast<TriangleIndex>(indices[i]);
+        }
+        Create(attribs, shortIndices, vertexLayout);
+        return;
+    }
+    indexCount = indices.size();
+    indexType = GL_UNSIGNED_INT;
+    CreateBuffers(attribs, indices.data(), indices.size() * sizeof(indices[0]), vertexLayout);
+}
+
+void GlGeometry::CreateBuffers(
+    const VertexAttribs& attribs,
+    const void* indexData,
+    const size_t indexSize,
+    const VertexLayout& vertexLayout) {
+    vertexCount = attribs.position.size();
+    layout = vertexLayout;
 
-    std::vector<OVR::Vector3f> position;
-    std::vector<OVR::Vector3f> normal;
-    std::vector<OVR::Vector3f> tangent;
-    std::vector<OVR::Vector3f> binormal;
+    std::vector<uint8_t> packed;
+    std::vector<VertexAttributeBinding> bindings;
 
     /// we asked for incoming transfom
-    if (t) {
-        position.resize(attribs.position.size());
-        normal.resize(attribs.normal.size());
-        tangent.resize(attribs.position.size());
-        binormal.resize(attribs.binormal.size());
+    if (enableGeometryTransfom) {
+        VertexAttribs transformed = attribs;
 
         /// poor man's 3x3
         OVR::Matrix4f nt = geometryTransfom.Transposed();
 
         /// Positions use 4x4
-        for (size_t i = 0; i < attribs.position.size(); ++i) {
-            position[i] = geometryTransfom.Transform(attribs.position[i]);
+        for (size_t i = 0; i < transformed.position.size(); ++i) {
+            transformed.position[i] = geometryTransfom.Transform(attribs.position[i]);
         }
         /// TBN use 3x3
-        for (size_t i = 0; i < attribs.normal.size(); ++i) {
-            normal[i] = nt.Transform(attribs.normal[i]).Normalized();
+        for (size_t i = 0; i < transformed.normal.size(); ++i) {
+            transformed.normal[i] = nt.Transform(attribs.normal[i]).Normalized();
         }
-        for (size_t i = 0; i < attribs.tangent.size(); ++i) {
-            tangent[i] = nt.Transform(attribs.tangent[i]).Normalized();
+        for (size_t i = 0; i < transformed.tangent.size(); ++i) {
+            transformed.tangent[i] = nt.Transform(attribs.tangent[i]).Normalized();
         }
-        for (size_t i = 0; i < attribs.binormal.size(); ++i) {
-            binormal[i] = nt.Transform(attribs.binormal[i]).Normalized();
+        for (size_t i = 0; i < transformed.binormal.size(); ++i) {
+            transformed.binormal[i] = nt.Transform(attribs.binormal[i]).Normalized();
         }
+        PackVertexAttribs(transformed, layout, packed, bindings);
+    } else {
+        PackVertexAttribs(attribs, layout, packed, bindings);
     }
 
     glGenBuffers(1, &vertexBuffer);
@@ -110,32 +181,12 @@ void GlGeometry::Create(const VertexAttribs& attribs, const std::vector<Triangle
     glBindVertexArray(vertexArrayObject);
     glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
 
-    std::vector<uint8_t> packed;
-    PackVertexAttribute(
-        packed, t ? position : attribs.position, VERTEX_ATTRIBUTE_LOCATION_POSITION, GL_FLOAT, 3);
-    PackVertexAttribute(
-        packed, t ? normal : attribs.normal, VERTEX_ATTRIBUTE_LOCATION_NORMAL, GL_FLOAT, 3);
-    PackVertexAttribute(
-        packed, t ? tangent : attribs.tangent, VERTEX_ATTRIBUTE_LOCATION_TANGENT, GL_FLOAT, 3);
-    PackVertexAttribute(
-        packed, t ? binormal : attribs.binormal, VERTEX_ATTRIBUTE_LOCATION_BINORMAL, GL_FLOAT, 3);
-    PackVertexAttribute(packed, attribs.color, VERTEX_ATTRIBUTE_LOCATION_COLOR, GL_FLOAT, 4);
-    PackVertexAttribute(packed, attribs.uv0, VERTEX_ATTRIBUTE_LOCATION_UV0, GL_FLOAT, 2);
-    PackVertexAttribute(packed, attribs.uv1, VERTEX_ATTRIBUTE_LOCATION_UV1, GL_FLOAT, 2);
-    PackVertexAttribute(
-        packed, attribs.jointIndices, VERTEX_ATTRIBUTE_LOCATION_JOINT_INDICES, GL_INT, 4);
-    PackVertexAttribute(
-        packed, attribs.jointWeights, VERTEX_ATTRIBUTE_LOCATION_JOINT_WEIGHTS, GL_FLOAT, 4);
-    // clang-format off
+    SetVertexAttribPointers(bindings);
 
     glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(packed[0]), packed.data(), GL_STATIC_DRAW);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
-    glBufferData(
-        GL_ELEMENT_ARRAY_BUFFER,
-        indices.size() * sizeof(indices[0]),
-        indices.data(),
-        GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexSize, indexData, GL_STATIC_DRAW);
 
     glBindVertexArray(0);
 
@@ -163,17 +214,9 @@ void GlGeometry::Update(const VertexAttribs& attribs, const bool updateBounds) {
     glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
 
     std::vector<uint8_t> packed;
-    PackVertexAttribute(packed, attribs.position, VERTEX_ATTRIBUTE_LOCATION_POSITION, GL_FLOAT, 3);
-    PackVertexAttribute(packed, attribs.normal, VERTEX_ATTRIBUTE_LOCATION_NORMAL, GL_FLOAT, 3);
-    PackVertexAttribute(packed, attribs.tangent, VERTEX_ATTRIBUTE_LOCATION_TANGENT, GL_FLOAT, 3);
-    PackVertexAttribute(packed, attribs.binormal, VERTEX_ATTRIBUTE_LOCATION_BINORMAL, GL_FLOAT, 3);
-    PackVertexAttribute(packed, attribs.color, VERTEX_ATTRIBUTE_LOCATION_COLOR, GL_FLOAT, 4);
-    PackVertexAttribute(packed, attribs.uv0, VERTEX_ATTRIBUTE_LOCATION_UV0, GL_FLOAT, 2);
-    PackVertexAttribute(packed, attribs.uv1, VERTEX_ATTRIBUTE_LOCATION_UV1, GL_FLOAT, 2);
-    PackVertexAttribute(
-        packed, attribs.jointIndices, VERTEX_ATTRIBUTE_LOCATION_JOINT_INDICES, GL_INT, 4);
-    PackVertexAttribute(
-        packed, attribs.jointWeights, VERTEX_ATTRIBUTE_LOCATION_JOINT_WEIGHTS, GL_FLOAT, 4);
+    std::vector<VertexAttributeBinding> bindings;
+    PackVertexAttribs(attribs, layout, packed, bindings);
+    SetVertexAttribPointers(bindings);
 
     glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(packed[0]), packed.data(), GL_STATIC_DRAW);
 
@@ -15,21 +15,10 @@ Authors     :   John Carmack
 #include "OVR_Math.h"
 
 #include "GlProgram.h"
+#include "VertexLayout.h"
 
 namespace OVRFW {
 
-struct VertexAttribs {
-    std::vector<OVR::Vector3f> position;
-    std::vector<OVR::Vector3f> normal;
-    std::vector<OVR::Vector3f> tangent;
-    std::vector<OVR::Vector3f> binormal;
-    std::vector<OVR::Vector4f> color;
-    std::vector<OVR::Vector2f> uv0;
-    std::vector<OVR::Vector2f> uv1;
-    std::vector<OVR::Vector4i> jointIndices;
-    std::vector<OVR::Vector4f> jointWeights;
-};
-
 typedef uint16_t TriangleIndex;
 
 class GlGeometry {
@@ -41,6 +30,7 @@ class GlGeometry {
           primitiveType(0x0004 /* GL_TRIANGLES */),
           vertexCount(0),
           indexCount(0),
+          indexType(0x1403 /* GL_UNSIGNED_SHORT */),
           localBounds(OVR::Bounds3f::Init) {}
 
     GlGeometry(const VertexAttribs& attribs, const std::vector<TriangleIndex>& indices)
@@ -50,12 +40,25 @@ class GlGeometry {
           primitiveType(0x0004 /* GL_TRIANGLES */),
           vertexCount(0),
           indexCount(0),
+          indexType(0x1403 /* GL_UNSIGNED_SHORT */),
           localBounds(OVR::Bounds3f::Init) {
         Create(attribs, indices);
     }
 
     // Create the VAO and vertex and index buffers from arrays of data.
     void Create(const VertexAttribs& attribs, const std::vector<TriangleIndex>& indices);
+    // Same, with the attributes converted to the formats of the layout, see VertexLayout::Compact.
+    void Create(
+        const VertexAttribs& attribs,
+        const std::vector<TriangleIndex>& indices,
+        const VertexLayout& vertexLayout);
+    // Uses 16 bit indices when all vertices can be addressed with them, 32 bit indices otherwise.
+    // Meshes that must stay on 16 bit indices can be split with SplitMesh first.
+    void Create(
+        const VertexAttribs& attribs,
+        const std::vector<uint32_t>& indices,
+        const VertexLayout& vertexLayout = VertexLayout());
+    // Repacks the vertices with the layout the geometry was created with.
     void Update(const VertexAttribs& attribs, const bool updateBounds = true);
 
     // Free the buffers and VAO, assuming that they are strictly for this geometry.
@@ -65,6 +68,7 @@ class GlGeometry {
     void Free();
 
    public:
+    // Vertex limit of geometry with 16 bit indices.
     static constexpr int32_t MAX_GEOMETRY_VERTICES = 1 << (sizeof(TriangleIndex) * 8);
     static constexpr int32_t MAX_GEOMETRY_INDICES = 1024 * 1024 * 3;
 
@@ -75,8 +79,6 @@ class GlGeometry {
         return MAX_GEOMETRY_INDICES;
     }
 
-    static unsigned IndexType; // GL_UNSIGNED_SHORT, GL_UNSIGNED_INT, etc.
-
     class TransformScope {
        public:
         TransformScope(const OVR::Matrix4f m, bool enableTransfom = true);
@@ -100,6 +102,13 @@ class GlGeometry {
         OVR::Matrix4f transform;
     };
 
+   private:
+    void CreateBuffers(
+        const VertexAttribs& attribs,
+        const void* indexData,
+        const size_t indexSize,
+        const VertexLayout& vertexLayout);
+
    public:
     unsigned vertexBuffer;
     unsigned indexBuffer;
@@ -107,7 +116,9 @@ class GlGeometry {
     unsigned primitiveType; // GL_TRIANGLES / GL_LINES / GL_POINTS / etc
     int vertexCount;
     int indexCount;
+    unsigned indexType; // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
     OVR::Bounds3f localBounds;
+    VertexLayout layout;
 };
 
 // Build it in a -1 to 1 range, which will be scaled to the appropriate
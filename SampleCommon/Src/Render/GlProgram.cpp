@@ -68,6 +68,14 @@ uniform SceneMatrices
 //	return hPos;
 //}
 #define TransformVertex(localPos) (sm.ProjectionMatrix[VIEW_ID] * ( sm.ViewMatrix[VIEW_ID] * ( ModelMatrix * localPos )))
+// Unit vector stored with VERTEX_FORMAT_OCTAHEDRAL16, see VertexLayout.h
+highp vec3 OctahedralDecode( highp vec2 e )
+{
+	highp vec3 n = vec3( e.x, e.y, 1.0 - abs( e.x ) - abs( e.y ) );
+	highp float t = max( -n.z, 0.0 );
+	n.xy += vec2( n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t );
+	return normalize( n );
+}
 )glsl";
 
 // All GlPrograms implicitly get the FragmentHeader
@@ -1525,6 +1525,43 @@ static int MipLevelsForSize(int width, int height) {
     return levels;
 }
 
+GlTexture LoadTextureFromRGBABuffer(
+    const char* fileName,
+    uint8_t* image,
+    const int width,
+    const int height,
+    const TextureFlags_t& flags) {
+    // Optionally outline the border alpha.
+    if (flags & TEXTUREFLAG_ALPHA_BORDER) {
+        for (int i = 0; i < width; i++) {
+            image[i * 4 + 3] = 0;
+            image[((height - 1) * width + i) * 4 + 3] = 0;
+        }
+        for (int i = 0; i < height; i++) {
+            image[i * width * 4 + 3] = 0;
+            image[(i * width + width - 1) * 4 + 3] = 0;
+        }
+    }
+
+    const size_t dataSize = GetOvrTextureSize(Texture_RGBA, width, height);
+    GlTexture texId = CreateGlTexture(
+        fileName,
+        Texture_RGBA,
+        width,
+        height,
+        image,
+        dataSize,
+        (flags & TEXTUREFLAG_NO_MIPMAPS) ? 1 : MipLevelsForSize(width, height),
+        flags & TEXTUREFLAG_USE_SRGB,
+        false);
+    if (texId.texture != 0 && !(flags & TEXTUREFLAG_NO_MIPMAPS)) {
+        glBindTexture(texId.target, texId.texture);
+        glGenerateMipmap(texId.target);
+        glTexParameteri(texId.target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    }
+    return texId;
+}
+
 GlTexture LoadTextureFromBuffer(
     const char* fileName,
     const uint8_t* buffer,
@@ -1558,35 +1595,8 @@ GlTexture LoadTextureFromBuffer(
         int comp;
         stbi_uc* image = stbi_load_from_memory(buffer, bufferSize, &width, &height, &comp, 4);
         if (image != NULL) {
-            // Optionally outline the border alpha.
-            if (flags & TEXTUREFLAG_ALPHA_BORDER) {
-                for (int i = 0; i < width; i++) {
-                    image[i * 4 + 3] = 0;
-                    image[((height - 1) * width + i) * 4 + 3] = 0;
-                }
-                for (int i = 0; i < height; i++) {
-                    image[i * width * 4 + 3] = 0;
-                    image[(i * width + width - 1) * 4 + 3] = 0;
-                }
-            }
-
-            const size_t dataSize = GetOvrTextureSize(Texture_RGBA, width, height);
-            texId = CreateGlTexture(
-                fileName,
-                Texture_RGBA,
-                width,
-                height,
-                image,
-                dataSize,
-                (flags & TEXTUREFLAG_NO_MIPMAPS) ? 1 : MipLevelsForSize(width, height),
-                flags & TEXTUREFLAG_USE_SRGB,
-                false);
+            texId = LoadTextureFromRGBABuffer(fileName, image, width, height, flags);
             free(image);
-            if (!(flags & TEXTUREFLAG_NO_MIPMAPS)) {
-                glBindTexture(texId.target, texId.texture);
-                glGenerateMipmap(texId.target);
-                glTexParameteri(texId.target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-            }
         } else {
             ALOG("stbi_load_from_memory() failed!");
         }
@@ -1669,13 +1679,14 @@ GlTexture LoadTextureFromOtherApplicationPackage(
         return GlTexture(0, 0, 0);
     }
 
-    std::vector<uint8_t> buffer;
-    ovr_ReadFileFromOtherApplicationPackage(zipFile, nameInZip, buffer);
-    if (buffer.size() == 0) {
+    // stored textures are read straight from the mapped package
+    ovrPackageFileView view;
+    ovr_MapFileFromOtherApplicationPackage(zipFile, nameInZip, view);
+    if (view.GetSize() == 0) {
         return GlTexture(0, 0, 0);
     }
 
-    return LoadTextureFromBuffer(nameInZip, buffer, flags, width, height);
+    return LoadTextureFromBuffer(nameInZip, view.GetData(), view.GetSize(), flags, width, height);
 }
 
 GlTexture LoadTextureFromApplicationPackage(
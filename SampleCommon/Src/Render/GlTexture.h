@@ -204,6 +204,16 @@ GlTexture LoadTextureFromBuffer(
     int& width,
     int& height);
 
+// Uploads an RGBA buffer returned by LoadImageToRGBABuffer the same way LoadTextureFromBuffer
+// uploads the stb_image formats, so the decode can be done off the GL context thread.
+// TEXTUREFLAG_ALPHA_BORDER modifies the buffer in place. No default texture is created on failure.
+GlTexture LoadTextureFromRGBABuffer(
+    const char* fileName,
+    uint8_t* image,
+    const int width,
+    const int height,
+    const TextureFlags_t& flags);
+
 inline GlTexture LoadTextureFromBuffer(
     const char* fileName,
     const std::vector<uint8_t>& buffer,
@@ -0,0 +1,494 @@
+// (c) Meta Platforms, Inc. and affiliates. Confidential and proprietary.
+
+/************************************************************************************
+
+Filename    :   MeshOptimizer.cpp
+Content     :   CPU side processing of triangle meshes before they are uploaded.
+Created     :   October 2026
+
+*************************************************************************************/
+
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+
+namespace OVRFW {
+
+// Triangles using each vertex, as ranges [triangleStart[v], triangleStart[v + 1]) of
+// vertexTriangles. Triangles with indices outside [0, vertexCount) are left out.
+static void BuildVertexTriangles(
+    const std::vector<uint32_t>& indices,
+    const int vertexCount,
+    std::vector<int>& triangleStart,
+    std::vector<int>& vertexTriangles) {
+    const int triangleCount = static_cast<int>(indices.size() / 3);
+    auto isValid = [&indices, vertexCount](const int t) {
+        return indices[t * 3 + 0] < static_cast<uint32_t>(vertexCount) &&
+            indices[t * 3 + 1] < static_cast<uint32_t>(vertexCount) &&
+            indices[t * 3 + 2] < static_cast<uint32_t>(vertexCount);
+    };
+
+    triangleStart.assign(vertexCount + 1, 0);
+    for (int t = 0; t < triangleCount; ++t) {
+        if (isValid(t)) {
+            for (int k = 0; k < 3; ++k) {
+                triangleStart[indices[t * 3 + k] + 1]++;
+            }
+        }
+    }
+    for (int v = 0; v < vertexCount; ++v) {
+        triangleStart[v + 1] += triangleStart[v];
+    }
+    vertexTriangles.resize(triangleStart[vertexCount]);
+    std::vector<int> fill(triangleStart.begin(), triangleStart.end() - 1);
+    for (int t = 0; t < triangleCount; ++t) {
+        if (isValid(t)) {
+            for (int k = 0; k < 3; ++k) {
+                vertexTriangles[fill[indices[t * 3 + k]]++] = t;
+            }
+        }
+    }
+}
+
+void SplitMesh(
+    const std::vector<uint32_t>& indices,
+    const int vertexCount,
+    const int maxVertices,
+    std::vector<MeshChunk>& chunks) {
+    chunks.clear();
+    if (maxVertices < 3) {
+        return;
+    }
+
+    const int triangleCount = static_cast<int>(indices.size() / 3);
+    std::vector<uint8_t> assigned(triangleCount, 0);
+
+    int remaining = 0;
+    for (int t = 0; t < triangleCount; ++t) {
+        const uint32_t* tri = &indices[t * 3];
+        if (tri[0] >= static_cast<uint32_t>(vertexCount) ||
+            tri[1] >= static_cast<uint32_t>(vertexCount) ||
+            tri[2] >= static_cast<uint32_t>(vertexCount)) {
+            assigned[t] = 1;
+        } else {
+            remaining++;
+        }
+    }
+
+    std::vector<int> triangleStart;
+    std::vector<int> vertexTriangles;
+    BuildVertexTriangles(indices, vertexCount, triangleStart, vertexTriangles);
+
+    std::vector<int> chunkVertex(vertexCount, -1); // index in the current chunk
+    std::vector<int> queuedInChunk(triangleCount, -1);
+    std::vector<int> queue;
+    int seed = 0;
+
+    while (remaining > 0) {
+        chunks.emplace_back();
+        MeshChunk& chunk = chunks.back();
+        const int chunkIndex = static_cast<int>(chunks.size()) - 1;
+
+        queue.clear();
+        size_t head = 0;
+        bool full = false;
+        for (;;) {
+            if (head == queue.size()) {
+                if (full) {
+                    break;
+                }
+                // the patch is closed, continue with the next triangle in input order
+                while (seed < triangleCount && assigned[seed]) {
+                    seed++;
+                }
+                if (seed == triangleCount) {
+                    break;
+                }
+                queuedInChunk[seed] = chunkIndex;
+                queue.push_back(seed);
+            }
+
+            const int t = queue[head++];
+            if (assigned[t]) {
+                continue;
+            }
+            const uint32_t* tri = &indices[t * 3];
+            int newVertices = 0;
+            for (int k = 0; k < 3; ++k) {
+                if (chunkVertex[tri[k]] < 0 && (k == 0 || tri[k] != tri[0]) &&
+                    (k < 2 || tri[k] != tri[1])) {
+                    newVertices++;
+                }
+            }
+            if (static_cast<int>(chunk.vertices.size()) + newVertices > maxVertices) {
+                // only take the queued triangles that need no new vertices from here on
+                full = true;
+                continue;
+            }
+
+            for (int k = 0; k < 3; ++k) {
+                const int v = static_cast<int>(tri[k]);
+                if (chunkVertex[v] < 0) {
+                    chunkVertex[v] = static_cast<int>(chunk.vertices.size());
+                    chunk.vertices.push_back(v);
+                }
+                chunk.indices.push_back(static_cast<TriangleIndex>(chunkVertex[v]));
+            }
+            assigned[t] = 1;
+            remaining--;
+
+            for (int k = 0; k < 3 && !full; ++k) {
+                for (int i = triangleStart[tri[k]]; i < triangleStart[tri[k] + 1]; ++i) {
+                    const int neighbor = vertexTriangles[i];
+                    if (!assigned[neighbor] && queuedInChunk[neighbor] != chunkIndex) {
+                        queuedInChunk[neighbor] = chunkIndex;
+                        queue.push_back(neighbor);
+                    }
+                }
+            }
+        }
+
+        for (const int v : chunk.vertices) {
+            chunkVertex[v] = -1;
+        }
+    }
+}
+
+int SimulateVertexCache(const std::vector<uint32_t>& indices, const int cacheSize) {
+    uint32_t maxIndex = 0;
+    for (const uint32_t index : indices) {
+        maxIndex = std::max(maxIndex, index);
+    }
+    // a vertex is still cached while fewer than cacheSize vertices were transformed after it
+    std::vector<int> transformedAt(indices.empty() ? 0 : maxIndex + 1, -cacheSize);
+    int transformed = 0;
+    for (const uint32_t index : indices) {
+        if (transformed - transformedAt[index] >= cacheSize) {
+            transformedAt[index] = transformed;
+            transformed++;
+        }
+    }
+    return transformed;
+}
+
+void OptimizeVertexCache(
+    std::vector<uint32_t>& indices,
+    const int vertexCount,
+    const int cacheSize) {
+    const int triangleCount = static_cast<int>(indices.size() / 3);
+    if (triangleCount == 0) {
+        return;
+    }
+
+    std::vector<int> triangleStart;
+    std::vector<int> vertexTriangles;
+    BuildVertexTriangles(indices, vertexCount, triangleStart, vertexTriangles);
+
+    std::vector<int> liveTriangles(vertexCount);
+    for (int v = 0; v < vertexCount; ++v) {
+        liveTriangles[v] = triangleStart[v + 1] - triangleStart[v];
+    }
+    std::vector<int> cacheTime(vertexCount, 0);
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    std::vector<int> deadEnd;
+    std::vector<int> candidates;
+    std::vector<uint32_t> out;
+    out.reserve(indices.size());
+
+    int time = cacheSize + 1;
+    int cursor = 0;
+    int fan = 0;
+    while (fan < vertexCount && liveTriangles[fan] == 0) {
+        fan++;
+    }
+    while (fan < vertexCount) {
+        // emit all remaining triangles around the fanning vertex
+        candidates.clear();
+        for (int i = triangleStart[fan]; i < triangleStart[fan + 1]; ++i) {
+            const int t = vertexTriangles[i];
+            if (emitted[t]) {
+                continue;
+            }
+            for (int k = 0; k < 3; ++k) {
+                const int v = static_cast<int>(indices[t * 3 + k]);
+                out.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                liveTriangles[v]--;
+                if (time - cacheTime[v] > cacheSize) {
+                    cacheTime[v] = time;
+                    time++;
+                }
+            }
+            emitted[t] = 1;
+        }
+
+        // continue with the oldest candidate that is still cached after its remaining triangles
+        int next = -1;
+        int bestPriority = -1;
+        for (const int v : candidates) {
+            if (liveTriangles[v] > 0) {
+                int priority = 0;
+                if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize) {
+                    priority = time - cacheTime[v];
+                }
+                if (priority > bestPriority) {
+                    bestPriority = priority;
+                    next = v;
+                }
+            }
+        }
+        // dead end, go back to recently used vertices, then to the input order
+        while (next < 0 && !deadEnd.empty()) {
+            const int v = deadEnd.back();
+            deadEnd.pop_back();
+            if (liveTriangles[v] > 0) {
+                next = v;
+            }
+        }
+        while (next < 0 && cursor < vertexCount) {
+            if (liveTriangles[cursor] > 0) {
+                next = cursor;
+            }
+            cursor++;
+        }
+        fan = next < 0 ? vertexCount : next;
+    }
+
+    // triangles with invalid indices are kept at the end
+    for (int t = 0; t < triangleCount; ++t) {
+        if (!emitted[t]) {
+            out.insert(out.end(), indices.begin() + t * 3, indices.begin() + t * 3 + 3);
+        }
+    }
+    indices.swap(out);
+}
+
+void OptimizeOverdraw(
+    std::vector<uint32_t>& indices,
+    const std::vector<OVR::Vector3f>& positions,
+    const float threshold,
+    const int cacheSize) {
+    const int triangleCount = static_cast<int>(indices.size() / 3);
+    if (triangleCount < 2) {
+        return;
+    }
+    for (const uint32_t index : indices) {
+        if (index >= positions.size()) {
+            return;
+        }
+    }
+
+    std::vector<int> transformedAt(positions.size(), -cacheSize);
+    int transformed = 0;
+    auto cacheMisses = [&](const int t) {
+        int misses = 0;
+        for (int k = 0; k < 3; ++k) {
+            const uint32_t v = indices[t * 3 + k];
+            if (transformed - transformedAt[v] >= cacheSize) {
+                transformedAt[v] = transformed;
+                transformed++;
+                misses++;
+            }
+        }
+        return misses;
+    };
+    auto flushCache = [&]() { transformed += cacheSize; };
+
+    // the cache optimizer restarts where a triangle misses on all vertices
+    std::vector<int> triangleMisses(triangleCount);
+    std::vector<int> hardClusters;
+    for (int t = 0; t < triangleCount; ++t) {
+        triangleMisses[t] = cacheMisses(t);
+        if (t == 0 || triangleMisses[t] == 3) {
+            hardClusters.push_back(t);
+        }
+    }
+    hardClusters.push_back(triangleCount);
+
+    // split further wherever the cache was warm enough that a restart costs little
+    std::vector<int> clusters;
+    for (int c = 0; c + 1 < static_cast<int>(hardClusters.size()); ++c) {
+        const int start = hardClusters[c];
+        const int end = hardClusters[c + 1];
+        int clusterMisses = 0;
+        for (int t = start; t < end; ++t) {
+            clusterMisses += triangleMisses[t];
+        }
+        const float limit = threshold * clusterMisses / (end - start);
+
+        flushCache();
+        clusters.push_back(start);
+        int misses = 0;
+        int triangles = 0;
+        for (int t = start; t < end; ++t) {
+            misses += cacheMisses(t);
+            triangles++;
+            if (t + 1 < end && misses <= limit * triangles) {
+                flushCache();
+                clusters.push_back(t + 1);
+                misses = 0;
+                triangles = 0;
+            }
+        }
+    }
+    clusters.push_back(triangleCount);
+
+    // area weighted centroid and normal of each cluster
+    const int clusterCount = static_cast<int>(clusters.size()) - 1;
+    std::vector<OVR::Vector3f> clusterCentroid(clusterCount, OVR::Vector3f(0.0f));
+    std::vector<OVR::Vector3f> clusterNormal(clusterCount, OVR::Vector3f(0.0f));
+    std::vector<float> clusterArea(clusterCount, 0.0f);
+    OVR::Vector3f meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (int c = 0; c < clusterCount; ++c) {
+        for (int t = clusters[c]; t < clusters[c + 1]; ++t) {
+            const OVR::Vector3f& p0 = positions[indices[t * 3 + 0]];
+            const OVR::Vector3f& p1 = positions[indices[t * 3 + 1]];
+            const OVR::Vector3f& p2 = positions[indices[t * 3 + 2]];
+            const OVR::Vector3f normal = (p1 - p0).Cross(p2 - p0);
+            const float area = normal.Length();
+            const OVR::Vector3f center = (p0 + p1 + p2) * (1.0f / 3.0f);
+            clusterCentroid[c] += center * area;
+            clusterNormal[c] += normal;
+            clusterArea[c] += area;
+        }
+        meshCentroid += clusterCentroid[c];
+        meshArea += clusterArea[c];
+    }
+    if (meshArea > 0.0f) {
+        meshCentroid *= 1.0f / meshArea;
+    }
+
+    std::vector<float> sortKey(clusterCount, 0.0f);
+    for (int c = 0; c < clusterCount; ++c) {
+        const float normalLength = clusterNormal[c].Length();
+        if (clusterArea[c] > 0.0f && normalLength > 0.0f) {
+            const OVR::Vector3f centroid = clusterCentroid[c] * (1.0f / clusterArea[c]);
+            sortKey[c] = (centroid - meshCentroid).Dot(clusterNormal[c]) / normalLength;
+        }
+    }
+    std::vector<int> order(clusterCount);
+    for (int c = 0; c < clusterCount; ++c) {
+        order[c] = c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&sortKey](const int a, const int b) {
+        return sortKey[a] > sortKey[b];
+    });
+
+    std::vector<uint32_t> out;
+    out.reserve(indices.size());
+    for (const int c : order) {
+        out.insert(
+            out.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+    }
+    indices.swap(out);
+}
+
+void OptimizeVertexFetch(
+    std::vector<uint32_t>& indices,
+    const int vertexCount,
+    std::vector<int>& vertices) {
+    std::vector<int> newIndex(vertexCount, -1);
+    vertices.clear();
+    vertices.reserve(vertexCount);
+    for (uint32_t& index : indices) {
+        if (newIndex[index] < 0) {
+            newIndex[index] = static_cast<int>(vertices.size());
+            vertices.push_back(static_cast<int>(index));
+        }
+        index = static_cast<uint32_t>(newIndex[index]);
+    }
+    for (int v = 0; v < vertexCount; ++v) {
+        if (newIndex[v] < 0) {
+            vertices.push_back(v);
+        }
+    }
+}
+
+MeshOptimizerStats OptimizeMesh(
+    VertexAttribs& attribs,
+    std::vector<uint32_t>& indices,
+    std::vector<VertexAttribs>* targets) {
+    MeshOptimizerStats stats;
+    const int vertexCount = static_cast<int>(attribs.position.size());
+    if (indices.size() % 3 != 0) {
+        return stats;
+    }
+    for (const uint32_t index : indices) {
+        if (index >= static_cast<uint32_t>(vertexCount)) {
+            return stats;
+        }
+    }
+
+    stats.triangleCount = static_cast<int>(indices.size() / 3);
+    stats.transformedBefore = SimulateVertexCache(indices, VERTEX_CACHE_SIZE);
+
+    std::vector<uint32_t> optimized = indices;
+    OptimizeVertexCache(optimized, vertexCount);
+    OptimizeOverdraw(optimized, attribs.position);
+    stats.transformedAfter = SimulateVertexCache(optimized, VERTEX_CACHE_SIZE);
+    // keep meshes that were already ordered better, e.g. by an offline tool
+    if (stats.transformedAfter <= stats.transformedBefore) {
+        indices.swap(optimized);
+    } else {
+        stats.transformedAfter = stats.transformedBefore;
+    }
+
+    std::vector<int> vertices;
+    OptimizeVertexFetch(indices, vertexCount, vertices);
+    attribs = GatherVertexAttribs(attribs, vertices);
+    if (targets != nullptr) {
+        for (VertexAttribs& target : *targets) {
+            target = GatherVertexAttribs(target, vertices);
+        }
+    }
+    return stats;
+}
+
+MeshOptimizerStats OptimizeMesh(
+    VertexAttribs& attribs,
+    std::vector<TriangleIndex>& indices,
+    std::vector<VertexAttribs>* targets) {
+    std::vector<uint32_t> wideIndices(indices.begin(), indices.end());
+    const MeshOptimizerStats stats = OptimizeMesh(attribs, wideIndices, targets);
+    for (int i = 0; i < static_cast<int>(indices.size()); ++i) {
+        indices[i] = static_cast<TriangleIndex>(wideIndices[i]);
+    }
+    return stats;
+}
+
+template <typename _attrib_type_>
+static void GatherAttribute(
+    const std::vector<_attrib_type_>& src,
+    const std::vector<int>& vertices,
+    const int maxVertex,
+    std::vector<_attrib_type_>& dst) {
+    if (static_cast<int>(src.size()) <= maxVertex) {
+        return;
+    }
+    dst.resize(vertices.size());
+    for (int i = 0; i < static_cast<int>(vertices.size()); ++i) {
+        dst[i] = src[vertices[i]];
+    }
+}
+
+VertexAttribs GatherVertexAttribs(const VertexAttribs& attribs, const std::vector<int>& vertices) {
+    int maxVertex = 0;
+    for (const int v : vertices) {
+        maxVertex = std::max(maxVertex, v);
+    }
+    VertexAttribs out;
+    GatherAttribute(attribs.position, vertices, maxVertex, out.position);
+    GatherAttribute(attribs.normal, vertices, maxVertex, out.normal);
+    GatherAttribute(attribs.tangent, vertices, maxVertex, out.tangent);
+    GatherAttribute(attribs.binormal, vertices, maxVertex, out.binormal);
+    GatherAttribute(attribs.color, vertices, maxVertex, out.color);
+    GatherAttribute(attribs.uv0, vertices, maxVertex, out.uv0);
+    GatherAttribute(attribs.uv1, vertices, maxVertex, out.uv1);
+    GatherAttribute(attribs.jointIndices, vertices, maxVertex, out.jointIndices);
+    GatherAttribute(attribs.jointWeights, vertices, maxVertex, out.jointWeights);
+    return out;
+}
+
+} // namespace OVRFW
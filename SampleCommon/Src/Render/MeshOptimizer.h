@@ -0,0 +1,97 @@
+// (c) Meta Platforms, Inc. and affiliates. Confidential and proprietary.
+
+/************************************************************************************
+
+Filename    :   MeshOptimizer.h
+Content     :   CPU side processing of triangle meshes before they are uploaded.
+Created     :   October 2026
+
+*************************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "GlGeometry.h"
+
+namespace OVRFW {
+
+// Part of a mesh that can be drawn with 16 bit indices.
+struct MeshChunk {
+    std::vector<int> vertices; // source vertex of each chunk vertex
+    std::vector<TriangleIndex> indices; // triangles indexing the chunk vertices
+};
+
+// Partitions a triangle list into chunks that each reference at most maxVertices vertices.
+// Chunks are grown over shared vertices from a seed triangle, so each chunk is a spatially
+// compact patch and vertices on chunk borders are the only ones that get duplicated.
+// Triangles referencing vertices outside [0, vertexCount) are dropped.
+void SplitMesh(
+    const std::vector<uint32_t>& indices,
+    const int vertexCount,
+    const int maxVertices,
+    std::vector<MeshChunk>& chunks);
+
+// Post-transform vertex cache size the optimizer targets, and simulates for the reported ACMR.
+static const int VERTEX_CACHE_SIZE = 16;
+
+// Vertex shader invocations of a triangle list before and after optimization, as simulated with a
+// FIFO post-transform cache. ACMR is the average number of invocations per triangle, between 0.5
+// for an ideal grid and 3 when nothing is reused.
+struct MeshOptimizerStats {
+    MeshOptimizerStats() : triangleCount(0), transformedBefore(0), transformedAfter(0) {}
+
+    float AcmrBefore() const {
+        return triangleCount > 0 ? float(transformedBefore) / triangleCount : 0.0f;
+    }
+    float AcmrAfter() const {
+        return triangleCount > 0 ? float(transformedAfter) / triangleCount : 0.0f;
+    }
+
+    int triangleCount;
+    int transformedBefore;
+    int transformedAfter;
+};
+
+// Number of vertices a FIFO post-transform cache of cacheSize entries would transform.
+int SimulateVertexCache(const std::vector<uint32_t>& indices, const int cacheSize);
+
+// Reorders triangles for post-transform cache hits (Tipsify, Sander et al. 2007).
+void OptimizeVertexCache(
+    std::vector<uint32_t>& indices,
+    const int vertexCount,
+    const int cacheSize = VERTEX_CACHE_SIZE);
+
+// Splits cache optimized triangles into clusters wherever the cache restarts, or where a cluster
+// reached threshold times the ACMR of the whole run, and draws clusters facing away from the mesh
+// center first, so they occlude the rest of the mesh.
+void OptimizeOverdraw(
+    std::vector<uint32_t>& indices,
+    const std::vector<OVR::Vector3f>& positions,
+    const float threshold = 1.05f,
+    const int cacheSize = VERTEX_CACHE_SIZE);
+
+// Renumbers vertices in the order the triangles first use them. Returns the source vertex of
+// each new vertex in vertices, unused vertices are moved to the end.
+void OptimizeVertexFetch(
+    std::vector<uint32_t>& indices,
+    const int vertexCount,
+    std::vector<int>& vertices);
+
+// Runs all of the above on a mesh and its morph targets, for example on the attribs and indices of
+// a GlGeometry::Descriptor. Meshes with indices outside the vertex attributes are left unchanged.
+MeshOptimizerStats OptimizeMesh(
+    VertexAttribs& attribs,
+    std::vector<uint32_t>& indices,
+    std::vector<VertexAttribs>* targets = nullptr);
+MeshOptimizerStats OptimizeMesh(
+    VertexAttribs& attribs,
+    std::vector<TriangleIndex>& indices,
+    std::vector<VertexAttribs>* targets = nullptr);
+
+// Returns the attributes of the given source vertices. Attributes too short to cover all of them
+// are left empty, so this also works for morph targets that only store some attributes.
+VertexAttribs GatherVertexAttribs(const VertexAttribs& attribs, const std::vector<int>& vertices);
+
+} // namespace OVRFW
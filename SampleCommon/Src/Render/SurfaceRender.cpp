@@ -404,7 +404,7 @@ ovrDrawCounters ovrSurfaceRender::RenderSurfaceList(
                 surfaceDef.geo.vertexBuffer,
                 surfaceDef.geo.primitiveType,
                 surfaceDef.geo.indexCount,
-                surfaceDef.geo.IndexType);
+                surfaceDef.geo.indexType);
         }
 
         // Bind all the vertex and element arrays
@@ -415,14 +415,14 @@ ovrDrawCounters ovrSurfaceRender::RenderSurfaceList(
                 GL(glDrawElementsInstanced(
                     surfaceDef.geo.primitiveType,
                     surfaceDef.geo.indexCount,
-                    surfaceDef.geo.IndexType,
+                    surfaceDef.geo.indexType,
                     NULL,
                     surfaceDef.numInstances));
             } else {
                 GL(glDrawElements(
                     surfaceDef.geo.primitiveType,
                     surfaceDef.geo.indexCount,
-                    surfaceDef.geo.IndexType,
+                    surfaceDef.geo.indexType,
                     NULL));
             }
         }
@@ -16,6 +16,11 @@ Authors     :   Jonathan E. Wright
 
 #include "Misc/Log.h"
 
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <unordered_map>
 
@@ -38,6 +43,30 @@ void ovrManagedTexture::Free() {
     Handle = textureHandle_t();
 }
 
+//==============================================================
+// ovrTextureRequest
+// An asynchronous texture load. Only the fields below the mutex comment are shared with the
+// decode threads.
+struct ovrTextureRequest {
+    enum ovrRequestState { REQUEST_QUEUED, REQUEST_DECODING, REQUEST_DECODED };
+
+    textureHandle_t Handle;
+    std::string Uri;
+    std::vector<uint8_t> Buffer; // encoded file contents
+    ovrTextureManager::ovrTextureFilter FilterType = ovrTextureManager::FILTER_DEFAULT;
+    ovrTextureManager::ovrTextureWrap WrapType = ovrTextureManager::WRAP_DEFAULT;
+    int Priority = 0;
+    int64_t Sequence = 0;
+
+    // protected by ovrTextureManagerImpl::RequestMutex
+    ovrRequestState State = REQUEST_QUEUED;
+    bool Cancelled = false;
+    int64_t UsedFrame = -1; // last frame the placeholder was asked for
+    uint8_t* Rgba = nullptr; // nullptr if the format is not decoded by stb_image
+    int Width = 0;
+    int Height = 0;
+};
+
 //==============================================================================================
 // ovrTextureManagerImpl
 //==============================================================================================
@@ -77,6 +106,24 @@ class ovrTextureManagerImpl : public ovrTextureManager {
         ovrTextureFilter const filterType = FILTER_DEFAULT,
         ovrTextureWrap const wrapType = WRAP_DEFAULT) OVR_OVERRIDE;
 
+    virtual textureHandle_t LoadTextureAsync(
+        ovrFileSys& fileSys,
+        char const* uri,
+        ovrTextureFilter const filterType = FILTER_DEFAULT,
+        ovrTextureWrap const wrapType = WRAP_DEFAULT,
+        int const priority = 0) OVR_OVERRIDE;
+    virtual textureHandle_t LoadTextureAsync(
+        char const* uri,
+        void const* buffer,
+        size_t const bufferSize,
+        ovrTextureFilter const filterType = FILTER_DEFAULT,
+        ovrTextureWrap const wrapType = WRAP_DEFAULT,
+        int const priority = 0) OVR_OVERRIDE;
+
+    virtual bool IsTextureLoaded(textureHandle_t const handle) const OVR_OVERRIDE;
+
+    virtual void Update(size_t const maxUploadBytes = DEFAULT_UPLOAD_BYTES_PER_FRAME) OVR_OVERRIDE;
+
     virtual void FreeTexture(textureHandle_t const handle) OVR_OVERRIDE;
 
     virtual ovrManagedTexture GetTexture(textureHandle_t const handle) const OVR_OVERRIDE;
@@ -102,6 +149,21 @@ class ovrTextureManagerImpl : public ovrTextureManager {
     mutable int NumSearches;
     mutable int NumCompares;
 
+    // asynchronous loads
+    GlTexture Placeholder;
+    std::unordered_map<int, std::shared_ptr<ovrTextureRequest>> PendingRequests; // by index
+    int64_t NumRequests;
+    int NumAsyncUploads;
+
+    // shared with the decode threads
+    mutable std::mutex RequestMutex;
+    std::condition_variable RequestCondition;
+    std::vector<std::shared_ptr<ovrTextureRequest>> QueuedRequests;
+    std::vector<std::shared_ptr<ovrTextureRequest>> DecodedRequests;
+    int64_t FrameNumber;
+    bool StopDecodeThreads;
+    std::vector<std::thread> DecodeThreads;
+
    private:
     ovrTextureManagerImpl();
     ~ovrTextureManagerImpl() override;
@@ -111,6 +173,16 @@ class ovrTextureManagerImpl : public ovrTextureManager {
     int IndexForHandle(textureHandle_t const handle) const;
     textureHandle_t AllocTexture();
 
+    textureHandle_t QueueRequest(
+        char const* uri,
+        std::vector<uint8_t>& buffer,
+        ovrTextureFilter const filterType,
+        ovrTextureWrap const wrapType,
+        int const priority);
+    void DecodeThread();
+    void StopDecoding();
+    bool IsHigherPriority(ovrTextureRequest const& a, ovrTextureRequest const& b) const;
+
     static void SetTextureWrapping(GlTexture& tex, ovrTextureWrap const wrapType);
     static void SetTextureFiltering(GlTexture& tex, ovrTextureFilter const filterType);
 };
@@ -126,7 +198,11 @@ ovrTextureManagerImpl::ovrTextureManagerImpl()
       NumStringSearches(0),
       NumStringCompares(0),
       NumSearches(0),
-      NumCompares(0) {}
+      NumCompares(0),
+      NumRequests(0),
+      NumAsyncUploads(0),
+      FrameNumber(0),
+      StopDecodeThreads(false) {}
 
 //==============================
 // ovrTextureManagerImpl::
@@ -144,6 +220,8 @@ void ovrTextureManagerImpl::Init() {
 //==============================
 // ovrTextureManagerImpl::
 void ovrTextureManagerImpl::Shutdown() {
+    StopDecoding();
+
     for (auto& texture : Textures) {
         if (texture.IsValid()) {
             texture.Free();
@@ -154,6 +232,9 @@ void ovrTextureManagerImpl::Shutdown() {
     FreeTextures.resize(0);
     UriHash.clear();
 
+    OVRFW::FreeTexture(Placeholder);
+    Placeholder = GlTexture();
+
     Initialized = false;
 }
 
@@ -405,6 +486,281 @@ textureHandle_t ovrTextureManagerImpl::LoadRGBATexture(
     return handle;
 }
 
+//==============================
+// ovrTextureManagerImpl::LoadTextureAsync
+textureHandle_t ovrTextureManagerImpl::LoadTextureAsync(
+    ovrFileSys& fileSys,
+    char const* uri,
+    ovrTextureFilter const filterType,
+    ovrTextureWrap const wrapType,
+    int const priority) {
+    NumUriLoads++;
+
+    int idx = FindTextureIndex(uri);
+    if (idx >= 0) {
+        return Textures[idx].GetHandle();
+    }
+
+    // the file system is not thread safe, so only the decode happens in the background
+    std::vector<uint8_t> buffer;
+    if (!fileSys.ReadFile(uri, buffer)) {
+        ALOG("LoadTextureAsync( '%s' ) failed to read file!", uri);
+        return textureHandle_t();
+    }
+
+    return QueueRequest(uri, buffer, filterType, wrapType, priority);
+}
+
+//==============================
+// ovrTextureManagerImpl::LoadTextureAsync
+textureHandle_t ovrTextureManagerImpl::LoadTextureAsync(
+    char const* uri,
+    void const* buffer,
+    size_t const bufferSize,
+    ovrTextureFilter const filterType,
+    ovrTextureWrap const wrapType,
+    int const priority) {
+    NumBufferLoads++;
+    if (buffer == nullptr || bufferSize == 0) {
+        return textureHandle_t();
+    }
+
+    int idx = FindTextureIndex(uri);
+    if (idx >= 0) {
+        return Textures[idx].GetHandle();
+    }
+
+    std::vector<uint8_t> bufferCopy(
+        static_cast<uint8_t const*>(buffer), static_cast<uint8_t const*>(buffer) + bufferSize);
+    return QueueRequest(uri, bufferCopy, filterType, wrapType, priority);
+}
+
+//==============================
+// ovrTextureManagerImpl::QueueRequest
+textureHandle_t ovrTextureManagerImpl::QueueRequest(
+    char const* uri,
+    std::vector<uint8_t>& buffer,
+    ovrTextureFilter const filterType,
+    ovrTextureWrap const wrapType,
+    int const priority) {
+    if (!Placeholder.IsValid()) {
+        static const uint8_t transparentPixel[4] = {0, 0, 0, 0};
+        Placeholder = LoadRGBATextureFromMemory(transparentPixel, 1, 1, false);
+    }
+
+    textureHandle_t handle = AllocTexture();
+    if (!handle.IsValid()) {
+        return handle;
+    }
+
+    int const idx = IndexForHandle(handle);
+    Textures[idx] = ovrManagedTexture(handle, uri, GlTexture());
+    UriHash[std::string(uri)] = idx;
+
+    std::shared_ptr<ovrTextureRequest> request = std::make_shared<ovrTextureRequest>();
+    request->Handle = handle;
+    request->Uri = uri;
+    request->Buffer.swap(buffer);
+    request->FilterType = filterType;
+    request->WrapType = wrapType;
+    request->Priority = priority;
+    request->Sequence = NumRequests++;
+    PendingRequests[idx] = request;
+
+    {
+        std::lock_guard<std::mutex> lock(RequestMutex);
+        QueuedRequests.push_back(request);
+
+        if (DecodeThreads.empty()) {
+            // leave a core for the render thread
+            int const numThreads = std::max(
+                1, std::min(2, static_cast<int>(std::thread::hardware_concurrency()) - 1));
+            StopDecodeThreads = false;
+            for (int i = 0; i < numThreads; i++) {
+                DecodeThreads.emplace_back(&ovrTextureManagerImpl::DecodeThread, this);
+            }
+        }
+    }
+    RequestCondition.notify_one();
+
+    return handle;
+}
+
+//==============================
+// ovrTextureManagerImpl::IsHigherPriority
+// Must be called with RequestMutex held.
+bool ovrTextureManagerImpl::IsHigherPriority(
+    ovrTextureRequest const& a,
+    ovrTextureRequest const& b) const {
+    bool const aUsed = a.UsedFrame >= 0 && a.UsedFrame >= FrameNumber - 1;
+    bool const bUsed = b.UsedFrame >= 0 && b.UsedFrame >= FrameNumber - 1;
+    if (aUsed != bUsed) {
+        return aUsed;
+    }
+    if (a.Priority != b.Priority) {
+        return a.Priority > b.Priority;
+    }
+    return a.Sequence < b.Sequence;
+}
+
+//==============================
+// ovrTextureManagerImpl::DecodeThread
+void ovrTextureManagerImpl::DecodeThread() {
+    for (;;) {
+        std::shared_ptr<ovrTextureRequest> request;
+        {
+            std::unique_lock<std::mutex> lock(RequestMutex);
+            RequestCondition.wait(
+                lock, [this]() { return StopDecodeThreads || !QueuedRequests.empty(); });
+            if (StopDecodeThreads) {
+                return;
+            }
+
+            int best = 0;
+            for (int i = 1; i < static_cast<int>(QueuedRequests.size()); i++) {
+                if (IsHigherPriority(*QueuedRequests[i], *QueuedRequests[best])) {
+                    best = i;
+                }
+            }
+            request = QueuedRequests[best];
+            QueuedRequests[best] = QueuedRequests.back();
+            QueuedRequests.pop_back();
+            if (request->Cancelled) {
+                continue;
+            }
+            request->State = ovrTextureRequest::REQUEST_DECODING;
+        }
+
+        // Formats that are not decoded by stb_image (ktx, pvr, astc) are mostly a copy into GL
+        // and are loaded from the encoded buffer in Update().
+        int width = 0;
+        int height = 0;
+        uint8_t* rgba = LoadImageToRGBABuffer(
+            request->Uri.c_str(), request->Buffer.data(), request->Buffer.size(), width, height);
+
+        {
+            std::lock_guard<std::mutex> lock(RequestMutex);
+            request->Rgba = rgba;
+            request->Width = width;
+            request->Height = height;
+            request->State = ovrTextureRequest::REQUEST_DECODED;
+            DecodedRequests.push_back(request);
+        }
+    }
+}
+
+//==============================
+// ovrTextureManagerImpl::StopDecoding
+void ovrTextureManagerImpl::StopDecoding() {
+    {
+        std::lock_guard<std::mutex> lock(RequestMutex);
+        StopDecodeThreads = true;
+    }
+    RequestCondition.notify_all();
+    for (std::thread& thread : DecodeThreads) {
+        thread.join();
+    }
+    DecodeThreads.clear();
+
+    for (auto& request : DecodedRequests) {
+        if (request->Rgba != nullptr) {
+            FreeRGBABuffer(request->Rgba);
+        }
+    }
+    DecodedRequests.clear();
+    QueuedRequests.clear();
+    PendingRequests.clear();
+}
+
+//==============================
+// ovrTextureManagerImpl::IsTextureLoaded
+bool ovrTextureManagerImpl::IsTextureLoaded(textureHandle_t const handle) const {
+    int const idx = IndexForHandle(handle);
+    return idx >= 0 && PendingRequests.find(idx) == PendingRequests.end();
+}
+
+//==============================
+// ovrTextureManagerImpl::Update
+void ovrTextureManagerImpl::Update(size_t const maxUploadBytes) {
+    /// OVR_PERF_TIMER( TextureManager_Update );
+
+    std::vector<std::shared_ptr<ovrTextureRequest>> uploads;
+    {
+        std::lock_guard<std::mutex> lock(RequestMutex);
+        FrameNumber++;
+        if (DecodedRequests.empty()) {
+            return;
+        }
+
+        std::sort(
+            DecodedRequests.begin(),
+            DecodedRequests.end(),
+            [this](
+                std::shared_ptr<ovrTextureRequest> const& a,
+                std::shared_ptr<ovrTextureRequest> const& b) {
+                return IsHigherPriority(*a, *b);
+            });
+
+        size_t uploadBytes = 0;
+        int count = 0;
+        for (; count < static_cast<int>(DecodedRequests.size()); count++) {
+            ovrTextureRequest const& request = *DecodedRequests[count];
+            if (request.Cancelled) {
+                continue;
+            }
+            // account for the generated mip levels
+            size_t const bytes = request.Rgba != nullptr
+                ? static_cast<size_t>(request.Width) * request.Height * 4 * 4 / 3
+                : request.Buffer.size();
+            if (uploadBytes > 0 && uploadBytes + bytes > maxUploadBytes) {
+                break;
+            }
+            uploadBytes += bytes;
+        }
+        uploads.assign(DecodedRequests.begin(), DecodedRequests.begin() + count);
+        DecodedRequests.erase(DecodedRequests.begin(), DecodedRequests.begin() + count);
+    }
+
+    for (auto& request : uploads) {
+        if (!request->Cancelled) {
+            GlTexture tex;
+            if (request->Rgba != nullptr) {
+                tex = LoadTextureFromRGBABuffer(
+                    request->Uri.c_str(),
+                    request->Rgba,
+                    request->Width,
+                    request->Height,
+                    TextureFlags_t());
+            } else {
+                int width = 0;
+                int height = 0;
+                tex = LoadTextureFromBuffer(
+                    request->Uri.c_str(),
+                    request->Buffer,
+                    TextureFlags_t(TEXTUREFLAG_NO_DEFAULT),
+                    width,
+                    height);
+            }
+
+            int const idx = IndexForHandle(request->Handle);
+            PendingRequests.erase(idx);
+            if (tex.IsValid()) {
+                SetTextureWrapping(tex, request->WrapType);
+                SetTextureFiltering(tex, request->FilterType);
+                Textures[idx] = ovrManagedTexture(request->Handle, request->Uri.c_str(), tex);
+                NumAsyncUploads++;
+            } else {
+                ALOG("LoadTextureAsync( '%s' ) failed!", request->Uri.c_str());
+                FreeTexture(request->Handle);
+            }
+        }
+        if (request->Rgba != nullptr) {
+            FreeRGBABuffer(request->Rgba);
+            request->Rgba = nullptr;
+        }
+    }
+}
+
 //==============================
 // ovrTextureManagerImpl::GetTexture
 ovrManagedTexture ovrTextureManagerImpl::GetTexture(textureHandle_t const handle) const {
@@ -422,6 +778,13 @@ GlTexture ovrTextureManagerImpl::GetGlTexture(textureHandle_t const handle) cons
     if (idx < 0) {
         return GlTexture();
     }
+    auto request = PendingRequests.find(idx);
+    if (request != PendingRequests.end()) {
+        // the texture is wanted on screen, move it to the front of the queue
+        std::lock_guard<std::mutex> lock(RequestMutex);
+        request->second->UsedFrame = FrameNumber;
+        return Placeholder;
+    }
     return Textures[idx].GetTexture();
 }
 
@@ -430,7 +793,13 @@ GlTexture ovrTextureManagerImpl::GetGlTexture(textureHandle_t const handle) cons
 void ovrTextureManagerImpl::FreeTexture(textureHandle_t const handle) {
     int idx = IndexForHandle(handle);
     if (idx >= 0) {
-        if (Textures[idx].GetUri().empty()) {
+        auto request = PendingRequests.find(idx);
+        if (request != PendingRequests.end()) {
+            std::lock_guard<std::mutex> lock(RequestMutex);
+            request->second->Cancelled = true;
+            PendingRequests.erase(request);
+        }
+        if (!Textures[idx].GetUri().empty()) {
             UriHash.erase(Textures[idx].GetUri());
         }
         Textures[idx].Free();
@@ -536,6 +905,8 @@ void ovrTextureManagerImpl::PrintStats() const {
     ALOG("NumBufferLoads:       %i", NumBufferLoads);
     ALOG("NumActualUriLoads:    %i", NumActualUriLoads);
     ALOG("NumActualBufferLoads: %i", NumActualBufferLoads);
+    ALOG("NumAsyncUploads:      %i", NumAsyncUploads);
+    ALOG("NumPendingRequests:   %i", static_cast<int>(PendingRequests.size()));
 
     ALOG("NumStringSearches: %i", NumStringSearches);
     ALOG("NumStringCompares: %i", NumStringCompares);
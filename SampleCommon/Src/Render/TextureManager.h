@@ -77,6 +77,8 @@ class ovrTextureManager {
 
     };
 
+    static const size_t DEFAULT_UPLOAD_BYTES_PER_FRAME = 2 * 1024 * 1024;
+
     virtual ~ovrTextureManager() {}
 
     static ovrTextureManager* Create();
@@ -111,6 +113,33 @@ class ovrTextureManager {
         ovrTextureFilter const filterType = FILTER_DEFAULT,
         ovrTextureWrap const wrapType = WRAP_DEFAULT) = 0;
 
+    // Asynchronous loads return a handle right away. Until the image has been decoded on a
+    // background thread and uploaded by Update(), GetGlTexture() returns a placeholder texture.
+    // Pending textures that were queried with GetGlTexture() since the last Update() are decoded
+    // and uploaded first, then the ones with the highest priority, then in request order.
+    virtual textureHandle_t LoadTextureAsync(
+        class ovrFileSys& fileSys,
+        char const* uri,
+        ovrTextureFilter const filterType = FILTER_DEFAULT,
+        ovrTextureWrap const wrapType = WRAP_DEFAULT,
+        int const priority = 0) = 0;
+    // The buffer is copied, the caller keeps ownership.
+    virtual textureHandle_t LoadTextureAsync(
+        char const* uri,
+        void const* buffer,
+        size_t const bufferSize,
+        ovrTextureFilter const filterType = FILTER_DEFAULT,
+        ovrTextureWrap const wrapType = WRAP_DEFAULT,
+        int const priority = 0) = 0;
+
+    // Returns false while an asynchronous load of the texture is still pending.
+    virtual bool IsTextureLoaded(textureHandle_t const handle) const = 0;
+
+    // Creates the GL textures for images decoded in the background. Must be called once per frame
+    // on the GL thread. Stops after maxUploadBytes have been uploaded, but always uploads at least
+    // one texture so large images cannot stall the queue.
+    virtual void Update(size_t const maxUploadBytes = DEFAULT_UPLOAD_BYTES_PER_FRAME) = 0;
+
     virtual void FreeTexture(textureHandle_t const handle) = 0;
 
     virtual ovrManagedTexture GetTexture(textureHandle_t const handle) const = 0;
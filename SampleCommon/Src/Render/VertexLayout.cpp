@@ -0,0 +1,455 @@
+// (c) Meta Platforms, Inc. and affiliates. Confidential and proprietary.
+
+/************************************************************************************
+
+Filename    :   VertexLayout.cpp
+Content     :   Vertex formats and CPU packing of vertex attributes.
+Created     :   October 2026
+
+*************************************************************************************/
+
+#include "VertexLayout.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "Misc/Log.h"
+
+using OVR::Vector2f;
+using OVR::Vector3f;
+using OVR::Vector4f;
+using OVR::Vector4i;
+
+namespace OVRFW {
+
+uint16_t FloatToHalf(const float f) {
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+
+    const uint16_t sign = static_cast<uint16_t>((x >> 16) & 0x8000);
+    const uint32_t absX = x & 0x7FFFFFFF;
+
+    if (absX >= 0x7F800000) {
+        // inf stays inf, NaN keeps a quiet NaN payload
+        return sign | (absX > 0x7F800000 ? 0x7E00 : 0x7C00);
+    }
+    if (absX >= 0x477FF000) {
+        // rounds to a value larger than the largest half
+        return sign | 0x7C00;
+    }
+    if (absX < 0x38800000) {
+        // half denormal or zero, shift the mantissa with the implicit bit into place
+        if (absX < 0x33000000) {
+            return sign;
+        }
+        const uint32_t exponent = absX >> 23;
+        const uint32_t mantissa = (absX & 0x007FFFFF) | 0x00800000;
+        const uint32_t shift = 126 - exponent;
+        const uint32_t halfMantissa = mantissa >> shift;
+        const uint32_t remainder = mantissa & ((1u << shift) - 1);
+        const uint32_t halfway = 1u << (shift - 1);
+        uint32_t result = halfMantissa;
+        if (remainder > halfway || (remainder == halfway && (halfMantissa & 1) != 0)) {
+            result++;
+        }
+        return sign | static_cast<uint16_t>(result);
+    }
+
+    // normal number, rebias the exponent and round the mantissa to nearest even
+    uint32_t result = absX - 0x38000000;
+    result += 0x0FFF + ((result >> 13) & 1);
+    return sign | static_cast<uint16_t>(result >> 13);
+}
+
+float HalfToFloat(const uint16_t h) {
+    const uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+    const uint32_t exponent = (h >> 10) & 0x1F;
+    uint32_t mantissa = h & 0x03FF;
+
+    uint32_t x;
+    if (exponent == 0x1F) {
+        x = sign | 0x7F800000 | (mantissa << 13);
+    } else if (exponent != 0) {
+        x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    } else if (mantissa != 0) {
+        // denormal half, normalize it
+        uint32_t e = 113;
+        while ((mantissa & 0x0400) == 0) {
+            mantissa <<= 1;
+            e--;
+        }
+        x = sign | (e << 23) | ((mantissa & 0x03FF) << 13);
+    } else {
+        x = sign;
+    }
+
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+static float SignNotZero(const float v) {
+    return v >= 0.0f ? 1.0f : -1.0f;
+}
+
+Vector2f OctahedralEncode(const Vector3f& n) {
+    const float l1 = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+    if (l1 <= 0.0f) {
+        return Vector2f(0.0f, 0.0f);
+    }
+    Vector2f e(n.x / l1, n.y / l1);
+    if (n.z < 0.0f) {
+        // fold the lower hemisphere over the diagonals
+        e = Vector2f(
+            (1.0f - fabsf(e.y)) * SignNotZero(e.x), (1.0f - fabsf(e.x)) * SignNotZero(e.y));
+    }
+    return e;
+}
+
+Vector3f OctahedralDecode(const Vector2f& e) {
+    Vector3f n(e.x, e.y, 1.0f - fabsf(e.x) - fabsf(e.y));
+    if (n.z < 0.0f) {
+        n.x = (1.0f - fabsf(e.y)) * SignNotZero(e.x);
+        n.y = (1.0f - fabsf(e.x)) * SignNotZero(e.y);
+    }
+    return n.Normalized();
+}
+
+int VertexFormatSize(const eVertexFormat format, const int components) {
+    switch (format) {
+        case VERTEX_FORMAT_NONE:
+            return 0;
+        case VERTEX_FORMAT_FLOAT:
+        case VERTEX_FORMAT_INT32:
+            return 4 * components;
+        case VERTEX_FORMAT_HALF:
+        case VERTEX_FORMAT_SNORM16:
+        case VERTEX_FORMAT_UNORM16:
+        case VERTEX_FORMAT_UINT16:
+            return (2 * components + 3) & ~3;
+        case VERTEX_FORMAT_SNORM8:
+        case VERTEX_FORMAT_UNORM8:
+        case VERTEX_FORMAT_UINT8:
+            return (components + 3) & ~3;
+        case VERTEX_FORMAT_OCTAHEDRAL16:
+            return 4;
+    }
+    return 0;
+}
+
+namespace {
+
+// Source data of one attribute as a flat array of components.
+struct SourceAttribute {
+    const float* floats;
+    const int* ints;
+    int count;
+    int components;
+};
+
+SourceAttribute GetSourceAttribute(const VertexAttribs& attribs, const int attribute) {
+    SourceAttribute s = {nullptr, nullptr, 0, 0};
+    switch (attribute) {
+        case VERTEX_ATTRIBUTE_POSITION:
+            s.floats = reinterpret_cast<const float*>(attribs.position.data());
+            s.count = static_cast<int>(attribs.position.size());
+            s.components = 3;
+            break;
+        case VERTEX_ATTRIBUTE_NORMAL:
+            s.floats = reinterpret_cast<const float*>(attribs.normal.data());
+            s.count = static_cast<int>(attribs.normal.size());
+            s.components = 3;
+            break;
+        case VERTEX_ATTRIBUTE_TANGENT:
+            s.floats = reinterpret_cast<const float*>(attribs.tangent.data());
+            s.count = static_cast<int>(attribs.tangent.size());
+            s.components = 3;
+            break;
+        case VERTEX_ATTRIBUTE_BINORMAL:
+            s.floats = reinterpret_cast<const float*>(attribs.binormal.data());
+            s.count = static_cast<int>(attribs.binormal.size());
+            s.components = 3;
+            break;
+        case VERTEX_ATTRIBUTE_COLOR:
+            s.floats = reinterpret_cast<const float*>(attribs.color.data());
+            s.count = static_cast<int>(attribs.color.size());
+            s.components = 4;
+            break;
+        case VERTEX_ATTRIBUTE_UV0:
+            s.floats = reinterpret_cast<const float*>(attribs.uv0.data());
+            s.count = static_cast<int>(attribs.uv0.size());
+            s.components = 2;
+            break;
+        case VERTEX_ATTRIBUTE_UV1:
+            s.floats = reinterpret_cast<const float*>(attribs.uv1.data());
+            s.count = static_cast<int>(attribs.uv1.size());
+            s.components = 2;
+            break;
+        case VERTEX_ATTRIBUTE_JOINT_INDICES:
+            s.ints = reinterpret_cast<const int*>(attribs.jointIndices.data());
+            s.count = static_cast<int>(attribs.jointIndices.size());
+            s.components = 4;
+            break;
+        case VERTEX_ATTRIBUTE_JOINT_WEIGHTS:
+            s.floats = reinterpret_cast<const float*>(attribs.jointWeights.data());
+            s.count = static_cast<int>(attribs.jointWeights.size());
+            s.components = 4;
+            break;
+    }
+    return s;
+}
+
+template <typename _type_>
+void Store(uint8_t* dst, const int component, const _type_ value) {
+    memcpy(dst + component * sizeof(_type_), &value, sizeof(_type_));
+}
+
+int QuantizeSigned(const float v, const int maxValue) {
+    return static_cast<int>(roundf(std::min(std::max(v, -1.0f), 1.0f) * maxValue));
+}
+
+int QuantizeUnsigned(const float v, const int maxValue) {
+    return static_cast<int>(roundf(std::min(std::max(v, 0.0f), 1.0f) * maxValue));
+}
+
+// Picks the rounding of each component that decodes closest to the original direction.
+void StoreOctahedral(uint8_t* dst, const Vector3f& n) {
+    const Vector2f e = OctahedralEncode(n);
+    const float fx = floorf(std::min(std::max(e.x, -1.0f), 1.0f) * 32767.0f);
+    const float fy = floorf(std::min(std::max(e.y, -1.0f), 1.0f) * 32767.0f);
+    const Vector3f target = n.Normalized();
+
+    int bestX = static_cast<int>(fx);
+    int bestY = static_cast<int>(fy);
+    float bestDot = -2.0f;
+    for (int i = 0; i < 4; ++i) {
+        const int qx = std::min(static_cast<int>(fx) + (i & 1), 32767);
+        const int qy = std::min(static_cast<int>(fy) + (i >> 1), 32767);
+        const float dot = OctahedralDecode(Vector2f(qx / 32767.0f, qy / 32767.0f)).Dot(target);
+        if (dot > bestDot) {
+            bestDot = dot;
+            bestX = qx;
+            bestY = qy;
+        }
+    }
+    Store(dst, 0, static_cast<int16_t>(bestX));
+    Store(dst, 1, static_cast<int16_t>(bestY));
+}
+
+// Quantizes normalized weights so the stored values still add up to exactly maxValue.
+void StoreWeights(uint8_t* dst, const eVertexFormat format, const float* w) {
+    const int maxValue = format == VERTEX_FORMAT_UNORM8 ? 255 : 65535;
+    float sum = 0.0f;
+    for (int c = 0; c < 4; ++c) {
+        sum += std::max(w[c], 0.0f);
+    }
+    int q[4];
+    float remainder[4];
+    int total = 0;
+    for (int c = 0; c < 4; ++c) {
+        const float scaled = sum > 0.0f ? std::max(w[c], 0.0f) / sum * maxValue : 0.0f;
+        q[c] = static_cast<int>(floorf(scaled));
+        remainder[c] = scaled - q[c];
+        total += q[c];
+    }
+    // hand the rounding error to the components that lost the most
+    while (sum > 0.0f && total < maxValue) {
+        int best = 0;
+        for (int c = 1; c < 4; ++c) {
+            if (remainder[c] > remainder[best]) {
+                best = c;
+            }
+        }
+        q[best]++;
+        remainder[best] = -1.0f;
+        total++;
+    }
+    for (int c = 0; c < 4; ++c) {
+        if (format == VERTEX_FORMAT_UNORM8) {
+            Store(dst, c, static_cast<uint8_t>(q[c]));
+        } else {
+            Store(dst, c, static_cast<uint16_t>(q[c]));
+        }
+    }
+}
+
+void StoreElement(
+    uint8_t* dst,
+    const eVertexAttribute attribute,
+    const eVertexFormat format,
+    const SourceAttribute& src,
+    const int index) {
+    if (index >= src.count) {
+        // missing data is left zeroed
+        return;
+    }
+    const float* f = src.floats != nullptr ? src.floats + index * src.components : nullptr;
+    const int* n = src.ints != nullptr ? src.ints + index * src.components : nullptr;
+
+    if (format == VERTEX_FORMAT_OCTAHEDRAL16 && f != nullptr && src.components == 3) {
+        StoreOctahedral(dst, Vector3f(f[0], f[1], f[2]));
+        return;
+    }
+    if (attribute == VERTEX_ATTRIBUTE_JOINT_WEIGHTS && f != nullptr &&
+        (format == VERTEX_FORMAT_UNORM8 || format == VERTEX_FORMAT_UNORM16)) {
+        StoreWeights(dst, format, f);
+        return;
+    }
+
+    for (int c = 0; c < src.components; ++c) {
+        const float v = f != nullptr ? f[c] : static_cast<float>(n[c]);
+        const int i = n != nullptr ? n[c] : (fabsf(v) < 2147483520.0f ? static_cast<int>(v) : 0);
+        switch (format) {
+            case VERTEX_FORMAT_NONE:
+            case VERTEX_FORMAT_OCTAHEDRAL16:
+                break;
+            case VERTEX_FORMAT_FLOAT:
+                Store(dst, c, v);
+                break;
+            case VERTEX_FORMAT_HALF:
+                Store(dst, c, FloatToHalf(v));
+                break;
+            case VERTEX_FORMAT_SNORM16:
+                Store(dst, c, static_cast<int16_t>(QuantizeSigned(v, 32767)));
+                break;
+            case VERTEX_FORMAT_SNORM8:
+                Store(dst, c, static_cast<int8_t>(QuantizeSigned(v, 127)));
+                break;
+            case VERTEX_FORMAT_UNORM16:
+                Store(dst, c, static_cast<uint16_t>(QuantizeUnsigned(v, 65535)));
+                break;
+            case VERTEX_FORMAT_UNORM8:
+                Store(dst, c, static_cast<uint8_t>(QuantizeUnsigned(v, 255)));
+                break;
+            case VERTEX_FORMAT_INT32:
+                Store(dst, c, static_cast<int32_t>(i));
+                break;
+            case VERTEX_FORMAT_UINT16:
+                Store(dst, c, static_cast<uint16_t>(std::min(std::max(i, 0), 65535)));
+                break;
+            case VERTEX_FORMAT_UINT8:
+                Store(dst, c, static_cast<uint8_t>(std::min(std::max(i, 0), 255)));
+                break;
+        }
+    }
+}
+
+} // namespace
+
+void PackVertexAttribs(
+    const VertexAttribs& attribs,
+    const VertexLayout& layout,
+    std::vector<uint8_t>& packed,
+    std::vector<VertexAttributeBinding>& bindings) {
+    const int vertexCount = static_cast<int>(attribs.position.size());
+
+    packed.resize(0);
+    bindings.resize(0);
+
+    SourceAttribute sources[VERTEX_ATTRIBUTE_MAX];
+    int offset = 0;
+    for (int a = 0; a < VERTEX_ATTRIBUTE_MAX; ++a) {
+        sources[a] = GetSourceAttribute(attribs, a);
+        const SourceAttribute& src = sources[a];
+        const eVertexFormat format = layout.format[a];
+        if (src.count == 0 || format == VERTEX_FORMAT_NONE) {
+            continue;
+        }
+        if (format == VERTEX_FORMAT_OCTAHEDRAL16 && src.components != 3) {
+            ALOGW("PackVertexAttribs: attribute %d can not be stored as octahedral", a);
+            continue;
+        }
+        if (src.count != vertexCount) {
+            ALOGW(
+                "PackVertexAttribs: attribute %d has %d elements for %d vertices",
+                a,
+                src.count,
+                vertexCount);
+        }
+
+        VertexAttributeBinding binding;
+        binding.attribute = static_cast<eVertexAttribute>(a);
+        binding.format = format;
+        binding.components = format == VERTEX_FORMAT_OCTAHEDRAL16 ? 2 : src.components;
+        binding.offset = offset;
+        binding.stride = VertexFormatSize(format, src.components);
+        bindings.push_back(binding);
+
+        if (layout.interleaved) {
+            offset += binding.stride;
+        } else {
+            // non-interleaved attributes each get a block covering every vertex
+            offset += binding.stride * vertexCount;
+        }
+    }
+
+    if (layout.interleaved) {
+        for (VertexAttributeBinding& b : bindings) {
+            b.stride = offset;
+        }
+        packed.resize(static_cast<size_t>(offset) * vertexCount, 0);
+    } else {
+        packed.resize(offset, 0);
+    }
+
+    for (const VertexAttributeBinding& b : bindings) {
+        const SourceAttribute& src = sources[b.attribute];
+        uint8_t* dst = packed.data() + b.offset;
+        for (int v = 0; v < vertexCount; ++v, dst += b.stride) {
+            StoreElement(dst, b.attribute, b.format, src, v);
+        }
+    }
+}
+
+VertexLayout VertexLayout::Compact(const VertexAttribs& attribs) {
+    // Half floats keep 11 significant bits, which is within 2 mm for positions up to 4 meters
+    // from the origin and within 1/4096 for texture coordinates in [-1, 1].
+    static const float MAX_HALF_POSITION = 4.0f;
+    static const float MAX_HALF_UV = 1.0f;
+
+    VertexLayout layout;
+    layout.interleaved = true;
+
+    float maxPosition = 0.0f;
+    for (const Vector3f& p : attribs.position) {
+        maxPosition = std::max(maxPosition, std::max(fabsf(p.x), std::max(fabsf(p.y), fabsf(p.z))));
+    }
+    layout.format[VERTEX_ATTRIBUTE_POSITION] =
+        maxPosition <= MAX_HALF_POSITION ? VERTEX_FORMAT_HALF : VERTEX_FORMAT_FLOAT;
+
+    layout.format[VERTEX_ATTRIBUTE_NORMAL] = VERTEX_FORMAT_SNORM8;
+    layout.format[VERTEX_ATTRIBUTE_TANGENT] = VERTEX_FORMAT_SNORM8;
+    layout.format[VERTEX_ATTRIBUTE_BINORMAL] = VERTEX_FORMAT_SNORM8;
+
+    // HDR or negative vertex colors can not use unorm8
+    bool unitColor = true;
+    for (const Vector4f& c : attribs.color) {
+        for (int i = 0; i < 4; ++i) {
+            unitColor = unitColor && c[i] >= 0.0f && c[i] <= 1.0f;
+        }
+    }
+    layout.format[VERTEX_ATTRIBUTE_COLOR] = unitColor ? VERTEX_FORMAT_UNORM8 : VERTEX_FORMAT_HALF;
+
+    const std::vector<Vector2f>* uvs[2] = {&attribs.uv0, &attribs.uv1};
+    for (int i = 0; i < 2; ++i) {
+        float maxUv = 0.0f;
+        for (const Vector2f& uv : *uvs[i]) {
+            maxUv = std::max(maxUv, std::max(fabsf(uv.x), fabsf(uv.y)));
+        }
+        layout.format[VERTEX_ATTRIBUTE_UV0 + i] =
+            maxUv <= MAX_HALF_UV ? VERTEX_FORMAT_HALF : VERTEX_FORMAT_FLOAT;
+    }
+
+    int maxJoint = 0;
+    for (const Vector4i& j : attribs.jointIndices) {
+        maxJoint = std::max(maxJoint, std::max(std::max(j.x, j.y), std::max(j.z, j.w)));
+    }
+    layout.format[VERTEX_ATTRIBUTE_JOINT_INDICES] =
+        maxJoint < 256 ? VERTEX_FORMAT_UINT8 : VERTEX_FORMAT_UINT16;
+    layout.format[VERTEX_ATTRIBUTE_JOINT_WEIGHTS] = VERTEX_FORMAT_UNORM8;
+
+    return layout;
+}
+
+} // namespace OVRFW
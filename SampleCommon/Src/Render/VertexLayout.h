@@ -0,0 +1,110 @@
+// (c) Meta Platforms, Inc. and affiliates. Confidential and proprietary.
+
+/************************************************************************************
+
+Filename    :   VertexLayout.h
+Content     :   Vertex formats and CPU packing of vertex attributes.
+Created     :   October 2026
+
+*************************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "OVR_Math.h"
+
+namespace OVRFW {
+
+struct VertexAttribs {
+    std::vector<OVR::Vector3f> position;
+    std::vector<OVR::Vector3f> normal;
+    std::vector<OVR::Vector3f> tangent;
+    std::vector<OVR::Vector3f> binormal;
+    std::vector<OVR::Vector4f> color;
+    std::vector<OVR::Vector2f> uv0;
+    std::vector<OVR::Vector2f> uv1;
+    std::vector<OVR::Vector4i> jointIndices;
+    std::vector<OVR::Vector4f> jointWeights;
+};
+
+// Storage format of one vertex attribute in the vertex buffer.
+enum eVertexFormat {
+    VERTEX_FORMAT_NONE, // attribute is not stored
+    VERTEX_FORMAT_FLOAT, // 32-bit float per component
+    VERTEX_FORMAT_HALF, // 16-bit float per component
+    VERTEX_FORMAT_SNORM16, // [-1, 1] as normalized 16-bit integers
+    VERTEX_FORMAT_SNORM8, // [-1, 1] as normalized 8-bit integers
+    VERTEX_FORMAT_UNORM16, // [0, 1] as normalized 16-bit unsigned integers
+    VERTEX_FORMAT_UNORM8, // [0, 1] as normalized 8-bit unsigned integers
+    VERTEX_FORMAT_OCTAHEDRAL16, // unit vector as 2 snorm16, see OctahedralDecode in GLSL
+    VERTEX_FORMAT_INT32, // integer attributes
+    VERTEX_FORMAT_UINT16,
+    VERTEX_FORMAT_UINT8,
+};
+
+enum eVertexAttribute {
+    VERTEX_ATTRIBUTE_POSITION,
+    VERTEX_ATTRIBUTE_NORMAL,
+    VERTEX_ATTRIBUTE_TANGENT,
+    VERTEX_ATTRIBUTE_BINORMAL,
+    VERTEX_ATTRIBUTE_COLOR,
+    VERTEX_ATTRIBUTE_UV0,
+    VERTEX_ATTRIBUTE_UV1,
+    VERTEX_ATTRIBUTE_JOINT_INDICES,
+    VERTEX_ATTRIBUTE_JOINT_WEIGHTS,
+    VERTEX_ATTRIBUTE_MAX
+};
+
+// Where and how to store each attribute of VertexAttribs.
+struct VertexLayout {
+    VertexLayout() : interleaved(false) {
+        format[VERTEX_ATTRIBUTE_POSITION] = VERTEX_FORMAT_FLOAT;
+        format[VERTEX_ATTRIBUTE_NORMAL] = VERTEX_FORMAT_FLOAT;
+        format[VERTEX_ATTRIBUTE_TANGENT] = VERTEX_FORMAT_FLOAT;
+        format[VERTEX_ATTRIBUTE_BINORMAL] = VERTEX_FORMAT_FLOAT;
+        format[VERTEX_ATTRIBUTE_COLOR] = VERTEX_FORMAT_FLOAT;
+        format[VERTEX_ATTRIBUTE_UV0] = VERTEX_FORMAT_FLOAT;
+        format[VERTEX_ATTRIBUTE_UV1] = VERTEX_FORMAT_FLOAT;
+        format[VERTEX_ATTRIBUTE_JOINT_INDICES] = VERTEX_FORMAT_INT32;
+        format[VERTEX_ATTRIBUTE_JOINT_WEIGHTS] = VERTEX_FORMAT_FLOAT;
+    }
+
+    // Interleaved, quantized layout that existing shaders read unchanged:
+    // snorm8 normals, tangents and binormals, unorm8 colors and weights, uint8 joint indices.
+    // Positions and texture coordinates use half floats only where that keeps their precision.
+    static VertexLayout Compact(const VertexAttribs& attribs);
+
+    bool interleaved; // one block per attribute when false
+    eVertexFormat format[VERTEX_ATTRIBUTE_MAX];
+};
+
+// Where one attribute ended up in the packed vertex data.
+struct VertexAttributeBinding {
+    eVertexAttribute attribute;
+    eVertexFormat format;
+    int components; // components read by the shader
+    int stride;
+    int offset;
+};
+
+// Converts the attributes to the layout's formats. Attributes without data are left out of the
+// bindings. Does not need a GL context.
+void PackVertexAttribs(
+    const VertexAttribs& attribs,
+    const VertexLayout& layout,
+    std::vector<uint8_t>& packed,
+    std::vector<VertexAttributeBinding>& bindings);
+
+// Size in bytes of one stored element, 3 component 8 and 16 bit attributes are padded to 4.
+int VertexFormatSize(const eVertexFormat format, const int components);
+
+uint16_t FloatToHalf(const float f);
+float HalfToFloat(const uint16_t h);
+
+// Octahedral mapping of a unit vector to [-1, 1]^2 and back.
+OVR::Vector2f OctahedralEncode(const OVR::Vector3f& n);
+OVR::Vector3f OctahedralDecode(const OVR::Vector2f& e);
+
+} // namespace OVRFW